@@ -0,0 +1,200 @@
+#include "Aircraft.hpp"
+
+#include <cmath>
+
+
+constexpr static double GRAVITY {9.80665};
+constexpr static double MIN_AIRSPEED {1.0};  // Below this the aerodynamic forces are ignored
+
+
+static double dot(const double* a, const double* b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(const double* a, const double* b, double* result) {
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+Aircraft::Aircraft(const Parameters& parameters):
+  _parameters {parameters} {
+	// Nothing to do
+}
+
+void Aircraft::toWorld(const double* body, double* world) const {
+	const double* q {_state.attitude};
+	double        t[3];
+	double        u[3];
+
+	// v + 2w(q x v) + 2q x (q x v) with the vector part q
+	cross(q + 1, body, t);
+	for (auto& e : t) {
+		e *= 2;
+	}
+	cross(q + 1, t, u);
+	for (int i {0}; i < 3; ++i) {
+		world[i] = body[i] + q[0] * t[i] + u[i];
+	}
+}
+
+void Aircraft::toBody(const double* world, double* body) const {
+	const double* q {_state.attitude};
+	double        conjugate[3] {-q[1], -q[2], -q[3]};
+	double        t[3];
+	double        u[3];
+
+	cross(conjugate, world, t);
+	for (auto& e : t) {
+		e *= 2;
+	}
+	cross(conjugate, t, u);
+	for (int i {0}; i < 3; ++i) {
+		body[i] = world[i] + q[0] * t[i] + u[i];
+	}
+}
+
+void Aircraft::launch(double airspeed, double altitude) {
+	_state = {};
+	_state.position[2] = -altitude;
+	_state.velocity[0] = airspeed;
+	for (int i {0}; i < 3; ++i) {
+		_state.velocity[i] += _wind[i];
+	}
+	_flying = true;
+}
+
+void Aircraft::step(double dt, const double* controls) {
+	for (int i {0}; i < 2; ++i) {
+		double target {controls[i] / 1000.0 * _parameters.maxDeflection};
+		_deflections[i] += (target - _deflections[i]) * dt / (_parameters.servoTime + dt);
+	}
+
+	if (!_flying) {
+		double gravity[3] {0, 0, -GRAVITY};  // Held up by the ground
+		toBody(gravity, _specificForce);
+		return;
+	}
+
+	const Parameters& p {_parameters};
+	double            air[3];
+	double            velocity[3];  // Relative to the air
+	double            force[3] {p.thrust, 0, 0};
+	double            moment[3] {};
+
+	for (int i {0}; i < 3; ++i) {
+		air[i] = _state.velocity[i] - _wind[i];
+	}
+	toBody(air, velocity);
+
+	double airspeed {std::sqrt(dot(velocity, velocity))};
+	if (airspeed > MIN_AIRSPEED) {
+		double alpha {std::atan2(velocity[2], velocity[0])};
+		double beta {std::asin(velocity[1] / airspeed)};
+		double pressure {0.5 * p.airDensity * airspeed * airspeed * p.wingArea};
+		double rates[3] {
+		  _state.rates[0] * p.wingSpan / (2 * airspeed),
+		  _state.rates[1] * p.chord / (2 * airspeed),
+		  _state.rates[2] * p.wingSpan / (2 * airspeed)
+		};
+
+		double cl {p.cl0 + p.clAlpha * alpha};
+		cl = cl > p.clMax ? p.clMax : cl < -p.clMax ? -p.clMax : cl;
+		double cd {p.cd0 + p.cdInduced * cl * cl};
+
+		// Lift is perpendicular to the airflow in the symmetry plane, drag is against it
+		force[0] += pressure * (cl * std::sin(alpha) - cd * velocity[0] / airspeed);
+		force[1] += pressure * (p.cyBeta * beta - cd * velocity[1] / airspeed);
+		force[2] += pressure * (-cl * std::cos(alpha) - cd * velocity[2] / airspeed);
+
+		moment[0] = pressure * p.wingSpan
+		          * (p.rollBeta * beta + p.rollRate * rates[0] + p.rollYawRate * rates[2] + p.rollAileron * _deflections[0]);
+		moment[1] = pressure * p.chord
+		          * (p.pitch0 + p.pitchAlpha * alpha + p.pitchRate * rates[1] + p.pitchElevator * _deflections[1]);
+		moment[2] = pressure * p.wingSpan
+		          * (p.yawBeta * beta + p.yawRollRate * rates[0] + p.yawRate * rates[2] + p.yawAileron * _deflections[0]);
+	}
+
+	for (int i {0}; i < 3; ++i) {
+		_specificForce[i] = force[i] / p.mass;
+	}
+
+	// Euler's equations with the principal moments of inertia
+	double momentum[3];
+	double gyroscopic[3];
+	for (int i {0}; i < 3; ++i) {
+		momentum[i] = p.inertia[i] * _state.rates[i];
+	}
+	cross(_state.rates, momentum, gyroscopic);
+
+	double acceleration[3];
+	toWorld(_specificForce, acceleration);
+	acceleration[2] += GRAVITY;
+
+	for (int i {0}; i < 3; ++i) {
+		_state.rates[i] += (moment[i] - gyroscopic[i]) / p.inertia[i] * dt;
+		_state.velocity[i] += acceleration[i] * dt;
+		_state.position[i] += _state.velocity[i] * dt;
+	}
+
+	// Integrating the attitude with the new rates, q' = q * (0, w) / 2
+	double* q {_state.attitude};
+	double  w[3] {_state.rates[0] * dt / 2, _state.rates[1] * dt / 2, _state.rates[2] * dt / 2};
+	double  next[4] {
+	  q[0] - q[1] * w[0] - q[2] * w[1] - q[3] * w[2],
+	  q[1] + q[0] * w[0] + q[2] * w[2] - q[3] * w[1],
+	  q[2] + q[0] * w[1] - q[1] * w[2] + q[3] * w[0],
+	  q[3] + q[0] * w[2] + q[1] * w[1] - q[2] * w[0]
+	};
+	double norm {std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3])};
+	for (int i {0}; i < 4; ++i) {
+		q[i] = next[i] / norm;
+	}
+
+	if (_state.position[2] > 0) {  // Hit the ground
+		_flying = false;
+		_state.velocity[0] = _state.velocity[1] = _state.velocity[2] = 0;
+		_state.rates[0] = _state.rates[1] = _state.rates[2] = 0;
+	}
+}
+
+void Aircraft::setWind(const double* wind) {
+	for (int i {0}; i < 3; ++i) {
+		_wind[i] = wind[i];
+	}
+}
+
+const Aircraft::State& Aircraft::getState() const {
+	return _state;
+}
+
+const double* Aircraft::getSpecificForce() const {
+	return _specificForce;
+}
+
+void Aircraft::getEuler(double& roll, double& pitch, double& yaw) const {
+	const double* q {_state.attitude};
+
+	roll = std::atan2(2 * (q[0] * q[1] + q[2] * q[3]), 1 - 2 * (q[1] * q[1] + q[2] * q[2]));
+	pitch = std::asin(2 * (q[0] * q[2] - q[3] * q[1]));
+	yaw = std::atan2(2 * (q[0] * q[3] + q[1] * q[2]), 1 - 2 * (q[2] * q[2] + q[3] * q[3]));
+}
+
+double Aircraft::getAltitude() const {
+	return -_state.position[2];
+}
+
+double Aircraft::getAirspeed() const {
+	double air[3];
+	double velocity[3];
+
+	for (int i {0}; i < 3; ++i) {
+		air[i] = _state.velocity[i] - _wind[i];
+	}
+	toBody(air, velocity);
+	return std::sqrt(dot(velocity, velocity));
+}
+
+bool Aircraft::flying() const {
+	return _flying;
+}
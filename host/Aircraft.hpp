@@ -0,0 +1,92 @@
+/*
+ * File:   Aircraft.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 10:20 PM
+ */
+
+#ifndef AIRCRAFT_HPP
+#define AIRCRAFT_HPP
+
+/* Rigid-body model of a small fixed-wing aircraft for the simulator, six degrees of freedom
+ * with linear aerodynamic coefficients, constant thrust and first-order servos.
+ * The model uses the usual flight dynamics axes, north-east-down for the world and forward-right-down for the body,
+ * conversion to the axes of the flight computer is left to the caller.
+ * Angles are in radians, everything else in SI units.
+ */
+
+class Aircraft {
+public:
+	struct Parameters {
+		double mass {1.2};
+		double inertia[3] {0.03, 0.05, 0.07};  // Principal moments, kg*m^2
+		double wingArea {0.3};
+		double wingSpan {1.4};
+		double chord {0.22};
+		double airDensity {1.225};
+		double thrust {2.0};  // N, enough to cruise at about 15m/s
+
+		double cl0 {0.25};
+		double clAlpha {4.8};
+		double clMax {1.2};  // Lift stops growing past this, a crude stall
+		double cd0 {0.05};
+		double cdInduced {0.05};  // Times CL squared
+		double cyBeta {-0.3};
+
+		double rollBeta {-0.12};
+		double rollRate {-0.45};
+		double rollYawRate {0.1};
+		double rollAileron {0.2};
+
+		double pitch0 {0.005};
+		double pitchAlpha {-0.6};
+		double pitchRate {-10.0};
+		double pitchElevator {-0.8};
+
+		double yawBeta {0.08};
+		double yawRollRate {-0.03};
+		double yawRate {-0.12};
+		double yawAileron {-0.01};
+
+		double maxDeflection {0.35};  // At a servo value of 1000
+		double servoTime {0.03};      // Time constant, s
+	};
+
+	struct State {
+		double position[3] {};  // World, m
+		double velocity[3] {};  // World, m/s
+		double attitude[4] {1, 0, 0, 0};  // Body to world quaternion, w first
+		double rates[3] {};               // Body, rad/s
+	};
+
+	Aircraft() = default;
+	explicit Aircraft(const Parameters& parameters);
+
+	// Level flight at the airspeed, heading north, carried along by the wind
+	void launch(double airspeed, double altitude);
+	// Controls are the servo values from -1000 to 1000, aileron and elevator
+	void step(double dt, const double* controls);
+	// Velocity of the air in world axes, m/s
+	void setWind(const double* wind);
+
+	const State& getState() const;
+	// Acceleration without gravity in body axes, what an accelerometer measures, m/s^2
+	const double* getSpecificForce() const;
+	void          getEuler(double& roll, double& pitch, double& yaw) const;
+	double        getAltitude() const;
+	double        getAirspeed() const;
+	bool          flying() const;
+
+protected:
+	void toBody(const double* world, double* body) const;
+	void toWorld(const double* body, double* world) const;
+
+	Parameters _parameters {};
+	State      _state {};
+	double     _specificForce[3] {0, 0, -9.80665};  // Resting on the ground
+	double     _deflections[2] {};
+	double     _wind[3] {};
+	bool       _flying {false};
+};
+
+#endif /* AIRCRAFT_HPP */
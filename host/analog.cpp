@@ -0,0 +1,31 @@
+#include "analog.hpp"
+
+#include "host.hpp"
+
+
+static uint16_t batteryVoltage {0};
+static uint16_t current {0};
+static int8_t   temperature {25};
+
+
+void analog::init() {
+	// Nothing to do
+}
+
+int8_t analog::getTemperature() {
+	return temperature;
+}
+
+uint16_t analog::getBatteryVoltage() {
+	return batteryVoltage;
+}
+
+uint16_t analog::getCurrent() {
+	return current;
+}
+
+void host::setAnalog(uint16_t newBatteryVoltage, uint16_t newCurrent, int8_t newTemperature) {
+	batteryVoltage = newBatteryVoltage;
+	current = newCurrent;
+	temperature = newTemperature;
+}
@@ -0,0 +1,22 @@
+/*
+ * File:   device.h
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 9:30 PM
+ */
+
+#ifndef HOST_DEVICE_H
+#define HOST_DEVICE_H
+
+/* Stands in for the device header in the host build, the portable code only needs the standard types
+ * and the interrupt masking, which does nothing since host interrupts are delivered from util::sleepUntil().
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+inline void __disable_irq() {}
+
+inline void __enable_irq() {}
+
+#endif /* HOST_DEVICE_H */
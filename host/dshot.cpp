@@ -0,0 +1,33 @@
+#include "dshot.hpp"
+
+#include "host.hpp"
+
+
+static uint16_t throttles[dshot::motorNumber] {};
+static bool     enabled {false};
+
+
+bool dshot::init(Protocol protocol) {
+	enabled = protocol != Protocol::Off && protocol <= Protocol::DShot300Bidirectional;
+	return enabled;
+}
+
+bool dshot::setThrottle(const uint16_t* values, bool telemetry) {
+	for (uint8_t i {0}; i < motorNumber; ++i) {
+		throttles[i] = values[i] ? util::clamp(values[i], DShotCodec::throttleMin, DShotCodec::throttleMax)
+		                         : static_cast<uint16_t>(0);
+	}
+	return true;
+}
+
+void dshot::update() {
+	// Nothing to do, the ESCs send no telemetry
+}
+
+uint32_t dshot::getERPM(uint8_t motor) {
+	return 0;
+}
+
+uint16_t host::getThrottle(uint8_t motor) {
+	return enabled && motor < dshot::motorNumber ? throttles[motor] : 0;
+}
@@ -0,0 +1,241 @@
+#include "flash.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "host.hpp"
+#include "util.hpp"
+
+/* Model of the NVMCTRL with the RWWEE section: commands change the memory right away, but the controller
+ * stays busy for the time the datasheet allows for them. The completion notification comes once that time
+ * has passed, the next time the main loop sleeps. Starting a command while busy is an error of the caller
+ * and ends the process.
+ * Polling ready() takes 1us each time, so in simulated time the clock moves on while the caller waits.
+ * Reading the section while a command runs stalls until it is done, like the bus of the device: the memory is
+ * protected from the start of a command and the first read after that waits for the controller in the fault handler.
+ *
+ * The power can be cut in the middle of a command: an erase only sets some of the bits of the row, a page write
+ * programs a part of the page and leaves the last word it got to half-programmed. The memory is saved and
+ * the process ends right there, like the device losing its RAM.
+ */
+
+constexpr static uint32_t ERASE_TIME {6000};  // us, longest row erase
+constexpr static uint32_t WRITE_TIME {2500};  // us, longest page write
+
+// Starts erased, like the page buffer after every write
+template <class T, uint16_t C>
+struct Erased {
+	T values[C];
+
+	Erased() {
+		for (auto& value : values) {
+			value = static_cast<T>(~T {0});
+		}
+	}
+};
+
+static void stall(int, siginfo_t* info, void*);
+
+// Pages of its own, erased, with the handler for reads while the controller is busy
+static uint8_t* map(size_t& size) {
+	long             page {sysconf(_SC_PAGESIZE)};
+	struct sigaction action {};
+
+	size = (flash::size + page - 1) / page * page;
+	void* mapped {mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+	if (mapped == MAP_FAILED) {
+		perror("flash");
+		abort();
+	}
+	std::memset(mapped, 0xff, flash::size);
+
+	action.sa_sigaction = stall;
+	action.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sigaction(SIGSEGV, &action, nullptr);
+	return static_cast<uint8_t*>(mapped);
+}
+
+static size_t                                               mappedSize {0};
+static uint8_t*                                             memory {map(mappedSize)};
+static Erased<uint32_t, flash::pageSize / sizeof(uint32_t)> pageBuffer {};
+static FILE*                                                file {nullptr};
+
+static void (*callback)() {nullptr};
+static bool     notified {false};
+static uint32_t eraseTime {ERASE_TIME};
+static uint32_t writeTime {WRITE_TIME};
+static uint64_t busyUntil {0};  // us
+static uint32_t commands {0};
+static uint32_t cutCommand {0};  // 0 to keep the power on
+static uint32_t noise {0};       // State of the xorshift generator for the partial commands
+static uint64_t stallTime {0};   // us
+
+
+static void save() {
+	if (file) {
+		fseek(file, 0, SEEK_SET);
+		fwrite(memory, 1, flash::size, file);
+		fflush(file);
+	}
+}
+
+static uint32_t nextNoise() {
+	noise ^= noise << 13u;
+	noise ^= noise >> 17u;
+	noise ^= noise << 5u;
+	return noise;
+}
+
+static void cutPower() {
+	save();
+	std::_Exit(host::powerCutStatus);
+}
+
+static bool busy() {
+	return util::getMicros64() < busyUntil;
+}
+
+static void setReadable(bool readable) {
+	mprotect(memory, mappedSize, readable ? PROT_READ | PROT_WRITE : PROT_NONE);
+}
+
+static void stall(int, siginfo_t* info, void*) {
+	auto* address {static_cast<uint8_t*>(info->si_addr)};
+
+	if (address < memory || address >= memory + flash::size) {  // Not the section, crashing as without the handler
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+
+	if (busy()) {
+		stallTime += busyUntil - util::getMicros64();
+	}
+	while (busy()) {  // The simulation may read the section again in the meantime, the handler is reentered then
+		host::_internal::spin(busyUntil - util::getMicros64());  // In real time the time passes by itself
+	}
+	setReadable(true);  // The read is repeated once the handler returns
+}
+
+static void start(const char* command, uint32_t duration) {
+	if (busy()) {
+		fprintf(stderr, "Flash %s started while the controller is busy\n", command);
+		abort();
+	}
+	busyUntil = util::getMicros64() + duration;
+	++commands;
+	setReadable(true);  // For the model itself, protected again once the command changed the memory
+}
+
+// Timers of cancelled notifications may still come, only the one for the current command is passed on
+static void complete() {
+	if (notified && !busy()) {
+		notified = false;
+		callback();
+	}
+}
+
+bool host::openFlash(const char* path) {
+	file = fopen(path, "r+b");
+	if (!file) {
+		file = fopen(path, "w+b");
+	}
+	if (!file) {
+		return false;
+	}
+
+	setReadable(true);
+	if (fread(memory, 1, flash::size, file) != flash::size) {  // A new file is erased
+		std::memset(memory, 0xff, flash::size);
+		save();
+	}
+	return true;
+}
+
+void flash::init(void (*cb)()) {
+	callback = cb;
+}
+
+const uint8_t* flash::getAddress() {
+	return memory;
+}
+
+void host::setFlashTiming(uint32_t rowErase, uint32_t pageWrite) {
+	eraseTime = rowErase;
+	writeTime = pageWrite;
+}
+
+uint64_t host::getFlashStallTime() {
+	return stallTime;
+}
+
+void host::cutFlashPower(uint32_t command, uint32_t seed) {
+	cutCommand = commands + command;
+	noise = seed ? seed : 1;
+}
+
+void flash::eraseRow(uint16_t offset) {
+	start("erase", eraseTime);
+	offset -= offset % rowSize;
+	if (commands == cutCommand) {
+		for (uint16_t i {0}; i < rowSize; ++i) {
+			memory[offset + i] |= nextNoise();
+		}
+		cutPower();
+	}
+
+	for (uint16_t i {0}; i < rowSize; ++i) {
+		memory[offset + i] = 0xff;
+	}
+	save();
+	setReadable(false);
+}
+
+volatile uint32_t* flash::getPageBuffer(uint16_t offset) {
+	return pageBuffer.values + offset % pageSize / sizeof(uint32_t);
+}
+
+void flash::writePage(uint16_t offset) {
+	const uint8_t* src {reinterpret_cast<const uint8_t*>(pageBuffer.values)};
+
+	start("write", writeTime);
+	offset -= offset % pageSize;
+	if (commands == cutCommand) {
+		uint8_t written = nextNoise() % pageSize;
+
+		for (uint8_t i {0}; i < written; ++i) {
+			memory[offset + i] &= src[i];
+		}
+		for (uint8_t i = written; i < (written | 0x3) + 1; ++i) {  // The rest of the word is partly programmed
+			memory[offset + i] &= src[i] | nextNoise();
+		}
+		cutPower();
+	}
+
+	for (uint8_t i {0}; i < pageSize; ++i) {  // Programming only clears bits
+		memory[offset + i] &= src[i];
+	}
+	pageBuffer = {};
+	save();
+	setReadable(false);
+}
+
+bool flash::ready() {
+	if (busy()) {
+		host::_internal::spin(1);
+		return false;
+	}
+	return true;
+}
+
+void flash::notify() {
+	notified = true;
+	host::_internal::postAt(busyUntil, complete);
+}
+
+void flash::cancel() {
+	notified = false;
+}
@@ -0,0 +1,112 @@
+/*
+ * File:   host.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 9:30 PM
+ */
+
+#ifndef HOST_HPP
+#define HOST_HPP
+
+#include <cstdint>
+
+/* Host implementation of the drivers, so that main.cpp and everything that doesn't touch registers
+ * runs as a Linux process. The drivers in this directory replace their SAML21 counterparts in src/ at link time,
+ * their headers in inc/ stay the same.
+ *
+ * Build from the repository root:
+ *   g++ -std=gnu++17 -O2 -Ihost -Iinc -o flight-computer main.cpp host/analog.cpp host/dshot.cpp host/flash.cpp \
+ *       host/i2c.cpp host/servo.cpp host/uart.cpp host/usb.cpp host/util.cpp src/AttitudeEstimator.cpp \
+ *       src/BlackboxCodec.cpp src/CompanionCodec.cpp src/DShotCodec.cpp src/LSM6DSO32.cpp src/Madgwick.cpp \
+ *       src/Mahony.cpp src/Quaternion.cpp src/ReceiverParser.cpp src/blackbox.cpp src/companion.cpp src/data.cpp \
+ *       src/flight.cpp src/nvm.cpp src/profiler.cpp src/receiver.cpp
+ * Adding host/Aircraft.cpp and host/simulator.cpp builds the simulator instead, see simulator.cpp.
+ *
+ * Peripherals are connected by environment variables read in util::init(), unset ones are left disconnected:
+ *   FC_UART1, FC_UART2, FC_UART3  A FIFO, a terminal, "udp:<port>" or a regular file that is only written to
+ *   FC_USB                        "udp:<port>", datagrams carry the endpoint 1 requests and the responses
+ *   FC_FLASH                      File holding the flash section, created erased if missing
+ * A simulated LSM6DSO32 at rest is attached to the I2C bus.
+ *
+ * Everything runs on one thread. Received data and completed flash commands are handled in util::sleepUntil(),
+ * the same way interrupts wake the device up from sleep.
+ */
+
+namespace host {
+	class I2CDevice {
+	public:
+		// Return false to NACK the transfer
+		virtual bool read(uint8_t regAddr, uint8_t* buf, uint8_t size) = 0;
+		virtual bool write(uint8_t regAddr, const uint8_t* buf, uint8_t size) = 0;
+
+	protected:
+		~I2CDevice() = default;
+	};
+
+	// Output registers of an LSM6DSO32 set directly, in sensor axes and LSB, starts level and at rest
+	class SimulatedIMU: public I2CDevice {
+	public:
+		SimulatedIMU();
+
+		bool read(uint8_t regAddr, uint8_t* buf, uint8_t size) override;
+		bool write(uint8_t regAddr, const uint8_t* buf, uint8_t size) override;
+
+		void setAccelerations(const int16_t* accelerations);
+		void setAngularRates(const int16_t* angularRates);
+
+	protected:
+		uint8_t _registers[0x80] {};
+	};
+
+	/* Switches to simulated time before util::init(): time only passes in util::sleepUntil(), in steps of the given
+	 * length in us, and the handler is called after each step. Received data is still handled but never waited for,
+	 * so the flight logic runs as fast as the CPU allows.
+	 */
+	void simulate(uint32_t step, void (*handler)(uint64_t time));
+
+	void attachI2C(uint8_t address, I2CDevice* device);
+	// The IMU attached by default
+	SimulatedIMU& getIMU();
+
+	// Returns false if the port could not be opened
+	bool openUART(uint8_t port, const char* path);
+	// Hands bytes to the port as if they were received
+	void receiveUART(uint8_t port, const uint8_t* buf, uint8_t len);
+
+	bool    getServoEnabled(uint8_t channel);
+	int16_t getServo(uint8_t channel);
+	// DShot throttle of the motor, 0 if stopped or DShot is not used
+	uint16_t getThrottle(uint8_t motor);
+
+	void setAnalog(uint16_t batteryVoltage, uint16_t current, int8_t temperature);
+
+	bool openUSB(const char* path);
+	bool openFlash(const char* path);
+	// Times the flash commands take in us, the longest ones of the datasheet by default
+	void     setFlashTiming(uint32_t rowErase, uint32_t pageWrite);
+	// Time the CPU stalled reading the flash section while a command was running, in us
+	uint64_t getFlashStallTime();
+
+	// Exit status of the process after a power cut
+	constexpr int powerCutStatus {86};
+	// Ends the process in the middle of the given flash command, 1 for the next one, partly done depending on the seed
+	void cutFlashPower(uint32_t command, uint32_t seed);
+
+	namespace _internal {
+		// Calls the handler from util::sleepUntil() once the descriptor can be read
+		void watch(int fd, void (*handler)(int fd));
+		void unwatch(int fd);
+		// Calls the handler from util::sleepUntil() before sleeping, once for each call
+		void post(void (*handler)());
+		// Posts the handler once util::getMicros64() reaches the time, util::sleepUntil() wakes up for it
+		void postAt(uint64_t time, void (*handler)());
+		// Lets the simulated time pass while the caller waits for a peripheral without sleeping, like the CPU
+		// spinning on a register. Nothing is handled in between. In real time the time passes by itself.
+		void spin(uint32_t us);
+
+		// Opens a datagram socket bound to the local port, returns -1 on error
+		int openUDP(uint16_t port);
+	}
+}
+
+#endif /* HOST_HPP */
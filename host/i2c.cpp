@@ -0,0 +1,110 @@
+#include "i2c.hpp"
+
+#include "host.hpp"
+#include "LSM6DSO32_regs.h"
+
+
+constexpr static uint8_t DEVICE_NUMBER {4};
+constexpr static int16_t ONE_G {8197};  // At 0.122mg/LSB
+
+struct Attached {
+	uint8_t           address;
+	host::I2CDevice* device;
+};
+
+static Attached            devices[DEVICE_NUMBER] {};
+static uint8_t             deviceCount {0};
+static host::SimulatedIMU imu {};
+
+
+static host::I2CDevice* find(uint8_t address) {
+	for (uint8_t i {0}; i < deviceCount; ++i) {
+		if (devices[i].address == address) {
+			return devices[i].device;
+		}
+	}
+	return nullptr;
+}
+
+host::SimulatedIMU::SimulatedIMU() {
+	int16_t accelerations[3] {0, 0, ONE_G};  // The Z axis points up
+
+	setAccelerations(accelerations);
+	_registers[LSM6DSO32_WHO_AM_I_ADDR] = LSM6DSO32_WHO_AM_I_RESETVALUE;
+}
+
+bool host::SimulatedIMU::read(uint8_t regAddr, uint8_t* buf, uint8_t size) {
+	if (regAddr + size > sizeof(_registers)) {
+		return false;
+	}
+
+	util::copy(buf, _registers + regAddr, size);
+	return true;
+}
+
+bool host::SimulatedIMU::write(uint8_t regAddr, const uint8_t* buf, uint8_t size) {
+	if (regAddr + size > sizeof(_registers)) {
+		return false;
+	}
+
+	util::copy(_registers + regAddr, buf, size);
+	return true;
+}
+
+void host::SimulatedIMU::setAccelerations(const int16_t* accelerations) {
+	util::copy(_registers + LSM6DSO32_OUTX_L_A_ADDR, reinterpret_cast<const uint8_t*>(accelerations), 6);
+}
+
+void host::SimulatedIMU::setAngularRates(const int16_t* angularRates) {
+	util::copy(_registers + LSM6DSO32_OUTX_L_G_ADDR, reinterpret_cast<const uint8_t*>(angularRates), 6);
+}
+
+void host::attachI2C(uint8_t address, I2CDevice* device) {
+	for (uint8_t i {0}; i < deviceCount; ++i) {
+		if (devices[i].address == address) {
+			devices[i].device = device;
+			return;
+		}
+	}
+
+	if (deviceCount < DEVICE_NUMBER) {
+		devices[deviceCount++] = {address, device};
+	}
+}
+
+host::SimulatedIMU& host::getIMU() {
+	return imu;
+}
+
+void i2c::init() {
+	// Nothing to do, devices are attached in util::init()
+}
+
+// Transfers complete right away, the callback is called before returning
+void i2c::write(uint8_t devAddr, uint8_t regAddr, uint8_t* buf, uint8_t size, void (*cb)(bool, const i2c::Transfer&)) {
+	Transfer         transfer {.devAddr = devAddr, .length = (uint8_t)(size + 1), .flags = {.read = false}, .cb = cb};
+	host::I2CDevice* device {find(devAddr)};
+
+	transfer.buf[0] = regAddr;
+	size = util::min<uint8_t>(size, sizeof(transfer.buf) - 1);
+	util::copy(transfer.buf + 1, buf, size);
+
+	bool success {device && device->write(regAddr, buf, size)};
+	transfer.transferred = success ? transfer.length : 0;
+	if (cb) {
+		cb(success, transfer);
+	}
+}
+
+void i2c::read(uint8_t devAddr, uint8_t regAddr, uint8_t size, void (*cb)(bool, const i2c::Transfer&)) {
+	Transfer         transfer {.devAddr = devAddr, .length = size, .flags = {.read = true}, .cb = cb};
+	host::I2CDevice* device {find(devAddr)};
+
+	size = util::min<uint8_t>(size, sizeof(transfer.buf));
+
+	bool success {device && device->read(regAddr, transfer.buf, size)};
+	transfer.transferred = success ? size : 0;
+	if (cb) {
+		cb(success, transfer);
+	}
+}
@@ -0,0 +1,55 @@
+#include "servo.hpp"
+
+#include "host.hpp"
+
+
+static int16_t values[servo::channelNumber] {};
+static bool    enabled[servo::channelNumber] {};
+static uint8_t ownedGroups {0};
+
+
+// Same groups as on the device
+static bool owned(uint8_t channel) {
+	uint8_t group = channel < 4 ? 0 : channel < 6 ? 1 : 2;
+	return ownedGroups & (1u << group);
+}
+
+void servo::init(uint8_t groups) {
+	ownedGroups = groups & allGroups;
+}
+
+void servo::setRate(uint8_t group, Rate rate) {
+	// Nothing to do, outputs are read as values
+}
+
+void servo::enable(uint8_t channel) {
+	if (channel < channelNumber && owned(channel)) {
+		enabled[channel] = true;
+	}
+}
+
+void servo::disable(uint8_t channel) {
+	if (channel < channelNumber) {
+		enabled[channel] = false;
+	}
+}
+
+void servo::setChannel(uint8_t channel, int16_t angle) {
+	if (channel < channelNumber && owned(channel)) {
+		values[channel] = util::clamp<int16_t>(angle, -1500, 1500);
+	}
+}
+
+void servo::setAll(const int16_t* angles) {
+	for (uint8_t i {0}; i < channelNumber; ++i) {
+		setChannel(i, angles[i]);
+	}
+}
+
+bool host::getServoEnabled(uint8_t channel) {
+	return channel < servo::channelNumber && enabled[channel];
+}
+
+int16_t host::getServo(uint8_t channel) {
+	return channel < servo::channelNumber ? values[channel] : 0;
+}
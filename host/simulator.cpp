@@ -0,0 +1,583 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <random>
+
+#include "Aircraft.hpp"
+#include "data.hpp"
+#include "flight.hpp"
+#include "host.hpp"
+#include "nvm.hpp"
+#include "ReceiverParser.hpp"
+
+/* Software-in-the-loop simulator, flies the unmodified flight logic against the aircraft model in simulated time.
+ * Linked into the host build instead of a real connection, add host/Aircraft.cpp and host/simulator.cpp
+ * to the build command in host.hpp.
+ *
+ * The aircraft sits level on the ground while the gyroscope is calibrated, then it is launched and flown
+ * in the attitude mode through a repeating sequence of roll and pitch steps, or of switches to the inverted
+ * orientation and back. The IMU samples are synthesized with noise and a random bias and may arrive late,
+ * the wind blows from a random direction with gusts. The commands are sent as S.BUS frames and the aileron
+ * and elevator are read from servo channels 0 and 1. If the flash is blank, the mixer and the PIDs are set up
+ * for this airframe first.
+ *
+ * Environment:
+ *   FC_SIM_TIME       Flight time in seconds, 60 by default
+ *   FC_SIM_SEED       Seed of the sensor noise, the biases and the wind, 1 by default
+ *   FC_SIM_TRACE      CSV file to write the flight to every 10ms, angles in degrees with right roll, nose up
+ *                     and clockwise yaw positive
+ *   FC_SIM_PIDS       Pitch, roll and heading P, I and D, 9 comma-separated values written over the options
+ *   FC_SIM_ESTIMATOR  Mahony Kp and Ki, comma-separated
+ *   FC_SIM_SEQUENCE   "steps" by default or "inverted"
+ *   FC_SIM_NOISE      Sensor noise, times the datasheet values, 1 by default
+ *   FC_SIM_BIAS       Largest sensor bias, times the default, 1 by default
+ *   FC_SIM_LATENCY    Delay of the IMU samples in us, 0 by default
+ *   FC_SIM_WIND       Mean wind speed in m/s, 0 by default
+ *
+ * Prints the results on one line once done, the exit status is 1 if the aircraft hit the ground.
+ * Errors are RMS in degrees. The overshoot is the mean peak past the commanded angle after each step, in degrees,
+ * the effort is the mean aileron and elevator travel, in full deflections per second. The saturation is the share
+ * of the flight with the aileron or the elevator at its limit. After every switch of the orientation the roll has
+ * to come within 10 degrees of the target before the next command, the longest time it took is the recovery time
+ * and the switches where it did not are unrecovered.
+ */
+
+constexpr static uint32_t STEP {1000};  // us, the model runs at 1kHz
+constexpr static uint32_t SBUS_PERIOD {14000};
+constexpr static uint32_t TRACE_PERIOD {10000};
+constexpr static double   IMU_PERIOD {1000000.0 / 208};
+constexpr static uint64_t LAUNCH_TIME {3000000};  // After the gyroscope calibration
+constexpr static double   LAUNCH_AIRSPEED {15};
+constexpr static double   LAUNCH_ALTITUDE {100};
+
+constexpr static double DEG {M_PI / 180};
+constexpr static double G {9.80665};
+constexpr static double ACC_LSB {0.122e-3 * G};  // Same full scales as configured in LSM6DSO32::init()
+constexpr static double ROT_LSB {35e-3 * DEG};
+constexpr static double ATT_LSB {10430.0};
+
+constexpr static double ACC_NOISE {1.5e-3 * G};  // RMS, the noise densities over the 104Hz bandwidth
+constexpr static double ROT_NOISE {0.07 * DEG};
+constexpr static double ACC_BIAS {20e-3 * G};  // Largest bias
+constexpr static double ROT_BIAS {1 * DEG};
+constexpr static double GUST_SHARE {0.3};  // RMS of the gusts, times the mean wind
+constexpr static double GUST_TIME {2};     // s, correlation time of the gusts
+constexpr static double RECOVERY_ANGLE {10};
+
+constexpr static int16_t ATTITUDE_MODE {-600};  // Flight mode channel, see updateControl()
+constexpr static int16_t NORMAL_ORIENTATION {-1000};
+constexpr static int16_t INVERTED_ORIENTATION {0};
+
+struct Command {
+	double time;   // s from the start of the sequence
+	double roll;   // Degrees, right wing down
+	double pitch;  // Degrees, nose up
+	bool   inverted;
+};
+
+// Repeat every SEQUENCE_LENGTH seconds
+static const Command steps[] {
+  {0,  0,   0,  false},
+  {3,  20,  0,  false},
+  {4,  -20, 0,  false},
+  {5,  0,   0,  false},
+  {8,  0,   5,  false},
+  {9,  0,   -5, false},
+  {10, 0,   0,  false}
+};
+static const Command inverted[] {
+  {0, 0, 0, false},
+  {3, 0, 0, true },
+  {5, 0, 0, false}
+};
+constexpr static double SEQUENCE_LENGTH {12};
+
+struct Sample {
+	double  time;  // When it reaches the IMU registers
+	int16_t accelerations[3];
+	int16_t angularRates[3];
+};
+
+// Overshoot of the steps on one axis
+struct Steps {
+	double   target {0};
+	double   direction {0};  // Of the current step, 0 before the first one
+	double   peak {0};
+	double   sum {0};
+	uint32_t count {0};
+
+	void command(double value) {
+		if (value != target) {
+			end();
+			direction = value > target ? 1 : -1;
+			target = value;
+		}
+	}
+
+	void add(double value) {
+		peak = std::fmax(peak, (value - target) * direction);
+	}
+
+	void end() {
+		if (direction) {
+			sum += peak;
+			++count;
+		}
+		peak = 0;
+	}
+
+	double mean() const {
+		return count ? sum / count : 0;
+	}
+};
+
+// Time to come back within RECOVERY_ANGLE of the target after the orientation was switched
+struct Recoveries {
+	double   start {-1};  // s, negative unless recovering
+	double   longest {0};
+	uint32_t failed {0};
+
+	void command(double time) {
+		end();
+		start = time;
+	}
+
+	void add(double time, double error) {
+		if (start >= 0 && std::abs(error) < RECOVERY_ANGLE) {
+			longest = std::fmax(longest, time - start);
+			start = -1;
+		}
+	}
+
+	void end() {
+		if (start >= 0) {
+			++failed;
+			start = -1;
+		}
+	}
+};
+
+struct Error {
+	double   sum {0};
+	uint32_t count {0};
+
+	void add(double error) {
+		sum += error * error;
+		++count;
+	}
+
+	double rms() const {
+		return count ? std::sqrt(sum / count) : 0;
+	}
+};
+
+static Aircraft     aircraft {};
+static std::mt19937 generator {};
+static double       accBias[3] {};
+static double       rotBias[3] {};
+static double       noiseScale {1};
+static double       latency {0};  // us
+static double       meanWind[3] {};
+static double       gusts[3] {};
+static double       gustRMS {0};
+
+static const Command* sequence {steps};
+static size_t         sequenceLength {sizeof(steps) / sizeof(steps[0])};
+static std::deque<Sample> samples {};
+
+static uint64_t endTime {0};
+static FILE*    trace {nullptr};
+static double   nextSample {0};
+static bool     configured {false};
+static bool     launched {false};
+static timespec startTime {};
+
+static Command commanded {};
+static float   pidGains[data::pidNumber * 3] {};
+static float   estimatorGains[2] {};
+static bool    pidsSet {false};
+static bool    estimatorSet {false};
+
+static Error   rollTracking {};
+static Error   pitchTracking {};
+static Error   rollEstimate {};
+static Error   pitchEstimate {};
+static Steps   rollSteps {};
+static Steps   pitchSteps {};
+static Recoveries recoveries {};
+static double  travel {0};
+static uint32_t recorded {0};
+static uint32_t saturated {0};
+static int16_t lastControls[2] {};
+static double  minAltitude {LAUNCH_ALTITUDE};
+
+
+static double noise(double rms) {
+	return std::normal_distribution<double> {0, rms}(generator);
+}
+
+static double uniform(double limit) {
+	return std::uniform_real_distribution<double> {-limit, limit}(generator);
+}
+
+static double wrap(double angle) {
+	return std::remainder(angle, 360);
+}
+
+// Returns false unless the string has exactly the given number of comma-separated values
+static bool parseValues(const char* str, float* values, uint8_t count) {
+	char* end {nullptr};
+
+	for (uint8_t i {0}; i < count; ++i) {
+		values[i] = strtof(str, &end);
+		if (end == str || *end != (i + 1 < count ? ',' : '\0')) {
+			return false;
+		}
+		str = end + 1;
+	}
+	return true;
+}
+
+static int16_t toLSB(double value, double lsb) {
+	double raw {std::round(value / lsb)};
+	return raw > 32767 ? 32767 : raw < -32768 ? -32768 : raw;
+}
+
+// Converts from the forward-right-down axes of the model to the sensor axes, see LSM6DSO32::getAccelerations()
+static void toSensor(const double* body, double* sensor) {
+	sensor[0] = -body[0];
+	sensor[1] = body[1];
+	sensor[2] = -body[2];
+}
+
+static void sample(uint64_t time) {
+	double acc[3];
+	double rot[3];
+	Sample sample {time + latency};
+
+	toSensor(aircraft.getSpecificForce(), acc);
+	toSensor(aircraft.getState().rates, rot);
+	for (uint8_t i {0}; i < 3; ++i) {
+		sample.accelerations[i] = toLSB(acc[i] + accBias[i] + noise(ACC_NOISE * noiseScale), ACC_LSB);
+		sample.angularRates[i] = toLSB(rot[i] + rotBias[i] + noise(ROT_NOISE * noiseScale), ROT_LSB);
+	}
+	samples.push_back(sample);
+}
+
+static void deliver(uint64_t time) {
+	while (!samples.empty() && samples.front().time <= time) {
+		host::getIMU().setAccelerations(samples.front().accelerations);
+		host::getIMU().setAngularRates(samples.front().angularRates);
+		samples.pop_front();
+	}
+}
+
+// First-order gusts around the mean wind
+static void blow() {
+	double wind[3];
+
+	for (uint8_t i {0}; i < 3; ++i) {
+		gusts[i] += -gusts[i] * STEP / 1e6 / GUST_TIME + noise(gustRMS * std::sqrt(2 * STEP / 1e6 / GUST_TIME));
+		wind[i] = meanWind[i] + gusts[i];
+	}
+	aircraft.setWind(wind);
+}
+
+// Inverse of the conversion in SBUSParser
+static uint16_t toSBUS(int16_t channel) {
+	int32_t value {((channel + 1210) * 2014 + 2459) / 2460};
+	return value < 1 ? 1 : value > 0x7ff ? 0x7ff : value;
+}
+
+static void sendCommands(uint64_t time) {
+	int16_t channels[ReceiverParser::channelNumber] {};
+
+	if (launched) {
+		double flightTime {std::fmod((time - LAUNCH_TIME) / 1e6, SEQUENCE_LENGTH)};
+
+		bool   wasInverted {commanded.inverted};
+
+		for (size_t i {0}; i < sequenceLength; ++i) {
+			if (sequence[i].time <= flightTime) {
+				commanded = sequence[i];
+			}
+		}
+		if (commanded.inverted != wasInverted) {
+			recoveries.command((time - LAUNCH_TIME) / 1e6);
+		}
+	}
+
+	channels[0] = commanded.roll / 45 * 1000;   // Full stick is 45 degrees
+	channels[1] = commanded.pitch / 45 * 1000;  // Inverted in updateControl()
+	channels[8] = ATTITUDE_MODE;
+	channels[9] = commanded.inverted ? INVERTED_ORIENTATION : NORMAL_ORIENTATION;
+
+	uint8_t  frame[25] {0x0f};
+	uint32_t bits {0};
+	uint8_t  bitCount {0};
+	uint8_t  position {1};
+
+	for (auto channel : channels) {
+		bits |= static_cast<uint32_t>(toSBUS(channel)) << bitCount;
+		for (bitCount += 11; bitCount >= 8; bitCount -= 8) {
+			frame[position++] = bits;
+			bits >>= 8u;
+		}
+	}
+
+	host::receiveUART(3, frame, sizeof(frame));
+}
+
+// On the first step, before the launch, so waiting for the options being written whenever another record page is edited
+static void setVariable(data::VariableID id, uint8_t offset, uint8_t length, const uint8_t* src) {
+	while (data::setVariable(static_cast<uint8_t>(id), offset, length, src) == data::SetResult::Pending) {
+		nvm::write();
+	}
+}
+
+static void setPIDs(const InlinePID<float>::PIDCoefficients* pids) {
+	setVariable(
+	    data::VariableID::PIDs,
+	    offsetof(data::USBPIDsResponse, coefficients) - data::variableHeaderSize,
+	    sizeof(InlinePID<float>::PIDCoefficients) * data::pidNumber,
+	    reinterpret_cast<const uint8_t*>(pids)
+	);
+}
+
+// Aileron on channel 0 and elevator on channel 1, both following the PID outputs
+static void configure() {
+	configured = true;
+	if (estimatorSet) {
+		flight::setEstimatorGains(estimatorGains[0], estimatorGains[1]);
+	}
+	if (pidsSet) {
+		InlinePID<float>::PIDCoefficients pids[data::pidNumber] {};
+
+		for (uint8_t i {0}; i < data::pidNumber; ++i) {
+			pids[i] = {pidGains[i * 3], pidGains[i * 3 + 1], pidGains[i * 3 + 2]};
+		}
+		setPIDs(pids);
+	}
+	if (nvm::get(nvm::options->limits)[1]) {  // Already set up
+		if (pidsSet) {
+			nvm::write();
+		}
+		return;
+	}
+
+	int16_t                           mixes[data::mixesNumber] {};
+	int16_t                           limits[data::outputChannelNumber * 2] {};
+	InlinePID<float>::PIDCoefficients pids[data::pidNumber] {
+	  {1500, 300, 40},  // Pitch
+	  {1500, 300, 40},  // Roll
+	  {1,    0,   0 }   // Heading
+	};
+
+	mixes[0 * data::inputChannelNumber + 0] = 1000;
+	mixes[1 * data::inputChannelNumber + 1] = 1000;
+	for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
+		limits[i * 2] = -1000;
+		limits[i * 2 + 1] = 1000;
+	}
+
+	setVariable(data::VariableID::Mux, 0, sizeof(mixes), reinterpret_cast<const uint8_t*>(mixes));
+	setVariable(data::VariableID::Limits, 0, sizeof(limits), reinterpret_cast<const uint8_t*>(limits));
+	if (!pidsSet) {
+		setPIDs(pids);
+	}
+	nvm::write();
+}
+
+static void record(uint64_t time) {
+	double roll;
+	double pitch;
+	double yaw;
+
+	aircraft.getEuler(roll, pitch, yaw);
+	pitch = -pitch;  // The flight computer pitches up with negative angles
+
+	double estimatedRoll {data::usbStatusResponse.roll / ATT_LSB};
+	double estimatedPitch {data::usbStatusResponse.pitch / ATT_LSB};
+
+	double targetRoll {wrap(commanded.roll + (commanded.inverted ? 180 : 0))};
+	double rollError {wrap(targetRoll - roll / DEG)};
+
+	rollTracking.add(rollError);
+	pitchTracking.add((-commanded.pitch * DEG - pitch) / DEG);
+	rollEstimate.add(wrap((estimatedRoll - roll) / DEG));
+	pitchEstimate.add((estimatedPitch - pitch) / DEG);
+	rollSteps.command(commanded.roll);  // Not the switches of the orientation, they go either way round
+	rollSteps.add(commanded.roll - rollError);
+	pitchSteps.command(-commanded.pitch);
+	pitchSteps.add(pitch / DEG);
+	recoveries.add((time - LAUNCH_TIME) / 1e6, rollError);
+
+	bool limited {false};
+	for (uint8_t i {0}; i < 2; ++i) {
+		travel += std::abs(host::getServo(i) - lastControls[i]) / 1000.0;
+		lastControls[i] = host::getServo(i);
+		limited = limited || data::outputs[i][0] <= data::limits[i][0] || data::outputs[i][0] >= data::limits[i][1];
+	}
+	++recorded;
+	saturated += limited;
+	minAltitude = std::fmin(minAltitude, aircraft.getAltitude());
+
+	if (trace && !(time % TRACE_PERIOD)) {
+		fprintf(
+		    trace,
+		    "%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%.1f,%.1f,%.2f,%.2f,%d,%d\n",
+		    (time - LAUNCH_TIME) / 1e6,
+		    roll / DEG,
+		    -pitch / DEG,
+		    yaw / DEG,
+		    estimatedRoll / DEG,
+		    -estimatedPitch / DEG,
+		    commanded.roll,
+		    commanded.pitch,
+		    aircraft.getAltitude(),
+		    aircraft.getAirspeed(),
+		    host::getServo(0),
+		    host::getServo(1)
+		);
+	}
+}
+
+static void finish(uint64_t time) {
+	timespec now {};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double flightTime {(time - LAUNCH_TIME) / 1e6};
+	double wallTime {(now.tv_sec - startTime.tv_sec) + (now.tv_nsec - startTime.tv_nsec) / 1e9};
+	bool   crashed {!aircraft.flying()};
+
+	rollSteps.end();
+	pitchSteps.end();
+	recoveries.end();
+	printf(
+	    "time=%.1f speedup=%.0f crashed=%d roll_tracking=%.3f pitch_tracking=%.3f roll_estimate=%.3f "
+	    "pitch_estimate=%.3f roll_overshoot=%.3f pitch_overshoot=%.3f effort=%.3f saturation=%.4f unrecovered=%u "
+	    "recovery_time=%.2f min_altitude=%.1f\n",
+	    flightTime,
+	    time / 1e6 / wallTime,
+	    crashed,
+	    rollTracking.rms(),
+	    pitchTracking.rms(),
+	    rollEstimate.rms(),
+	    pitchEstimate.rms(),
+	    rollSteps.mean(),
+	    pitchSteps.mean(),
+	    flightTime > 0 ? travel / 2 / flightTime : 0,
+	    recorded ? static_cast<double>(saturated) / recorded : 0,
+	    recoveries.failed,
+	    recoveries.longest,
+	    minAltitude
+	);
+
+	if (trace) {
+		fclose(trace);
+	}
+	exit(crashed ? 1 : 0);
+}
+
+static void step(uint64_t time) {
+	if (!configured) {
+		configure();
+	}
+	if (!launched && time >= LAUNCH_TIME) {
+		aircraft.launch(LAUNCH_AIRSPEED, LAUNCH_ALTITUDE);
+		launched = true;
+		for (uint8_t i {0}; i < 2; ++i) {
+			lastControls[i] = host::getServo(i);
+		}
+	}
+
+	double controls[2] {static_cast<double>(host::getServo(0)), static_cast<double>(host::getServo(1))};
+	if (gustRMS > 0) {
+		blow();
+	}
+	aircraft.step(STEP / 1e6, controls);
+
+	if (time >= nextSample) {
+		sample(time);
+		nextSample += IMU_PERIOD;
+	}
+	deliver(time);
+	if (!(time % SBUS_PERIOD)) {
+		sendCommands(time);
+	}
+	if (launched) {
+		record(time);
+	}
+
+	if (time >= endTime || (launched && !aircraft.flying())) {
+		finish(time);
+	}
+}
+
+// Set up before main() runs
+static struct Simulator {
+	Simulator() {
+		const char* flightTime {getenv("FC_SIM_TIME")};
+		const char* seed {getenv("FC_SIM_SEED")};
+		const char* tracePath {getenv("FC_SIM_TRACE")};
+		const char* pids {getenv("FC_SIM_PIDS")};
+		const char* estimator {getenv("FC_SIM_ESTIMATOR")};
+		const char* sequenceName {getenv("FC_SIM_SEQUENCE")};
+		const char* noiseValue {getenv("FC_SIM_NOISE")};
+		const char* biasValue {getenv("FC_SIM_BIAS")};
+		const char* latencyValue {getenv("FC_SIM_LATENCY")};
+		const char* windValue {getenv("FC_SIM_WIND")};
+		double      biasScale {biasValue ? atof(biasValue) : 1};
+		double      windSpeed {windValue ? atof(windValue) : 0};
+
+		if (pids && !(pidsSet = parseValues(pids, pidGains, data::pidNumber * 3))) {
+			fprintf(stderr, "FC_SIM_PIDS: expected %u values\n", data::pidNumber * 3);
+			exit(2);
+		}
+		if (estimator && !(estimatorSet = parseValues(estimator, estimatorGains, 2))) {
+			fprintf(stderr, "FC_SIM_ESTIMATOR: expected 2 values\n");
+			exit(2);
+		}
+
+		endTime = LAUNCH_TIME + (flightTime ? atof(flightTime) : 60) * 1000000;
+		generator.seed(seed ? strtoul(seed, nullptr, 0) : 1);
+
+		if (sequenceName && !strcmp(sequenceName, "inverted")) {
+			sequence = inverted;
+			sequenceLength = sizeof(inverted) / sizeof(inverted[0]);
+		} else if (sequenceName && strcmp(sequenceName, "steps")) {
+			fprintf(stderr, "FC_SIM_SEQUENCE: unknown sequence %s\n", sequenceName);
+			exit(2);
+		}
+		noiseScale = noiseValue ? atof(noiseValue) : 1;
+		latency = latencyValue ? atof(latencyValue) : 0;
+
+		for (uint8_t i {0}; i < 3; ++i) {
+			accBias[i] = uniform(ACC_BIAS) * biasScale;
+			rotBias[i] = uniform(ROT_BIAS) * biasScale;
+		}
+		if (windSpeed > 0) {  // Drawn after the biases, so that they stay the same for a seed
+			double direction {uniform(M_PI)};
+
+			meanWind[0] = windSpeed * std::cos(direction);
+			meanWind[1] = windSpeed * std::sin(direction);
+			gustRMS = windSpeed * GUST_SHARE;
+			aircraft.setWind(meanWind);
+		}
+
+		if (tracePath && (trace = fopen(tracePath, "w"))) {
+			fprintf(
+			    trace,
+			    "time,roll,pitch,yaw,estimated_roll,estimated_pitch,commanded_roll,commanded_pitch,"
+			    "altitude,airspeed,aileron,elevator\n"
+			);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &startTime);
+		host::simulate(STEP, step);
+	}
+} simulator {};
@@ -0,0 +1,166 @@
+#include "uart.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "host.hpp"
+
+
+constexpr static uint8_t PORT_NUMBER {3};
+constexpr static uint8_t READ_SIZE {64};
+
+struct Port {
+	int                                  fd {-1};
+	bool                                 udp {false};
+	sockaddr_in                          peer {};  // Replies go to whoever sent the last datagram
+	bool                                 peerKnown {false};
+	uart::DefaultCallback::callback_type callback {nullptr};
+};
+
+static Port ports[PORT_NUMBER] {};
+
+
+static uint8_t send(Port& port, const uint8_t* buf, uint8_t len) {
+	len = util::min<uint8_t>(len, uart::DefaultQueue::value_type::capacity);  // Same chunks as on the device
+
+	if (port.fd < 0) {  // Nothing connected, the bytes are gone like on an unconnected pin
+		return len;
+	}
+
+	if (port.udp) {
+		if (port.peerKnown) {
+			sendto(port.fd, buf, len, 0, reinterpret_cast<const sockaddr*>(&port.peer), sizeof(port.peer));
+		}
+	} else if (write(port.fd, buf, len) < 0) {
+		return -1;  // The reader is not keeping up, like a full queue
+	}
+	return len;
+}
+
+static void receive(uint8_t index, int fd) {
+	Port&   port {ports[index]};
+	uint8_t buf[READ_SIZE];
+	ssize_t len;
+
+	if (port.udp) {
+		socklen_t peerSize {sizeof(port.peer)};
+
+		len = recvfrom(fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&port.peer), &peerSize);
+		port.peerKnown = len >= 0;
+	} else {
+		len = read(fd, buf, sizeof(buf));
+	}
+
+	if (len > 0) {
+		host::receiveUART(index + 1, buf, len);
+	} else if (!len || (errno != EAGAIN && errno != EINTR)) {  // Closed, not waiting for it any more
+		host::_internal::unwatch(fd);
+	}
+}
+
+bool host::openUART(uint8_t port, const char* path) {
+	if (!port || port > PORT_NUMBER) {
+		return false;
+	}
+
+	Port&       target {ports[port - 1]};
+	struct stat status {};
+	int         fd;
+
+	if (!strncmp(path, "udp:", 4)) {
+		fd = _internal::openUDP(atoi(path + 4));
+		target.udp = true;
+	} else if (stat(path, &status) || S_ISREG(status.st_mode)) {  // Files are only written to
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		target.fd = fd;
+		return fd >= 0;
+	} else {
+		fd = open(path, O_RDWR | O_NONBLOCK | O_NOCTTY);  // Read-write so a FIFO is not closed with its writer
+
+		termios settings {};
+		if (fd >= 0 && !tcgetattr(fd, &settings)) {  // A terminal, passing the bytes through unchanged
+			cfmakeraw(&settings);
+			tcsetattr(fd, TCSANOW, &settings);
+		}
+	}
+
+	if (fd < 0) {
+		return false;
+	}
+	target.fd = fd;
+
+	switch (port) {
+		case 1:
+			_internal::watch(fd, [](int fd) {
+				receive(0, fd);
+			});
+			break;
+		case 2:
+			_internal::watch(fd, [](int fd) {
+				receive(1, fd);
+			});
+			break;
+		case 3:
+			_internal::watch(fd, [](int fd) {
+				receive(2, fd);
+			});
+			break;
+	}
+	return true;
+}
+
+void host::receiveUART(uint8_t port, const uint8_t* buf, uint8_t len) {
+	if (!port || port > PORT_NUMBER || !ports[port - 1].callback) {
+		return;
+	}
+
+	uart::DefaultCallback::buffer_type buffer {};
+
+	for (uint8_t i {0}; i < len; ++i) {  // One byte at a time, like the receive interrupt
+		buffer.buffer[0] = buf[i];
+		buffer.transferred = 1;
+		ports[port - 1].callback(buffer);
+	}
+}
+
+void uart::init() {
+	// Nothing to do, the ports are opened in util::init()
+}
+
+uint8_t uart::print(const char* buf) {
+	uint8_t len {0};
+	for (; buf[len] && len < 32; ++len);
+
+	return send(ports[0], reinterpret_cast<const uint8_t*>(buf), len);
+}
+
+uint8_t uart::sendTo1(const uint8_t* buf, uint8_t len) {
+	return send(ports[0], buf, len);
+}
+
+void uart::set1Callback(uart::DefaultCallback::callback_type cb) {
+	ports[0].callback = cb;
+}
+
+uint8_t uart::sendTo2(const uint8_t* buf, uint8_t len) {
+	return send(ports[1], buf, len);
+}
+
+void uart::set2Callback(uart::DefaultCallback::callback_type cb) {
+	ports[1].callback = cb;
+}
+
+void uart::init3(uint32_t baud, bool parity, bool twoStopBits) {
+	// Nothing to do, bytes arrive already framed
+}
+
+void uart::set3Callback(uart::DefaultCallback::callback_type cb) {
+	ports[2].callback = cb;
+}
@@ -0,0 +1,172 @@
+#include "usb.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "host.hpp"
+#include "nvm.hpp"
+#include "profiler.hpp"
+
+/* Endpoint 1 requests arrive as datagrams laid out like the transfers, the command, the value and the data.
+ * Responses and stream frames are sent to whoever sent the last request, an empty datagram reads the default response.
+ * A request to set variables that has to wait for the options being written is kept and the socket is not read
+ * until update() applies it, like the endpoint bank that stays full on the device.
+ */
+
+constexpr static uint8_t REQUEST_HEADER_SIZE {2};
+constexpr static uint8_t REQUEST_DATA_SIZE {160};
+constexpr static uint8_t STREAM_FRAME_SIZE {96};
+
+static int         fd {-1};
+static sockaddr_in peer {};
+static bool        peerKnown {false};
+
+const static uint8_t* defaultData {nullptr};
+static uint8_t        defaultLen {0};
+
+static uint8_t variablesResponse[REQUEST_HEADER_SIZE + REQUEST_DATA_SIZE] {};
+static uint8_t pendingRequest[REQUEST_HEADER_SIZE + REQUEST_DATA_SIZE] {};
+static bool    requestPending {false};
+
+static data::Stream subscription {};
+
+static void receive(int fd);
+
+// Returns false if the request has to be applied again once the commit is written
+static bool setVariables(uint8_t command, uint8_t value, const uint8_t* src) {
+	data::SetResult result {
+	  command == static_cast<uint8_t>(data::CommandType::SetVariable)
+	      ? data::setVariable(value, 0, REQUEST_DATA_SIZE, src)
+	      : data::setVariables(value, src, REQUEST_DATA_SIZE)
+	};
+
+	if (result != data::SetResult::NotStored) {
+		nvm::commit();
+	}
+	return result != data::SetResult::Pending;
+}
+
+static void handle(const uint8_t* request) {
+	uint8_t        command {request[0]};
+	uint8_t        value {request[1]};
+	const uint8_t* src {request + REQUEST_HEADER_SIZE};
+
+	switch (command) {
+		case static_cast<uint8_t>(data::CommandType::GetVariable): {
+			const data::Variable* variable {data::getVariable(value)};
+			if (variable && variable->flags & data::variableInFlash) {
+				data::readVariable(variable, 0, variable->size, variablesResponse);
+				usb::write(variablesResponse, variable->size);
+			} else if (variable) {
+				usb::write(variable->response, variable->size);
+			}
+			break;
+		}
+		case static_cast<uint8_t>(data::CommandType::SetVariable):
+		case static_cast<uint8_t>(data::CommandType::SetVariables):
+			if (!setVariables(command, value, src)) {
+				util::copy(pendingRequest, request, sizeof(pendingRequest));
+				requestPending = true;
+				host::_internal::unwatch(fd);
+			}
+			break;
+		case static_cast<uint8_t>(data::CommandType::GetVariables):
+			usb::write(
+			    variablesResponse,
+			    data::getVariables(
+			        util::min<uint8_t>(value, REQUEST_DATA_SIZE / sizeof(data::VariableSlice)),
+			        reinterpret_cast<const data::VariableSlice*>(src),
+			        variablesResponse,
+			        sizeof(variablesResponse)
+			    )
+			);
+			break;
+		case static_cast<uint8_t>(data::CommandType::Subscribe):
+			data::subscribe(subscription, value, src, REQUEST_DATA_SIZE, STREAM_FRAME_SIZE);
+			break;
+	}
+}
+
+static void receive(int fd) {
+	uint8_t   request[REQUEST_HEADER_SIZE + REQUEST_DATA_SIZE] {};  // The rest of a short request reads as zeros
+	socklen_t peerSize {sizeof(peer)};
+	ssize_t   len {recvfrom(fd, request, sizeof(request), 0, reinterpret_cast<sockaddr*>(&peer), &peerSize)};
+
+	if (len < 0) {
+		return;
+	}
+	peerKnown = true;
+
+	if (len < REQUEST_HEADER_SIZE) {
+		usb::write(defaultData, defaultLen);
+	} else {
+		handle(request);
+	}
+}
+
+bool host::openUSB(const char* path) {
+	if (strncmp(path, "udp:", 4)) {
+		return false;
+	}
+
+	fd = _internal::openUDP(atoi(path + 4));
+	if (fd < 0) {
+		return false;
+	}
+
+	_internal::watch(fd, receive);
+	return true;
+}
+
+void usb::init() {
+	writeDefault(reinterpret_cast<const uint8_t*>(&data::usbStatusResponse), sizeof(data::USBStatusResponse));
+}
+
+void usb::writeDefault(const uint8_t* data, uint8_t len) {
+	defaultData = data;
+	defaultLen = len;
+}
+
+void usb::write(const uint8_t* data, uint8_t len) {
+	if (fd >= 0 && peerKnown && data) {
+		sendto(fd, data, len, 0, reinterpret_cast<const sockaddr*>(&peer), sizeof(peer));
+	}
+}
+
+void usb::update() {
+	if (requestPending && setVariables(pendingRequest[0], pendingRequest[1], pendingRequest + REQUEST_HEADER_SIZE)) {
+		requestPending = false;
+		host::_internal::watch(fd, receive);
+	}
+}
+
+void usb::stream() {
+	PROFILE_ZONE("usb");
+
+	uint32_t now {util::getMicros()};
+	if (!data::streamDue(subscription, now)) {
+		return;
+	}
+
+	uint8_t buffer[STREAM_FRAME_SIZE];
+	auto*   frame {new (buffer) data::USBStreamFrame {}};
+	uint8_t position {sizeof(data::USBStreamFrame)};
+
+	frame->count = subscription.count;
+	frame->sequence = subscription.sequence++;
+	frame->time = now;
+
+	for (uint8_t i {0}; i < subscription.count; ++i) {
+		const data::Variable* variable {data::getVariable(subscription.variableIDs[i])};
+		data::readVariable(variable, 0, variable->size, buffer + position);
+		position += variable->size;
+	}
+
+	write(buffer, position);
+}
+
+void usb::read(uint8_t* data, uint8_t len) {
+	// Nothing to do, requests are handled as they arrive
+}
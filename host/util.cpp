@@ -0,0 +1,312 @@
+#include "util.hpp"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "host.hpp"
+#include "i2c.hpp"
+#include "LSM6DSO32_regs.h"
+#include "RingBuffer.hpp"
+
+
+constexpr static uint8_t MAX_WATCHED {8};
+constexpr static uint8_t MAX_POSTED {16};
+constexpr static uint8_t MAX_TIMERS {8};
+
+struct Watched {
+	int fd;
+	void (*handler)(int fd);
+};
+
+struct Timer {
+	uint64_t time;
+	void (*handler)();
+};
+
+static Watched                               watched[MAX_WATCHED] {};
+static uint8_t                               watchedCount {0};
+static RingBuffer<void (*)(), uint8_t, MAX_POSTED> posted {};
+static Timer                                 timers[MAX_TIMERS] {};
+static uint8_t                               timerCount {0};
+
+static timespec startTime {};
+static uint32_t sleepTime {0};
+
+static uint32_t simulationStep {0};  // us, 0 for real time
+static void (*simulationHandler)(uint64_t time) {nullptr};
+static uint64_t simulatedTime {0};
+static bool     ledOn {false};
+
+
+static uint64_t readClock() {
+	if (simulationStep) {
+		return simulatedTime;
+	}
+
+	timespec time {};
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint64_t>(time.tv_sec - startTime.tv_sec) * 1000000 + time.tv_nsec / 1000
+	     - startTime.tv_nsec / 1000;
+}
+
+static void connect(const char* variable, bool (*open)(const char* path)) {
+	const char* path {getenv(variable)};
+
+	if (path && !open(path)) {
+		fprintf(stderr, "Could not open %s for %s\n", path, variable);
+	}
+}
+
+// Posts the handlers of the timers that are due
+static void postDue() {
+	uint64_t now {readClock()};
+
+	for (uint8_t i {0}; i < timerCount;) {
+		if (timers[i].time <= now) {
+			host::_internal::post(timers[i].handler);
+			timers[i] = timers[--timerCount];
+		} else {
+			++i;
+		}
+	}
+}
+
+// Time until the next timer is due, up to the timeout
+static uint32_t untilTimer(uint32_t timeout) {
+	uint64_t now {readClock()};
+
+	for (uint8_t i {0}; i < timerCount; ++i) {
+		if (timers[i].time <= now) {
+			return 0;
+		}
+		timeout = util::min<uint64_t>(timers[i].time - now, timeout);
+	}
+	return timeout;
+}
+
+static void runPosted() {
+	// Handlers posted while running wait for the next call, like an interrupt that is raised again
+	for (uint8_t count {posted.size()}; count; --count) {
+		auto handler {posted.front()};
+
+		posted.pop_front();
+		handler();
+	}
+}
+
+// Waits for the watched descriptors for up to the timeout and calls the handlers of the readable ones
+static void poll(uint32_t timeout) {
+	pollfd  fds[MAX_WATCHED] {};
+	Watched ready[MAX_WATCHED] {};  // Copied, the handlers may stop watching
+	uint8_t count {watchedCount};
+
+	for (uint8_t i {0}; i < count; ++i) {
+		fds[i] = {watched[i].fd, POLLIN, 0};
+		ready[i] = watched[i];
+	}
+
+	timespec duration {static_cast<time_t>(timeout / 1000000), static_cast<long>(timeout % 1000000 * 1000)};
+	if (ppoll(fds, count, &duration, nullptr) <= 0) {
+		return;
+	}
+
+	for (uint8_t i {0}; i < count; ++i) {
+		if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+			ready[i].handler(ready[i].fd);
+		}
+	}
+}
+
+// Moves the simulated time forward by up to the timeout, stopping at the next step
+static uint32_t step(uint32_t timeout) {
+	uint64_t step {(simulatedTime / simulationStep + 1) * simulationStep};
+	uint64_t target {simulatedTime + timeout};
+
+	if (target < step) {
+		simulatedTime = target;
+		return timeout;
+	}
+
+	uint32_t advanced = step - simulatedTime;
+	simulatedTime = step;
+	simulationHandler(simulatedTime);
+	return advanced;
+}
+
+// Same as step(), but also handles the received data first
+static uint32_t advance(uint32_t timeout) {
+	if (watchedCount) {
+		poll(0);
+	}
+	return step(timeout);
+}
+
+void util::init() {
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+	host::attachI2C(LSM6DSO32_ADDR_0, &host::getIMU());
+
+	connect("FC_UART1", [](const char* path) {
+		return host::openUART(1, path);
+	});
+	connect("FC_UART2", [](const char* path) {
+		return host::openUART(2, path);
+	});
+	connect("FC_UART3", [](const char* path) {
+		return host::openUART(3, path);
+	});
+	connect("FC_USB", host::openUSB);
+	connect("FC_FLASH", host::openFlash);
+}
+
+// Fast inverse square root, same as on the device but with a 32-bit integer, long has 64 bits here
+// See: http://en.wikipedia.org/wiki/Fast_inverse_square_root
+float util::invSqrt(float x) {
+	float halfx = 0.5f * x;
+
+	union {
+		float   f;
+		int32_t i;
+	} conv = {x};
+
+	conv.i = 0x5f3759df - (conv.i >> 1);
+	conv.f *= 1.5f - (halfx * conv.f * conv.f);
+	conv.f *= 1.5f - (halfx * conv.f * conv.f);
+	return conv.f;
+}
+
+uint32_t util::getTime() {
+	return getMicros64() / 1000;
+}
+
+uint32_t util::getMicros() {
+	return readClock();
+}
+
+uint64_t util::getMicros64() {
+	return readClock();
+}
+
+void util::sleep(uint32_t ms) {
+	sleepUntil(getMicros() + ms * 1000);
+}
+
+void util::sleepUntil(uint32_t us) {
+	while (true) {
+		postDue();
+		runPosted();
+
+		uint32_t start {getMicros()};
+		if (static_cast<int32_t>(start - us) >= 0) {
+			break;
+		}
+		if (!posted.empty()) {
+			continue;
+		}
+
+		if (simulationStep) {
+			sleepTime += advance(untilTimer(us - start));
+		} else {
+			poll(untilTimer(us - start));
+			sleepTime += getMicros() - start;  // Including the handlers, they take no time compared to the wait
+		}
+	}
+}
+
+uint32_t util::getSleepTime() {
+	return sleepTime;
+}
+
+void util::setLED(bool on) {
+	if (on != ledOn) {
+		fprintf(stderr, "LED %s\n", on ? "on" : "off");
+		ledOn = on;
+	}
+}
+
+void util::startWatchdog() {
+	// Nothing to do, a stuck process is easy enough to notice
+}
+
+void util::clearWatchdog() {
+	// Nothing to do
+}
+
+bool util::reached(uint32_t deadline) {
+	return static_cast<int32_t>(getMicros() - deadline) >= 0;
+}
+
+uint32_t util::elapsedSince(uint32_t us) {
+	return getMicros() - us;
+}
+
+void host::simulate(uint32_t step, void (*handler)(uint64_t time)) {
+	simulationStep = step;
+	simulationHandler = handler;
+}
+
+void host::_internal::watch(int fd, void (*handler)(int fd)) {
+	for (uint8_t i {0}; i < watchedCount; ++i) {
+		if (watched[i].fd == fd) {
+			watched[i].handler = handler;
+			return;
+		}
+	}
+
+	if (watchedCount < MAX_WATCHED) {
+		watched[watchedCount++] = {fd, handler};
+	}
+}
+
+void host::_internal::unwatch(int fd) {
+	for (uint8_t i {0}; i < watchedCount; ++i) {
+		if (watched[i].fd == fd) {
+			watched[i] = watched[--watchedCount];
+			return;
+		}
+	}
+}
+
+void host::_internal::post(void (*handler)()) {
+	if (!posted.full()) {
+		posted.push_back(handler);
+	}
+}
+
+void host::_internal::postAt(uint64_t time, void (*handler)()) {
+	if (timerCount < MAX_TIMERS) {
+		timers[timerCount++] = {time, handler};
+	}
+}
+
+void host::_internal::spin(uint32_t us) {
+	while (simulationStep && us) {
+		us -= step(us);
+	}
+}
+
+int host::_internal::openUDP(uint16_t port) {
+	int fd {socket(AF_INET, SOCK_DGRAM, 0)};
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	sockaddr_in address {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
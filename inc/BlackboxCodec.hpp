@@ -0,0 +1,87 @@
+/*
+ * File:   BlackboxCodec.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 2:10 PM
+ */
+
+#ifndef BLACKBOXCODEC_HPP
+#define BLACKBOXCODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/* Blackbox frames are encoded as a difference to the previous frame, treating the frame as 16-bit words.
+ * Each difference is zigzag-encoded so that small negative values stay small and written as a varint,
+ * so an unchanged word only takes a single byte.
+ * Every keyframeInterval frames, and after a frame was dropped, a keyframe is encoded against an all-zero frame.
+ * Keyframes start with a sync sequence and end with a CRC8 (DVB-S2), so decoding can start or resume from them.
+ *
+ * Nothing here depends on the device, the same definitions are used by the host tools.
+ */
+
+struct __attribute__((packed, aligned(4))) BlackboxFrame {
+	uint32_t time;               // ms
+	uint16_t loopTime;           // us
+	uint16_t status;             // Receiver available, failsafe and companion setpoint bits, flight mode in the high byte
+	int16_t  accelerations[3];   // Raw, ZYX
+	int16_t  angularRates[3];    // Raw, yaw - pitch - roll
+	int16_t  attitude[3];        // Yaw - pitch - roll, 10430 LSB/rad
+	int16_t  channels[16];       // Receiver channels, roughly -1000 to 1000
+	int16_t  pidTerms[3][3];     // P, I and D terms of the pitch, roll and heading PIDs, heading in 10430 LSB/rad
+	int16_t  outputs[8];         // Mixer outputs
+	uint16_t taskTimes[6];       // Last execution time of each rate group, us
+	int16_t  setpoint[2];        // Companion pitch and heading setpoint, 10430 LSB/rad
+	uint16_t intervals[2];       // Time since the previous sensor and control runs, us
+};
+
+class BlackboxCodec {
+public:
+	constexpr static uint8_t syncBytes[2] {0xb1, 0xac};
+	constexpr static uint8_t keyframeType {0x4b};
+	constexpr static uint8_t deltaType {0x44};
+	constexpr static uint8_t keyframeInterval {32};
+
+	constexpr static uint8_t wordNumber {sizeof(BlackboxFrame) / sizeof(uint16_t)};
+	constexpr static uint8_t keyframeOverhead {sizeof(syncBytes) + 2};  // Sync, type and CRC
+	constexpr static uint8_t maxFrameSize {keyframeOverhead + wordNumber * 3};
+
+	static_assert(sizeof(BlackboxFrame) % sizeof(uint16_t) == 0, "Frames must consist of whole words");
+
+	static uint8_t crc8DVBS2(uint8_t crc, uint8_t byte);
+
+protected:
+	BlackboxCodec() = default;
+	~BlackboxCodec() = default;
+
+	BlackboxFrame _previous {};
+};
+
+class BlackboxEncoder: public BlackboxCodec {
+public:
+	// Writes up to maxFrameSize bytes, returns the encoded size
+	uint8_t encode(const BlackboxFrame& frame, uint8_t* dest);
+	// Makes the next frame a keyframe, so that the log can be decoded after a gap
+	void    restart();
+
+protected:
+	uint8_t _frameCount {0};  // Frames since the last keyframe
+};
+
+class BlackboxDecoder: public BlackboxCodec {
+public:
+	// Decodes a frame at the start of the data, returns the bytes used or 0 if there is no valid frame
+	size_t decode(const uint8_t* src, size_t length);
+
+	const BlackboxFrame& getFrame() const;
+	bool                 synchronized() const;
+
+	static bool isKeyframe(const uint8_t* src, size_t length);
+	// Returns the position of the next keyframe or length if there is none
+	static size_t findKeyframe(const uint8_t* src, size_t length);
+
+protected:
+	bool _synchronized {false};  // A keyframe was decoded and no frames were invalid since
+};
+
+#endif /* BLACKBOXCODEC_HPP */
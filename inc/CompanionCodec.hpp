@@ -0,0 +1,84 @@
+/*
+ * File:   CompanionCodec.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 5:20 PM
+ */
+
+#ifndef COMPANIONCODEC_HPP
+#define COMPANIONCODEC_HPP
+
+#include <cstdint>
+
+/* Messages to and from the companion computer are followed by a CRC16 (CCITT-FALSE, little-endian)
+ * and framed with COBS, so the frame contains no zero bytes and a zero byte is sent on both sides of it.
+ * A receiver can start listening at any point and resynchronizes at the next zero byte.
+ * The first byte of a message is its ID.
+ *
+ * Nothing here depends on the device, the same classes can be used on the companion computer.
+ */
+
+class CompanionCodec {
+public:
+	constexpr static uint8_t  delimiter {0x00};
+	constexpr static uint16_t crcInitial {0xffff};  // Runs of zeros still change the CRC
+	constexpr static uint8_t  maxMessageSize {164};  // Fits the largest variable with a command header
+	// Delimiters, the CRC and one COBS code byte for every 254 bytes
+	constexpr static uint8_t  maxFrameSize {maxMessageSize + 2 + 2 + (maxMessageSize + 2) / 254 + 1};
+
+	static uint16_t crc16CCITT(uint16_t crc, uint8_t byte);
+
+protected:
+	CompanionCodec() = default;
+	~CompanionCodec() = default;
+
+	uint16_t _crc {crcInitial};
+};
+
+class CompanionEncoder: public CompanionCodec {
+public:
+	// Starts a frame in dest, which must hold maxFrameSize bytes
+	void    begin(uint8_t* dest);
+	// Encodes message bytes straight from the source, without copying the message first
+	void    append(const uint8_t* src, uint8_t length);
+	void    append(uint8_t byte);
+	// Appends the CRC and the delimiter, returns the frame size
+	uint8_t finish();
+
+protected:
+	void encode(uint8_t byte);
+
+	uint8_t* _dest {nullptr};
+	uint8_t  _position {0};
+	uint8_t  _code {0};  // Position of the COBS code byte of the current block
+	uint8_t  _length {0};
+};
+
+class CompanionDecoder: public CompanionCodec {
+public:
+	struct Statistics {
+		uint32_t bytes {0};
+		uint16_t messages {0};
+		uint16_t errors {0};  // Frames with a wrong CRC, an invalid encoding or too long to fit
+	};
+
+	// Returns true once a complete message is received, it stays valid until the next byte is processed
+	bool process(uint8_t byte);
+
+	const uint8_t*    getMessage() const;
+	uint8_t           getLength() const;
+	const Statistics& getStatistics() const;
+
+protected:
+	bool reject();
+
+	uint8_t    _message[maxMessageSize + 2] {};  // Includes the CRC
+	uint8_t    _length {0};
+	uint8_t    _messageLength {0};  // Of the last complete message
+	uint8_t    _remaining {0};      // Bytes left in the current COBS block, 0 before the code byte
+	bool       _zeroPending {false};
+	bool       _dropping {true};  // Skipping a bad or partial frame until the next delimiter
+	Statistics _statistics {};
+};
+
+#endif /* COMPANIONCODEC_HPP */
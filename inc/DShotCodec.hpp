@@ -0,0 +1,43 @@
+/*
+ * File:   DShotCodec.hpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 4:40 AM
+ */
+
+#ifndef DSHOTCODEC_HPP
+#define DSHOTCODEC_HPP
+
+#include <cstdint>
+
+/* DShot frames and the eRPM telemetry of bidirectional DShot. A frame is an 11-bit value, a telemetry request bit
+ * and a 4-bit CRC, sent MSB first as pulses of two lengths. The telemetry is a 16-bit value with its own CRC,
+ * GCR-encoded into 20 bits and sent back as edges on the same line.
+ *
+ * Nothing here depends on the device, so the encoding can be tested on the host.
+ */
+
+class DShotCodec {
+public:
+	constexpr static uint8_t  frameBits {16};
+	constexpr static uint8_t  telemetryBits {21};  // GCR value and the start bit
+	constexpr static uint16_t throttleMin {48};    // Values 1-47 are reserved for commands, 0 disarms
+	constexpr static uint16_t throttleMax {2047};
+
+	// Maps a servo output, 1000-2000us for -1024 to 1024, to a throttle, the motors stop at the low end
+	static uint16_t toThrottle(int16_t output);
+	// CRC inverted in bidirectional mode
+	static uint16_t encodeFrame(uint16_t value, bool telemetry, bool bidirectional);
+	// Writes the compare value of every bit followed by a 0 to keep the line idle after the frame
+	static void     buildBuffer(uint32_t* buffer, uint16_t frame, uint16_t one, uint16_t zero);
+	// Recovers the line value from samples of a single pin taken at 3x the telemetry bit rate
+	static uint32_t extractTelemetry(const uint16_t* samples, uint16_t count, uint8_t pin);
+	// Decodes the GCR line value into eRPM, returns false if the value is invalid
+	static bool     decodeTelemetry(uint32_t value, uint32_t& eRPM);
+
+protected:
+	DShotCodec() = default;
+	~DShotCodec() = default;
+};
+
+#endif /* DSHOTCODEC_HPP */
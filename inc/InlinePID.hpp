@@ -24,6 +24,11 @@ struct InlinePID {
 
 	T process(T val, T sp = 0, float dt = 0.01f);
 
+	// Terms of the last output, for logging
+	T getP() const;
+	T getI() const;
+	T getD() const;
+
 	T* kp {};
 	T* ki {};
 	T* kd {};
@@ -33,6 +38,8 @@ struct InlinePID {
 protected:
 	T _prev {};
 	T _sum {};
+	T _p {};
+	T _d {};
 };
 
 template <class T>
@@ -58,10 +65,26 @@ T InlinePID<T>::process(T val, T sp, float dt) {
 	T error {val - sp};
 
 	_sum = util::clamp(*ki * error * dt + _sum, -iLim, iLim);
-	T out = *kp * error + _sum + *kd * (val - _prev) / dt;
+	_p = *kp * error;
+	_d = *kd * (val - _prev) / dt;
 	_prev = val;
 
-	return out;
+	return _p + _sum + _d;
+}
+
+template <class T>
+T InlinePID<T>::getP() const {
+	return _p;
+}
+
+template <class T>
+T InlinePID<T>::getI() const {
+	return _sum;
+}
+
+template <class T>
+T InlinePID<T>::getD() const {
+	return _d;
 }
 
 
@@ -0,0 +1,116 @@
+/*
+ * File:   ReceiverParser.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 10:12 AM
+ */
+
+#ifndef RECEIVERPARSER_HPP
+#define RECEIVERPARSER_HPP
+
+#include <cstdint>
+
+/* Receiver protocol parsers are fed one byte at a time straight from the UART interrupt.
+ * Channels are decoded directly into the back snapshot as the bytes arrive, so no raw frame is ever stored.
+ * Once the frame is complete and its checksum matches, the back snapshot is published by swapping
+ * the front index, so readers always see the last complete frame without any copying.
+ */
+
+class ReceiverParser {
+public:
+	constexpr static uint8_t channelNumber {16};
+
+	// Same bit layout as the S.BUS flags byte
+	constexpr static uint8_t channel17Flag {0x01};
+	constexpr static uint8_t channel18Flag {0x02};
+	constexpr static uint8_t frameLostFlag {0x04};
+	constexpr static uint8_t failsafeFlag {0x08};
+
+	struct Snapshot {
+		int16_t channels[channelNumber] {};  // Roughly -1000 to 1000 for 1000-2000us pulses, 0 if not received
+		uint8_t flags {0};
+	};
+
+	struct Statistics {
+		uint32_t bytes {0};   // Bytes processed
+		uint32_t frames {0};  // Valid frames published
+		uint32_t errors {0};  // Frames dropped due to framing or checksum errors
+	};
+
+	// Returns true when a complete valid frame has been published
+	virtual bool process(uint8_t byte) = 0;
+	virtual void reset();
+
+	const Snapshot&   getSnapshot() const;
+	const Statistics& getStatistics() const;
+
+protected:
+	ReceiverParser() = default;
+	~ReceiverParser() = default;
+
+	Snapshot& back();
+	bool      publish();
+	bool      reject();
+
+	Snapshot         _snapshots[2] {};
+	volatile uint8_t _front {0};
+	Statistics       _statistics {};
+	uint8_t          _position {0};  // Bytes received in the current frame
+};
+
+// Futaba S.BUS, 100000 baud 8E2, 25-byte frames, no checksum
+class SBUSParser: public ReceiverParser {
+public:
+	bool process(uint8_t byte) override;
+	void reset() override;
+
+protected:
+	uint32_t _bits {0};
+	uint8_t  _bitCount {0};
+	uint8_t  _channel {0};
+};
+
+// TBS Crossfire (CRSF), 420000 baud 8N1, variable length frames with CRC8 (DVB-S2)
+class CRSFParser: public ReceiverParser {
+public:
+	bool process(uint8_t byte) override;
+	void reset() override;
+
+protected:
+	uint32_t _bits {0};
+	uint8_t  _bitCount {0};
+	uint8_t  _channel {0};
+	uint8_t  _length {0};
+	uint8_t  _type {0};
+	uint8_t  _crc {0};
+	uint8_t  _linkQuality {0};
+	bool     _linkLost {false};
+};
+
+// FlySky i-BUS, 115200 baud 8N1, 32-byte frames with additive checksum
+class IBUSParser: public ReceiverParser {
+public:
+	bool process(uint8_t byte) override;
+	void reset() override;
+
+protected:
+	uint16_t _sum {0};
+	uint16_t _checksum {0};
+	uint8_t  _low {0};
+};
+
+// Graupner SUMD, 115200 baud 8N1, up to 32 channels with CRC16 (CCITT)
+class SUMDParser: public ReceiverParser {
+public:
+	bool process(uint8_t byte) override;
+	void reset() override;
+
+protected:
+	uint16_t _crc {0};
+	uint16_t _checksum {0};
+	uint8_t  _status {0};
+	uint8_t  _channelCount {0};
+	uint8_t  _high {0};
+};
+
+#endif /* RECEIVERPARSER_HPP */
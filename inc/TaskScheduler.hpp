@@ -5,30 +5,66 @@
 #ifndef SANDBOX_TASKSCHEDULER_HPP
 #define SANDBOX_TASKSCHEDULER_HPP
 
-#include "RingBuffer.hpp"
-
+#include <cstdint>
+
+/*
+ * Measures execution times and start delays of every task, costs two reads of the clock given to setClock()
+ * and a few additions per run
+ */
+#define TASK_STATISTICS true
+
+/*
+ * Tasks are kept in a binary heap ordered by their timestamps, so scheduling, cancelling
+ * and taking the next task all take O(log n).
+ * IDs index a table of heap positions, IDs range from 1 to C and are reused once a task is cleared or done.
+ * Interval tasks keep their ID and phase between runs, so the timing error does not build up,
+ * runs missed while the tasks were busy are skipped.
+ */
 template <class size_type, size_type C>
 class TaskScheduler {
 public:
 	using timestamp_type = uint32_t;
 	using task_type = void (*)();
 
-	TaskScheduler() = default;
+#if TASK_STATISTICS
+	using clock_type = uint32_t (*)();
+
+	struct Statistics {
+		uint32_t       runs {0};
+		uint32_t       lastTime {0};  // Execution times in clock units
+		uint32_t       minTime {0};
+		uint32_t       averageTime {0};  // Moving average over roughly the last 16 runs
+		uint32_t       maxTime {0};
+		timestamp_type maxLateness {0};  // Start after the scheduled time, in timestamp units
+		uint16_t       overruns {0};     // Runs of an interval task skipped because the previous one started too late
+	};
+#endif
+
+	TaskScheduler();
 	~TaskScheduler() = default;
 
+	// Return 0 if the scheduler is full
 	size_type setTimeout(timestamp_type currentTime, timestamp_type timeout, task_type cb);
 	size_type setInterval(timestamp_type currentTime, timestamp_type interval, task_type cb);
 	void      clearTimeout(size_type id);
 	void      clearInterval(size_type id);
 
-	task_type getNextTask(timestamp_type currentTime);
-	void      execute(timestamp_type currentTime);
+	task_type      getNextTask(timestamp_type currentTime);
+	void           execute(timestamp_type currentTime);
+	// Time the first task is due, only valid if the scheduler is not empty
+	timestamp_type getNextTimestamp() const;
 
 	size_type size() const;
 	bool      empty() const;
 
 	void reset();
 
+#if TASK_STATISTICS
+	// Execution times are only measured once a clock is set, the mask keeps the bits the clock counts with
+	void              setClock(clock_type clock, uint32_t mask = 0xffffffff);
+	const Statistics& getStatistics(size_type id) const;
+#endif
+
 protected:
 	struct Task {
 		task_type      cb {nullptr};
@@ -37,17 +73,42 @@ protected:
 		size_type      id {0};
 	};
 
+	constexpr static size_type noPosition {static_cast<size_type>(~size_type {0})};
+	static_assert(C > 0 && C < noPosition, "Capacity must leave room for the empty position");
+
 	size_type schedule(timestamp_type currentTime, timestamp_type timeout, task_type cb, timestamp_type interval = 0);
 	void      unschedule(size_type id);
 
-	static size_type lastID;
-
-	RingBuffer<Task, size_type, C> _tasks {};
+	void place(size_type position, const Task& task);
+	void remove(size_type position);
+	void siftUp(size_type position);
+	void siftDown(size_type position);
+
+	// Compares timestamps correctly across a timer overflow
+	static bool earlier(timestamp_type a, timestamp_type b);
+
+	Task      _heap[C] {};
+	size_type _positions[C] {};  // Heap position of the task with ID i + 1, noPosition if the ID is free
+	size_type _freeIDs[C] {};
+	size_type _freeCount {0};
+	size_type _size {0};
+
+#if TASK_STATISTICS
+	void record(size_type id, uint32_t time);
+
+	clock_type _clock {nullptr};
+	uint32_t   _clockMask {0xffffffff};
+	Statistics _statistics[C] {};         // Indexed like the positions
+	size_type  _running {0};              // ID of the task being executed
+	bool       _runningReplaced {false};  // Set once the callback gives the ID to another task
+#endif
 };
 
 
 template <class size_type, size_type C>
-size_type TaskScheduler<size_type, C>::lastID {0};
+TaskScheduler<size_type, C>::TaskScheduler() {
+	reset();
+}
 
 template <class size_type, size_type C>
 size_type TaskScheduler<size_type, C>::schedule(
@@ -56,56 +117,98 @@ size_type TaskScheduler<size_type, C>::schedule(
     task_type      cb,
     timestamp_type interval
 ) {
-	timestamp_type timestamp = currentTime + timeout;
-
-	if (_tasks.full()) {
+	if (!_freeCount) {
 		return 0;
 	}
 
-	size_type i {0};
-	Task      task {cb, timestamp, interval, ++lastID != 0 ? lastID : ++lastID};
-
-	if (!_tasks.empty()) {
-		for (; _tasks[i].timestamp <= timestamp && i < _tasks.size(); ++i);
-
-		// When the position is found, shift existing tasks
-		if (i < _tasks.size() / 2) {  // If the new task should be closer to the front, shift the tasks before
-			_tasks.push_front(_tasks.front());
-			for (size_type j {0}; j < i - 1; ++j) {
-				_tasks[j + 1] = _tasks[j + 2];
-			}
-		} else {  // Otherwise shift the tasks after
-			_tasks.push_back(_tasks.back());
-			for (size_type j = _tasks.size() - 1; j > i + 1; --j) {
-				_tasks[j - 1] = _tasks[j - 2];
-			}
-		}
+	Task task {cb, currentTime + timeout, interval, _freeIDs[--_freeCount]};
 
-		_tasks[i] = task;
-	} else {
-		_tasks.push_back(task);
-	}
+#if TASK_STATISTICS
+	_statistics[task.id - 1] = {};
+	_runningReplaced |= task.id == _running;
+#endif
 
+	place(_size++, task);
+	siftUp(_size - 1);
 	return task.id;
 }
 
 template <class size_type, size_type C>
 void TaskScheduler<size_type, C>::unschedule(size_type id) {
-	size_type i {0};
-	for (; _tasks[i].id != id && i < _tasks.size(); ++i);
+	if (!id || id > C || _positions[id - 1] == noPosition) {
+		return;
+	}
 
-	// Same logic as when adding tasks: shift the smaller part
-	if (i < _tasks.size() / 2) {
-		for (size_type j {i}; j > 0; --j) {
-			_tasks[j] = _tasks[j - 1];
-		}
-		_tasks.pop_front();
+	remove(_positions[id - 1]);
+}
+
+template <class size_type, size_type C>
+void TaskScheduler<size_type, C>::place(size_type position, const Task& task) {
+	_heap[position] = task;
+	_positions[task.id - 1] = position;
+}
+
+template <class size_type, size_type C>
+void TaskScheduler<size_type, C>::remove(size_type position) {
+	size_type id {_heap[position].id};
+
+	_positions[id - 1] = noPosition;
+	_freeIDs[_freeCount++] = id;
+
+	if (position == --_size) {
+		return;
+	}
+
+	// The last task takes the place of the removed one and moves whichever way it has to
+	place(position, _heap[_size]);
+	if (position && earlier(_heap[position].timestamp, _heap[(position - 1) / 2].timestamp)) {
+		siftUp(position);
 	} else {
-		for (size_type j {i}; j < _tasks.size() - 1; ++j) {
-			_tasks[j] = _tasks[j + 1];
+		siftDown(position);
+	}
+}
+
+template <class size_type, size_type C>
+void TaskScheduler<size_type, C>::siftUp(size_type position) {
+	Task task {_heap[position]};
+
+	while (position) {
+		size_type parent = (position - 1) / 2;
+
+		if (!earlier(task.timestamp, _heap[parent].timestamp)) {
+			break;
 		}
-		_tasks.pop_back();
+		place(position, _heap[parent]);
+		position = parent;
 	}
+	place(position, task);
+}
+
+template <class size_type, size_type C>
+void TaskScheduler<size_type, C>::siftDown(size_type position) {
+	Task task {_heap[position]};
+
+	while (true) {
+		size_type child = position * 2 + 1;
+
+		if (child >= _size) {
+			break;
+		}
+		if (child + 1 < _size && earlier(_heap[child + 1].timestamp, _heap[child].timestamp)) {
+			++child;
+		}
+		if (!earlier(_heap[child].timestamp, task.timestamp)) {
+			break;
+		}
+		place(position, _heap[child]);
+		position = child;
+	}
+	place(position, task);
+}
+
+template <class size_type, size_type C>
+bool TaskScheduler<size_type, C>::earlier(timestamp_type a, timestamp_type b) {
+	return static_cast<int32_t>(a - b) < 0;
 }
 
 template <class size_type, size_type C>
@@ -130,44 +233,112 @@ void TaskScheduler<size_type, C>::clearInterval(size_type id) {
 
 template <class size_type, size_type C>
 typename TaskScheduler<size_type, C>::task_type TaskScheduler<size_type, C>::getNextTask(timestamp_type currentTime) {
-	if (_tasks.empty()) {
+	if (!_size || earlier(currentTime, _heap[0].timestamp)) {
 		return nullptr;
 	}
 
-	Task task {_tasks.front()};
+	task_type      cb {_heap[0].cb};
+	timestamp_type late {currentTime - _heap[0].timestamp};
 
-	if (task.timestamp <= currentTime) {
-		if (task.interval) {
-			schedule(currentTime, task.interval, task.cb, task.interval);
-		}
-		_tasks.pop_front();
-		return task.cb;
+#if TASK_STATISTICS
+	Statistics& statistics {_statistics[_heap[0].id - 1]};
+
+	if (late > statistics.maxLateness) {
+		statistics.maxLateness = late;
+	}
+	if (_heap[0].interval) {
+		statistics.overruns += late / _heap[0].interval;
+	}
+#endif
+
+	if (_heap[0].interval) {  // Rescheduled in place, keeping the ID
+		_heap[0].timestamp += (late / _heap[0].interval + 1) * _heap[0].interval;
+		siftDown(0);
 	} else {
-		return nullptr;
+		remove(0);
 	}
+	return cb;
 }
 
 template <class size_type, size_type C>
 void TaskScheduler<size_type, C>::execute(timestamp_type currentTime) {
+#if TASK_STATISTICS
+	while (_size && !earlier(currentTime, _heap[0].timestamp)) {
+		size_type id {_heap[0].id};
+		task_type cb {getNextTask(currentTime)};
+
+		if (!_clock) {
+			cb();
+			continue;
+		}
+
+		uint32_t start {_clock()};
+		_running = id;
+		_runningReplaced = false;
+		cb();
+		_running = 0;
+		if (!_runningReplaced) {  // Otherwise the ID belongs to a task the callback scheduled
+			record(id, (_clock() - start) & _clockMask);
+		}
+	}
+#else
 	for (task_type cb {getNextTask(currentTime)}; cb; cb = getNextTask(currentTime)) {
 		cb();
 	}
+#endif
 }
 
+template <class size_type, size_type C>
+typename TaskScheduler<size_type, C>::timestamp_type TaskScheduler<size_type, C>::getNextTimestamp() const {
+	return _heap[0].timestamp;
+}
+
+#if TASK_STATISTICS
+template <class size_type, size_type C>
+void TaskScheduler<size_type, C>::record(size_type id, uint32_t time) {
+	Statistics& statistics {_statistics[id - 1]};
+
+	if (!statistics.runs++) {
+		statistics.minTime = statistics.averageTime = statistics.maxTime = time;
+	} else {
+		statistics.minTime = time < statistics.minTime ? time : statistics.minTime;
+		statistics.maxTime = time > statistics.maxTime ? time : statistics.maxTime;
+		statistics.averageTime += static_cast<int32_t>(time - statistics.averageTime) / 16;
+	}
+	statistics.lastTime = time;
+}
+
+template <class size_type, size_type C>
+void TaskScheduler<size_type, C>::setClock(clock_type clock, uint32_t mask) {
+	_clock = clock;
+	_clockMask = mask;
+}
+
+template <class size_type, size_type C>
+const typename TaskScheduler<size_type, C>::Statistics& TaskScheduler<size_type, C>::getStatistics(size_type id) const {
+	return _statistics[id ? id - 1 : 0];
+}
+#endif
+
 template <class size_type, size_type C>
 size_type TaskScheduler<size_type, C>::size() const {
-	return _tasks.size();
+	return _size;
 }
 
 template <class size_type, size_type C>
 bool TaskScheduler<size_type, C>::empty() const {
-	return _tasks.empty();
+	return !_size;
 }
 
 template <class size_type, size_type C>
 void TaskScheduler<size_type, C>::reset() {
-	_tasks.clear();
-	lastID = 0;
+	_size = 0;
+	_freeCount = C;
+
+	for (size_type i {0}; i < C; ++i) {
+		_positions[i] = noPosition;
+		_freeIDs[i] = C - i;  // Lowest IDs are given out first
+	}
 }
 
 
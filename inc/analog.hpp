@@ -0,0 +1,28 @@
+/*
+ * File:   analog.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 3:10 PM
+ */
+
+#ifndef ANALOG_HPP
+#define ANALOG_HPP
+
+#include "device.h"
+
+#include "util.hpp"
+
+/* Background measurement of the internal temperature sensor, battery voltage (PA02) and current (PA03).
+ * A scan is started by the RTC periodic event at 128Hz through the event system, every input is averaged
+ * over 16 samples by the ADC and the results are converted in the ADC interrupt, so reading them never blocks.
+ */
+
+namespace analog {
+	void init();
+
+	int8_t   getTemperature();     // Degrees Celsius
+	uint16_t getBatteryVoltage();  // Millivolts
+	uint16_t getCurrent();         // Milliamps
+}
+
+#endif /* ANALOG_HPP */
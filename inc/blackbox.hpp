@@ -0,0 +1,45 @@
+/*
+ * File:   blackbox.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 2:40 PM
+ */
+
+#ifndef BLACKBOX_HPP
+#define BLACKBOX_HPP
+
+#include "device.h"
+
+#include "BlackboxCodec.hpp"
+#include "util.hpp"
+
+/* Frames are encoded by record() into a RAM ring and handed to the backend by flush(), neither waits.
+ * If the backend falls behind and a frame does not fit into the ring, it is dropped and counted,
+ * the next recorded frame is a keyframe so the log can be decoded again from there.
+ */
+
+namespace blackbox {
+	class Backend {
+	public:
+		// Takes up to length bytes without waiting, returns the amount taken
+		virtual uint16_t write(const uint8_t* data, uint16_t length) = 0;
+
+	protected:
+		~Backend() = default;
+	};
+
+	// Streams the log over UART1, to be stored by an external logger
+	class UARTBackend: public Backend {
+	public:
+		uint16_t write(const uint8_t* data, uint16_t length) override;
+	};
+
+	void init(Backend* backend);
+
+	void record(const BlackboxFrame& frame);
+	void flush();
+
+	uint32_t getDroppedFrames();
+}
+
+#endif /* BLACKBOX_HPP */
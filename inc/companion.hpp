@@ -0,0 +1,38 @@
+/*
+ * File:   companion.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 5:50 PM
+ */
+
+#ifndef COMPANION_HPP
+#define COMPANION_HPP
+
+#include "device.h"
+
+#include "CompanionCodec.hpp"
+#include "data.hpp"
+#include "util.hpp"
+
+/* Companion computer link on UART2, messages are framed by CompanionCodec.
+ * Commands use the same layout as USB requests: the command type, the value and the data,
+ * replies and telemetry are the same responses as over USB, starting with the response type.
+ * Responses are encoded straight from the variables, those kept in flash are read byte by byte.
+ * A command is copied from the decoder in the interrupt and handled by update(), the decoder keeps decoding
+ * and commands completed in between are dropped.
+ * A command setting options while another record page of them is being written is kept until the next update().
+ */
+
+namespace companion {
+	void init();
+	// Handles a received command, sends subscribed variables when due
+	void update();
+
+	// Returns false if no setpoint was received recently
+	bool getSetpoint(float& pitch, float& heading);
+
+	const CompanionDecoder::Statistics& getStatistics();
+	uint32_t                            getDroppedFrames();
+}
+
+#endif /* COMPANION_HPP */
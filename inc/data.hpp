@@ -18,16 +18,33 @@ namespace data {
 	constexpr uint8_t inputChannelNumber {8};
 	constexpr uint8_t outputChannelNumber {8};
 	constexpr uint8_t pidNumber {3};
+	constexpr uint8_t taskNumber {6};  // Rate groups of the main loop
+	constexpr uint8_t profileZoneNumber {6};
+	constexpr uint8_t profileNameLength {8};
 	constexpr uint8_t mixesNumber {inputChannelNumber * outputChannelNumber};
+	constexpr uint8_t streamVariableNumber {8};
+	constexpr uint8_t variableNumber {11};
+	constexpr uint8_t variableHeaderSize {2};  // Response type and variable ID
+
+	// Variable flags
+	constexpr uint8_t variableWritable {0x01};
+	constexpr uint8_t variablePersistent {0x02};
+	constexpr uint8_t variableInFlash {0x04};  // Persistent part is read from nvm, response only holds the header
 
 	enum class CommandType : uint8_t {
 		GetVariable = 0x0,
 		SetVariable = 0x1,
-		Calibration = 0x2
+		Calibration = 0x2,
+		GetVariables = 0x3,
+		SetVariables = 0x4,
+		Subscribe = 0x5,
+		Setpoint = 0x6  // Companion computer only
 	};
 
 	enum class ResponseType : uint8_t {
-		ReturnVariable = 0x0
+		ReturnVariable = 0x0,
+		ReturnVariables = 0x1,
+		StreamFrame = 0x2
 	};
 
 	enum class VariableID : uint8_t {
@@ -39,7 +56,16 @@ namespace data {
 		Trims = 0x5,
 		Limits = 0x6,
 		Outputs = 0x7,
-		PIDs = 0x8
+		PIDs = 0x8,
+		Tasks = 0x9,
+		Profile = 0xa
+	};
+
+	// Result of setting variables, stored options have to be committed unless nothing was stored
+	enum class SetResult : uint8_t {
+		Stored,
+		NotStored,
+		Pending  // Options of another record page are being edited, set again once the commit has written them
 	};
 
 	struct __attribute__((packed)) USBStatusResponse {
@@ -106,15 +132,99 @@ namespace data {
 		InlinePID<float>::PIDCoefficients coefficients[pidNumber];
 	};
 
+	struct __attribute__((packed)) TaskStatistics {
+		uint16_t minTime;  // us
+		uint16_t averageTime;
+		uint16_t maxTime;
+		uint16_t maxLateness;  // us after the scheduled time
+		uint16_t overruns;     // Runs skipped because the task was late
+	};
+
+	struct __attribute__((packed)) USBTasksResponse {
+		const uint8_t  responseType {static_cast<uint8_t>(ResponseType::ReturnVariable)};
+		const uint8_t  variableID {static_cast<uint8_t>(VariableID::Tasks)};
+		TaskStatistics tasks[taskNumber];  // Sensors, control, outputs, telemetry, housekeeping and USB
+		uint16_t       sleepShare;         // Time the CPU spent asleep over the last housekeeping period, 1/1000
+	};
+
+	struct __attribute__((packed)) ProfileStatistics {
+		char     name[profileNameLength];  // Not terminated if it takes the whole length
+		uint16_t runs;                     // Wraps
+		uint32_t minTime;                  // ns
+		uint32_t averageTime;
+		uint32_t p99Time;
+		uint32_t maxTime;
+	};
+
+	struct __attribute__((packed)) USBProfileResponse {
+		const uint8_t     responseType {static_cast<uint8_t>(ResponseType::ReturnVariable)};
+		const uint8_t     variableID {static_cast<uint8_t>(VariableID::Profile)};
+		ProfileStatistics zones[profileZoneNumber];  // In the order they first ran, unused zones are empty
+	};
+
+	// Part of a variable in batched requests and responses, followed by the data itself except in get requests
+	struct __attribute__((packed)) VariableSlice {
+		uint8_t variableID;
+		uint8_t offset;  // Bytes from the start of the variable data, after the response type and variable ID
+		uint8_t length;  // Can be 0 in get requests to read until the end of the variable
+	};
+
+	// Followed by the requested variable slices
+	struct __attribute__((packed)) USBVariablesResponse {
+		const uint8_t responseType {static_cast<uint8_t>(ResponseType::ReturnVariables)};
+		uint8_t       count;
+	};
+
+	struct __attribute__((packed)) USBSubscribeRequest {
+		uint16_t rate;  // Frames per second, 0 to stop streaming
+		uint8_t  variableIDs[streamVariableNumber];
+	};
+
+	// Variables subscribed over one of the transports and the timing of their frames
+	struct Stream {
+		uint8_t  variableIDs[streamVariableNumber] {};
+		uint8_t  count {0};
+		uint32_t period {0};  // us, 0 if not streaming
+		uint16_t sequence {0};
+		uint32_t lastFrame {0};  // us
+	};
+
+	// Targets for the position mode, used while they keep coming
+	struct __attribute__((packed)) SetpointRequest {
+		int16_t pitch;    // 10430 LSB/rad
+		int16_t heading;  // 10430 LSB/rad
+	};
+
+	// Followed by the complete responses of the subscribed variables
+	struct __attribute__((packed)) USBStreamFrame {
+		const uint8_t responseType {static_cast<uint8_t>(ResponseType::StreamFrame)};
+		uint8_t       count;
+		uint16_t      sequence;  // Incremented for every frame, including the ones dropped while the host was busy
+		uint32_t      time;      // us, wraps every 71 minutes
+	};
+
+	/* Every variable is described by an entry in a constant table indexed by its ID,
+	 * so the transports can access any variable without knowing its type.
+	 * The persistent part of a variable runs from storedOffset to the end of the response
+	 * and is mirrored byte for byte in nvm::options, stored points to the option in nvm::options.
+	 * Variables only read by the transports and the mixer are not copied to RAM at all.
+	 */
+	struct Variable {
+		uint8_t*       response;  // Complete response, starting with the response type and variable ID
+		uint8_t        size;
+		uint8_t        flags;
+		uint8_t        storedOffset;
+		const uint8_t* stored;
+	};
+
 	extern USBStatusResponse   usbStatusResponse;
 	extern USBSensorsResponse  usbSensorsResponse;
 	extern USBSettingsResponse usbSettingsResponse;
 	extern USBInputsResponse   usbInputsResponse;
-	extern USBMixesResponse    usbMixesResponse;
-	extern USBTrimsResponse    usbTrimsResponse;
-	extern USBLimitsResponse   usbLimitsResponse;
 	extern USBOutputsResponse  usbOutputsResponse;
 	extern USBPIDsResponse     usbPIDsResponse;
+	extern USBTasksResponse    usbTasksResponse;
+	extern USBProfileResponse  usbProfileResponse;
 
 	extern InlineMatrix<int16_t, uint8_t, inputChannelNumber, 1>                   inputs;
 	extern InlineMatrix<int16_t, uint8_t, outputChannelNumber, inputChannelNumber> mixes;
@@ -128,6 +238,24 @@ namespace data {
 	extern InlinePID<float>& headingPID;
 
 	void calculateOutputs();
+	// Copies the mixes, trims and limits used by calculateOutputs() once their records change and nvm is idle.
+	// Only from the main loop between cycles, the records move and their rows are erased from the NVMCTRL interrupt
+	void updateOptions();
+
+	// Returns nullptr if the variable does not exist
+	const Variable* getVariable(uint8_t variableID);
+	// Copies a part of the complete response, including the header
+	void            readVariable(const Variable* variable, uint8_t start, uint8_t length, uint8_t* dest);
+	// Offset and length are relative to the variable data
+	SetResult       setVariable(uint8_t variableID, uint8_t offset, uint8_t length, const uint8_t* src);
+	// Packs as many of the requested slices as fit into a USBVariablesResponse, returns its size
+	uint8_t         getVariables(uint8_t count, const VariableSlice* slices, uint8_t* dest, uint8_t capacity);
+	// Applies the slices found within length bytes, stops at the first pending one
+	SetResult       setVariables(uint8_t count, const uint8_t* slices, uint8_t length);
+	// Subscribes to up to count variables of a USBSubscribeRequest of length bytes, skipping those that don't fit
+	void            subscribe(Stream& stream, uint8_t count, const uint8_t* src, uint8_t length, uint8_t frameSize);
+	// Returns true if a frame is due and moves on to the next one
+	bool            streamDue(Stream& stream, uint32_t now);
 }  // namespace data
 
 #endif /* DATA_HPP */
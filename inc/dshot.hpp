@@ -0,0 +1,49 @@
+/*
+ * File:   dshot.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 2:05 PM
+ */
+
+#ifndef DSHOT_HPP
+#define DSHOT_HPP
+
+#include "device.h"
+
+#include "DShotCodec.hpp"
+#include "util.hpp"
+
+/* DShot output on TCC0 (servo channels 0-3), replacing the analog PWM of that group.
+ * Each frame is prebuilt as a list of compare values, one per bit, and streamed into TCC0_CCBUF by the DMAC
+ * on every timer overflow, so the CPU is only involved when a new frame is started.
+ *
+ * In bidirectional mode the outputs are inverted and, after a frame is sent, the pins are sampled through the DMAC
+ * to capture the eRPM telemetry the ESCs send back. The DMAC is done with a frame one bit before the line is,
+ * so the pins are only switched to inputs on the overflow after that. The samples are decoded in update().
+ * The frames and the telemetry are encoded by DShotCodec.
+ */
+
+namespace dshot {
+	// Selected by the motorProtocol option
+	enum class Protocol : uint8_t {
+		Off = 0x0,  // Servo outputs
+		DShot150 = 0x1,
+		DShot300 = 0x2,
+		DShot150Bidirectional = 0x3,
+		DShot300Bidirectional = 0x4
+	};
+
+	constexpr uint8_t motorNumber {4};
+
+	// Takes TCC0 over from the servo outputs, returns false for Off and unknown protocols, TCC0 is left alone then
+	bool init(Protocol protocol);
+
+	// Starts sending new throttle values to all motors, returns false if the previous frame is still being sent
+	bool setThrottle(const uint16_t* throttles, bool telemetry = false);
+	// Decodes captured telemetry, should be called before the next frame is started
+	void update();
+	// Last valid eRPM value, 0 if none was received
+	uint32_t getERPM(uint8_t motor);
+}
+
+#endif /* DSHOT_HPP */
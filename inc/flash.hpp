@@ -0,0 +1,39 @@
+/*
+ * File:   flash.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 9:10 PM
+ */
+
+#ifndef FLASH_HPP
+#define FLASH_HPP
+
+#include <cstdint>
+
+/* Read-while-write section of the flash, the CPU keeps running from the main array while it is written.
+ * Commands don't wait, ready() tells when the last one is done. Offsets are from the start of the section.
+ */
+
+namespace flash {
+	constexpr uint8_t  pageSize {64};
+	constexpr uint16_t rowSize {pageSize * 4};  // Smallest erasable unit
+	constexpr uint16_t size {2048};
+
+	// The callback is called from the interrupt once a command completes, when enabled by notify()
+	void init(void (*cb)());
+
+	// Can be read directly
+	const uint8_t* getAddress();
+
+	void               eraseRow(uint16_t offset);
+	// Buffer for the page at the offset, words written there are programmed by writePage()
+	volatile uint32_t* getPageBuffer(uint16_t offset);
+	void               writePage(uint16_t offset);
+
+	bool ready();
+	void notify();
+	// Disables the notification and discards it if it is already pending
+	void cancel();
+}
+
+#endif /* FLASH_HPP */
@@ -0,0 +1,72 @@
+/*
+ * File:   flight.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 11:10 PM
+ */
+
+#ifndef FLIGHT_HPP
+#define FLIGHT_HPP
+
+#include "device.h"
+
+#include "BlackboxCodec.hpp"
+#include "Matrix.hpp"
+#include "Quaternion.hpp"
+#include "ReceiverParser.hpp"
+#include "util.hpp"
+
+/* Attitude estimation, flight modes and the output calculation. Nothing here reads a peripheral or the clock,
+ * the main loop passes in the sensor samples, a snapshot of the commands and the time since the previous run,
+ * so a recorded flight can be replayed through the same code, see tools/blackbox-replay.cpp.
+ * The results are left in data::inputs and data::outputs.
+ */
+
+namespace flight {
+	enum class FlightMode : uint8_t {
+		Manual = 0x0,
+		Attitude = 0x1,
+		Position = 0x2
+	};
+
+	enum class OrientationMode : uint8_t {
+		Normal = 0x0,
+		Inverted = 0x1,
+		Tailsitter = 0x2  // Unused for now
+	};
+
+	enum class GimbalMode : uint8_t {
+		Fixed = 0x0,
+		Horizon = 0x1,
+		Direction = 0x2
+	};
+
+	// Taken once per cycle, so the control and the outputs see the same commands
+	struct Commands {
+		int16_t channels[ReceiverParser::channelNumber] {};
+		bool    receiverAvailable {false};
+		bool    failsafeActive {false};
+		bool    setpointActive {false};  // A companion setpoint was received recently
+		float   setpointPitch {0};
+		float   setpointHeading {0};
+	};
+
+	// Intervals are in us since the previous run, late runs integrate over the time that has actually passed
+	void updateAttitude(
+	    const Vector3<float, uint8_t>& angularRates, const Vector3<float, uint8_t>& accelerations, uint32_t interval
+	);
+	void updateControl(const Commands& commands, uint32_t interval);
+	void updateOutputs(const Commands& commands);
+
+	// Mahony gains, not kept in the options, the defaults are used until this is called
+	void setEstimatorGains(float kp, float ki);
+
+	// Writes the attitude, the flight mode, the PID terms and the outputs into a blackbox frame
+	void writeResults(BlackboxFrame& frame);
+
+	FlightMode                     getFlightMode();
+	const Quaternion&              getOrientation();
+	const Vector3<float, uint8_t>& getAngles();  // Yaw, pitch and roll
+}
+
+#endif /* FLIGHT_HPP */
@@ -13,17 +13,32 @@
 #include "device.h"
 
 #include "data.hpp"
+#include "servo.hpp"
 #include "util.hpp"
 
 
-#define FLASH_ROW_SIZE (FLASH_PAGE_SIZE * 4)
-
-/* Non-volatile memory controller can write one page and erase one row (4 pages) at a time,
- * therefore, a following procedure is used:
- * - Upon any edits, a copy of an entire row is made
- * - Multiple edits can take place
- * - After calling write() or when starting to edit another row, the current row is erased,
- * the data is copied back and all 4 pages are written.
+/* Options are kept in the read-while-write EEPROM emulation area (RWWEE), which can be erased and written
+ * while the CPU keeps executing from the main flash.
+ * Non-volatile memory controller can write one page and erase one row (4 pages) at a time, so instead of
+ * rewriting the same row on every change, the RWWEE is used as a journal of records:
+ * - Each option field is a key, a record holds the key, a sequence number, a CRC and the value
+ * - Options are read directly from their current records, unwritten options are read from the defaults
+ * - Edits are made to a copy of a single record page in RAM, another page can only be edited once the copy
+ * is committed and written, edit() returns false until then and is called again later. Taking the copy
+ * reads the flash, so it also waits while the controller is busy.
+ * - After calling commit() or write(), a new record is appended if the edited page changed,
+ * the other pages are copied from the current record straight into the page buffer
+ * - Edited values are returned by read() right away, but by get() only once they are written
+ * - The record with the highest sequence number and a valid CRC is the current value of its key
+ * - Once fewer than 3 rows remain blank, current records are moved out of the oldest row and it is erased
+ *
+ * The header page of a record is written last, so a record interrupted by a power loss never becomes valid
+ * and the previous one is used instead. All rows are written in turn, spreading the wear across the RWWEE.
+ * Each step is started from the NVMCTRL interrupt once the previous one completes, so a commit never waits
+ * for the controller. Edits made while a commit is in progress are written by the next one.
+ * Reading any option while a row is being erased or written stalls the CPU until the controller is done,
+ * the RWWEE is a single array. Options used every cycle are copied to RAM once a commit completes,
+ * see data::updateOptions().
  */
 
 
@@ -34,51 +49,62 @@ namespace nvm {
 		int16_t                           trims[data::outputChannelNumber] {0};
 		int16_t                           limits[data::outputChannelNumber * 2] {0};
 		InlinePID<float>::PIDCoefficients pidCoefficients[data::pidNumber] {};
+		uint8_t                           outputRates[servo::groupNumber] {0};
+		uint8_t                           motorProtocol {0};     // dshot::Protocol driving group 0, servos if Off
+		uint8_t                           receiverProtocol {0};  // receiver::Protocol, SBUS by default
 	};
 
 	namespace _internal {
-		extern uint8_t        rowCopy[FLASH_ROW_SIZE];  // Copy of the row
-		extern const uint8_t* modifiedRow;              // Original address of the data
-
-		struct __attribute__((packed)) Rows {
-			union {
-				Options options {};
-				uint8_t pad[FLASH_ROW_SIZE];
-			};
-		};
-
-		extern const Rows rows;
+		extern const Options defaults;
+
+		// Returns the current location of the option byte at the offset
+		const uint8_t* locate(uint8_t offset);
+		uint8_t        read(uint8_t offset);
+		// Returns false if the edit stopped at a byte of another record page than the one being edited
+		// or while a record is written, unchanged bytes are skipped, so the whole edit is repeated later
+		bool           edit(uint8_t offset, const uint8_t* src, uint8_t length);
 	}
 
+	// Default options, only used to address the options, the current values are returned by get()
 	extern const Options* options;
 
+	// Rebuilds the record index, unwritten options keep their defaults
 	void load();
 
+	// Writes the edited options and waits for completion, which takes up to tens of milliseconds.
+	// Only for startup, never from the loop or an interrupt, the transports use commit()
 	void write();
+	// Starts writing the edited options in the background
+	void commit();
+	// Returns true while a record is written or a row erased, reading options then may stall the CPU
+	bool busy();
+
+	// Changes whenever a record is written and options may have moved, copies made in between are consistent
+	uint8_t getRevision();
 
+	// Returns the current written value of an option, valid until the next commit
 	template <class T>
-	void edit(const T* dest, T src) {
-		// Cannot use % with pointers, need to cast to a number and back
-		auto row {reinterpret_cast<const uint8_t*>(
-		    reinterpret_cast<uint32_t>(dest) - (reinterpret_cast<uint32_t>(dest) % FLASH_ROW_SIZE)
-		)};
-
-		if (reinterpret_cast<const _internal::Rows*>(row) < &_internal::rows
-		    || reinterpret_cast<const _internal::Rows*>(row) >= &_internal::rows + 1) {
-			return;
-		}
+	const T* get(const T* option) {
+		return reinterpret_cast<const T*>(
+		    _internal::locate(reinterpret_cast<const uint8_t*>(option) - reinterpret_cast<const uint8_t*>(options))
+		);
+	}
+
+	// Returns a byte of an option, including edits not yet written
+	inline uint8_t read(const uint8_t* option) {
+		return _internal::read(option - reinterpret_cast<const uint8_t*>(options));
+	}
+
+	// Returns false if another record page is being edited, see _internal::edit()
+	template <class T>
+	bool edit(const T* dest, T src) {
+		auto offset {reinterpret_cast<const uint8_t*>(dest) - reinterpret_cast<const uint8_t*>(options)};
 
-		if (reinterpret_cast<const uint8_t*>(row) != _internal::modifiedRow) {  // Starting to edit another row
-			write();                                                              // Writing current row
-			util::copy(                                                           // Making a copy of the new row
-			    reinterpret_cast<uint32_t*>(_internal::rowCopy),                  // Destination
-			    reinterpret_cast<const uint32_t*>(row),                           // New row
-			    FLASH_ROW_SIZE / sizeof(uint32_t)  // Copying the entire row in 32-bit operations
-			);
-			_internal::modifiedRow = row;
+		if (offset < 0 || static_cast<size_t>(offset) + sizeof(T) > sizeof(Options)) {
+			return true;
 		}
 
-		*reinterpret_cast<T*>(_internal::rowCopy + (reinterpret_cast<const uint8_t*>(dest) - row)) = src;
+		return _internal::edit(offset, reinterpret_cast<const uint8_t*>(&src), sizeof(T));
 	}
 }  // namespace nvm
 
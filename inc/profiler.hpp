@@ -0,0 +1,91 @@
+/*
+ * File:   profiler.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 8:30 PM
+ */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+
+/*
+ * Records how long the rest of the scope takes, PROFILE_ZONE("name") at the start of a function or a block.
+ * Zones are registered the first time they run, into a fixed table of zoneNumber entries,
+ * zones that don't fit are not recorded. Only use zones outside of interrupts.
+ */
+#ifndef PROFILING
+	#define PROFILING true
+#endif
+
+/*
+ * PORT pin set while a zone runs through the single-cycle IOBUS, for measuring with a scope, 0xff to disable
+ */
+#define PROFILE_PIN 0xff
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+
+#if PROFILING
+	#define PROFILE_ZONE(name)                                   \
+		static uint8_t  PROFILE_CONCAT(profileZone, __LINE__) {0}; \
+		profiler::Scope PROFILE_CONCAT(profileScope, __LINE__) {PROFILE_CONCAT(profileZone, __LINE__), name}
+#else
+	#define PROFILE_ZONE(name)
+#endif
+
+/* Durations are measured in ticks of a free-running counter, the CPU cycles on the device
+ * and nanoseconds from clock_gettime() on the host. Each zone keeps a histogram with two buckets per octave,
+ * the 99th percentile is the upper bound of the bucket it falls into.
+ */
+
+namespace profiler {
+	constexpr uint8_t zoneNumber {6};
+	constexpr uint8_t bucketNumber {24};  // From 64 to 2^18 ticks, shorter and longer runs are counted in the ends
+#if defined(__arm__)
+	constexpr uint32_t tickMask {0xffffff};  // SysTick is a 24-bit counter
+#else
+	constexpr uint32_t tickMask {0xffffffff};
+#endif
+
+	struct Statistics {
+		const char* name {nullptr};
+		uint32_t    runs {0};
+		uint32_t    minTime {0};  // ns
+		uint32_t    averageTime {0};
+		uint32_t    p99Time {0};
+		uint32_t    maxTime {0};
+	};
+
+	void init();
+
+	// Differences of ticks only have the bits of the tick mask
+	uint32_t getTicks();
+	uint32_t toNanoseconds(uint32_t ticks);
+	uint8_t  getZoneCount();
+	// Times are converted to ns
+	Statistics getStatistics(uint8_t zone);
+	void       reset();
+
+	// Returns the starting tick
+	uint32_t begin();
+	// Registers the zone on its first run, the ID stays 0 until then
+	void     end(uint8_t& zone, const char* name, uint32_t start);
+
+	class Scope {
+	public:
+		Scope(uint8_t& zone, const char* name);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	protected:
+		uint8_t&    _zone;
+		const char* _name;
+		uint32_t    _start;
+	};
+}
+
+#endif /* PROFILER_HPP */
@@ -0,0 +1,37 @@
+/*
+ * File:   receiver.hpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 11:40 AM
+ */
+
+#ifndef RECEIVER_HPP
+#define RECEIVER_HPP
+
+#include "device.h"
+
+#include "ReceiverParser.hpp"
+#include "util.hpp"
+
+namespace receiver {
+	// Selected by the receiverProtocol option
+	enum class Protocol : uint8_t {
+		SBUS = 0x0,
+		CRSF = 0x1,
+		IBUS = 0x2,
+		SUMD = 0x3
+	};
+
+	// Unknown protocols fall back to SBUS
+	void init(Protocol protocol);
+
+	bool    available();
+	int16_t getChannel(uint8_t channel);  // Channels start from 0
+	bool    frameLost();
+	bool    failsafeActive();
+
+	const ReceiverParser::Snapshot&   getSnapshot();
+	const ReceiverParser::Statistics& getStatistics();
+}
+
+#endif /* RECEIVER_HPP */
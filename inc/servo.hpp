@@ -13,7 +13,27 @@
 #include "util.hpp"
 
 namespace servo {
-	void init();
+	/* Channels are split into groups by the timer driving them:
+	 * - Group 0 (TCC0): channels 0-3
+	 * - Group 1 (TCC1): channels 4-5
+	 * - Group 2 (TCC2): channels 6-7
+	 * All channels in a group share the same output rate.
+	 */
+	constexpr uint8_t channelNumber {8};
+	constexpr uint8_t groupNumber {3};
+	constexpr uint8_t allGroups {(1u << groupNumber) - 1};
+
+	enum class Rate : uint8_t {
+		Analog50Hz = 0x0,    // 1-2ms pulses every 20ms
+		Digital200Hz = 0x1,  // 1-2ms pulses every 5ms
+		Digital333Hz = 0x2,  // 1-2ms pulses every 3ms
+		OneShot125 = 0x3     // 125-250us pulses every 500us
+	};
+
+	// Groups left out of the mask are not touched, their timers can be used by other drivers
+	void init(uint8_t groups = allGroups);
+
+	void setRate(uint8_t group, Rate rate);
 
 	// Channels start from 0
 	void enable(uint8_t channel);
@@ -21,6 +41,8 @@ namespace servo {
 
 	// Values from -1500 to 1500
 	void setChannel(uint8_t channel, int16_t angle);
+	// Updates all channels at once, new values are applied to all outputs at the start of the next period
+	void setAll(const int16_t* angles);
 }
 
 
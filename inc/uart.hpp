@@ -29,6 +29,7 @@ namespace uart {
 		using callback_type = void (*)(const Buffer<size_type, C>&);
 	};
 
+	// Called from the interrupt with every received byte
 	using DefaultCallback = Callback<uint8_t, 8>;
 	using DefaultQueue = RingBuffer<uart::Buffer<uint8_t, 32>, uint8_t, 32>;
 
@@ -40,6 +41,10 @@ namespace uart {
 
 	uint8_t sendTo2(const uint8_t* buf, uint8_t len);
 	void    set2Callback(uart::DefaultCallback::callback_type cb);
+
+	// Receive-only port for the RC receiver, 8 data bits with even or no parity
+	void init3(uint32_t baud, bool parity, bool twoStopBits);
+	void set3Callback(uart::DefaultCallback::callback_type cb);
 }
 
 
@@ -107,7 +107,7 @@ namespace usb {
 		uint8_t                 bInterfaceSubclass;
 		uint8_t                 bInterfaceProtocol;
 		uint8_t                 iInterface;
-		usb_descriptor_endpoint ENDPOINTS[2];
+		usb_descriptor_endpoint ENDPOINTS[3];
 	};
 
 	struct __attribute__((packed)) usb_descriptor_configuration {
@@ -174,8 +174,6 @@ namespace usb {
 		usb_descriptor_registry_property registry_property;
 	};
 
-	extern usb_descriptor_device_registers_t EPDESCTBL[];
-
 	extern usb_descriptor_device        DESCRIPTOR_DEVICE;
 	extern usb_descriptor_configuration DESCRIPTOR_CONFIGURATION[];
 	extern usb_descriptor_string        DESCRIPTOR_STRING[];
@@ -187,6 +185,11 @@ namespace usb {
 	void writeDefault(const uint8_t* data, uint8_t len);
 	void write(const uint8_t* data, uint8_t len);
 	void read(uint8_t* data, uint8_t len);
+	// Applies a request to set variables that had to wait for the options being written, never waits itself
+	void update();
+	// Sends a frame of the subscribed variables over the bulk endpoint when due, never waits for the host.
+	// Called at 1kHz, the highest subscription rate
+	void stream();
 }  // namespace usb
 
 #endif /* USB_HPP */
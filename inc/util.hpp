@@ -38,8 +38,21 @@ constexpr uint32_t MAX_UINT32 {0xffffffff};
 namespace util {
 	void init();
 
-	uint32_t getTime();
+	uint32_t getTime();      // ms
+	uint32_t getMicros();    // Wraps every 71 minutes
+	uint64_t getMicros64();  // Never wraps in practice, can be read from interrupts
 	void     sleep(uint32_t ms);
+	void     sleepUntil(uint32_t us);
+	uint32_t getSleepTime();  // Total time spent asleep, us, wraps like getMicros()
+
+	void setLED(bool on);
+	// Resets the device unless cleared every 64ms
+	void startWatchdog();
+	void clearWatchdog();
+
+	// Wrap-safe while the times are less than half the counter range (35 minutes) apart
+	bool     reached(uint32_t deadline);
+	uint32_t elapsedSince(uint32_t us);
 
 	template <class T, class S>
 	void copy(T* dest, const T* src, S len = 1) {
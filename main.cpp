@@ -1,44 +1,45 @@
 #include "device.h"
 // #include <xc.h>  // TODO: explore, possibly delete Harmony files
 
+#include "analog.hpp"
+#include "blackbox.hpp"
+#include "companion.hpp"
 #include "data.hpp"
+#include "dshot.hpp"
+#include "flight.hpp"
 #include "i2c.hpp"
 #include "LSM6DSO32.hpp"
-#include "Mahony.hpp"
 #include "nvm.hpp"
-#include "Quaternion.hpp"
-#include "sbus.hpp"
+#include "profiler.hpp"
+#include "receiver.hpp"
 #include "servo.hpp"
+#include "TaskScheduler.hpp"
 #include "uart.hpp"
 #include "usb.hpp"
 #include "util.hpp"
 
-#define DV_OUT 0
+#define DV_OUT   0
+#define BLACKBOX 1
 
 constexpr static float ATT_LSB {10430.0f};
 
-enum class FlightMode : uint8_t {
-	Manual = 0x0,
-	Attitude = 0x1,
-	Position = 0x2
-};
+static_assert(profiler::zoneNumber == data::profileZoneNumber, "Every profiling zone must be exported");
 
-enum class OrientationMode : uint8_t {
-	Normal = 0x0,
-	Inverted = 0x1,
-	Tailsitter = 0x2  // Unused for now
-};
-
-enum class GimbalMode : uint8_t {
-	Fixed = 0x0,
-	Horizon = 0x1,
-	Direction = 0x2
-};
+/* Rate groups, periods in us. The groups sharing a period are started 1ms apart in the order
+ * they depend on each other, the scheduler keeps the phases so the timing error does not build up.
+ */
+constexpr static uint16_t SENSOR_PERIOD {5000};         // 200Hz, the IMU samples at 208Hz
+constexpr static uint16_t CONTROL_PERIOD {5000};        // 200Hz, right after the estimator
+constexpr static uint16_t OUTPUT_PERIOD {5000};         // 200Hz, the fastest regular servo rate
+constexpr static uint16_t TELEMETRY_PERIOD {10000};     // 100Hz, the companion
+constexpr static uint16_t HOUSEKEEPING_PERIOD {20000};  // Well within the 64ms watchdog period
+constexpr static uint16_t USB_PERIOD {1000};            // 1kHz, the fastest USB stream, the stream keeps its own rate
+constexpr static uint16_t GROUP_PHASE {1000};
 
 void calibrate(bool force = false) {
-	if ((nvm::options->angularRateOffsets[0] == 0 && nvm::options->angularRateOffsets[1] == 0
-	     && nvm::options->angularRateOffsets[2] == 0)
-	    || force) {
+	const float* offsets {nvm::get(nvm::options->angularRateOffsets)};
+
+	if ((offsets[0] == 0 && offsets[1] == 0 && offsets[2] == 0) || force) {
 		// If all offsets are zero, recalibrate
 		Vector3<float, uint8_t> zeroOffsets {};
 
@@ -53,35 +54,60 @@ void calibrate(bool force = false) {
 		LSM6DSO32::setOffsets(zeroOffsets);
 
 		for (uint8_t i {0}; i < 3; ++i) {
-			nvm::edit(nvm::options->angularRateOffsets + i, zeroOffsets[i][0]);
+			while (!nvm::edit(nvm::options->angularRateOffsets + i, zeroOffsets[i][0])) {
+				nvm::write();  // Rows freed by nvm::load() might still be erased
+			}
 		}
 
 		nvm::write();
 	} else {  // Otherwise load previous calibration
 		LSM6DSO32::setOffsets(
-		    {{nvm::options->angularRateOffsets[0]},
-		     {nvm::options->angularRateOffsets[1]},
-		     {nvm::options->angularRateOffsets[2]}}
+		    {{offsets[0]}, {offsets[1]}, {offsets[2]}}
 		);
 	}
 }
 
-// Temperature calibration values
-static uint8_t tempR = TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_0 & FUSES_TEMP_LOG_WORD_0_ROOM_TEMP_VAL_INT_Msk;
-static uint8_t tempH = (TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_0 & FUSES_TEMP_LOG_WORD_0_HOT_TEMP_VAL_INT_Msk)
-                    >> FUSES_TEMP_LOG_WORD_0_HOT_TEMP_VAL_INT_Pos;
-static uint16_t adcR = (TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_1 & FUSES_TEMP_LOG_WORD_1_ROOM_ADC_VAL_Msk)
-                    >> FUSES_TEMP_LOG_WORD_1_ROOM_ADC_VAL_Pos;
-static uint16_t adcH = (TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_1 & FUSES_TEMP_LOG_WORD_1_HOT_ADC_VAL_Msk)
-                    >> FUSES_TEMP_LOG_WORD_1_HOT_ADC_VAL_Pos;
+static TaskScheduler<uint8_t, 8> scheduler {};
+static uint8_t                   taskIDs[data::taskNumber] {};
+
+static flight::Commands commands {};
+static bool             motorsOnDShot {false};  // Servo group 0 drives ESCs over DShot instead
 
-static Mahony     mahony {};
-static Quaternion deviceOrientation {};
+static uint32_t lastSensorUpdate {0};  // us
+static uint32_t lastControlUpdate {0};
+static uint32_t sensorInterval {0};
+static uint32_t controlInterval {0};
+static uint32_t lastHousekeeping {0};
+static uint32_t lastSleepTime {0};
+
+#if DV_OUT || BLACKBOX
+// From the start of the sensor group to the end of the output group
+static uint64_t cycleStart {0};  // us
+static uint16_t cycleTime {0};
+#endif
+
+#if TASK_STATISTICS
+// Tasks are timed in profiler ticks, SysTick reads in a single access while the TC counter has to be synchronized
+static uint16_t toMicros(uint32_t ticks) {
+	return util::min<uint32_t>(profiler::toNanoseconds(ticks) / 1000, 0xffff);
+}
+#endif
+
+// Time since the last run in us
+static uint32_t getInterval(uint32_t& lastRun) {
+	uint32_t now {util::getMicros()};
+	uint32_t interval {now - lastRun};
+
+	lastRun = now;
+	return interval;
+}
 
 void updateSensors() {
-	ADC_REGS->ADC_SWTRIG = ADC_SWTRIG_START(1);                 // Start conversion
-	while (!(ADC_REGS->ADC_INTFLAG & ADC_INTFLAG_RESRDY_Msk));  // Wait for ADC result
-	data::usbSensorsResponse.temperature = tempR + ((ADC_REGS->ADC_RESULT - adcR) * (tempH - tempR) / (adcH - adcR));
+#if DV_OUT || BLACKBOX
+	cycleStart = util::getMicros64();
+#endif
+
+	data::usbSensorsResponse.temperature = analog::getTemperature();
 
 	LSM6DSO32::update();
 
@@ -90,30 +116,13 @@ void updateSensors() {
 		data::usbSensorsResponse.angularRates[i] = LSM6DSO32::getRawAngularRates()[2 - i][0];
 	}
 
-	mahony.updateIMU(LSM6DSO32::getAngularRates(), LSM6DSO32::getAccelerations(), 0.01f);
-	deviceOrientation = mahony.getQuaternion();
-	auto deviceAngles {deviceOrientation.toEuler()};
-
-	data::usbStatusResponse.pitch = deviceAngles[1][0] * ATT_LSB;
-	data::usbStatusResponse.roll = deviceAngles[2][0] * ATT_LSB;
-	data::usbStatusResponse.receiverStatus = !!sbus::available() | (!!sbus::failsafeActive() << 1u);
-}
-
-float getDifference(float angleA, float angleB) {
-	float diff = angleA - angleB;
-
-	if (diff > F_PI) {
-		return diff - F_2_PI;
-	} else if (diff < -F_PI) {
-		return diff + F_2_PI;
-	} else {
-		return diff;
-	}
-}
+	sensorInterval = getInterval(lastSensorUpdate);
+	flight::updateAttitude(LSM6DSO32::getAngularRates(), LSM6DSO32::getAccelerations(), sensorInterval);
 
-void startWatchdog() {
-	WDT_REGS->WDT_CONFIG = WDT_CONFIG_PER_CYC64;
-	WDT_REGS->WDT_CTRLA = WDT_CTRLA_ENABLE(1);
+	data::usbStatusResponse.pitch = flight::getAngles()[1][0] * ATT_LSB;
+	data::usbStatusResponse.roll = flight::getAngles()[2][0] * ATT_LSB;
+	data::usbStatusResponse.receiverStatus
+	    = static_cast<uint8_t>(receiver::available()) | static_cast<uint8_t>(receiver::failsafeActive()) << 1u;
 }
 
 #if DV_OUT
@@ -127,176 +136,201 @@ struct DVData {
 } __attribute__((packed));
 #endif
 
-int main() {
-	util::init();
+#if BLACKBOX
+static blackbox::UARTBackend blackboxBackend {};
 
-	nvm::load();
+// Rounded back to the value received from the companion, so the replay converts it to the same float
+static int16_t toSetpoint(float angle) {
+	return angle * ATT_LSB + (angle < 0 ? -0.5f : 0.5f);
+}
 
-	uart::init();
-	sbus::init();
-	i2c::init();
-	LSM6DSO32::init();
-	servo::init();
-	usb::init();
+void recordFrame() {
+	BlackboxFrame frame {};
 
-	calibrate();
+	frame.time = cycleStart / 1000;
+	frame.loopTime = cycleTime;
+	frame.status = commands.receiverAvailable | (commands.failsafeActive << 1u) | (commands.setpointActive << 2u);
 
-	PORT_REGS->GROUP[0].PORT_DIR = 0x1 << 27u;
+	for (uint8_t i {0}; i < 3; ++i) {
+		frame.accelerations[i] = data::usbSensorsResponse.accelerations[i];
+		frame.angularRates[i] = data::usbSensorsResponse.angularRates[i];
+	}
 
-	for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
-		servo::enable(i);
+	for (uint8_t i {0}; i < ReceiverParser::channelNumber; ++i) {
+		frame.channels[i] = commands.channels[i];
 	}
 
-	FlightMode flightMode {};
-	float      pitchTarget {0};
-	float      rollTarget {0};
-	float      headingTarget {0};
-	bool       rthSet {false};
+	if (commands.setpointActive) {
+		frame.setpoint[0] = toSetpoint(commands.setpointPitch);
+		frame.setpoint[1] = toSetpoint(commands.setpointHeading);
+	}
+	frame.intervals[0] = util::min<uint32_t>(sensorInterval, 0xffff);
+	frame.intervals[1] = util::min<uint32_t>(controlInterval, 0xffff);
 
-	startWatchdog();
+	flight::writeResults(frame);
 
-	while (1) {
-#if DV_OUT
-		auto startMs = util::getTime();
-		auto startUs = SysTick->VAL;
+#if TASK_STATISTICS
+	for (uint8_t i {0}; i < data::taskNumber; ++i) {
+		frame.taskTimes[i] = toMicros(scheduler.getStatistics(taskIDs[i]).lastTime);
+	}
 #endif
 
-		updateSensors();
+	blackbox::record(frame);
+	blackbox::flush();
+}
+#endif
 
-		auto deviceAngles {deviceOrientation.toEuler()};
 
-		flightMode = sbus::available() ? static_cast<FlightMode>((sbus::getChannel(8) + 1100) / 333) : FlightMode::Position;
-		OrientationMode orientationMode {
-		  sbus::available() ? static_cast<OrientationMode>((sbus::getChannel(9) + 1100) / 1000) : OrientationMode::Normal
-		};
+void updateControl() {
+	for (uint8_t i {0}; i < ReceiverParser::channelNumber; ++i) {
+		commands.channels[i] = receiver::getChannel(i);
+	}
+	commands.receiverAvailable = receiver::available();
+	commands.failsafeActive = receiver::failsafeActive();
+	commands.setpointActive = companion::getSetpoint(commands.setpointPitch, commands.setpointHeading);
 
-		if (!sbus::available()) {
-			PORT_REGS->GROUP[0].PORT_OUTSET = 0x1 << 27u;
-		} else {
-			PORT_REGS->GROUP[0].PORT_OUTCLR = 0x1 << 27u;
-		}
+	controlInterval = getInterval(lastControlUpdate);
+	flight::updateControl(commands, controlInterval);
+}
 
-		if (sbus::failsafeActive()) {
-			if (!rthSet) {
-				headingTarget = deviceAngles[0][0] + F_PI;
-				if (headingTarget > F_PI) {
-					headingTarget -= F_2_PI;
-				}
-				rthSet = true;
-			}
-		} else {
-			rthSet = false;
-		}
+void updateOutputs() {
+	flight::updateOutputs(commands);
 
-		switch (flightMode) {
-			case (FlightMode::Manual):
-			default: {
-				data::inputs[0][0] = sbus::getChannel(0);
-				data::inputs[1][0] = sbus::getChannel(1);
-				break;
-			}
-			case (FlightMode::Attitude): {
-				rollTarget = sbus::getChannel(0) * F_PI_4 / 1000;
-				pitchTarget = -sbus::getChannel(1) * F_PI_4 / 1000;
-
-				if (orientationMode == OrientationMode::Inverted) {
-					rollTarget = rollTarget + F_PI;
-					if (rollTarget > F_PI) {
-						rollTarget -= F_2_PI;
-					}
-				}
-
-				data::inputs[0][0] = data::rollPID.process(getDifference(rollTarget, deviceAngles[2][0]));
-				data::inputs[1][0] = data::pitchPID.process(getDifference(pitchTarget, deviceAngles[1][0]));
-
-				if (deviceAngles[2][0] < -F_PI_2 || deviceAngles[2][0] > F_PI_2) {
-					data::inputs[1][0] = -data::inputs[1][0];
-				}
-				break;
-			}
-			case (FlightMode::Position): {
-				if (!rthSet) {
-					headingTarget = -sbus::getChannel(0) * F_PI / 1000;
-				}
-				rollTarget =
-				    util::clamp(data::headingPID.process(getDifference(deviceAngles[0][0], headingTarget), 0), -F_PI_4, F_PI_4);
-				pitchTarget = -sbus::getChannel(1) * F_PI_4 / 1000;
-
-				if (orientationMode == OrientationMode::Inverted) {
-					rollTarget = rollTarget + F_PI;
-					if (rollTarget > F_PI) {
-						rollTarget -= F_2_PI;
-					}
-				}
-
-				data::inputs[0][0] = data::rollPID.process(getDifference(rollTarget, deviceAngles[2][0]));
-				data::inputs[1][0] = data::pitchPID.process(getDifference(pitchTarget, deviceAngles[1][0]));
-
-				if (deviceAngles[2][0] < -F_PI_2 || deviceAngles[2][0] > F_PI_2) {
-					data::inputs[1][0] = -data::inputs[1][0];
-				}
-				break;
-			}
+	if (motorsOnDShot) {
+		uint16_t throttles[dshot::motorNumber];
+
+		dshot::update();  // Telemetry of the previous frame
+		for (uint8_t i {0}; i < dshot::motorNumber; ++i) {
+			throttles[i] = DShotCodec::toThrottle(data::outputs[i][0]);
 		}
+		dshot::setThrottle(throttles);
+	}
+	servo::setAll(data::outputs[0]);  // Channels of the groups DShot drives are skipped
 
-		GimbalMode gimbalMode {
-		  sbus::available() ? static_cast<GimbalMode>((sbus::getChannel(10) + 1100) / 1000) : GimbalMode::Horizon
-		};
+#if DV_OUT || BLACKBOX
+	cycleTime = util::getMicros64() - cycleStart;
+#endif
 
-		switch (gimbalMode) {
-			case (GimbalMode::Fixed): {
-				data::inputs[2][0] = -sbus::getChannel(3);
-				data::inputs[3][0] = -sbus::getChannel(4);
-				data::inputs[4][0] = 0;
-				break;
-			}
-			case (GimbalMode::Horizon): {
-				Quaternion cameraOrientation {Quaternion::fromEuler(
-				    deviceAngles[0][0] - sbus::getChannel(3) * F_PI_4 / 1000,
-				    -sbus::getChannel(4) * F_PI_4 / 1000,
-				    0
-				)};
-				Quaternion cameraRotation {deviceOrientation.conjugate() * cameraOrientation};
-				auto       cameraAngles {cameraRotation.toEuler()};
-
-				for (uint8_t i {0}; i < 3; ++i) {
-					data::inputs[i + 2][0] = cameraAngles[i][0] / F_PI_4 * 1000;
-				}
-				break;
-			}
-			case (GimbalMode::Direction): {
-				Quaternion cameraOrientation {
-				  Quaternion::fromEuler(-sbus::getChannel(3) * F_PI / 1000, -sbus::getChannel(4) * F_PI_4 / 1000, 0)
-				};
-				Quaternion cameraRotation {deviceOrientation.conjugate() * cameraOrientation};
-				auto       cameraAngles {cameraRotation.toEuler()};
-
-				for (uint8_t i {0}; i < 3; ++i) {
-					data::inputs[i + 2][0] = cameraAngles[i][0] / F_PI_4 * 1000;
-				}
+#if BLACKBOX
+	recordFrame();  // Every cycle, so that the log can be replayed
+#endif
+}
+
+void updateTelemetry() {
+	companion::update();
+
+#if DV_OUT
+	DVData data {};
+
+	data.dt = cycleTime;
+	data.yaw = flight::getAngles()[0][0];
+	data.pitch = flight::getAngles()[1][0];
+	data.roll = flight::getAngles()[2][0];
+	uart::sendTo1(reinterpret_cast<uint8_t*>(&data), sizeof(data));
+#endif
+}
+
+void updateHousekeeping() {
+#if TASK_STATISTICS
+	for (uint8_t i {0}; i < data::taskNumber; ++i) {
+		const auto&           statistics {scheduler.getStatistics(taskIDs[i])};
+		data::TaskStatistics& response {data::usbTasksResponse.tasks[i]};
+
+		response.minTime = toMicros(statistics.minTime);
+		response.averageTime = toMicros(statistics.averageTime);
+		response.maxTime = toMicros(statistics.maxTime);
+		response.maxLateness = util::min<uint32_t>(statistics.maxLateness, 0xffff);
+		response.overruns = statistics.overruns;
+	}
+#endif
+
+#if PROFILING
+	for (uint8_t i {0}; i < profiler::getZoneCount(); ++i) {
+		profiler::Statistics     statistics {profiler::getStatistics(i)};
+		data::ProfileStatistics& response {data::usbProfileResponse.zones[i]};
+
+		for (uint8_t j {0}; j < data::profileNameLength; ++j) {
+			response.name[j] = statistics.name[j];
+			if (!statistics.name[j]) {
 				break;
 			}
 		}
+		response.runs = statistics.runs;
+		response.minTime = statistics.minTime;
+		response.averageTime = statistics.averageTime;
+		response.p99Time = statistics.p99Time;
+		response.maxTime = statistics.maxTime;
+	}
+#endif
 
-		data::calculateOutputs();
+	uint32_t now {util::getMicros()};
+	uint32_t sleepTime {util::getSleepTime()};
 
-		for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
-			servo::setChannel(i, data::outputs[i][0]);
-		}
+	data::usbTasksResponse.sleepShare = 1000.0f * (sleepTime - lastSleepTime) / (now - lastHousekeeping);
+	lastHousekeeping = now;
+	lastSleepTime = sleepTime;
 
-#if DV_OUT
-		DVData data {};
+	util::setLED(!receiver::available());
+	util::clearWatchdog();
+}
 
-		data.dt = (util::getTime() - startMs) * 1000 + (startUs - SysTick->VAL) / 48;
-		data.yaw = deviceAngles[0][0];
-		data.pitch = deviceAngles[1][0];
-		data.roll = deviceAngles[2][0];
-		uart::sendTo1(reinterpret_cast<uint8_t*>(&data), sizeof(data));
+void updateUSB() {
+	usb::update();
+	usb::stream();
+}
+
+int main() {
+	util::init();
+	profiler::init();
+
+	nvm::load();
+
+	uart::init();
+	companion::init();
+#if BLACKBOX
+	blackbox::init(&blackboxBackend);
+#endif
+	analog::init();
+	receiver::init(static_cast<receiver::Protocol>(*nvm::get(&nvm::options->receiverProtocol)));
+	i2c::init();
+	LSM6DSO32::init();
+	motorsOnDShot = dshot::init(static_cast<dshot::Protocol>(*nvm::get(&nvm::options->motorProtocol)));
+	servo::init(motorsOnDShot ? servo::allGroups & ~0x1u : servo::allGroups);
+	usb::init();
+
+	calibrate();
+
+	for (uint8_t i {0}; i < servo::groupNumber; ++i) {
+		servo::setRate(i, static_cast<servo::Rate>(nvm::get(nvm::options->outputRates)[i]));
+	}
+
+	for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
+		servo::enable(i);
+	}
+
+	util::startWatchdog();
+
+#if TASK_STATISTICS
+	scheduler.setClock(profiler::getTicks, profiler::tickMask);
 #endif
 
-		util::sleep(10);
+	uint32_t start {util::getMicros()};
+	lastSensorUpdate = start;  // Intervals run first a period after their start, so the first runs get it too
+	lastControlUpdate = start + GROUP_PHASE;
+	lastHousekeeping = start;
+	lastSleepTime = util::getSleepTime();
+
+	taskIDs[0] = scheduler.setInterval(start, SENSOR_PERIOD, updateSensors);
+	taskIDs[1] = scheduler.setInterval(start + GROUP_PHASE, CONTROL_PERIOD, updateControl);
+	taskIDs[2] = scheduler.setInterval(start + GROUP_PHASE * 2, OUTPUT_PERIOD, updateOutputs);
+	taskIDs[3] = scheduler.setInterval(start + GROUP_PHASE * 3, TELEMETRY_PERIOD, updateTelemetry);
+	taskIDs[4] = scheduler.setInterval(start + GROUP_PHASE * 4, HOUSEKEEPING_PERIOD, updateHousekeeping);
+	taskIDs[5] = scheduler.setInterval(start + GROUP_PHASE / 2, USB_PERIOD, updateUSB);  // Between the other groups
 
-		WDT_REGS->WDT_CLEAR = WDT_CLEAR_CLEAR_KEY;
+	while (1) {
+		data::updateOptions();  // Between the tasks, the mixer never waits for the flash
+		scheduler.execute(util::getMicros());
+		util::sleepUntil(scheduler.getNextTimestamp());  // Interrupts still wake the CPU up in between
 	}
 
 	return 1;
@@ -0,0 +1,135 @@
+#include "BlackboxCodec.hpp"
+
+
+static uint16_t zigzag(uint16_t delta) {
+	return (delta << 1u) ^ (delta & 0x8000 ? 0xffff : 0);
+}
+
+static uint16_t unzigzag(uint16_t value) {
+	return (value >> 1u) ^ (value & 0x1 ? 0xffff : 0);
+}
+
+uint8_t BlackboxCodec::crc8DVBS2(uint8_t crc, uint8_t byte) {
+	crc ^= byte;
+	for (uint8_t i {0}; i < 8; ++i) {
+		crc = crc & 0x80 ? (crc << 1u) ^ 0xd5 : crc << 1u;
+	}
+	return crc;
+}
+
+uint8_t BlackboxEncoder::encode(const BlackboxFrame& frame, uint8_t* dest) {
+	auto*   words {reinterpret_cast<const uint16_t*>(&frame)};
+	auto*   previous {reinterpret_cast<const uint16_t*>(&_previous)};
+	bool    keyframe {!_frameCount};
+	uint8_t length {0};
+
+	if (keyframe) {
+		dest[length++] = syncBytes[0];
+		dest[length++] = syncBytes[1];
+		dest[length++] = keyframeType;
+	} else {
+		dest[length++] = deltaType;
+	}
+
+	for (uint8_t i {0}; i < wordNumber; ++i) {
+		uint16_t value {zigzag(keyframe ? words[i] : words[i] - previous[i])};
+
+		while (value >= 0x80) {
+			dest[length++] = (value & 0x7f) | 0x80;
+			value >>= 7u;
+		}
+		dest[length++] = value;
+	}
+
+	if (keyframe) {
+		uint8_t crc {0};
+		for (uint8_t i {sizeof(syncBytes)}; i < length; ++i) {
+			crc = crc8DVBS2(crc, dest[i]);
+		}
+		dest[length++] = crc;
+	}
+
+	_previous = frame;
+	_frameCount = (_frameCount + 1) % keyframeInterval;
+	return length;
+}
+
+void BlackboxEncoder::restart() {
+	_frameCount = 0;
+}
+
+size_t BlackboxDecoder::decode(const uint8_t* src, size_t length) {
+	bool   keyframe {isKeyframe(src, length)};
+	size_t position {keyframe ? sizeof(syncBytes) + 1 : 1};
+
+	if (!keyframe && (!length || src[0] != deltaType || !_synchronized)) {
+		_synchronized = false;
+		return 0;
+	}
+
+	BlackboxFrame frame {keyframe ? BlackboxFrame {} : _previous};
+	auto*         words {reinterpret_cast<uint16_t*>(&frame)};
+
+	for (uint8_t i {0}; i < wordNumber; ++i) {
+		uint16_t value {0};
+
+		for (uint8_t shift {0};; shift += 7) {
+			if (position >= length || shift > 14) {  // Truncated or more than 16 bits
+				_synchronized = false;
+				return 0;
+			}
+
+			uint8_t byte {src[position++]};
+			value |= (byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				break;
+			}
+		}
+		words[i] += unzigzag(value);
+	}
+
+	if (keyframe) {
+		++position;  // CRC, checked by isKeyframe()
+	}
+
+	_previous = frame;
+	_synchronized = true;
+	return position;
+}
+
+const BlackboxFrame& BlackboxDecoder::getFrame() const {
+	return _previous;
+}
+
+bool BlackboxDecoder::synchronized() const {
+	return _synchronized;
+}
+
+bool BlackboxDecoder::isKeyframe(const uint8_t* src, size_t length) {
+	if (length < keyframeOverhead || src[0] != syncBytes[0] || src[1] != syncBytes[1] || src[2] != keyframeType) {
+		return false;
+	}
+
+	uint8_t crc {0};
+	size_t  position {sizeof(syncBytes)};
+	crc = crc8DVBS2(crc, src[position++]);
+
+	for (uint8_t i {0}; i < wordNumber; ++i) {
+		do {
+			if (position >= length) {
+				return false;
+			}
+			crc = crc8DVBS2(crc, src[position]);
+		} while (src[position++] & 0x80);
+	}
+	return position < length && src[position] == crc;
+}
+
+size_t BlackboxDecoder::findKeyframe(const uint8_t* src, size_t length) {
+	for (size_t i {0}; i < length; ++i) {
+		if (src[i] == syncBytes[0] && isKeyframe(src + i, length - i)) {
+			return i;
+		}
+	}
+	return length;
+}
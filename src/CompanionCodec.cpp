@@ -0,0 +1,141 @@
+#include "CompanionCodec.hpp"
+
+
+uint16_t CompanionCodec::crc16CCITT(uint16_t crc, uint8_t byte) {
+	crc ^= byte << 8u;
+	for (uint8_t i {0}; i < 8; ++i) {
+		crc = crc & 0x8000 ? (crc << 1u) ^ 0x1021 : crc << 1u;
+	}
+	return crc;
+}
+
+void CompanionEncoder::begin(uint8_t* dest) {
+	_dest = dest;
+	_dest[0] = delimiter;
+	_code = 1;
+	_position = 2;
+	_length = 0;
+	_crc = crcInitial;
+}
+
+void CompanionEncoder::append(const uint8_t* src, uint8_t length) {
+	for (uint8_t i {0}; i < length; ++i) {
+		append(src[i]);
+	}
+}
+
+void CompanionEncoder::append(uint8_t byte) {
+	if (_length >= maxMessageSize) {
+		return;
+	}
+
+	++_length;
+	_crc = crc16CCITT(_crc, byte);
+	encode(byte);
+}
+
+uint8_t CompanionEncoder::finish() {
+	uint16_t crc {_crc};
+
+	encode(crc & 0xff);
+	encode(crc >> 8u);
+	_dest[_code] = _position - _code;
+	_dest[_position++] = delimiter;
+	return _position;
+}
+
+void CompanionEncoder::encode(uint8_t byte) {
+	if (byte == delimiter) {  // Ends the block, the code byte holds the distance to the zero
+		_dest[_code] = _position - _code;
+		_code = _position++;
+		return;
+	}
+
+	_dest[_position++] = byte;
+	if (_position - _code == 0xff) {  // Longest block, not followed by a zero
+		_dest[_code] = 0xff;
+		_code = _position++;
+	}
+}
+
+bool CompanionDecoder::process(uint8_t byte) {
+	++_statistics.bytes;
+
+	if (byte == delimiter) {
+		bool empty {!_length && !_remaining && !_zeroPending};
+		bool dropping {_dropping};
+
+		_length -= _length >= 2 ? 2 : _length;  // Leaving only the message
+		_dropping = false;
+		_zeroPending = false;
+
+		if (dropping || empty) {
+			_length = 0;
+			_remaining = 0;
+			return false;
+		} else if (_remaining || !_length) {  // Truncated or too short
+			_length = 0;
+			_remaining = 0;
+			++_statistics.errors;
+			return false;
+		}
+
+		uint16_t crc {crcInitial};
+		for (uint8_t i {0}; i < _length; ++i) {
+			crc = crc16CCITT(crc, _message[i]);
+		}
+
+		uint8_t length {_length};
+		_length = 0;
+		if (crc != (_message[length] | (_message[length + 1] << 8u))) {
+			++_statistics.errors;
+			return false;
+		}
+
+		_messageLength = length;
+		++_statistics.messages;
+		return true;
+	}
+
+	if (_dropping) {
+		return false;
+	}
+
+	if (!_remaining) {  // Code byte
+		if (_zeroPending) {
+			if (_length >= sizeof(_message)) {
+				return reject();
+			}
+			_message[_length++] = 0;
+		}
+		_remaining = byte - 1;
+		_zeroPending = byte != 0xff;
+		return false;
+	}
+
+	if (_length >= sizeof(_message)) {
+		return reject();
+	}
+	_message[_length++] = byte;
+	--_remaining;
+	return false;
+}
+
+const uint8_t* CompanionDecoder::getMessage() const {
+	return _message;
+}
+
+uint8_t CompanionDecoder::getLength() const {
+	return _messageLength;
+}
+
+const CompanionDecoder::Statistics& CompanionDecoder::getStatistics() const {
+	return _statistics;
+}
+
+bool CompanionDecoder::reject() {
+	++_statistics.errors;
+	_dropping = true;
+	_remaining = 0;
+	return false;
+}
@@ -0,0 +1,103 @@
+#include "DShotCodec.hpp"
+
+#include "util.hpp"
+
+
+// Inverse of the 4b/5b GCR code, 0xff for invalid codes
+constexpr static uint8_t gcrDecode[32] {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x9,  0xa,
+                                        0xb,  0xff, 0xd,  0xe,  0xf,  0xff, 0xff, 0x2,  0x3,  0xff, 0x5,
+                                        0x6,  0x7,  0xff, 0x0,  0x8,  0x1,  0xff, 0x4,  0xc,  0xff};
+
+uint16_t DShotCodec::toThrottle(int16_t output) {
+	if (output <= -1024) {
+		return 0;
+	}
+	return util::map<int32_t>(util::min<int16_t>(output, 1024), -1024, 1024, throttleMin, throttleMax);
+}
+
+uint16_t DShotCodec::encodeFrame(uint16_t value, bool telemetry, bool bidirectional) {
+	uint16_t frame = (value << 1u) | (telemetry ? 0x1 : 0x0);
+	uint16_t crc = (frame ^ (frame >> 4u) ^ (frame >> 8u)) & 0xf;
+
+	return (frame << 4u) | (bidirectional ? ~crc & 0xf : crc);
+}
+
+void DShotCodec::buildBuffer(uint32_t* buffer, uint16_t frame, uint16_t one, uint16_t zero) {
+	for (uint8_t i {0}; i < frameBits; ++i) {  // MSB first
+		buffer[i] = frame & (0x8000 >> i) ? one : zero;
+	}
+	buffer[frameBits] = 0;
+}
+
+uint32_t DShotCodec::extractTelemetry(const uint16_t* samples, uint16_t count, uint8_t pin) {
+	uint16_t i {0};
+
+	// Skip the idle line before the start bit
+	for (; i < count && (samples[i] >> pin & 0x1); ++i);
+	if (i == count) {
+		return 0;
+	}
+
+	// Every edge on the line is a 1 bit of the GCR value, bits without an edge are 0
+	uint32_t value {0};
+	uint8_t  bits {0};
+	bool     level {false};
+	uint16_t edge {i};
+
+	for (++i; i < count && bits < telemetryBits; ++i) {
+		if ((samples[i] >> pin & 0x1) != level) {
+			uint8_t length = util::max((i - edge + 1) / 3, 1);
+			value = (value << length) | (0x1 << (length - 1));
+			bits += length;
+			level = !level;
+			edge = i;
+		}
+	}
+
+	// The response ends high, so the length of the last run has to be inferred
+	if (bits < telemetryBits) {
+		uint8_t length = telemetryBits - bits;
+		value = (value << length) | (0x1 << (length - 1));
+	} else if (bits > telemetryBits) {
+		return 0;
+	}
+
+	return value;
+}
+
+bool DShotCodec::decodeTelemetry(uint32_t value, uint32_t& eRPM) {
+	if (!value) {
+		return false;
+	}
+
+	uint16_t decoded {0};
+	for (uint8_t i {0}; i < 4; ++i) {
+		uint8_t nibble {gcrDecode[(value >> (i * 5u)) & 0x1f]};
+
+		if (nibble == 0xff) {  // Invalid GCR code
+			return false;
+		}
+		decoded |= nibble << (i * 4u);
+	}
+
+	uint16_t crc = decoded ^ (decoded >> 8u);
+	crc ^= crc >> 4u;
+	if ((crc & 0xf) != 0xf) {
+		return false;
+	}
+
+	// 3-bit exponent and 9-bit mantissa of the electrical period in microseconds
+	uint16_t periodValue = decoded >> 4u;
+	if (periodValue == 0x0fff) {  // Motor stopped
+		eRPM = 0;
+		return true;
+	}
+
+	uint32_t period = (periodValue & 0x1ff) << (periodValue >> 9u);
+	if (!period) {
+		return false;
+	}
+
+	eRPM = 60000000 / period;
+	return true;
+}
@@ -14,8 +14,8 @@ static float accelerations[3] {0};
 static float angularRates[3] {0};
 
 void LSM6DSO32::init() {
-	uint8_t ctrl1_xl {LSM6DSO32_CTRL1_XL_ODR_XL_104Hz};
-	uint8_t ctrl2_g {LSM6DSO32_CTRL2_G_ODR_G_104Hz | LSM6DSO32_CTRL2_G_FS_G_1000DPS};
+	uint8_t ctrl1_xl {LSM6DSO32_CTRL1_XL_ODR_XL_208Hz};
+	uint8_t ctrl2_g {LSM6DSO32_CTRL2_G_ODR_G_208Hz | LSM6DSO32_CTRL2_G_FS_G_1000DPS};
 	i2c::write(LSM6DSO32_ADDR_0, LSM6DSO32_CTRL1_XL_ADDR, &ctrl1_xl);
 	i2c::write(LSM6DSO32_ADDR_0, LSM6DSO32_CTRL2_G_ADDR, &ctrl2_g);
 }
@@ -14,6 +14,8 @@
 
 #include "Mahony.hpp"
 
+#include "profiler.hpp"
+
 Mahony::Mahony(float Kp, float Ki):
   _twoKp {Kp * 2.0f},
   _twoKi {Ki * 2.0f},
@@ -145,6 +147,8 @@ void Mahony::update(Vector3<float, uint8_t> rot, Vector3<float, uint8_t> acc, Ve
 }
 
 void Mahony::updateIMU(Vector3<float, uint8_t> rot, Vector3<float, uint8_t> acc, float dt) {
+	PROFILE_ZONE("ahrs");
+
 	// Convert gyroscope degrees/sec to radians/sec
 	rot[0][0] *= F_DEG_TO_RAD;
 	rot[1][0] *= F_DEG_TO_RAD;
@@ -0,0 +1,288 @@
+#include "ReceiverParser.hpp"
+
+#include "util.hpp"
+
+constexpr static uint8_t SBUS_START_BYTE {0x0f};
+constexpr static uint8_t SBUS_END_BYTE {0x00};
+constexpr static uint8_t SBUS_FRAME_SIZE {25};
+
+constexpr static uint8_t CRSF_SYNC_BYTE {0xc8};
+constexpr static uint8_t CRSF_ADDRESS_TX {0xee};  // Sent by some receivers instead of the sync byte
+constexpr static uint8_t CRSF_TYPE_LINK_STATISTICS {0x14};
+constexpr static uint8_t CRSF_TYPE_RC_CHANNELS {0x16};
+constexpr static uint8_t CRSF_RC_CHANNELS_LENGTH {24};  // Type + 22 bytes of packed channels + CRC
+constexpr static uint8_t CRSF_MAX_LENGTH {62};
+constexpr static uint8_t CRSF_UPLINK_LQ_OFFSET {2};
+
+constexpr static uint8_t IBUS_LENGTH {0x20};
+constexpr static uint8_t IBUS_COMMAND {0x40};
+constexpr static uint8_t IBUS_CHANNEL_COUNT {14};
+
+constexpr static uint8_t SUMD_HEADER {0xa8};
+constexpr static uint8_t SUMD_STATUS_LIVE {0x01};
+constexpr static uint8_t SUMD_STATUS_FAILSAFE {0x81};
+constexpr static uint8_t SUMD_MAX_CHANNELS {32};
+
+// S.BUS and CRSF share the same 11-bit channel encoding (172-1811 for 988-2012us)
+static int16_t convert11Bit(uint16_t value) {
+	return value ? util::map(static_cast<int>(value), 0, 2014, -1210, 1250) : 0;
+}
+
+static uint8_t crc8DVBS2(uint8_t crc, uint8_t byte) {
+	crc ^= byte;
+	for (uint8_t i {0}; i < 8; ++i) {
+		crc = crc & 0x80 ? (crc << 1u) ^ 0xd5 : crc << 1u;
+	}
+	return crc;
+}
+
+static uint16_t crc16CCITT(uint16_t crc, uint8_t byte) {
+	crc ^= byte << 8u;
+	for (uint8_t i {0}; i < 8; ++i) {
+		crc = crc & 0x8000 ? (crc << 1u) ^ 0x1021 : crc << 1u;
+	}
+	return crc;
+}
+
+void ReceiverParser::reset() {
+	_position = 0;
+}
+
+const ReceiverParser::Snapshot& ReceiverParser::getSnapshot() const {
+	return _snapshots[_front];
+}
+
+const ReceiverParser::Statistics& ReceiverParser::getStatistics() const {
+	return _statistics;
+}
+
+ReceiverParser::Snapshot& ReceiverParser::back() {
+	return _snapshots[_front ^ 0x1];
+}
+
+bool ReceiverParser::publish() {
+	_front ^= 0x1;
+	++_statistics.frames;
+	reset();
+	return true;
+}
+
+bool ReceiverParser::reject() {
+	++_statistics.errors;
+	reset();
+	return false;
+}
+
+void SBUSParser::reset() {
+	ReceiverParser::reset();
+	_bits = 0;
+	_bitCount = 0;
+	_channel = 0;
+}
+
+bool SBUSParser::process(uint8_t byte) {
+	++_statistics.bytes;
+
+	if (!_position) {
+		if (byte == SBUS_START_BYTE) {
+			++_position;
+		}
+		return false;
+	}
+
+	if (_position < SBUS_FRAME_SIZE - 2) {  // Packed channel data, 16 channels * 11 bits
+		_bits |= static_cast<uint32_t>(byte) << _bitCount;
+		_bitCount += 8;
+
+		if (_bitCount >= 11) {
+			back().channels[_channel++] = convert11Bit(_bits & 0x7ff);
+			_bits >>= 11u;
+			_bitCount -= 11;
+		}
+	} else if (_position == SBUS_FRAME_SIZE - 2) {  // Flags
+		back().flags = byte;
+	} else {  // End byte
+		return byte == SBUS_END_BYTE ? publish() : reject();
+	}
+
+	++_position;
+	return false;
+}
+
+void CRSFParser::reset() {
+	ReceiverParser::reset();
+	_bits = 0;
+	_bitCount = 0;
+	_channel = 0;
+	_crc = 0;
+}
+
+bool CRSFParser::process(uint8_t byte) {
+	++_statistics.bytes;
+
+	switch (_position) {
+		case 0:  // Address
+			if (byte == CRSF_SYNC_BYTE || byte == CRSF_ADDRESS_TX) {
+				++_position;
+			}
+			return false;
+		case 1:  // Length of type, payload and CRC
+			if (byte < 2 || byte > CRSF_MAX_LENGTH) {
+				return reject();
+			}
+			_length = byte;
+			++_position;
+			return false;
+		case 2:  // Type
+			_type = byte;
+			if (_type == CRSF_TYPE_RC_CHANNELS && _length != CRSF_RC_CHANNELS_LENGTH) {
+				return reject();
+			}
+			_crc = crc8DVBS2(_crc, byte);
+			++_position;
+			return false;
+		default:
+			break;
+	}
+
+	if (_position == _length + 1) {  // CRC
+		if (byte != _crc) {
+			return reject();
+		}
+
+		if (_type == CRSF_TYPE_LINK_STATISTICS) {
+			_linkLost = !_linkQuality;
+		} else if (_type == CRSF_TYPE_RC_CHANNELS) {
+			back().flags = _linkLost ? failsafeFlag : 0;
+			return publish();
+		}
+
+		reset();
+		return false;
+	}
+
+	_crc = crc8DVBS2(_crc, byte);
+
+	if (_type == CRSF_TYPE_RC_CHANNELS) {
+		_bits |= static_cast<uint32_t>(byte) << _bitCount;
+		_bitCount += 8;
+
+		if (_bitCount >= 11) {
+			back().channels[_channel++] = convert11Bit(_bits & 0x7ff);
+			_bits >>= 11u;
+			_bitCount -= 11;
+		}
+	} else if (_type == CRSF_TYPE_LINK_STATISTICS && _position == 3 + CRSF_UPLINK_LQ_OFFSET) {
+		_linkQuality = byte;
+	}
+
+	++_position;
+	return false;
+}
+
+void IBUSParser::reset() {
+	ReceiverParser::reset();
+	_sum = 0;
+	_checksum = 0;
+}
+
+bool IBUSParser::process(uint8_t byte) {
+	++_statistics.bytes;
+
+	if (!_position && byte != IBUS_LENGTH) {
+		return false;
+	} else if (_position == 1 && byte != IBUS_COMMAND) {
+		return reject();
+	}
+
+	if (_position < IBUS_LENGTH - 2) {
+		_sum += byte;
+
+		if (_position >= 2) {  // Little-endian channel values in microseconds
+			if (!(_position & 0x1)) {
+				_low = byte;
+			} else {
+				uint16_t value = _low | (byte << 8u);
+				back().channels[(_position - 3) / 2] = static_cast<int16_t>((value - 1500) * 2);
+			}
+		}
+	} else if (_position == IBUS_LENGTH - 2) {
+		_checksum = byte;
+	} else {
+		_checksum |= byte << 8u;
+
+		if (_checksum != static_cast<uint16_t>(0xffff - _sum)) {
+			return reject();
+		}
+
+		for (uint8_t i {IBUS_CHANNEL_COUNT}; i < channelNumber; ++i) {
+			back().channels[i] = 0;
+		}
+		back().flags = 0;
+		return publish();
+	}
+
+	++_position;
+	return false;
+}
+
+void SUMDParser::reset() {
+	ReceiverParser::reset();
+	_crc = 0;
+	_checksum = 0;
+}
+
+bool SUMDParser::process(uint8_t byte) {
+	++_statistics.bytes;
+
+	switch (_position) {
+		case 0:
+			if (byte != SUMD_HEADER) {
+				return false;
+			}
+			break;
+		case 1:
+			if (byte != SUMD_STATUS_LIVE && byte != SUMD_STATUS_FAILSAFE) {
+				return reject();
+			}
+			_status = byte;
+			break;
+		case 2:
+			if (byte < 2 || byte > SUMD_MAX_CHANNELS) {
+				return reject();
+			}
+			_channelCount = byte;
+			break;
+		default: {
+			uint8_t dataEnd = 3 + _channelCount * 2;
+
+			if (_position == dataEnd) {  // Big-endian CRC
+				_checksum = byte << 8u;
+				++_position;
+				return false;
+			} else if (_position == dataEnd + 1) {
+				_checksum |= byte;
+
+				if (_checksum != _crc) {
+					return reject();
+				}
+
+				back().flags = _status == SUMD_STATUS_FAILSAFE ? failsafeFlag : 0;
+				return publish();
+			}
+
+			uint8_t channel = (_position - 3) / 2;
+			if (!((_position - 3) & 0x1)) {
+				_high = byte;
+			} else if (channel < channelNumber) {  // Big-endian channel values in 1/8 microseconds
+				uint16_t value = (_high << 8u) | byte;
+				back().channels[channel] = static_cast<int16_t>((value - 12000) / 4);
+			}
+			break;
+		}
+	}
+
+	_crc = crc16CCITT(_crc, byte);
+	++_position;
+	return false;
+}
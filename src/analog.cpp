@@ -0,0 +1,120 @@
+#include "analog.hpp"
+
+
+// Full scale readings at the 1.0V internal reference, depend on the board
+constexpr static uint32_t BATTERY_SCALE {11000};  // 1:11 divider, mV
+constexpr static uint32_t CURRENT_SCALE {25000};  // 40mV/A current sense amplifier, mA
+
+constexpr static uint8_t INPUT_NUMBER {3};
+constexpr static uint8_t inputs[INPUT_NUMBER] {
+  ADC_INPUTCTRL_MUXPOS_AIN0,  // Battery voltage
+  ADC_INPUTCTRL_MUXPOS_AIN1,  // Current
+  ADC_INPUTCTRL_MUXPOS_TEMP   // Temperature sensor
+};
+
+// Temperature calibration, precomputed from the fuse values
+static int16_t  tempR {0};
+static uint16_t adcR {0};
+static int32_t  temperatureSlope {0};  // Degrees per ADC count, Q16
+
+static uint8_t currentInput {0};
+
+static volatile int8_t   temperature {0};
+static volatile uint16_t batteryVoltage {0};
+static volatile uint16_t current {0};
+
+static void selectInput(uint8_t input);
+
+
+extern "C" {
+	void ADC_Handler() {
+		uint16_t result = ADC_REGS->ADC_RESULT;  // Clears the interrupt flag
+
+		switch (currentInput) {
+			case 0:
+				batteryVoltage = result * BATTERY_SCALE >> 12u;
+				break;
+			case 1:
+				current = result * CURRENT_SCALE >> 12u;
+				break;
+			case 2:
+				temperature = tempR + ((static_cast<int32_t>(result) - adcR) * temperatureSlope >> 16u);
+				break;
+		}
+
+		if (++currentInput < INPUT_NUMBER) {
+			selectInput(currentInput);
+			ADC_REGS->ADC_SWTRIG = ADC_SWTRIG_START(1);
+		} else {  // Scan complete, the next one is started by the RTC event
+			currentInput = 0;
+			selectInput(currentInput);
+		}
+	}
+}
+
+static void selectInput(uint8_t input) {
+	ADC_REGS->ADC_INPUTCTRL = ADC_INPUTCTRL_MUXNEG_GND  // Set GND as negative input
+	                        | inputs[input];            // Set positive input
+	while (ADC_REGS->ADC_SYNCBUSY & ADC_SYNCBUSY_INPUTCTRL_Msk);
+}
+
+void analog::init() {
+	tempR = TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_0 & FUSES_TEMP_LOG_WORD_0_ROOM_TEMP_VAL_INT_Msk;
+	int16_t tempH = (TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_0 & FUSES_TEMP_LOG_WORD_0_HOT_TEMP_VAL_INT_Msk)
+	             >> FUSES_TEMP_LOG_WORD_0_HOT_TEMP_VAL_INT_Pos;
+	adcR = (TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_1 & FUSES_TEMP_LOG_WORD_1_ROOM_ADC_VAL_Msk)
+	     >> FUSES_TEMP_LOG_WORD_1_ROOM_ADC_VAL_Pos;
+	uint16_t adcH = (TEMP_LOG_FUSES_REGS->FUSES_TEMP_LOG_WORD_1 & FUSES_TEMP_LOG_WORD_1_HOT_ADC_VAL_Msk)
+	              >> FUSES_TEMP_LOG_WORD_1_HOT_ADC_VAL_Pos;
+	temperatureSlope = adcH != adcR ? (static_cast<int32_t>(tempH - tempR) << 16u) / (adcH - adcR) : 0;
+
+	// GCLK config
+	GCLK_REGS->GCLK_PCHCTRL[ADC_GCLK_ID] = GCLK_PCHCTRL_CHEN(1)     // Enable ADC clock
+	                                     | GCLK_PCHCTRL_GEN_GCLK2;  // Set GCLK2 as a clock source
+
+	// RTC config
+	OSC32KCTRL_REGS->OSC32KCTRL_RTCCTRL = OSC32KCTRL_RTCCTRL_RTCSEL_ULP32K;  // 32.768kHz from the ULP oscillator
+	RTC_REGS->MODE0.RTC_CTRLA = 0;                                           // Disable RTC to change settings
+	while (RTC_REGS->MODE0.RTC_SYNCBUSY & RTC_MODE0_SYNCBUSY_ENABLE_Msk);
+	RTC_REGS->MODE0.RTC_EVCTRL = RTC_MODE0_EVCTRL_PEREO5(1);  // Periodic event every 256 cycles (128Hz)
+	RTC_REGS->MODE0.RTC_CTRLA = RTC_MODE0_CTRLA_MODE_COUNT32 | RTC_MODE0_CTRLA_PRESCALER_DIV1
+	                          | RTC_MODE0_CTRLA_ENABLE(1);
+	while (RTC_REGS->MODE0.RTC_SYNCBUSY & RTC_MODE0_SYNCBUSY_ENABLE_Msk);
+
+	// EVSYS config
+	EVSYS_REGS->EVSYS_CHANNEL[0] = EVSYS_CHANNEL_EVGEN(EVENT_ID_GEN_RTC_PER_5)  // RTC periodic event as a generator
+	                             | EVSYS_CHANNEL_PATH_ASYNCHRONOUS;
+	EVSYS_REGS->EVSYS_USER[EVENT_ID_USER_ADC_START] = EVSYS_USER_CHANNEL(1);  // Channel 0 starts the ADC
+
+	// ADC config
+	ADC_REGS->ADC_CTRLA = 0;  // Disable ADC to change enable-protected settings
+	while (ADC_REGS->ADC_SYNCBUSY & ADC_SYNCBUSY_ENABLE_Msk);
+	ADC_REGS->ADC_CTRLB = ADC_CTRLB_PRESCALER_DIV2;                            // 125kHz ADC clock
+	ADC_REGS->ADC_REFCTRL = ADC_REFCTRL_REFSEL_INTREF;                         // Set ADC reference voltage
+	ADC_REGS->ADC_CTRLC = ADC_CTRLC_RESSEL_16BIT;                              // Required for averaging
+	ADC_REGS->ADC_AVGCTRL = ADC_AVGCTRL_SAMPLENUM_16 | ADC_AVGCTRL_ADJRES(4);  // Average 16 samples to 12 bits
+	ADC_REGS->ADC_EVCTRL = ADC_EVCTRL_STARTEI(1);                              // Start scan on event
+	ADC_REGS->ADC_INTENSET = ADC_INTENSET_RESRDY(1);                           // Enable result ready interrupt
+	selectInput(0);
+	ADC_REGS->ADC_CTRLA = ADC_CTRLA_ENABLE(1);  // Enable ADC
+	while (ADC_REGS->ADC_SYNCBUSY & ADC_SYNCBUSY_ENABLE_Msk);
+
+	NVIC_EnableIRQ(ADC_IRQn);
+
+	// PORT config
+	PORT_REGS->GROUP[0].PORT_WRCONFIG = PORT_WRCONFIG_PINMASK((0x1 << 2u) | (0x1 << 3u)) | PORT_WRCONFIG_PMUXEN(1)
+	                                  | PORT_WRCONFIG_PMUX(MUX_PA02B_ADC_AIN0) | PORT_WRCONFIG_WRPMUX(1)
+	                                  | PORT_WRCONFIG_WRPINCFG(1);
+}
+
+int8_t analog::getTemperature() {
+	return temperature;
+}
+
+uint16_t analog::getBatteryVoltage() {
+	return batteryVoltage;
+}
+
+uint16_t analog::getCurrent() {
+	return current;
+}
@@ -0,0 +1,89 @@
+#include "blackbox.hpp"
+
+#include "data.hpp"
+#include "profiler.hpp"
+#include "ReceiverParser.hpp"
+#include "RingBuffer.hpp"
+#include "uart.hpp"
+
+constexpr static uint16_t RING_SIZE {512};
+
+static_assert(
+    sizeof(BlackboxFrame::channels) / sizeof(int16_t) == ReceiverParser::channelNumber,
+    "Blackbox frames must hold all receiver channels"
+);
+static_assert(
+    sizeof(BlackboxFrame::outputs) / sizeof(int16_t) == data::outputChannelNumber,
+    "Blackbox frames must hold all outputs"
+);
+static_assert(
+    sizeof(BlackboxFrame::taskTimes) / sizeof(uint16_t) == data::taskNumber,
+    "Blackbox frames must hold all rate groups"
+);
+
+static blackbox::Backend*                       currentBackend {nullptr};
+static BlackboxEncoder                          encoder {};
+static RingBuffer<uint8_t, uint16_t, RING_SIZE> ring {};
+static uint32_t                                 droppedFrames {0};
+
+uint16_t blackbox::UARTBackend::write(const uint8_t* data, uint16_t length) {
+	uint16_t taken {0};
+
+	while (taken < length) {
+		uint8_t sent {uart::sendTo1(data + taken, util::min<uint16_t>(length - taken, 0xff))};
+
+		if (sent == 0xff) {  // Queue full
+			break;
+		}
+		taken += sent;
+	}
+	return taken;
+}
+
+void blackbox::init(Backend* backend) {
+	currentBackend = backend;
+	ring.clear();
+	encoder.restart();
+}
+
+void blackbox::record(const BlackboxFrame& frame) {
+	PROFILE_ZONE("blackbox");
+
+	if (!currentBackend) {
+		return;
+	}
+
+	uint8_t buffer[BlackboxCodec::maxFrameSize];
+	uint8_t length {encoder.encode(frame, buffer)};
+
+	if (ring.capacity() - ring.size() < length) {
+		++droppedFrames;
+		encoder.restart();
+		return;
+	}
+
+	for (uint8_t i {0}; i < length; ++i) {
+		ring.push_back(buffer[i]);
+	}
+}
+
+void blackbox::flush() {
+	if (!currentBackend) {
+		return;
+	}
+
+	// The ring may wrap around, so the data is passed in at most two parts
+	for (uint8_t i {0}; i < 2 && !ring.empty(); ++i) {
+		uint16_t length {ring.contiguous()};
+		uint16_t taken {currentBackend->write(ring.data(), length)};
+
+		ring.pop_front(taken);
+		if (taken < length) {
+			break;
+		}
+	}
+}
+
+uint32_t blackbox::getDroppedFrames() {
+	return droppedFrames;
+}
@@ -0,0 +1,170 @@
+#include "companion.hpp"
+
+#include "nvm.hpp"
+#include "profiler.hpp"
+#include "uart.hpp"
+
+constexpr static uint16_t SETPOINT_TIMEOUT {200};  // ms
+constexpr static float    SETPOINT_LSB {10430.0f};
+constexpr static uint8_t  COMMAND_HEADER_SIZE {2};  // Command type and value
+
+static CompanionDecoder decoder {};
+static CompanionEncoder encoder {};
+static uint8_t          message[CompanionCodec::maxMessageSize] {};
+static uint8_t          messageLength {0};
+static volatile bool    messageReceived {false};
+static uint32_t         droppedFrames {0};
+
+static data::Stream subscription {};
+
+static data::SetpointRequest setpoint {};
+static uint32_t              lastSetpoint {0};
+static bool                  setpointReceived {false};
+
+static void receive(const uart::DefaultCallback::buffer_type& buffer) {
+	for (uint8_t i {0}; i < buffer.transferred; ++i) {
+		// Every byte is decoded to stay in sync with the frames, only the command being handled is kept
+		if (decoder.process(buffer.buffer[i]) && !messageReceived) {
+			messageLength = decoder.getLength();
+			util::copy(message, decoder.getMessage(), messageLength);
+			messageReceived = true;
+		}
+	}
+}
+
+static void appendVariable(const data::Variable* variable) {
+	if (!(variable->flags & data::variableInFlash)) {
+		encoder.append(variable->response, variable->size);
+		return;
+	}
+
+	for (uint8_t i {0}; i < variable->size; ++i) {
+		uint8_t byte;
+		data::readVariable(variable, i, 1, &byte);
+		encoder.append(byte);
+	}
+}
+
+// The rest of a frame that doesn't fit is dropped, the receiver resynchronizes at the next frame
+static void send(const uint8_t* frame, uint8_t length) {
+	for (uint8_t sent {0}; sent < length;) {
+		uint8_t chunk {uart::sendTo2(frame + sent, length - sent)};
+
+		if (chunk == 0xff) {
+			++droppedFrames;
+			return;
+		}
+		sent += chunk;
+	}
+}
+
+// Returns false if the message has to be handled again once the commit is written
+static bool handle(const uint8_t* message, uint8_t length) {
+	if (length < COMMAND_HEADER_SIZE) {
+		return true;
+	}
+
+	uint8_t        value {message[1]};
+	const uint8_t* src {message + COMMAND_HEADER_SIZE};
+	uint8_t        srcLength = length - COMMAND_HEADER_SIZE;
+	uint8_t        frame[CompanionCodec::maxFrameSize];
+	data::SetResult result {data::SetResult::NotStored};
+
+	switch (message[0]) {
+		case static_cast<uint8_t>(data::CommandType::GetVariable): {
+			const data::Variable* variable {data::getVariable(value)};
+			if (variable) {
+				encoder.begin(frame);
+				appendVariable(variable);
+				send(frame, encoder.finish());
+			}
+			break;
+		}
+		case static_cast<uint8_t>(data::CommandType::SetVariable):
+			result = data::setVariable(value, 0, srcLength, src);
+			break;
+		case static_cast<uint8_t>(data::CommandType::GetVariables): {
+			uint8_t response[CompanionCodec::maxMessageSize];
+			uint8_t count {util::min<uint8_t>(value, srcLength / sizeof(data::VariableSlice))};
+
+			encoder.begin(frame);
+			encoder.append(
+			    response,
+			    data::getVariables(count, reinterpret_cast<const data::VariableSlice*>(src), response, sizeof(response))
+			);
+			send(frame, encoder.finish());
+			break;
+		}
+		case static_cast<uint8_t>(data::CommandType::SetVariables):
+			result = data::setVariables(value, src, srcLength);
+			break;
+		case static_cast<uint8_t>(data::CommandType::Subscribe):
+			data::subscribe(subscription, value, src, srcLength, CompanionCodec::maxMessageSize);
+			break;
+		case static_cast<uint8_t>(data::CommandType::Setpoint):
+			if (srcLength >= sizeof(data::SetpointRequest)) {
+				util::copy(reinterpret_cast<uint8_t*>(&setpoint), src, sizeof(setpoint));
+				lastSetpoint = util::getTime();
+				setpointReceived = true;
+			}
+			break;
+	}
+
+	if (result != data::SetResult::NotStored) {
+		nvm::commit();
+	}
+	return result != data::SetResult::Pending;
+}
+
+static void stream() {
+	uint32_t now {util::getMicros()};
+	if (!data::streamDue(subscription, now)) {
+		return;
+	}
+
+	data::USBStreamFrame header {};
+	uint8_t              frame[CompanionCodec::maxFrameSize];
+
+	header.count = subscription.count;
+	header.sequence = subscription.sequence++;
+	header.time = now;
+
+	encoder.begin(frame);
+	encoder.append(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+	for (uint8_t i {0}; i < subscription.count; ++i) {
+		appendVariable(data::getVariable(subscription.variableIDs[i]));
+	}
+	send(frame, encoder.finish());
+}
+
+void companion::init() {
+	uart::set2Callback(receive);
+}
+
+void companion::update() {
+	PROFILE_ZONE("link");
+
+	if (messageReceived && handle(message, messageLength)) {
+		messageReceived = false;  // Otherwise handled again by the next update
+	}
+
+	stream();
+}
+
+bool companion::getSetpoint(float& pitch, float& heading) {
+	if (!setpointReceived || util::getTime() - lastSetpoint > SETPOINT_TIMEOUT) {
+		return false;
+	}
+
+	pitch = setpoint.pitch / SETPOINT_LSB;
+	heading = setpoint.heading / SETPOINT_LSB;
+	return true;
+}
+
+const CompanionDecoder::Statistics& companion::getStatistics() {
+	return decoder.getStatistics();
+}
+
+uint32_t companion::getDroppedFrames() {
+	return droppedFrames;
+}
@@ -1,40 +1,236 @@
 #include "data.hpp"
 
+#include <cstddef>
+#include <new>
+
 #include "nvm.hpp"
+#include "profiler.hpp"
 
 
 data::USBStatusResponse   data::usbStatusResponse {};
 data::USBSensorsResponse  data::usbSensorsResponse {};
 data::USBSettingsResponse data::usbSettingsResponse {};
 data::USBInputsResponse   data::usbInputsResponse {};
-data::USBMixesResponse    data::usbMixesResponse {};
-data::USBTrimsResponse    data::usbTrimsResponse {};
-data::USBLimitsResponse   data::usbLimitsResponse {};
 data::USBOutputsResponse  data::usbOutputsResponse {};
 data::USBPIDsResponse     data::usbPIDsResponse {};
+data::USBTasksResponse    data::usbTasksResponse {};
+data::USBProfileResponse  data::usbProfileResponse {};
 
-InlineMatrix<int16_t, uint8_t, data::inputChannelNumber, 1> data::inputs {data::usbInputsResponse.inputs};
-InlineMatrix<int16_t, uint8_t, data::outputChannelNumber, data::inputChannelNumber> data::mixes {
-  data::usbMixesResponse.mixes
-};
-InlineMatrix<int16_t, uint8_t, data::outputChannelNumber, 1> data::trims {data::usbTrimsResponse.trims};
-InlineMatrix<int16_t, uint8_t, data::outputChannelNumber, 2> data::limits {data::usbLimitsResponse.limits};
+InlineMatrix<int16_t, uint8_t, data::inputChannelNumber, 1>  data::inputs {data::usbInputsResponse.inputs};
 InlineMatrix<int16_t, uint8_t, data::outputChannelNumber, 1> data::outputs {data::usbOutputsResponse.outputs};
 
+// Copies of the options for the mixer, which never reads them from flash
+static int16_t mixesCopy[data::mixesNumber] {};
+static int16_t trimsCopy[data::outputChannelNumber] {};
+static int16_t limitsCopy[data::outputChannelNumber * 2] {};
+static uint8_t copiedRevision {0};  // Revision of nvm the copies were made at, nvm::load() starts at 1
+
+InlineMatrix<int16_t, uint8_t, data::outputChannelNumber, data::inputChannelNumber> data::mixes {mixesCopy};
+InlineMatrix<int16_t, uint8_t, data::outputChannelNumber, 1>                        data::trims {trimsCopy};
+InlineMatrix<int16_t, uint8_t, data::outputChannelNumber, 2>                        data::limits {limitsCopy};
+
 InlinePID<float> data::pids[data::pidNumber] {
   {data::usbPIDsResponse.coefficients,     500   },
   {data::usbPIDsResponse.coefficients + 1, 500   },
   {data::usbPIDsResponse.coefficients + 2, F_PI_8}
 };
 
+#define VARIABLE(response, flags) \
+	{reinterpret_cast<uint8_t*>(&response), sizeof(response), (flags), sizeof(response), nullptr}
+#define STORED_VARIABLE(response, flags, field, option) \
+	{reinterpret_cast<uint8_t*>(&response), \
+	 sizeof(response), \
+	 (flags) | data::variablePersistent, \
+	 offsetof(decltype(response), field), \
+	 reinterpret_cast<const uint8_t*>(&nvm::_internal::defaults.option)}
+#define FLASH_VARIABLE(response, header, flags, option) \
+	{header, \
+	 sizeof(response), \
+	 (flags) | data::variablePersistent | data::variableInFlash, \
+	 data::variableHeaderSize, \
+	 reinterpret_cast<const uint8_t*>(&nvm::_internal::defaults.option)}
+
+// Read-mostly options are served from flash, only the headers of their responses are kept in RAM
+static uint8_t mixesHeader[] {
+  static_cast<uint8_t>(data::ResponseType::ReturnVariable),
+  static_cast<uint8_t>(data::VariableID::Mux)
+};
+static uint8_t trimsHeader[] {
+  static_cast<uint8_t>(data::ResponseType::ReturnVariable),
+  static_cast<uint8_t>(data::VariableID::Trims)
+};
+static uint8_t limitsHeader[] {
+  static_cast<uint8_t>(data::ResponseType::ReturnVariable),
+  static_cast<uint8_t>(data::VariableID::Limits)
+};
+
+// Indexed by VariableID
+static const data::Variable variables[] {
+  VARIABLE(data::usbStatusResponse, 0),
+  VARIABLE(data::usbSensorsResponse, 0),
+  VARIABLE(data::usbSettingsResponse, 0),
+  VARIABLE(data::usbInputsResponse, 0),
+  FLASH_VARIABLE(data::USBMixesResponse, mixesHeader, data::variableWritable, mixes),
+  FLASH_VARIABLE(data::USBTrimsResponse, trimsHeader, data::variableWritable, trims),
+  FLASH_VARIABLE(data::USBLimitsResponse, limitsHeader, data::variableWritable, limits),
+  VARIABLE(data::usbOutputsResponse, 0),
+  STORED_VARIABLE(data::usbPIDsResponse, data::variableWritable, coefficients, pidCoefficients),
+  VARIABLE(data::usbTasksResponse, 0),
+  VARIABLE(data::usbProfileResponse, 0)
+};
+
+static_assert(sizeof(variables) / sizeof(variables[0]) == data::variableNumber, "Every variable must have an entry");
+
 InlinePID<float>& data::pitchPID {data::pids[0]};
 InlinePID<float>& data::rollPID {data::pids[1]};
 InlinePID<float>& data::headingPID {data::pids[2]};
 
 void data::calculateOutputs() {
+	PROFILE_ZONE("mixer");
+
 	auto out = mixes.multiplyAndScale(inputs, static_cast<int16_t>(1000)) + trims;
 
 	for (uint8_t i {0}; i < outputChannelNumber; ++i) {
 		outputs[i][0] = util::clamp(out[i][0], limits[i][0], limits[i][1]);
 	}
 }
+
+void data::updateOptions() {
+	uint8_t revision {nvm::getRevision()};
+
+	if (revision == copiedRevision || nvm::busy()) {
+		return;
+	}
+
+	// Copied again if a write started from an interrupt moves the records in the meantime
+	do {
+		revision = nvm::getRevision();
+		util::copy(mixesCopy, nvm::get(nvm::options->mixes), mixesNumber);
+		util::copy(trimsCopy, nvm::get(nvm::options->trims), outputChannelNumber);
+		util::copy(limitsCopy, nvm::get(nvm::options->limits), outputChannelNumber * 2);
+	} while (revision != nvm::getRevision());
+	copiedRevision = revision;
+}
+
+const data::Variable* data::getVariable(uint8_t variableID) {
+	return variableID < variableNumber ? &variables[variableID] : nullptr;
+}
+
+data::SetResult data::setVariable(uint8_t variableID, uint8_t offset, uint8_t length, const uint8_t* src) {
+	const Variable* variable {getVariable(variableID)};
+	if (!variable || !(variable->flags & variableWritable) || offset >= variable->size - variableHeaderSize) {
+		return SetResult::NotStored;
+	}
+
+	uint8_t start = variableHeaderSize + offset;
+	uint8_t end = start + util::min(length, static_cast<uint8_t>(variable->size - start));
+	if (!(variable->flags & variableInFlash)) {
+		util::copy(variable->response + start, src, end - start);
+	}
+
+	if (!(variable->flags & variablePersistent)) {
+		return SetResult::NotStored;
+	}
+
+	for (uint8_t i {util::max(start, variable->storedOffset)}; i < end; ++i) {
+		if (!nvm::edit(variable->stored + (i - variable->storedOffset), src[i - start])) {
+			return SetResult::Pending;
+		}
+	}
+	return SetResult::Stored;
+}
+
+void data::readVariable(const Variable* variable, uint8_t start, uint8_t length, uint8_t* dest) {
+	for (uint8_t i {start}; i < start + length; ++i) {
+		*(dest++) = variable->flags & variableInFlash && i >= variable->storedOffset
+		              ? nvm::read(variable->stored + (i - variable->storedOffset))
+		              : variable->response[i];
+	}
+}
+
+uint8_t data::getVariables(uint8_t count, const VariableSlice* slices, uint8_t* dest, uint8_t capacity) {
+	auto*   response {new (dest) USBVariablesResponse {}};
+	uint8_t position {sizeof(USBVariablesResponse)};
+
+	for (uint8_t i {0}; i < count; ++i) {
+		const Variable* variable {getVariable(slices[i].variableID)};
+		if (!variable || slices[i].offset >= variable->size - variableHeaderSize) {
+			continue;
+		}
+
+		uint8_t available = variable->size - variableHeaderSize - slices[i].offset;
+		uint8_t length = slices[i].length ? util::min(slices[i].length, available) : available;
+		if (position + sizeof(VariableSlice) + length > capacity) {
+			break;
+		}
+
+		VariableSlice slice {slices[i].variableID, slices[i].offset, length};
+		util::copy(dest + position, reinterpret_cast<const uint8_t*>(&slice), sizeof(slice));
+		position += sizeof(slice);
+		readVariable(variable, variableHeaderSize + slice.offset, length, dest + position);
+		position += length;
+		++response->count;
+	}
+
+	return position;
+}
+
+data::SetResult data::setVariables(uint8_t count, const uint8_t* slices, uint8_t length) {
+	uint8_t   position {0};
+	SetResult result {SetResult::NotStored};
+
+	for (uint8_t i {0}; i < count && position + sizeof(VariableSlice) <= length; ++i) {
+		auto* slice {reinterpret_cast<const VariableSlice*>(slices + position)};
+		position += sizeof(VariableSlice);
+
+		if (position + slice->length > length) {
+			break;
+		}
+
+		switch (setVariable(slice->variableID, slice->offset, slice->length, slices + position)) {
+			case SetResult::Stored:
+				result = SetResult::Stored;
+				break;
+			case SetResult::NotStored:
+				break;
+			case SetResult::Pending:
+				return SetResult::Pending;  // The slices before are set again, which changes nothing
+		}
+		position += slice->length;
+	}
+
+	return result;
+}
+
+void data::subscribe(Stream& stream, uint8_t count, const uint8_t* src, uint8_t length, uint8_t frameSize) {
+	USBSubscribeRequest request {};  // Variables left out of a short request read as zeros
+	if (length < sizeof(request.rate)) {
+		return;
+	}
+	util::copy(reinterpret_cast<uint8_t*>(&request), src, util::min<uint8_t>(length, sizeof(request)));
+	count = util::min<uint8_t>(count, util::min<uint8_t>(length - sizeof(request.rate), streamVariableNumber));
+
+	stream.count = 0;
+	stream.period = request.rate ? 1000000 / request.rate : 0;
+
+	uint8_t size {sizeof(USBStreamFrame)};
+	for (uint8_t i {0}; i < count; ++i) {
+		const Variable* variable {getVariable(request.variableIDs[i])};
+
+		if (variable && size + variable->size <= frameSize) {
+			stream.variableIDs[stream.count++] = request.variableIDs[i];
+			size += variable->size;
+		}
+	}
+}
+
+bool data::streamDue(Stream& stream, uint32_t now) {
+	uint32_t elapsed {now - stream.lastFrame};
+
+	if (!stream.period || elapsed < stream.period) {
+		return false;
+	}
+	// Frames stay on the period grid so the jitter of the caller doesn't lower the rate, missed frames are skipped
+	stream.lastFrame += elapsed - elapsed % stream.period;
+	return true;
+}
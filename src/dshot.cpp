@@ -0,0 +1,214 @@
+#include "dshot.hpp"
+
+
+struct SpeedConfig {
+	uint16_t period;        // Bit period, timer ticks
+	uint16_t one;           // High time of a 1 bit, timer ticks
+	uint16_t zero;          // High time of a 0 bit, timer ticks
+	uint16_t samplePeriod;  // Telemetry sampling period (3x of the 5/4 telemetry bit rate), timer ticks
+};
+
+// TCC0 is clocked from the 16MHz GCLK1
+static const SpeedConfig speedConfigs[] {
+  {107, 80, 40, 28}, // DShot150, 6.69us bits
+  {53,  40, 20, 14}  // DShot300, 3.31us bits
+};
+
+constexpr static uint8_t  BUFFER_LENGTH {DShotCodec::frameBits + 1};
+constexpr static uint16_t SAMPLE_COUNT {128};  // Covers the ~30us turnaround and the whole response
+constexpr static uint8_t  SAMPLE_CHANNEL {dshot::motorNumber};
+
+constexpr static uint8_t motorPins[dshot::motorNumber] {4, 5, 10, 11};
+
+static dmac_descriptor_registers_t descriptors[dshot::motorNumber + 1] __attribute__((aligned(16))) {};
+static dmac_descriptor_registers_t writeback[dshot::motorNumber + 1] __attribute__((aligned(16))) {};
+
+static uint32_t buffers[dshot::motorNumber][BUFFER_LENGTH] {};
+static uint16_t samples[SAMPLE_COUNT] {};
+static uint32_t eRPMs[dshot::motorNumber] {};
+
+static const SpeedConfig* config {&speedConfigs[0]};
+static bool               bidirectional {false};
+static volatile bool      busy {false};
+static volatile bool      telemetryReady {false};
+
+static void startChannel(uint8_t channel);
+static void startSampling();
+static void stopSampling();
+static void setPinsToTimer();
+static void setPinsToInput();
+
+
+extern "C" {
+	void DMAC_Handler() {
+		uint8_t channel = DMAC_REGS->DMAC_INTPEND & DMAC_INTPEND_ID_Msk;
+		DMAC_REGS->DMAC_CHID = channel;
+		DMAC_REGS->DMAC_CHINTFLAG = DMAC_CHINTFLAG_TCMPL(1);
+
+		if (channel == 0) {  // Last beat written, all channels are triggered by the same overflow and complete together
+			if (bidirectional) {  // The last bit is still being sent until the next overflow
+				TCC0_REGS->TCC_INTFLAG = TCC_INTFLAG_OVF(1);
+				TCC0_REGS->TCC_INTENSET = TCC_INTENSET_OVF(1);
+			} else {
+				busy = false;
+			}
+		} else if (channel == SAMPLE_CHANNEL) {  // Telemetry captured
+			stopSampling();
+			telemetryReady = true;
+			busy = false;
+		}
+	}
+
+	void TCC0_Handler() {  // Frame sent, the trailing 0 keeps the line idle from this overflow on
+		TCC0_REGS->TCC_INTENCLR = TCC_INTENCLR_OVF(1);
+		TCC0_REGS->TCC_INTFLAG = TCC_INTFLAG_OVF(1);
+		startSampling();
+	}
+}
+
+static void startChannel(uint8_t channel) {
+	DMAC_REGS->DMAC_CHID = channel;
+	DMAC_REGS->DMAC_CHCTRLA = DMAC_CHCTRLA_ENABLE(1);
+}
+
+static void startSampling() {
+	setPinsToInput();
+	TCC0_REGS->TCC_PER = config->samplePeriod;
+	startChannel(SAMPLE_CHANNEL);
+}
+
+static void stopSampling() {
+	TCC0_REGS->TCC_PER = config->period;
+	setPinsToTimer();
+}
+
+static void setPinsToTimer() {
+	for (uint8_t pin : motorPins) {
+		PORT_REGS->GROUP[0].PORT_PINCFG[pin] = PORT_PINCFG_PMUXEN(1);
+	}
+}
+
+static void setPinsToInput() {
+	// ESCs drive the line low, idle is kept high by the pull-ups
+	PORT_REGS->GROUP[0].PORT_OUTSET = (0x1 << motorPins[0]) | (0x1 << motorPins[1]) | (0x1 << motorPins[2])
+	                                | (0x1 << motorPins[3]);
+	for (uint8_t pin : motorPins) {
+		PORT_REGS->GROUP[0].PORT_PINCFG[pin] = PORT_PINCFG_INEN(1) | PORT_PINCFG_PULLEN(1);
+	}
+}
+
+bool dshot::init(Protocol protocol) {
+	if (protocol == Protocol::Off || protocol > Protocol::DShot300Bidirectional) {
+		return false;
+	}
+	config = &speedConfigs[(static_cast<uint8_t>(protocol) - 1) % 2];  // DShot150 and DShot300 alternate
+	bidirectional = protocol >= Protocol::DShot150Bidirectional;
+
+	// GLCK config
+	GCLK_REGS->GCLK_PCHCTRL[TCC0_GCLK_ID] = GCLK_PCHCTRL_CHEN(1)     // Enable TCC[0:1] clock
+	                                      | GCLK_PCHCTRL_GEN_GCLK1;  // Set GCLK1 as a clock source
+
+	// TCC config
+	TCC0_REGS->TCC_CTRLA = 0;  // Disable timer to change enable-protected settings
+	while (TCC0_REGS->TCC_SYNCBUSY & TCC_SYNCBUSY_ENABLE_Msk);
+	TCC0_REGS->TCC_CTRLA = TCC_CTRLA_PRESCALER_DIV1;
+	TCC0_REGS->TCC_DBGCTRL = TCC_DBGCTRL_DBGRUN(1);  // Run while debugging
+	TCC0_REGS->TCC_WAVE = TCC_WAVE_WAVEGEN_NPWM;     // PWM generation
+	TCC0_REGS->TCC_DRVCTRL = bidirectional ? TCC_DRVCTRL_INVEN0(1) | TCC_DRVCTRL_INVEN1(1) | TCC_DRVCTRL_INVEN2(1)
+	                                             | TCC_DRVCTRL_INVEN3(1)
+	                                       : 0;  // Bidirectional DShot idles high
+	TCC0_REGS->TCC_PER = config->period;
+	for (uint8_t i {0}; i < motorNumber; ++i) {
+		TCC0_REGS->TCC_CC[i] = 0;
+	}
+	TCC0_REGS->TCC_CTRLA |= TCC_CTRLA_ENABLE(1);  // Enable timer
+	while (TCC0_REGS->TCC_SYNCBUSY & TCC_SYNCBUSY_ENABLE_Msk);
+
+	// DMAC config
+	DMAC_REGS->DMAC_CTRL = 0;
+	DMAC_REGS->DMAC_BASEADDR = reinterpret_cast<uint32_t>(descriptors);
+	DMAC_REGS->DMAC_WRBADDR = reinterpret_cast<uint32_t>(writeback);
+	DMAC_REGS->DMAC_CTRL = DMAC_CTRL_DMAENABLE(1) | DMAC_CTRL_LVLEN0(1);
+
+	for (uint8_t i {0}; i < motorNumber; ++i) {
+		descriptors[i].DMAC_BTCTRL = DMAC_BTCTRL_VALID(1) | DMAC_BTCTRL_BEATSIZE_WORD | DMAC_BTCTRL_SRCINC(1)
+		                           | (i ? DMAC_BTCTRL_BLOCKACT_NOACT : DMAC_BTCTRL_BLOCKACT_INT);
+		descriptors[i].DMAC_BTCNT = BUFFER_LENGTH;
+		descriptors[i].DMAC_SRCADDR = reinterpret_cast<uint32_t>(buffers[i] + BUFFER_LENGTH);  // End of the buffer
+		descriptors[i].DMAC_DSTADDR = reinterpret_cast<uint32_t>(&TCC0_REGS->TCC_CCBUF[i]);
+		descriptors[i].DMAC_DESCADDR = 0;
+
+		DMAC_REGS->DMAC_CHID = i;
+		DMAC_REGS->DMAC_CHCTRLB = DMAC_CHCTRLB_TRIGSRC(TCC0_DMAC_ID_OVF)  // One bit per timer period
+		                        | DMAC_CHCTRLB_TRIGACT_BEAT | DMAC_CHCTRLB_LVL(0);
+	}
+	DMAC_REGS->DMAC_CHID = 0;
+	DMAC_REGS->DMAC_CHINTENSET = DMAC_CHINTENSET_TCMPL(1);
+
+	descriptors[SAMPLE_CHANNEL].DMAC_BTCTRL = DMAC_BTCTRL_VALID(1) | DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_DSTINC(1)
+	                                        | DMAC_BTCTRL_BLOCKACT_INT;
+	descriptors[SAMPLE_CHANNEL].DMAC_BTCNT = SAMPLE_COUNT;
+	descriptors[SAMPLE_CHANNEL].DMAC_SRCADDR = reinterpret_cast<uint32_t>(&PORT_REGS->GROUP[0].PORT_IN);
+	descriptors[SAMPLE_CHANNEL].DMAC_DSTADDR = reinterpret_cast<uint32_t>(samples + SAMPLE_COUNT);
+	descriptors[SAMPLE_CHANNEL].DMAC_DESCADDR = 0;
+	DMAC_REGS->DMAC_CHID = SAMPLE_CHANNEL;
+	DMAC_REGS->DMAC_CHCTRLB = DMAC_CHCTRLB_TRIGSRC(TCC0_DMAC_ID_OVF) | DMAC_CHCTRLB_TRIGACT_BEAT | DMAC_CHCTRLB_LVL(0);
+	DMAC_REGS->DMAC_CHINTENSET = DMAC_CHINTENSET_TCMPL(1);
+
+	NVIC_EnableIRQ(DMAC_IRQn);
+	NVIC_EnableIRQ(TCC0_IRQn);  // Only enabled for the overflow ending a bidirectional frame
+
+	// PORT config
+	for (uint8_t i {0}; i < motorNumber; ++i) {
+		uint8_t pin {motorPins[i]};
+		if (pin & 0x1) {  // Odd pin
+			PORT_REGS->GROUP[0].PORT_PMUX[pin / 2] =
+			    (PORT_REGS->GROUP[0].PORT_PMUX[pin / 2] & 0xf) | (i == 3 ? PORT_PMUX_PMUXO_F : PORT_PMUX_PMUXO_E);
+		} else {  // Even pin
+			PORT_REGS->GROUP[0].PORT_PMUX[pin / 2] =
+			    (i == 2 ? PORT_PMUX_PMUXE_F : PORT_PMUX_PMUXE_E) | (PORT_REGS->GROUP[0].PORT_PMUX[pin / 2] & 0xf0);
+		}
+	}
+	setPinsToTimer();
+	return true;
+}
+
+bool dshot::setThrottle(const uint16_t* throttles, bool telemetry) {
+	if (busy) {
+		return false;
+	}
+
+	for (uint8_t i {0}; i < motorNumber; ++i) {
+		uint16_t throttle {
+		  throttles[i] ? util::clamp(throttles[i], DShotCodec::throttleMin, DShotCodec::throttleMax)
+		               : static_cast<uint16_t>(0)
+		};
+		uint16_t frame {DShotCodec::encodeFrame(throttle, telemetry, bidirectional)};
+
+		DShotCodec::buildBuffer(buffers[i], frame, config->one, config->zero);
+	}
+
+	busy = true;
+	for (uint8_t i {0}; i < motorNumber; ++i) {
+		startChannel(i);
+	}
+	return true;
+}
+
+void dshot::update() {
+	if (!telemetryReady) {
+		return;
+	}
+	telemetryReady = false;
+
+	for (uint8_t i {0}; i < motorNumber; ++i) {
+		uint32_t eRPM {0};
+		if (DShotCodec::decodeTelemetry(DShotCodec::extractTelemetry(samples, SAMPLE_COUNT, motorPins[i]), eRPM)) {
+			eRPMs[i] = eRPM;
+		}
+	}
+}
+
+uint32_t dshot::getERPM(uint8_t motor) {
+	return motor < motorNumber ? eRPMs[motor] : 0;
+}
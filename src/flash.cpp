@@ -0,0 +1,56 @@
+#include "flash.hpp"
+
+#include "device.h"
+
+static_assert(flash::pageSize == FLASH_PAGE_SIZE, "Page size must match the device");
+static_assert(flash::size == RWW_SIZE, "Section size must match the device");
+
+static void (*callback)() {nullptr};
+
+
+extern "C" {
+	void NVMCTRL_Handler() {
+		// READY stays set while the controller is idle, so the interrupt is only enabled while a command runs
+		NVMCTRL_REGS->NVMCTRL_INTENCLR = NVMCTRL_INTENCLR_READY(1);
+		if (callback) {
+			callback();
+		}
+	}
+}
+
+void flash::init(void (*cb)()) {
+	callback = cb;
+	NVIC_EnableIRQ(NVMCTRL_IRQn);
+}
+
+const uint8_t* flash::getAddress() {
+	return reinterpret_cast<const uint8_t*>(RWW_ADDR);
+}
+
+void flash::eraseRow(uint16_t offset) {
+	NVMCTRL_REGS->NVMCTRL_ADDR = (RWW_ADDR + offset) >> 1u;
+	NVMCTRL_REGS->NVMCTRL_CTRLA = NVMCTRL_CTRLA_CMD_RWWEEER_Val | NVMCTRL_CTRLA_CMDEX_KEY;
+}
+
+// Writes to the flash addresses go to the page buffer
+volatile uint32_t* flash::getPageBuffer(uint16_t offset) {
+	return reinterpret_cast<volatile uint32_t*>(RWW_ADDR + offset);
+}
+
+void flash::writePage(uint16_t offset) {
+	NVMCTRL_REGS->NVMCTRL_ADDR = (RWW_ADDR + offset) >> 1u;
+	NVMCTRL_REGS->NVMCTRL_CTRLA = NVMCTRL_CTRLA_CMD_RWWEEWP_Val | NVMCTRL_CTRLA_CMDEX_KEY;
+}
+
+bool flash::ready() {
+	return NVMCTRL_REGS->NVMCTRL_INTFLAG & NVMCTRL_INTFLAG_READY_Msk;
+}
+
+void flash::notify() {
+	NVMCTRL_REGS->NVMCTRL_INTENSET = NVMCTRL_INTENSET_READY(1);
+}
+
+void flash::cancel() {
+	NVMCTRL_REGS->NVMCTRL_INTENCLR = NVMCTRL_INTENCLR_READY(1);
+	NVIC_ClearPendingIRQ(NVMCTRL_IRQn);
+}
@@ -0,0 +1,203 @@
+#include "flight.hpp"
+
+#include "data.hpp"
+#include "Mahony.hpp"
+
+constexpr static float ATT_LSB {10430.0f};
+
+static Mahony                  mahony {};
+static Quaternion              deviceOrientation {};
+static Vector3<float, uint8_t> deviceAngles {};
+
+static flight::FlightMode flightMode {};
+static float              pitchTarget {0};
+static float              rollTarget {0};
+static float              headingTarget {0};
+static bool               rthSet {false};
+
+
+static int16_t toLogged(float value) {
+	return util::clamp(value, -32768.0f, 32767.0f);
+}
+
+static float toSeconds(uint32_t interval) {
+	return interval / 1000000.0f;
+}
+
+static float getDifference(float angleA, float angleB) {
+	float diff = angleA - angleB;
+
+	if (diff > F_PI) {
+		return diff - F_2_PI;
+	} else if (diff < -F_PI) {
+		return diff + F_2_PI;
+	} else {
+		return diff;
+	}
+}
+
+void flight::updateAttitude(
+    const Vector3<float, uint8_t>& angularRates, const Vector3<float, uint8_t>& accelerations, uint32_t interval
+) {
+	mahony.updateIMU(angularRates, accelerations, toSeconds(interval));
+	deviceOrientation = mahony.getQuaternion();
+	deviceAngles = deviceOrientation.toEuler();
+}
+
+void flight::updateControl(const Commands& commands, uint32_t interval) {
+	float dt {toSeconds(interval)};
+
+	flightMode = commands.receiverAvailable ? static_cast<FlightMode>((commands.channels[8] + 1100) / 333)
+	                                        : FlightMode::Position;
+	OrientationMode orientationMode {
+	  commands.receiverAvailable ? static_cast<OrientationMode>((commands.channels[9] + 1100) / 1000)
+	                             : OrientationMode::Normal
+	};
+
+	if (commands.failsafeActive) {
+		if (!rthSet) {
+			headingTarget = deviceAngles[0][0] + F_PI;
+			if (headingTarget > F_PI) {
+				headingTarget -= F_2_PI;
+			}
+			rthSet = true;
+		}
+	} else {
+		rthSet = false;
+	}
+
+	switch (flightMode) {
+		case (FlightMode::Manual):
+		default: {
+			data::inputs[0][0] = commands.channels[0];
+			data::inputs[1][0] = commands.channels[1];
+			break;
+		}
+		case (FlightMode::Attitude): {
+			rollTarget = commands.channels[0] * F_PI_4 / 1000;
+			pitchTarget = -commands.channels[1] * F_PI_4 / 1000;
+
+			if (orientationMode == OrientationMode::Inverted) {
+				rollTarget = rollTarget + F_PI;
+				if (rollTarget > F_PI) {
+					rollTarget -= F_2_PI;
+				}
+			}
+
+			data::inputs[0][0] = data::rollPID.process(getDifference(rollTarget, deviceAngles[2][0]), 0, dt);
+			data::inputs[1][0] = data::pitchPID.process(getDifference(pitchTarget, deviceAngles[1][0]), 0, dt);
+
+			if (deviceAngles[2][0] < -F_PI_2 || deviceAngles[2][0] > F_PI_2) {
+				data::inputs[1][0] = -data::inputs[1][0];
+			}
+			break;
+		}
+		case (FlightMode::Position): {
+			bool companionActive {!rthSet && commands.setpointActive};
+
+			if (companionActive) {
+				headingTarget = commands.setpointHeading;
+			} else if (!rthSet) {
+				headingTarget = -commands.channels[0] * F_PI / 1000;
+			}
+			rollTarget =
+			    util::clamp(data::headingPID.process(getDifference(deviceAngles[0][0], headingTarget), 0, dt), -F_PI_4, F_PI_4);
+			pitchTarget = companionActive ? commands.setpointPitch : -commands.channels[1] * F_PI_4 / 1000;
+
+			if (orientationMode == OrientationMode::Inverted) {
+				rollTarget = rollTarget + F_PI;
+				if (rollTarget > F_PI) {
+					rollTarget -= F_2_PI;
+				}
+			}
+
+			data::inputs[0][0] = data::rollPID.process(getDifference(rollTarget, deviceAngles[2][0]), 0, dt);
+			data::inputs[1][0] = data::pitchPID.process(getDifference(pitchTarget, deviceAngles[1][0]), 0, dt);
+
+			if (deviceAngles[2][0] < -F_PI_2 || deviceAngles[2][0] > F_PI_2) {
+				data::inputs[1][0] = -data::inputs[1][0];
+			}
+			break;
+		}
+	}
+}
+
+void flight::updateOutputs(const Commands& commands) {
+	GimbalMode gimbalMode {
+	  commands.receiverAvailable ? static_cast<GimbalMode>((commands.channels[10] + 1100) / 1000) : GimbalMode::Horizon
+	};
+
+	switch (gimbalMode) {
+		case (GimbalMode::Fixed): {
+			data::inputs[2][0] = -commands.channels[3];
+			data::inputs[3][0] = -commands.channels[4];
+			data::inputs[4][0] = 0;
+			break;
+		}
+		case (GimbalMode::Horizon): {
+			Quaternion cameraOrientation {Quaternion::fromEuler(
+			    deviceAngles[0][0] - commands.channels[3] * F_PI_4 / 1000,
+			    -commands.channels[4] * F_PI_4 / 1000,
+			    0
+			)};
+			Quaternion cameraRotation {deviceOrientation.conjugate() * cameraOrientation};
+			auto       cameraAngles {cameraRotation.toEuler()};
+
+			for (uint8_t i {0}; i < 3; ++i) {
+				data::inputs[i + 2][0] = cameraAngles[i][0] / F_PI_4 * 1000;
+			}
+			break;
+		}
+		case (GimbalMode::Direction): {
+			Quaternion cameraOrientation {
+			  Quaternion::fromEuler(-commands.channels[3] * F_PI / 1000, -commands.channels[4] * F_PI_4 / 1000, 0)
+			};
+			Quaternion cameraRotation {deviceOrientation.conjugate() * cameraOrientation};
+			auto       cameraAngles {cameraRotation.toEuler()};
+
+			for (uint8_t i {0}; i < 3; ++i) {
+				data::inputs[i + 2][0] = cameraAngles[i][0] / F_PI_4 * 1000;
+			}
+			break;
+		}
+	}
+
+	data::calculateOutputs();
+}
+
+void flight::setEstimatorGains(float kp, float ki) {
+	mahony.setKp(kp);
+	mahony.setKi(ki);
+}
+
+void flight::writeResults(BlackboxFrame& frame) {
+	frame.status = (frame.status & 0xffu) | (static_cast<uint8_t>(flightMode) << 8u);
+
+	for (uint8_t i {0}; i < 3; ++i) {
+		frame.attitude[i] = deviceAngles[i][0] * ATT_LSB;
+	}
+
+	for (uint8_t i {0}; i < data::pidNumber; ++i) {
+		float scale {&data::pids[i] == &data::headingPID ? ATT_LSB : 1.0f};  // Heading PID outputs radians
+
+		frame.pidTerms[i][0] = toLogged(data::pids[i].getP() * scale);
+		frame.pidTerms[i][1] = toLogged(data::pids[i].getI() * scale);
+		frame.pidTerms[i][2] = toLogged(data::pids[i].getD() * scale);
+	}
+
+	for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
+		frame.outputs[i] = data::outputs[i][0];
+	}
+}
+
+flight::FlightMode flight::getFlightMode() {
+	return flightMode;
+}
+
+const Quaternion& flight::getOrientation() {
+	return deviceOrientation;
+}
+
+const Vector3<float, uint8_t>& flight::getAngles() {
+	return deviceAngles;
+}
@@ -1,67 +1,511 @@
 #include "nvm.hpp"
 
-const nvm::_internal::Rows nvm::_internal::rows __attribute__((aligned(FLASH_ROW_SIZE), keep, space(prog))) {};
-const nvm::Options*        nvm::options {&nvm::_internal::rows.options};
+#include <cstddef>
 
-uint8_t        nvm::_internal::rowCopy[FLASH_ROW_SIZE] {};
-const uint8_t* nvm::_internal::modifiedRow {nullptr};
+#include "flash.hpp"
 
-static void nvmWaitUntilReady();
-static void nvmRowErase(uint32_t address);
-static void nvmPageWrite();
 
-static void nvmWaitUntilReady() {
-	while ((NVMCTRL_REGS->NVMCTRL_INTFLAG & NVMCTRL_INTFLAG_READY_Msk) != NVMCTRL_INTFLAG_READY_Msk);
+constexpr static uint8_t PAGES_PER_ROW {flash::rowSize / flash::pageSize};
+constexpr static uint8_t ROW_NUMBER {flash::size / flash::rowSize};
+constexpr static uint8_t PAGE_NUMBER {ROW_NUMBER * PAGES_PER_ROW};
+constexpr static uint8_t RESERVED_ROWS {3};  // Blank rows kept ahead of the journal for moving current records
+constexpr static uint8_t NO_PAGE {0xff};
+constexpr static uint8_t NO_KEY {0xff};
+constexpr static uint8_t NO_ROW {0xff};
+
+struct __attribute__((packed)) RecordHeader {
+	uint8_t  key;
+	uint8_t  length;
+	uint16_t crc;       // CRC16 (CCITT) of the key, length, sequence and value
+	uint32_t sequence;  // Increments with every record written
+};
+
+struct Field {
+	uint8_t offset;
+	uint8_t size;
+};
+
+#define FIELD(field) {offsetof(nvm::Options, field), sizeof(nvm::Options::field)}
+// Adjacent fields, from first to last, under a single key
+#define FIELDS(first, last)                                                                   \
+	{offsetof(nvm::Options, first),                                                             \
+	 offsetof(nvm::Options, last) + sizeof(nvm::Options::last) - offsetof(nvm::Options, first)}
+
+// Indexed by record key, new fields must be added at the end to keep the existing records
+static const Field fields[] {
+  FIELD(angularRateOffsets),
+  FIELD(mixes),
+  FIELD(trims),
+  FIELD(limits),
+  FIELD(pidCoefficients),
+  FIELD(outputRates),
+  FIELDS(motorProtocol, receiverProtocol)  // A key of their own each would leave no row without current records
+};
+
+constexpr static uint8_t KEY_NUMBER {sizeof(fields) / sizeof(fields[0])};
+
+static_assert(sizeof(nvm::Options) <= 0xff, "Field offsets must fit in a byte");
+static_assert(KEY_NUMBER <= 8, "Key masks must fit in a byte");
+static_assert(KEY_NUMBER < ROW_NUMBER, "A row without current records must always exist");
+static_assert(
+    sizeof(RecordHeader) + sizeof(nvm::Options::mixes) <= flash::rowSize, "Every record must fit in a row"
+);
+
+alignas(uint32_t) const nvm::Options nvm::_internal::defaults {};
+const nvm::Options*                  nvm::options {&nvm::_internal::defaults};
+
+// Edited part of a single record page, the rest of the record is copied from flash when it is written
+static uint8_t          editedValue[flash::pageSize] {};
+static volatile uint8_t editedKey {NO_KEY};
+static volatile uint8_t editedPage {0};
+
+enum class State : uint8_t {
+	Idle,
+	Erasing,
+	Writing
+};
+
+static volatile State state {State::Idle};
+static volatile uint8_t editedKeys {0};   // Edited since the last commit
+static volatile uint8_t pendingKeys {0};  // Committed but not yet written
+static volatile uint8_t revision {0};     // Incremented whenever a record is written
+
+static uint8_t  recordPages[KEY_NUMBER] {};  // First page of the current record of each key
+static uint8_t  usedRows {0};                // Rows that have not been erased since they were written
+static uint8_t  head {0};                    // Next page to be written
+static uint32_t sequence {0};                // Sequence number of the next record
+static uint8_t  collectedRow {NO_ROW};       // Row being freed
+
+static uint8_t        writtenKey {0};
+static uint8_t        writtenPages {0};  // Pages of the current record left to write
+static const uint8_t* writtenValue {nullptr};
+static bool           writtenEdits {false};
+
+static void nvmRowErase(uint8_t row);
+static void nvmPageWrite(uint8_t page);
+static void advance();
+
+
+static const uint8_t* pageAddress(uint8_t page) {
+	return flash::getAddress() + page * flash::pageSize;
+}
+
+static const RecordHeader* recordHeader(uint8_t page) {
+	return reinterpret_cast<const RecordHeader*>(pageAddress(page));
+}
+
+static uint8_t pagesFor(uint8_t key) {
+	return (sizeof(RecordHeader) + fields[key].size + flash::pageSize - 1) / flash::pageSize;
+}
+
+static uint8_t keyOf(uint8_t offset) {
+	uint8_t key {0};
+	while (key < KEY_NUMBER - 1 && offset >= fields[key + 1].offset) {
+		++key;
+	}
+	return key;
+}
+
+// Position of the first byte of the value in a record page
+static uint8_t pageStart(uint8_t page) {
+	return page ? page * flash::pageSize - sizeof(RecordHeader) : 0;
+}
+
+static uint8_t pageOf(uint8_t position) {
+	return (position + sizeof(RecordHeader)) / flash::pageSize;
+}
+
+static uint8_t pageEnd(uint8_t key, uint8_t page) {
+	return util::min(static_cast<uint8_t>(pageStart(page + 1)), fields[key].size);
+}
+
+// The current record takes precedence over the defaults, edits are not included until they are written
+static const uint8_t* valueOf(uint8_t key) {
+	if (recordPages[key] != NO_PAGE) {
+		return pageAddress(recordPages[key]) + sizeof(RecordHeader);
+	}
+	return reinterpret_cast<const uint8_t*>(nvm::options) + fields[key].offset;
+}
+
+static uint16_t crc16CCITT(uint16_t crc, uint8_t byte) {
+	crc ^= byte << 8u;
+	for (uint8_t i {0}; i < 8; ++i) {
+		crc = crc & 0x8000 ? (crc << 1u) ^ 0x1021 : crc << 1u;
+	}
+	return crc;
+}
+
+static uint16_t crc16CCITT(uint16_t crc, const uint8_t* data, uint8_t length) {
+	for (uint8_t i {0}; i < length; ++i) {
+		crc = crc16CCITT(crc, data[i]);
+	}
+	return crc;
+}
+
+static uint16_t headerCRC(uint8_t key, uint32_t recordSequence) {
+	uint16_t crc {0xffff};
+	crc = crc16CCITT(crc, key);
+	crc = crc16CCITT(crc, fields[key].size);
+	return crc16CCITT(crc, reinterpret_cast<const uint8_t*>(&recordSequence), sizeof(recordSequence));
+}
+
+static bool pageBlank(uint8_t page) {
+	auto* words {reinterpret_cast<const uint32_t*>(pageAddress(page))};
+
+	for (uint8_t i {0}; i < flash::pageSize / sizeof(uint32_t); ++i) {
+		if (words[i] != 0xffffffff) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Returns the key of a complete record starting at the page or NO_KEY if there is none
+static uint8_t recordKey(uint8_t page) {
+	const RecordHeader* header {recordHeader(page)};
+
+	if (header->key >= KEY_NUMBER || header->length != fields[header->key].size
+	    || page % PAGES_PER_ROW + pagesFor(header->key) > PAGES_PER_ROW) {
+		return NO_KEY;
+	}
+
+	uint16_t crc {headerCRC(header->key, header->sequence)};
+	crc = crc16CCITT(crc, pageAddress(page) + sizeof(RecordHeader), header->length);
+	return crc == header->crc ? header->key : NO_KEY;
+}
+
+static bool rowLive(uint8_t row) {
+	for (uint8_t key {0}; key < KEY_NUMBER; ++key) {
+		if (recordPages[key] != NO_PAGE && recordPages[key] / PAGES_PER_ROW == row) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Counts the blank rows ahead of the one being written
+static uint8_t blankRows() {
+	uint8_t count {0};
+
+	for (uint8_t row {0}; row < ROW_NUMBER; ++row) {
+		if (!(usedRows & (1u << row)) && row != head / PAGES_PER_ROW) {
+			++count;
+		}
+	}
+	return count;
+}
+
+// The journal wraps around, so the oldest row is the first used one after the row being written
+static uint8_t oldestRow() {
+	for (uint8_t i {1}; i < ROW_NUMBER; ++i) {
+		uint8_t row = (head / PAGES_PER_ROW + i) % ROW_NUMBER;
+
+		if (usedRows & (1u << row)) {
+			return row;
+		}
+	}
+	return NO_ROW;
+}
+
+static void nvmRowErase(uint8_t row) {
+	flash::eraseRow(row * flash::rowSize);
+}
+
+// Fills the page buffer with a page of the record being written and starts the write
+static void nvmPageWrite(uint8_t page) {
+	const Field& field {fields[writtenKey]};
+	auto*        dest {flash::getPageBuffer((head + page) * flash::pageSize)};
+	uint8_t      start = page * flash::pageSize;  // Position of the page in the record
+	uint16_t     crc {headerCRC(writtenKey, sequence)};
+	bool         edited {writtenEdits && page == editedPage};  // Other pages are copied from the current record
+
+	// The header page is written last, the CRC covers the rest of the value exactly as it is in flash
+	for (uint8_t i = page ? 0 : 2; i < flash::pageSize / sizeof(uint32_t); ++i) {
+		uint32_t word {0};
+
+		for (uint8_t j {0}; j < sizeof(uint32_t); ++j) {
+			uint8_t position = start + i * sizeof(uint32_t) + j - sizeof(RecordHeader);
+			uint8_t byte {0xff};
+
+			if (position < field.size) {
+				byte = edited ? editedValue[position - pageStart(page)] : writtenValue[position];
+			}
+
+			if (!page && position < field.size) {
+				crc = crc16CCITT(crc, byte);
+			}
+			word |= static_cast<uint32_t>(byte) << (j * 8u);
+		}
+		dest[i] = word;
+	}
+
+	if (!page) {
+		uint8_t written = flash::pageSize - sizeof(RecordHeader);
+
+		if (field.size > written) {
+			crc = crc16CCITT(crc, pageAddress(head + 1), field.size - written);
+		}
+		dest[0] = writtenKey | (field.size << 8u) | (static_cast<uint32_t>(crc) << 16u);
+		dest[1] = sequence;
+	}
+
+	flash::writePage((head + page) * flash::pageSize);
+}
+
+static void startRecord(uint8_t key, bool edits) {
+	writtenKey = key;
+	writtenPages = pagesFor(key);
+	writtenValue = valueOf(key);
+	writtenEdits = edits;
+
+	if (head % PAGES_PER_ROW + writtenPages > PAGES_PER_ROW) {  // Records do not cross rows
+		head = (head / PAGES_PER_ROW + 1) % ROW_NUMBER * PAGES_PER_ROW;
+	}
+	usedRows |= 1u << (head / PAGES_PER_ROW);
+
+	nvmPageWrite(--writtenPages);
+	state = State::Writing;
+}
+
+static bool changed() {
+	const uint8_t* value {valueOf(editedKey)};
+
+	for (uint8_t i {pageStart(editedPage)}; i < pageEnd(editedKey, editedPage); ++i) {
+		if (editedValue[i - pageStart(editedPage)] != value[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Reading the option from flash again unless it was edited in the meantime
+static void releaseEdits(uint8_t key) {
+	if (key == editedKey && !((editedKeys | pendingKeys) & (1u << key))) {
+		editedKey = NO_KEY;
+	}
+}
+
+static void step() {
+	switch (state) {
+		case State::Writing:
+			if (writtenPages) {
+				nvmPageWrite(--writtenPages);
+				return;
+			}
+
+			recordPages[writtenKey] = head;
+			head = (head + pagesFor(writtenKey)) % PAGE_NUMBER;
+			++sequence;
+
+			if (writtenEdits) {
+				releaseEdits(writtenKey);
+			}
+			++revision;
+			break;
+		case State::Erasing:
+			usedRows &= ~(1u << collectedRow);
+			collectedRow = NO_ROW;
+			break;
+		case State::Idle:
+			break;
+	}
+	state = State::Idle;
+
+	if (collectedRow == NO_ROW && blankRows() < RESERVED_ROWS) {
+		collectedRow = oldestRow();
+	}
+
+	if (collectedRow != NO_ROW) {  // Moving current records out of the oldest row before erasing it
+		for (uint8_t key {0}; key < KEY_NUMBER; ++key) {
+			if (recordPages[key] != NO_PAGE && recordPages[key] / PAGES_PER_ROW == collectedRow) {
+				startRecord(key, false);  // Edits might not be committed yet
+				return;
+			}
+		}
+
+		nvmRowErase(collectedRow);
+		state = State::Erasing;
+		return;
+	}
+
+	while (pendingKeys) {
+		uint8_t key {0};
+		while (!(pendingKeys & (1u << key))) {
+			++key;
+		}
+		pendingKeys &= ~(1u << key);
+
+		if (key == editedKey && changed()) {
+			startRecord(key, true);
+			return;
+		}
+		releaseEdits(key);
+	}
+}
+
+// Starts the next step of the write, called with interrupts disabled or from the flash interrupt
+static void advance() {
+	step();
+
+	if (state != State::Idle) {
+		flash::notify();  // Continue once the command completes
+	}
 }
 
-static void nvmRowErase(const uint8_t* address) {
-	NVMCTRL_REGS->NVMCTRL_ADDR = reinterpret_cast<uint32_t>(address) >> 1u;
-	NVMCTRL_REGS->NVMCTRL_CTRLA = NVMCTRL_CTRLA_CMD_ER_Val | NVMCTRL_CTRLA_CMDEX_KEY;
+static void eraseNow(uint8_t row) {
+	nvmRowErase(row);
+	while (!flash::ready());
+}
+
+const uint8_t* nvm::_internal::locate(uint8_t offset) {
+	uint8_t key {keyOf(offset)};
+	return valueOf(key) + (offset - fields[key].offset);
+}
+
+uint8_t nvm::_internal::read(uint8_t offset) {
+	uint8_t key {keyOf(offset)};
+	uint8_t position = offset - fields[key].offset;
 
-	nvmWaitUntilReady();
+	if (key == editedKey && pageOf(position) == editedPage) {
+		return editedValue[position - pageStart(editedPage)];
+	}
+	return valueOf(key)[position];
 }
 
-static void nvmPageWrite(const uint8_t* address) {
-	NVMCTRL_REGS->NVMCTRL_ADDR = reinterpret_cast<uint32_t>(address) >> 1u;
-	NVMCTRL_REGS->NVMCTRL_CTRLA = NVMCTRL_CTRLA_CMD_WP_Val | NVMCTRL_CTRLA_CMDEX_KEY;
+bool nvm::_internal::edit(uint8_t offset, const uint8_t* src, uint8_t length) {
+	for (uint8_t i {0}; i < length; ++i) {
+		uint8_t key {keyOf(offset + i)};
+		uint8_t position = offset + i - fields[key].offset;
+		uint8_t page {pageOf(position)};
+
+		__disable_irq();
+		if (key != editedKey || page != editedPage) {
+			if (state != State::Idle) {  // Comparing with the flash would stall until the controller is done
+				__enable_irq();
+				return false;
+			} else if (src[i] == valueOf(key)[position]) {  // Unchanged, not taking the copy for it
+				__enable_irq();
+				continue;
+			} else if (editedKey != NO_KEY) {  // Another page is being edited, the copy is free once it is written
+				__enable_irq();
+				return false;
+			}
 
-	nvmWaitUntilReady();
+			util::copy(editedValue, valueOf(key) + pageStart(page), pageEnd(key, page) - pageStart(page));
+			editedKey = key;
+			editedPage = page;
+		}
+		editedValue[position - pageStart(page)] = src[i];
+		editedKeys |= 1u << key;
+		__enable_irq();
+	}
+	return true;
 }
 
 void nvm::load() {
-	for (uint8_t i {0}; i < data::mixesNumber; ++i) {
-		data::usbMixesResponse.mixes[i] = nvm::options->mixes[i];
+	for (uint8_t key {0}; key < KEY_NUMBER; ++key) {
+		recordPages[key] = NO_PAGE;
 	}
 
-	for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
-		data::usbTrimsResponse.trims[i] = nvm::options->trims[i];
+	// Rebuilding the index, every page is read once
+	uint8_t newestPage {NO_PAGE};
+
+	for (uint8_t page {0}; page < PAGE_NUMBER;) {
+		if (!pageBlank(page)) {
+			usedRows |= 1u << (page / PAGES_PER_ROW);
+		}
+
+		uint8_t key {recordKey(page)};
+		if (key == NO_KEY) {  // Blank, interrupted or a part of a previous record
+			++page;
+			continue;
+		}
+
+		uint32_t recordSequence {recordHeader(page)->sequence};
+		if (recordPages[key] == NO_PAGE || recordSequence > recordHeader(recordPages[key])->sequence) {
+			recordPages[key] = page;
+		}
+		if (newestPage == NO_PAGE || recordSequence >= sequence) {
+			newestPage = page;
+			sequence = recordSequence + 1;
+		}
+
+		for (uint8_t i {1}; i < pagesFor(key); ++i) {
+			if (!pageBlank(page + i)) {
+				usedRows |= 1u << ((page + i) / PAGES_PER_ROW);
+			}
+		}
+		page += pagesFor(key);
+	}
+
+	// Continuing after the newest record, skipping the rest of the row if a write was interrupted there
+	head = newestPage == NO_PAGE ? 0 : (newestPage + pagesFor(recordHeader(newestPage)->key)) % PAGE_NUMBER;
+	for (uint8_t page {head}; page % PAGES_PER_ROW; ++page) {
+		if (!pageBlank(page)) {
+			head = (head / PAGES_PER_ROW + 1) % ROW_NUMBER * PAGES_PER_ROW;
+			break;
+		}
 	}
 
-	for (uint8_t i {0}; i < data::outputChannelNumber * 2; ++i) {
-		data::usbLimitsResponse.limits[i] = nvm::options->limits[i];
+	// A new row must be blank, an interrupted erase leaves a used row without current records
+	for (uint8_t i {0}; i < ROW_NUMBER && head % PAGES_PER_ROW == 0; ++i) {
+		uint8_t row = head / PAGES_PER_ROW;
+
+		if (!(usedRows & (1u << row))) {
+			break;
+		} else if (!rowLive(row)) {
+			eraseNow(row);
+			usedRows &= ~(1u << row);
+			break;
+		}
+
+		head = (row + 1) % ROW_NUMBER * PAGES_PER_ROW;
 	}
 
-	for (uint8_t i {0}; i < data::pidNumber; ++i) {
-		data::usbPIDsResponse.coefficients[i] = nvm::options->pidCoefficients[i];
+	for (uint8_t i {0}; i < data::variableNumber; ++i) {
+		const data::Variable* variable {data::getVariable(i)};
+
+		if ((variable->flags & data::variablePersistent) && !(variable->flags & data::variableInFlash)) {
+			util::copy(
+			    variable->response + variable->storedOffset,
+			    get(variable->stored),
+			    variable->size - variable->storedOffset
+			);
+		}
 	}
+	++revision;
+
+	flash::init(advance);
+	commit();  // Freeing rows if needed
 }
 
 void nvm::write() {
-	if (_internal::modifiedRow == nullptr) {
-		return;  // No rows modified, nothing to do
-	}
+	commit();
 
-	nvmRowErase(_internal::modifiedRow);  // Erasing modified row
+	while (state != State::Idle) {  // Polling instead of waiting for the interrupt
+		__disable_irq();
+		if (state != State::Idle && flash::ready()) {
+			flash::cancel();
+			advance();
+		}
+		__enable_irq();
+	}
+}
 
-	for (uint8_t i {0}; i < 4; ++i) {  // Writing all 4 pages
-		auto* page {_internal::modifiedRow + i * FLASH_PAGE_SIZE};
-		util::copy(                                                                       // Copying a page
-		    (uint32_t*)(page),                                                            // Original page
-		    reinterpret_cast<const uint32_t*>(_internal::rowCopy + i * FLASH_PAGE_SIZE),  // Page copy
-		    FLASH_PAGE_SIZE / sizeof(uint32_t)  // Copying the entire page in 32-bit operations
-		);
-		nvmPageWrite(page);
+void nvm::commit() {
+	__disable_irq();
+	pendingKeys |= editedKeys;
+	editedKeys = 0;
+	if (state == State::Idle) {
+		advance();
 	}
+	__enable_irq();
+}
+
+bool nvm::busy() {
+	return state != State::Idle;
+}
 
-	_internal::modifiedRow = nullptr;
+uint8_t nvm::getRevision() {
+	return revision;
 }
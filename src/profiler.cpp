@@ -0,0 +1,178 @@
+#include "profiler.hpp"
+
+#if defined(__arm__)
+	#include "device.h"
+#else
+	#include <ctime>
+#endif
+
+
+constexpr static uint8_t  FIRST_OCTAVE {6};     // Runs shorter than 2^6 ticks all go into the first bucket
+constexpr static uint8_t  FULL_TABLE {0xff};    // Zone ID once the table is full, not registered again
+constexpr static uint16_t MAX_BUCKET {0xffff};  // All buckets are halved once one of them is full
+
+struct Zone {
+	const char* name {nullptr};
+	uint32_t    runs {0};
+	uint32_t    minTime {0};  // Ticks
+	uint32_t    maxTime {0};
+	uint64_t    totalTime {0};
+	uint16_t    histogram[profiler::bucketNumber] {};
+};
+
+static Zone    zones[profiler::zoneNumber] {};
+static uint8_t zoneCount {0};
+
+
+static uint8_t getBucket(uint32_t ticks) {
+	if (ticks < (1u << FIRST_OCTAVE)) {
+		return 0;
+	}
+
+	uint8_t octave = 31 - __builtin_clz(ticks);
+	uint8_t bucket = (octave - FIRST_OCTAVE) * 2 + (ticks >> (octave - 1u) & 0x1);  // Second bit picks the half
+	return bucket < profiler::bucketNumber ? bucket : profiler::bucketNumber - 1;
+}
+
+// Upper bound of the bucket
+static uint32_t getBucketLimit(uint8_t bucket) {
+	uint32_t octave {1u << (FIRST_OCTAVE + bucket / 2u)};
+
+	return bucket % 2 ? octave * 2 : octave + octave / 2;
+}
+
+static uint8_t registerZone(const char* name) {
+	if (zoneCount >= profiler::zoneNumber) {
+		return FULL_TABLE;
+	}
+
+	zones[zoneCount].name = name;
+	return ++zoneCount;
+}
+
+static void record(Zone& zone, uint32_t ticks) {
+	if (!zone.runs++) {
+		zone.minTime = zone.maxTime = ticks;
+	} else {
+		zone.minTime = ticks < zone.minTime ? ticks : zone.minTime;
+		zone.maxTime = ticks > zone.maxTime ? ticks : zone.maxTime;
+	}
+	zone.totalTime += ticks;
+
+	if (++zone.histogram[getBucket(ticks)] == MAX_BUCKET) {  // Older runs count less from now on
+		for (uint8_t i {0}; i < profiler::bucketNumber; ++i) {
+			zone.histogram[i] /= 2;
+		}
+	}
+}
+
+void profiler::init() {
+#if defined(__arm__)
+	// SysTick setup, counts CPU cycles without interrupts
+	SysTick->LOAD = profiler::tickMask;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+
+	#if PROFILE_PIN != 0xff
+	PORT_REGS->GROUP[0].PORT_DIRSET = 0x1 << PROFILE_PIN;
+	#endif
+#endif
+}
+
+uint32_t profiler::getTicks() {
+#if defined(__arm__)
+	return profiler::tickMask - SysTick->VAL;  // Counting up
+#else
+	timespec time {};
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<uint32_t>(time.tv_sec) * 1000000000u + time.tv_nsec;
+#endif
+}
+
+uint32_t profiler::toNanoseconds(uint32_t ticks) {
+#if defined(__arm__)
+	return static_cast<uint64_t>(ticks) * 125 / 6;  // 48MHz CPU clock
+#else
+	return ticks;
+#endif
+}
+
+uint32_t profiler::begin() {
+#if defined(__arm__) && PROFILE_PIN != 0xff
+	PORT_IOBUS_REGS->GROUP[0].PORT_OUTSET = 0x1 << PROFILE_PIN;
+#endif
+	return getTicks();
+}
+
+void profiler::end(uint8_t& zone, const char* name, uint32_t start) {
+	uint32_t ticks {(getTicks() - start) & profiler::tickMask};
+
+#if defined(__arm__) && PROFILE_PIN != 0xff
+	PORT_IOBUS_REGS->GROUP[0].PORT_OUTCLR = 0x1 << PROFILE_PIN;
+#endif
+
+	if (!zone) {
+		zone = registerZone(name);
+	}
+	if (zone != FULL_TABLE) {
+		record(zones[zone - 1], ticks);
+	}
+}
+
+uint8_t profiler::getZoneCount() {
+	return zoneCount;
+}
+
+profiler::Statistics profiler::getStatistics(uint8_t zone) {
+	Statistics statistics {};
+
+	if (zone >= zoneCount) {
+		return statistics;
+	}
+
+	const Zone& source {zones[zone]};
+	uint32_t    total {0};
+	uint32_t    counted {0};
+	uint8_t     bucket {0};
+
+	for (uint8_t i {0}; i < bucketNumber; ++i) {
+		total += source.histogram[i];
+	}
+	for (; bucket < bucketNumber - 1; ++bucket) {
+		counted += source.histogram[bucket];
+		if (counted >= total - total / 100) {
+			break;
+		}
+	}
+
+	uint32_t p99 {getBucketLimit(bucket)};
+
+	statistics.name = source.name;
+	statistics.runs = source.runs;
+	statistics.minTime = toNanoseconds(source.minTime);
+	statistics.averageTime = source.runs ? toNanoseconds(source.totalTime / source.runs) : 0;
+	statistics.p99Time = toNanoseconds(p99 < source.maxTime ? p99 : source.maxTime);
+	statistics.maxTime = toNanoseconds(source.maxTime);
+	return statistics;
+}
+
+void profiler::reset() {
+	for (uint8_t i {0}; i < zoneCount; ++i) {
+		const char* name {zones[i].name};
+
+		zones[i] = {};
+		zones[i].name = name;
+	}
+}
+
+profiler::Scope::Scope(uint8_t& zone, const char* name):
+  _zone {zone},
+  _name {name},
+  _start {begin()} {
+	// Nothing to do
+}
+
+profiler::Scope::~Scope() {
+	end(_zone, _name, _start);
+}
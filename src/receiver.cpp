@@ -0,0 +1,108 @@
+#include "receiver.hpp"
+
+#include <new>
+
+#include "uart.hpp"
+
+struct ProtocolConfig {
+	uint32_t baud;
+	bool     parity;
+	bool     twoStopBits;
+	uint8_t  timeout;  // Time without valid frames after which the receiver is considered lost, ms
+};
+
+static const ProtocolConfig protocolConfigs[] {
+  {100000, true,  true,  20}, // S.BUS, 8E2
+  {420000, false, false, 40}, // CRSF, 8N1, allows for the 50Hz packet rate
+  {115200, false, false, 20}, // i-BUS, 8N1
+  {115200, false, false, 20}  // SUMD, 8N1
+};
+
+// Only one parser is ever active, so all of them share the same storage
+union ParserStorage {
+	alignas(SBUSParser) uint8_t sbus[sizeof(SBUSParser)];
+	alignas(CRSFParser) uint8_t crsf[sizeof(CRSFParser)];
+	alignas(IBUSParser) uint8_t ibus[sizeof(IBUSParser)];
+	alignas(SUMDParser) uint8_t sumd[sizeof(SUMDParser)];
+};
+
+static ParserStorage   parserStorage {};
+static ReceiverParser* parser {nullptr};
+static uint8_t         timeout {20};
+
+static volatile uint32_t lastFrameReceived {0};
+static volatile bool     frameReceived {false};
+
+
+// Called from the UART interrupt
+static void receive(const uart::DefaultCallback::buffer_type& buffer) {
+	for (uint8_t i {0}; i < buffer.transferred; ++i) {
+		if (parser->process(buffer.buffer[i])) {
+			lastFrameReceived = util::getTime();
+			frameReceived = true;
+		}
+	}
+}
+
+void receiver::init(Protocol protocol) {
+	switch (protocol) {
+		case Protocol::SBUS:
+		default:
+			protocol = Protocol::SBUS;
+			parser = new (&parserStorage) SBUSParser();
+			break;
+		case Protocol::CRSF:
+			parser = new (&parserStorage) CRSFParser();
+			break;
+		case Protocol::IBUS:
+			parser = new (&parserStorage) IBUSParser();
+			break;
+		case Protocol::SUMD:
+			parser = new (&parserStorage) SUMDParser();
+			break;
+	}
+
+	const ProtocolConfig& config {protocolConfigs[static_cast<uint8_t>(protocol)]};
+	timeout = config.timeout;
+
+	uart::set3Callback(receive);
+	uart::init3(config.baud, config.parity, config.twoStopBits);
+}
+
+bool receiver::available() {
+	return frameReceived && util::getTime() - lastFrameReceived < timeout;
+}
+
+int16_t receiver::getChannel(uint8_t channel) {
+	if (!available()) {
+		return 0;
+	} else if (channel < ReceiverParser::channelNumber) {
+		return parser->getSnapshot().channels[channel];
+	} else if (channel < ReceiverParser::channelNumber + 2) {
+		/* Calculate the bit corresponding to the channel
+		 *
+		 * Bit 0: channel 17 (0x01)
+		 * Bit 1: channel 18 (0x02)
+		 */
+		uint8_t bit = channel - ReceiverParser::channelNumber;
+		return (parser->getSnapshot().flags >> bit) & 0x1;
+	} else {
+		return 0;
+	}
+}
+
+bool receiver::frameLost() {
+	return parser->getSnapshot().flags & ReceiverParser::frameLostFlag;
+}
+
+bool receiver::failsafeActive() {
+	return parser->getSnapshot().flags & ReceiverParser::failsafeFlag;
+}
+
+const ReceiverParser::Snapshot& receiver::getSnapshot() {
+	return parser->getSnapshot();
+}
+
+const ReceiverParser::Statistics& receiver::getStatistics() {
+	return parser->getStatistics();
+}
@@ -1,20 +1,52 @@
 #include "servo.hpp"
 
 
-static tcc_registers_t* getTimer(uint8_t channel);
+struct RateConfig {
+	uint32_t prescaler;
+	uint16_t period;  // Timer ticks
+	uint8_t  scale;   // Timer ticks per microsecond of the 1-2ms range
+};
+
+// Timers are clocked from the 16MHz GCLK1
+static const RateConfig rateConfigs[] {
+  {TCC_CTRLA_PRESCALER_DIV16, 20000, 1}, // 50Hz, 1us resolution
+  {TCC_CTRLA_PRESCALER_DIV16, 5000,  1}, // 200Hz, 1us resolution
+  {TCC_CTRLA_PRESCALER_DIV16, 3000,  1}, // 333Hz, 1us resolution
+  {TCC_CTRLA_PRESCALER_DIV1,  8000,  2}  // 2kHz, 1/16us resolution, pulse length divided by 8
+};
+
+static servo::Rate groupRates[servo::groupNumber] {};
+static uint8_t     ownedGroups {0};
+
+static tcc_registers_t* getTimer(uint8_t group);
+static uint8_t          getGroup(uint8_t channel);
 static uint8_t          getTimerChannel(uint8_t channel);
 static uint8_t          getPin(uint8_t channel);
+static bool             owned(uint8_t group);
+static uint32_t         getCompareValue(uint8_t group, int16_t angle);
+static void             startTimer(uint8_t group);
+static void             synchronizeTimers();
 
-static tcc_registers_t* getTimer(uint8_t channel) {
-	if (channel < 4) {
+static tcc_registers_t* getTimer(uint8_t group) {
+	if (group == 0) {
 		return TCC0_REGS;
-	} else if (channel < 6) {
+	} else if (group == 1) {
 		return TCC1_REGS;
 	} else {
 		return TCC2_REGS;
 	}
 }
 
+static uint8_t getGroup(uint8_t channel) {
+	if (channel < 4) {
+		return 0;
+	} else if (channel < 6) {
+		return 1;
+	} else {
+		return 2;
+	}
+}
+
 static uint8_t getTimerChannel(uint8_t channel) {
 	if (channel < 4) {
 		return channel;
@@ -35,24 +67,82 @@ static uint8_t getPin(uint8_t channel) {
 	}
 }
 
-void servo::init() {
+static bool owned(uint8_t group) {
+	return ownedGroups & (1u << group);
+}
+
+static uint32_t getCompareValue(uint8_t group, int16_t angle) {
+	// Range: [1ms * GCLK_TC; 2ms * GCLK_TCC]
+	angle = (angle * 1000) >> 10u;
+	return (util::clamp(static_cast<int>(angle), -1500, 1500) / 2 + 1500)
+	     * rateConfigs[static_cast<uint8_t>(groupRates[group])].scale;
+}
+
+static void startTimer(uint8_t group) {
+	tcc_registers_t*  timer {getTimer(group)};
+	const RateConfig& config {rateConfigs[static_cast<uint8_t>(groupRates[group])]};
+
+	timer->TCC_CTRLA = 0;  // Disable timer to change enable-protected settings
+	while (timer->TCC_SYNCBUSY & TCC_SYNCBUSY_ENABLE_Msk);
+
+	// TCC config
+	timer->TCC_CTRLA = config.prescaler;
+	timer->TCC_DBGCTRL = TCC_DBGCTRL_DBGRUN(1);  // Run while debugging
+	timer->TCC_WAVE = TCC_WAVE_WAVEGEN_NPWM;     // PWM generation
+	timer->TCC_PER = config.period;
+	for (uint8_t i {0}; i < (group ? 2 : 4); ++i) {
+		timer->TCC_CC[i] = getCompareValue(group, 0);  // 1.5ms
+	}
+	timer->TCC_CTRLA |= TCC_CTRLA_ENABLE(1);  // Enable timer
+	while (timer->TCC_SYNCBUSY & TCC_SYNCBUSY_ENABLE_Msk);
+}
+
+static void synchronizeTimers() {
+	// Restart all timers back-to-back so that the periods of groups with the same rate line up
+	for (uint8_t i {0}; i < servo::groupNumber; ++i) {
+		if (owned(i)) {
+			getTimer(i)->TCC_CTRLBSET = TCC_CTRLBSET_CMD_RETRIGGER;
+		}
+	}
+	for (uint8_t i {0}; i < servo::groupNumber; ++i) {
+		while (owned(i) && getTimer(i)->TCC_SYNCBUSY & TCC_SYNCBUSY_CTRLB_Msk);
+	}
+}
+
+void servo::init(uint8_t groups) {
+	ownedGroups = groups & allGroups;
+
 	// GLCK config
 	GCLK_REGS->GCLK_PCHCTRL[TCC0_GCLK_ID] = GCLK_PCHCTRL_CHEN(1)     // Enable TCC[0:1] clock
-	                                      | GCLK_PCHCTRL_GEN_GCLK1;  // Set GCLK0 as a clock source
+	                                      | GCLK_PCHCTRL_GEN_GCLK1;  // Set GCLK1 as a clock source
 	GCLK_REGS->GCLK_PCHCTRL[TCC2_GCLK_ID] = GCLK_PCHCTRL_CHEN(1)     // Enable TCC2 clock
-	                                      | GCLK_PCHCTRL_GEN_GCLK1;  // Set GCLK0 as a clock source
+	                                      | GCLK_PCHCTRL_GEN_GCLK1;  // Set GCLK1 as a clock source
+
+	for (uint8_t i {0}; i < groupNumber; ++i) {
+		if (owned(i)) {
+			startTimer(i);
+		}
+	}
+	synchronizeTimers();
 }
 
-void servo::enable(uint8_t channel) {
-	tcc_registers_t* timer {getTimer(channel)};
+void servo::setRate(uint8_t group, Rate rate) {
+	if (group >= groupNumber || !owned(group)) {
+		return;
+	}
+	if (static_cast<uint8_t>(rate) > static_cast<uint8_t>(Rate::OneShot125)) {
+		rate = Rate::Analog50Hz;
+	}
 
-	// TCC config
-	timer->TCC_CTRLA = TCC_CTRLA_PRESCALER_DIV16;
-	timer->TCC_DBGCTRL = TCC_DBGCTRL_DBGRUN(1);      // Run while debugging
-	timer->TCC_WAVE = TCC_WAVE_WAVEGEN_NPWM;         // PWM generation
-	timer->TCC_PER = 20000;                          // 20ms
-	timer->TCC_CC[getTimerChannel(channel)] = 1500;  // 1.5ms
-	timer->TCC_CTRLA |= TCC_CTRLA_ENABLE(1);         // Enable timer
+	groupRates[group] = rate;
+	startTimer(group);
+	synchronizeTimers();
+}
+
+void servo::enable(uint8_t channel) {
+	if (!owned(getGroup(channel))) {
+		return;
+	}
 
 	// PORT config
 	uint8_t pin {getPin(channel)};
@@ -67,13 +157,41 @@ void servo::enable(uint8_t channel) {
 }
 
 void servo::disable(uint8_t channel) {
+	if (!owned(getGroup(channel))) {
+		return;
+	}
+
 	uint8_t pin {getPin(channel)};
 	PORT_REGS->GROUP[0].PORT_OUTCLR = 0x1 << pin;
-	PORT_REGS->GROUP[0].PORT_PINCFG[pin] = PORT_PINCFG_PMUXEN(0);  // Enable mux on pin
+	PORT_REGS->GROUP[0].PORT_PINCFG[pin] = PORT_PINCFG_PMUXEN(0);  // Disable mux on pin
 }
 
 void servo::setChannel(uint8_t channel, int16_t angle) {
-	// Range: [1ms * GCLK_TC; 2ms * GCLK_TCC]
-	angle = (angle * 1000) >> 10u;
-	getTimer(channel)->TCC_CCBUF[getTimerChannel(channel)] = util::clamp(static_cast<int>(angle), -1500, 1500) / 2 + 1500;
+	uint8_t group {getGroup(channel)};
+
+	if (owned(group)) {
+		getTimer(group)->TCC_CCBUF[getTimerChannel(channel)] = getCompareValue(group, angle);
+	}
+}
+
+void servo::setAll(const int16_t* angles) {
+	// Lock buffer updates so that a period boundary in the middle of the update cannot latch only some of the channels
+	for (uint8_t i {0}; i < groupNumber; ++i) {
+		if (owned(i)) {
+			getTimer(i)->TCC_CTRLBSET = TCC_CTRLBSET_LUPD(1);
+		}
+	}
+	for (uint8_t i {0}; i < groupNumber; ++i) {
+		while (owned(i) && getTimer(i)->TCC_SYNCBUSY & TCC_SYNCBUSY_CTRLB_Msk);
+	}
+
+	for (uint8_t i {0}; i < channelNumber; ++i) {
+		setChannel(i, angles[i]);
+	}
+
+	for (uint8_t i {0}; i < groupNumber; ++i) {
+		if (owned(i)) {
+			getTimer(i)->TCC_CTRLBCLR = TCC_CTRLBCLR_LUPD(1);
+		}
+	}
 }
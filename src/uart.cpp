@@ -1,5 +1,7 @@
 #include "uart.hpp"
 
+constexpr static uint32_t BAUD_1 {460800};  // Carries the blackbox at the control rate
+constexpr static uint32_t BAUD_2 {115200};
 
 static uart::DefaultQueue                   outQueue1 {};
 static uart::DefaultCallback::buffer_type   inBuffer1 {};
@@ -9,15 +11,24 @@ static uart::DefaultQueue                   outQueue2 {};
 static uart::DefaultCallback::buffer_type   inBuffer2 {};
 static uart::DefaultCallback::callback_type callback2 {nullptr};
 
+static uart::DefaultCallback::buffer_type   inBuffer3 {};
+static uart::DefaultCallback::callback_type callback3 {nullptr};
+
+// Arithmetic baud rate generation with 16x oversampling from the 48MHz GCLK0
+static uint16_t baudValue(uint32_t baud) {
+	return 65536 - (65536ull * 16 * baud + 24000000) / 48000000;
+}
+
 static void initSERCOM(
     sercom_registers_t* regs,
+    uint32_t            baud,
     unsigned            txPad = SERCOM_USART_INT_CTRLA_TXPO_PAD0,
     unsigned rxPad = SERCOM_USART_INT_CTRLA_RXPO_PAD1
 ) {
 	regs->USART_INT.SERCOM_CTRLB = SERCOM_USART_INT_CTRLB_TXEN(1) | SERCOM_USART_INT_CTRLB_RXEN(1)
 	                             | SERCOM_USART_INT_CTRLB_PMODE_ODD | SERCOM_USART_INT_CTRLB_SBMODE_1_BIT
 	                             | SERCOM_USART_INT_CTRLB_CHSIZE_8_BIT;
-	regs->USART_INT.SERCOM_BAUD = 63020;  // 115200 baud
+	regs->USART_INT.SERCOM_BAUD = baudValue(baud);
 	regs->USART_INT.SERCOM_DBGCTRL = SERCOM_USART_INT_DBGCTRL_DBGSTOP(1);
 	regs->USART_INT.SERCOM_CTRLA = SERCOM_USART_INT_CTRLA_DORD_LSB | SERCOM_USART_INT_CTRLA_CMODE_ASYNC
 	                             | SERCOM_USART_INT_CTRLA_SAMPR_16X_ARITHMETIC
@@ -55,7 +66,13 @@ static void SERCOM_Handler(
 			regs->USART_INT.SERCOM_DATA = outQueue.front().buffer[outQueue.front().transferred++];
 		}
 	}
-	(void)regs->USART_INT.SERCOM_DATA;  // Clear the RXC interrupt flag
+	if (regs->USART_INT.SERCOM_INTFLAG & SERCOM_USART_INT_INTFLAG_RXC_Msk) {  // Incoming transfer
+		inBuffer.buffer[inBuffer.transferred++] = regs->USART_INT.SERCOM_DATA;  // Also clears the RXC flag
+		if (callback) {
+			callback(inBuffer);
+		}
+		inBuffer.transferred = 0;
+	}
 	regs->USART_INT.SERCOM_INTFLAG = SERCOM_USART_INT_INTFLAG_Msk;
 }
 
@@ -67,6 +84,14 @@ extern "C" {
 	void SERCOM1_Handler() {
 		SERCOM_Handler(SERCOM1_REGS, outQueue2, inBuffer2, callback2);
 	}
+
+	void SERCOM3_Handler() {
+		inBuffer3.buffer[inBuffer3.transferred++] = SERCOM3_REGS->USART_INT.SERCOM_DATA;  // Also clears the RXC flag
+		if (callback3) {
+			callback3(inBuffer3);
+		}
+		inBuffer3.transferred = 0;
+	}
 }
 
 void uart::init() {
@@ -84,10 +109,10 @@ void uart::init() {
 	                                  | PORT_WRCONFIG_WRPINCFG(1) | PORT_WRCONFIG_HWSEL(1);
 
 	// SERCOM config
-	initSERCOM(SERCOM1_REGS);
+	initSERCOM(SERCOM1_REGS, BAUD_2);
 	NVIC_EnableIRQ(SERCOM1_IRQn);
 
-	initSERCOM(SERCOM4_REGS, SERCOM_USART_INT_CTRLA_TXPO_PAD1, SERCOM_USART_INT_CTRLA_RXPO_PAD3);
+	initSERCOM(SERCOM4_REGS, BAUD_1, SERCOM_USART_INT_CTRLA_TXPO_PAD1, SERCOM_USART_INT_CTRLA_RXPO_PAD3);
 	NVIC_EnableIRQ(SERCOM4_IRQn);
 }
 
@@ -135,3 +160,33 @@ uint8_t uart::sendTo2(const uint8_t* buf, uint8_t len) {
 void uart::set2Callback(uart::DefaultCallback::callback_type cb) {
 	callback2 = cb;
 }
+
+void uart::init3(uint32_t baud, bool parity, bool twoStopBits) {
+	GCLK_REGS->GCLK_PCHCTRL[SERCOM3_GCLK_ID_CORE] = GCLK_PCHCTRL_CHEN(1)     // Enable SERCOM3 clock
+	                                              | GCLK_PCHCTRL_GEN_GCLK0;  // Set GCLK0 as a clock source
+
+	// PORT config
+	PORT_REGS->GROUP[0].PORT_WRCONFIG = PORT_WRCONFIG_PINMASK((0x1 << 6u) | (0x1 << 7u)) | PORT_WRCONFIG_PMUXEN(1)
+	                                  | PORT_WRCONFIG_PMUX(MUX_PA22C_SERCOM3_PAD0) | PORT_WRCONFIG_WRPMUX(1)
+	                                  | PORT_WRCONFIG_WRPINCFG(1) | PORT_WRCONFIG_HWSEL(1);
+
+	// SERCOM config
+	SERCOM3_REGS->USART_INT.SERCOM_CTRLB = SERCOM_USART_INT_CTRLB_RXEN(1)
+	                                     | (parity ? SERCOM_USART_INT_CTRLB_PMODE_EVEN : 0)
+	                                     | (twoStopBits ? SERCOM_USART_INT_CTRLB_SBMODE_2_BIT
+	                                                    : SERCOM_USART_INT_CTRLB_SBMODE_1_BIT)
+	                                     | SERCOM_USART_INT_CTRLB_CHSIZE_8_BIT;
+	SERCOM3_REGS->USART_INT.SERCOM_BAUD = baudValue(baud);
+	SERCOM3_REGS->USART_INT.SERCOM_INTENSET = SERCOM_USART_INT_INTENSET_RXC(1);
+	SERCOM3_REGS->USART_INT.SERCOM_CTRLA =
+	    SERCOM_USART_INT_CTRLA_DORD_LSB | SERCOM_USART_INT_CTRLA_CMODE_ASYNC | SERCOM_USART_INT_CTRLA_SAMPR_16X_ARITHMETIC
+	    | (parity ? SERCOM_USART_INT_CTRLA_FORM_USART_FRAME_WITH_PARITY : SERCOM_USART_INT_CTRLA_FORM_USART_FRAME_NO_PARITY)
+	    | SERCOM_USART_INT_CTRLA_RXPO_PAD1 | SERCOM_USART_INT_CTRLA_TXPO_PAD0 | SERCOM_USART_INT_CTRLA_MODE_USART_INT_CLK
+	    | SERCOM_USART_INT_CTRLA_ENABLE(1);
+
+	NVIC_EnableIRQ(SERCOM3_IRQn);
+}
+
+void uart::set3Callback(uart::DefaultCallback::callback_type cb) {
+	callback3 = cb;
+}
@@ -1,6 +1,9 @@
 #include "usb.hpp"
 
+#include <new>
+
 #include "nvm.hpp"
+#include "profiler.hpp"
 #include "servo.hpp"
 #include "uart.hpp"
 
@@ -12,6 +15,9 @@ static void standardRequestHandler();
 static void vendorRequestHandler();
 static void enableEndpoints(uint8_t configurationNumber);
 static void endpoint1Handler();
+static bool setRequestedVariables();
+static void endpoint2Handler();
+static void startStreamTransfer(uint8_t buffer);
 
 
 #define MIN(a, b) ((a < b) ? (a) : (b))
@@ -39,7 +45,10 @@ typedef struct __attribute__((packed)) {
 	uint8_t bData[160];
 } usb_device_endpoint1_request;
 
-usb_descriptor_device_registers_t usb::EPDESCTBL[2];
+constexpr static uint8_t STREAM_FRAME_SIZE {96};
+constexpr static uint8_t NO_BUFFER {0xff};
+
+static usb_descriptor_device_registers_t EPDESCTBL[3];
 
 static usb_device_endpoint0_request EP0REQ;
 static usb_device_endpoint1_request EP1REQ;
@@ -47,6 +56,17 @@ static usb_device_endpoint1_request EP1REQ;
 const static uint8_t* defaultData {nullptr};
 static uint8_t        defaultLen {0};
 
+static uint8_t       variablesResponse[sizeof(usb_device_endpoint1_request)] {};
+static volatile bool requestPending {false};  // SetVariable(s) request left in EP1REQ for update()
+
+// Stream frames are double-buffered: one can be filled while the other one is being sent or waits for the host
+static uint8_t          streamBuffers[2][STREAM_FRAME_SIZE] {};
+static uint8_t          streamLengths[2] {};
+static volatile uint8_t sendingBuffer {NO_BUFFER};
+static volatile uint8_t queuedBuffer {NO_BUFFER};
+
+static data::Stream subscription {};
+
 extern "C" {
 
 	void USB_Handler() {
@@ -65,9 +85,14 @@ extern "C" {
 		} else if (USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPINTFLAG
 		           & (USB_DEVICE_EPINTFLAG_TRCPT1_Msk | USB_DEVICE_EPINTFLAG_TRCPT0_Msk)) {
 			endpoint1Handler();
-			USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPSTATUSCLR = USB_DEVICE_EPSTATUS_BK0RDY(1);
+			if (!requestPending) {  // Otherwise the bank stays full and the host is NAKed until update()
+				USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPSTATUSCLR = USB_DEVICE_EPSTATUS_BK0RDY(1);
+			}
 			USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPINTFLAG =
 			    USB_DEVICE_EPINTFLAG_Msk;  // Clear all pending endpoint interrupts
+		} else if (USB_REGS->DEVICE.DEVICE_ENDPOINT[2].USB_EPINTFLAG & USB_DEVICE_EPINTFLAG_TRCPT1_Msk) {
+			USB_REGS->DEVICE.DEVICE_ENDPOINT[2].USB_EPINTFLAG = USB_DEVICE_EPINTFLAG_TRCPT1(1);  // Clear pending interrupt
+			endpoint2Handler();
 		}
 	}
 }
@@ -165,70 +190,38 @@ static void vendorRequestHandler() {
 
 void endpoint1Handler() {
 	if (USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPINTFLAG & USB_DEVICE_EPINTFLAG_TRCPT0_Msk) {  // OUT transfer
-		if (EP1REQ.bRequest == static_cast<uint8_t>(data::CommandType::GetVariable)) {
-			switch (EP1REQ.bValue) {
-				case static_cast<uint8_t>(data::VariableID::Sensors):
-					write(reinterpret_cast<uint8_t*>(&data::usbSensorsResponse), sizeof(data::USBSensorsResponse));
-					break;
-				case static_cast<uint8_t>(data::VariableID::Settings):
-					write(reinterpret_cast<uint8_t*>(&data::usbSettingsResponse), sizeof(data::USBSettingsResponse));
-					break;
-				case static_cast<uint8_t>(data::VariableID::Inputs):
-					write(reinterpret_cast<uint8_t*>(&data::usbInputsResponse), sizeof(data::USBInputsResponse));
-					break;
-				case static_cast<uint8_t>(data::VariableID::Mux):
-					write(reinterpret_cast<uint8_t*>(&data::usbMixesResponse), sizeof(data::USBMixesResponse));
-					break;
-				case static_cast<uint8_t>(data::VariableID::Trims):
-					write(reinterpret_cast<uint8_t*>(&data::usbTrimsResponse), sizeof(data::USBTrimsResponse));
-					break;
-				case static_cast<uint8_t>(data::VariableID::Limits):
-					write(reinterpret_cast<uint8_t*>(&data::usbLimitsResponse), sizeof(data::USBLimitsResponse));
-					break;
-				case static_cast<uint8_t>(data::VariableID::Outputs):
-					write(reinterpret_cast<uint8_t*>(&data::usbOutputsResponse), sizeof(data::USBOutputsResponse));
-					break;
-				case static_cast<uint8_t>(data::VariableID::PIDs):
-					write(reinterpret_cast<uint8_t*>(&data::usbPIDsResponse), sizeof(data::usbPIDsResponse));
-					break;
-			}
-		} else {
-			switch (EP1REQ.bValue) {
-				case static_cast<uint8_t>(data::VariableID::Mux):
-					util::copy(data::usbMixesResponse.mixes, reinterpret_cast<int16_t*>(EP1REQ.bData), data::mixesNumber);
-					for (uint8_t i {0}; i < data::mixesNumber; ++i) {
-						nvm::edit(nvm::options->mixes + i, data::usbMixesResponse.mixes[i]);
-					}
-					nvm::write();
-					break;
-				case static_cast<uint8_t>(data::VariableID::Trims):
-					util::copy(data::usbTrimsResponse.trims, reinterpret_cast<int16_t*>(EP1REQ.bData), data::outputChannelNumber);
-					for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
-						nvm::edit(nvm::options->trims + i, data::usbTrimsResponse.trims[i]);
-					}
-					nvm::write();
-					break;
-				case static_cast<uint8_t>(data::VariableID::Limits):
-					util::copy(
-					    data::usbLimitsResponse.limits,
-					    reinterpret_cast<int16_t*>(EP1REQ.bData),
-					    data::outputChannelNumber * 2
-					);
-					for (uint8_t i {0}; i < data::outputChannelNumber * 2; ++i) {
-						nvm::edit(nvm::options->limits + i, data::usbLimitsResponse.limits[i]);
-					}
-					nvm::write();
-					break;
-				case static_cast<uint8_t>(data::VariableID::PIDs):
-					for (uint8_t i {0}; i < data::pidNumber; ++i) {
-						data::usbPIDsResponse.coefficients[i] = *reinterpret_cast<InlinePID<float>::PIDCoefficients*>(
-						    EP1REQ.bData + 2 + sizeof(InlinePID<float>::PIDCoefficients) * i
-						);
-						nvm::edit(nvm::options->pidCoefficients + i, data::usbPIDsResponse.coefficients[i]);
-					}
-					nvm::write();
-					break;
+		switch (EP1REQ.bRequest) {
+			case static_cast<uint8_t>(data::CommandType::GetVariable): {
+				const data::Variable* variable {data::getVariable(EP1REQ.bValue)};
+				if (variable && variable->flags & data::variableInFlash) {  // Assembling the response from flash
+					data::readVariable(variable, 0, variable->size, variablesResponse);
+					write(variablesResponse, variable->size);
+				} else if (variable) {
+					write(variable->response, variable->size);
+				}
+				break;
 			}
+			case static_cast<uint8_t>(data::CommandType::SetVariable):
+			case static_cast<uint8_t>(data::CommandType::SetVariables):
+				if (!setRequestedVariables()) {
+					requestPending = true;
+					return;
+				}
+				break;
+			case static_cast<uint8_t>(data::CommandType::GetVariables):
+				write(
+				    variablesResponse,
+				    data::getVariables(
+				        MIN(EP1REQ.bValue, sizeof(EP1REQ.bData) / sizeof(data::VariableSlice)),
+				        reinterpret_cast<const data::VariableSlice*>(EP1REQ.bData),
+				        variablesResponse,
+				        sizeof(variablesResponse)
+				    )
+				);
+				break;
+			case static_cast<uint8_t>(data::CommandType::Subscribe):
+				data::subscribe(subscription, EP1REQ.bValue, EP1REQ.bData, sizeof(EP1REQ.bData), STREAM_FRAME_SIZE);
+				break;
 		}
 		EPDESCTBL[1].DEVICE_DESC_BANK[0].USB_PCKSIZE =
 		    USB_DEVICE_PCKSIZE_MULTI_PACKET_SIZE(sizeof(EP1REQ)) | USB_DEVICE_PCKSIZE_SIZE(0x3);
@@ -238,6 +231,37 @@ void endpoint1Handler() {
 	}
 }
 
+// Applies a SetVariable(s) request, returns false if it has to be applied again once the commit is written
+static bool setRequestedVariables() {
+	data::SetResult result {
+	  EP1REQ.bRequest == static_cast<uint8_t>(data::CommandType::SetVariable)
+	      ? data::setVariable(EP1REQ.bValue, 0, sizeof(EP1REQ.bData), EP1REQ.bData)
+	      : data::setVariables(EP1REQ.bValue, EP1REQ.bData, sizeof(EP1REQ.bData))
+	};
+
+	if (result != data::SetResult::NotStored) {
+		nvm::commit();
+	}
+	return result != data::SetResult::Pending;
+}
+
+static void endpoint2Handler() {
+	sendingBuffer = NO_BUFFER;
+
+	if (queuedBuffer != NO_BUFFER) {
+		startStreamTransfer(queuedBuffer);
+		queuedBuffer = NO_BUFFER;
+	}
+}
+
+static void startStreamTransfer(uint8_t buffer) {
+	sendingBuffer = buffer;
+	EPDESCTBL[2].DEVICE_DESC_BANK[1].USB_ADDR = reinterpret_cast<uint32_t>(streamBuffers[buffer]);
+	EPDESCTBL[2].DEVICE_DESC_BANK[1].USB_PCKSIZE = USB_DEVICE_PCKSIZE_BYTE_COUNT(streamLengths[buffer])
+	                                             | USB_DEVICE_PCKSIZE_SIZE(0x3) | USB_DEVICE_PCKSIZE_AUTO_ZLP(1);
+	USB_REGS->DEVICE.DEVICE_ENDPOINT[2].USB_EPSTATUSSET = USB_DEVICE_EPSTATUS_BK1RDY(1);
+}
+
 static void enableEndpoints(uint8_t configurationNumber) {
 	USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPCFG =
 	    USB_DEVICE_EPCFG_EPTYPE0(0x4)     // Configure endpoint 1 bank 0 as interrupt out
@@ -248,6 +272,13 @@ static void enableEndpoints(uint8_t configurationNumber) {
 	USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPINTENSET = USB_DEVICE_EPINTENSET_TRCPT0(1)  // Enable OUT endpoint interrupt
 	                                                   | USB_DEVICE_EPINTENSET_TRCPT1(1);  // Enable IN endpoint interrupt
 
+	USB_REGS->DEVICE.DEVICE_ENDPOINT[2].USB_EPCFG = USB_DEVICE_EPCFG_EPTYPE1(0x3);  // Configure endpoint 2 bank 1 as bulk in
+	USB_REGS->DEVICE.DEVICE_ENDPOINT[2].USB_EPINTENSET = USB_DEVICE_EPINTENSET_TRCPT1(1);  // Enable IN endpoint interrupt
+	sendingBuffer = NO_BUFFER;
+	queuedBuffer = NO_BUFFER;
+	subscription.period = 0;
+	requestPending = false;
+
 	writeDefault(reinterpret_cast<const uint8_t*>(&data::usbStatusResponse), sizeof(data::USBStatusResponse));
 }
 
@@ -292,6 +323,60 @@ void usb::write(const uint8_t* data, uint8_t len) {
 	USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPSTATUSSET = USB_DEVICE_EPSTATUS_BK1RDY(1);
 }
 
+void usb::update() {
+	if (!requestPending) {
+		return;
+	}
+
+	NVIC_DisableIRQ(USB_IRQn);
+	if (requestPending && setRequestedVariables()) {
+		requestPending = false;
+		EPDESCTBL[1].DEVICE_DESC_BANK[0].USB_PCKSIZE =
+		    USB_DEVICE_PCKSIZE_MULTI_PACKET_SIZE(sizeof(EP1REQ)) | USB_DEVICE_PCKSIZE_SIZE(0x3);
+		USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPSTATUSCLR = USB_DEVICE_EPSTATUS_BK0RDY(1);
+	}
+	NVIC_EnableIRQ(USB_IRQn);
+}
+
+void usb::stream() {
+	PROFILE_ZONE("usb");
+
+	uint32_t now {util::getMicros()};
+	if (!data::streamDue(subscription, now)) {
+		return;
+	}
+
+	uint8_t buffer {0};
+	while (buffer == sendingBuffer || buffer == queuedBuffer) {
+		if (++buffer > 1) {  // Both buffers are waiting for the host, dropping the frame
+			++subscription.sequence;
+			return;
+		}
+	}
+
+	auto*   frame {new (streamBuffers[buffer]) data::USBStreamFrame {}};
+	uint8_t position {sizeof(data::USBStreamFrame)};
+
+	frame->count = subscription.count;
+	frame->sequence = subscription.sequence++;
+	frame->time = now;
+
+	for (uint8_t i {0}; i < subscription.count; ++i) {
+		const data::Variable* variable {data::getVariable(subscription.variableIDs[i])};
+		data::readVariable(variable, 0, variable->size, streamBuffers[buffer] + position);
+		position += variable->size;
+	}
+	streamLengths[buffer] = position;
+
+	NVIC_DisableIRQ(USB_IRQn);
+	if (sendingBuffer == NO_BUFFER) {
+		startStreamTransfer(buffer);
+	} else {
+		queuedBuffer = buffer;
+	}
+	NVIC_EnableIRQ(USB_IRQn);
+}
+
 void usb::read(uint8_t* data, uint8_t len) {
 	// memcpy(data, outBuf1, MIN(len, sizeof (outBuf1)));
 	USB_REGS->DEVICE.DEVICE_ENDPOINT[1].USB_EPSTATUSCLR = USB_DEVICE_EPSTATUS_BK0RDY(1);
@@ -39,24 +39,34 @@ usb::usb_descriptor_endpoint endpoint2 = {
 };
 
 
+usb::usb_descriptor_endpoint endpoint3 = {
+  .bLength = 7,
+  .bDescriptorType = (uint8_t)usb::DESCRIPTOR_TYPE::ENDPOINT,
+  .bEndpointAddress = 0x82,
+  .bmAttributes = 0x2,
+  .wMaxPacketSize = 64,
+  .bInterval = 0
+};
+
+
 usb::usb_descriptor_interface interface0 = {
   .bLength = 9,
   .bDescriptorType = (uint8_t)usb::DESCRIPTOR_TYPE::INTERFACE,
   .bInterfaceNumber = 0,
   .bAlternateSetting = 0,
-  .bNumEndpoints = 2,
+  .bNumEndpoints = 3,
   .bInterfaceClass = 0xff,
   .bInterfaceSubclass = 0xff,
   .bInterfaceProtocol = 0,
   .iInterface = 0,
-  .ENDPOINTS = {endpoint1, endpoint2}
+  .ENDPOINTS = {endpoint1, endpoint2, endpoint3}
 };
 
 
 usb::usb_descriptor_configuration usb::DESCRIPTOR_CONFIGURATION[] = {
   {.bLength = 9,
    .bDescritptorType = (uint8_t)usb::DESCRIPTOR_TYPE::CONFIGURATION,
-   .wTotalLength = 32,
+   .wTotalLength = 39,
    .bNumInterfaces = 1,
    .bConfigurationValue = 1,
    .iConfiguration = 0,
@@ -1,15 +1,32 @@
 #include "util.hpp"
 
 
-static uint32_t ticks {0};
+constexpr static uint8_t LED_PIN {27};
+
+/* The time is kept by TC0 and TC1 chained into a 32-bit counter running at 1MHz,
+ * the overflow interrupt extends it to 64 bits. The compare channel wakes the CPU up from sleepUntil().
+ */
+static volatile uint32_t overflows {0};
+static uint32_t          sleepTime {0};
 
 
 extern "C" {
-	void SysTick_Handler() {
-		++ticks;
+	void TC0_Handler() {
+		uint8_t flags = TC0_REGS->COUNT32.TC_INTFLAG;
+
+		TC0_REGS->COUNT32.TC_INTFLAG = flags;
+		if (flags & TC_INTFLAG_OVF_Msk) {
+			++overflows;
+		}
 	}
 }
 
+static uint32_t readCounter() {
+	TC0_REGS->COUNT32.TC_CTRLBSET = TC_CTRLBSET_CMD_READSYNC;
+	while (TC0_REGS->COUNT32.TC_SYNCBUSY & TC_SYNCBUSY_CTRLB_Msk);
+	return TC0_REGS->COUNT32.TC_COUNT;
+}
+
 void util::init() {
 	uint32_t calibration = *((uint32_t*)0x00806020);
 
@@ -26,6 +43,8 @@ void util::init() {
 	// PM setup
 	PM_REGS->PM_PLCFG = PM_PLCFG_PLSEL_PL2;                 // Enter PL2
 	while (!(PM_REGS->PM_INTFLAG & PM_INTFLAG_PLRDY_Msk));  // Wait for the transition to complete
+	PM_REGS->PM_SLEEPCFG = PM_SLEEPCFG_SLEEPMODE_IDLE;      // Stop the CPU and bus clocks in sleep
+	while (PM_REGS->PM_SLEEPCFG != PM_SLEEPCFG_SLEEPMODE_IDLE);
 
 	// OSCCTRL setup
 	OSCCTRL_REGS->OSCCTRL_OSC16MCTRL = OSCCTRL_OSC16MCTRL_ENABLE(1)  // Enable OSC16M
@@ -45,22 +64,26 @@ void util::init() {
 	                           | GCLK_GENCTRL_DIVSEL_DIV2   // Set division mode (2^(x+1))
 	                           | GCLK_GENCTRL_DIV(5);       // Divide by 64 (2^(5+1))
 
-	// SysTick setup
-	SysTick_Config(48000);
+	// PORT config
+	PORT_REGS->GROUP[0].PORT_DIRSET = 0x1 << LED_PIN;
+
+	// GCLK config
+	GCLK_REGS->GCLK_PCHCTRL[TC0_GCLK_ID] = GCLK_PCHCTRL_CHEN(1)     // Enable TC[0:1] clock
+	                                     | GCLK_PCHCTRL_GEN_GCLK1;  // Set GCLK1 as a clock source
+
+	// TC config
+	TC0_REGS->COUNT32.TC_CTRLA = 0;  // Disable TC to change enable-protected settings
+	while (TC0_REGS->COUNT32.TC_SYNCBUSY & TC_SYNCBUSY_ENABLE_Msk);
+	TC0_REGS->COUNT32.TC_CTRLA = TC_CTRLA_MODE_COUNT32      // Chain TC1 as the upper half
+	                           | TC_CTRLA_PRESCALER_DIV16;  // 1MHz from GCLK1
+	TC0_REGS->COUNT32.TC_INTENSET = TC_INTENSET_OVF(1);     // Enable overflow interrupt
+	TC0_REGS->COUNT32.TC_CTRLA |= TC_CTRLA_ENABLE(1);       // Enable TC
+	while (TC0_REGS->COUNT32.TC_SYNCBUSY & TC_SYNCBUSY_ENABLE_Msk);
 
 	// NVIC setup
 	__DMB();
 	__enable_irq();
-	NVIC_EnableIRQ(SysTick_IRQn);
-
-	// ADC setup
-	GCLK_REGS->GCLK_PCHCTRL[30] = GCLK_PCHCTRL_CHEN(1)     // Enable ADC clock
-	                            | GCLK_PCHCTRL_GEN_GCLK2;  // Set GCLK2 as a clock source
-	ADC_REGS->ADC_REFCTRL = ADC_REFCTRL_REFSEL_INTREF;     // Set ADC reference voltage
-	ADC_REGS->ADC_INPUTCTRL = ADC_INPUTCTRL_MUXNEG_GND     // Set GND as negative input
-	                        | ADC_INPUTCTRL_MUXPOS_TEMP;   // Set temperature sensor as positive input
-	ADC_REGS->ADC_INTENSET = ADC_INTFLAG_RESRDY(1);        // Enable result ready interrupt
-	ADC_REGS->ADC_CTRLA = ADC_CTRLA_ENABLE(1);             // Enable ADC
+	NVIC_EnableIRQ(TC0_IRQn);
 }
 
 // Fast inverse square root
@@ -80,13 +103,85 @@ float util::invSqrt(float x) {
 }
 
 uint32_t util::getTime() {
-	return ticks;
+	return getMicros64() / 1000;
+}
+
+uint32_t util::getMicros() {
+	uint32_t primask {__get_PRIMASK()};  // Also called from interrupts, the read sequence must not be interleaved
+
+	__disable_irq();
+	uint32_t time {readCounter()};
+	__set_PRIMASK(primask);
+	return time;
+}
+
+uint64_t util::getMicros64() {
+	uint32_t primask {__get_PRIMASK()};
+
+	__disable_irq();
+	uint32_t high {overflows};
+	uint32_t low {readCounter()};
+	// Overflowed before the read but not counted yet, a low value tells it apart from an overflow right after it
+	if (TC0_REGS->COUNT32.TC_INTFLAG & TC_INTFLAG_OVF_Msk && low < 0x80000000) {
+		++high;
+	}
+	__set_PRIMASK(primask);
+
+	return static_cast<uint64_t>(high) << 32u | low;
 }
 
 void util::sleep(uint32_t ms) {
-	uint32_t t {ticks + ms};
+	sleepUntil(getMicros() + ms * 1000);
+}
 
-	while (ticks < t) {
+void util::sleepUntil(uint32_t us) {
+	TC0_REGS->COUNT32.TC_CC[0] = us;
+	while (TC0_REGS->COUNT32.TC_SYNCBUSY & TC_SYNCBUSY_CC0_Msk);
+	TC0_REGS->COUNT32.TC_INTFLAG = TC_INTFLAG_MC0_Msk;
+	TC0_REGS->COUNT32.TC_INTENSET = TC_INTENSET_MC0(1);
+
+	// Checked with interrupts disabled so the match can't come between the check and the sleep,
+	// a pending interrupt still wakes the CPU up and is handled once they are enabled again
+	while (true) {
+		__disable_irq();
+		uint32_t start {getMicros()};
+		if (static_cast<int32_t>(start - us) >= 0) {
+			__enable_irq();
+			break;
+		}
 		__WFI();
+		sleepTime += getMicros() - start;  // Before the interrupt handlers run, they are not counted as sleep
+		__enable_irq();
 	}
+
+	TC0_REGS->COUNT32.TC_INTENCLR = TC_INTENCLR_MC0(1);
+}
+
+void util::setLED(bool on) {
+	if (on) {
+		PORT_REGS->GROUP[0].PORT_OUTSET = 0x1 << LED_PIN;
+	} else {
+		PORT_REGS->GROUP[0].PORT_OUTCLR = 0x1 << LED_PIN;
+	}
+}
+
+void util::startWatchdog() {
+	WDT_REGS->WDT_CONFIG = WDT_CONFIG_PER_CYC64;
+	WDT_REGS->WDT_CTRLA = WDT_CTRLA_ENABLE(1);
+}
+
+void util::clearWatchdog() {
+	WDT_REGS->WDT_CLEAR = WDT_CLEAR_CLEAR_KEY;
+}
+
+uint32_t util::getSleepTime() {
+	return sleepTime;
+}
+
+bool util::reached(uint32_t deadline) {
+	return static_cast<int32_t>(getMicros() - deadline) >= 0;
+}
+
+uint32_t util::elapsedSince(uint32_t us) {
+	return getMicros() - us;
 }
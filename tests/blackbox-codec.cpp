@@ -0,0 +1,248 @@
+/*
+ * File:   blackbox-codec.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 7:10 AM
+ */
+
+/* Blackbox frames encoded and decoded back, also after corrupted bytes and with frames made as large as possible.
+ * The frames are made up like those of a flight at 200Hz: noisy sensors, slowly changing attitude and sticks,
+ * outputs and timings that vary by a few LSB between the runs. Also reports the compression ratio for them
+ * and how long encoding and decoding a frame takes.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "BlackboxCodec.hpp"
+#include "test.hpp"
+
+constexpr static uint16_t FRAME_NUMBER {2000};  // 10s at 200Hz
+
+static uint32_t          seed {2026};
+static volatile uint32_t sink {0};  // Keeps the measured calls from being optimized away
+
+static uint32_t nextRandom() {
+	seed ^= seed << 13u;
+	seed ^= seed >> 17u;
+	seed ^= seed << 5u;
+	return seed;
+}
+
+// Uniform noise of up to the amplitude either way
+static int16_t noise(int16_t amplitude) {
+	return static_cast<int16_t>(nextRandom() % (2 * amplitude + 1)) - amplitude;
+}
+
+static std::vector<BlackboxFrame> makeFlight() {
+	std::vector<BlackboxFrame> frames(FRAME_NUMBER);
+
+	for (uint16_t i {0}; i < FRAME_NUMBER; ++i) {
+		BlackboxFrame& frame {frames[i]};
+		float          t = i * 0.005f;
+
+		frame.time = 1200 + i * 5;
+		frame.loopTime = 640 + noise(20);
+		frame.status = 0x1;
+		frame.accelerations[0] = 2048 + noise(30);
+		frame.accelerations[1] = std::sin(t) * 300 + noise(30);
+		frame.accelerations[2] = std::cos(t) * 200 + noise(30);
+		for (uint8_t j {0}; j < 3; ++j) {
+			frame.angularRates[j] = noise(40);
+		}
+		frame.attitude[0] = t * 500;
+		frame.attitude[1] = std::sin(t * 0.7f) * 2000;
+		frame.attitude[2] = std::cos(t * 0.5f) * 3000;
+		for (uint8_t j {0}; j < 16; ++j) {  // Sticks on the first four channels, switches on the others
+			frame.channels[j] = j < 4 ? std::sin(t * (j + 1) * 0.3f) * 600 + noise(2) : (j % 3) * 1000 - 1000;
+		}
+		for (uint8_t j {0}; j < 3; ++j) {
+			frame.pidTerms[j][0] = frame.attitude[j] / 4 + noise(40);
+			frame.pidTerms[j][1] = frame.attitude[j] / 16;
+			frame.pidTerms[j][2] = noise(80);
+		}
+		for (uint8_t j {0}; j < 8; ++j) {
+			frame.outputs[j] = j < 4 ? frame.pidTerms[j % 3][0] + frame.channels[j] / 2 : 0;
+		}
+		for (uint8_t j {0}; j < 6; ++j) {
+			frame.taskTimes[j] = 60 * (j + 1) + noise(6);
+		}
+		frame.intervals[0] = 5000 + noise(8);
+		frame.intervals[1] = 5000 + noise(8);
+	}
+	return frames;
+}
+
+static std::vector<uint8_t> encode(const std::vector<BlackboxFrame>& frames) {
+	BlackboxEncoder      encoder {};
+	std::vector<uint8_t> log {};
+	uint8_t              buffer[BlackboxCodec::maxFrameSize];
+
+	for (const auto& frame : frames) {
+		uint8_t length {encoder.encode(frame, buffer)};
+		log.insert(log.end(), buffer, buffer + length);
+	}
+	return log;
+}
+
+static bool sameFrame(const BlackboxFrame& a, const BlackboxFrame& b) {
+	return !std::memcmp(&a, &b, sizeof(BlackboxFrame));
+}
+
+// Decodes the log from the start, returns the number of frames matching the ones from the position on
+static uint16_t decode(const std::vector<uint8_t>& log, const std::vector<BlackboxFrame>& frames, uint16_t first) {
+	BlackboxDecoder decoder {};
+	size_t          position {0};
+	uint16_t        matching {0};
+
+	for (uint16_t i {first}; i < frames.size() && position < log.size(); ++i) {
+		size_t used {decoder.decode(log.data() + position, log.size() - position)};
+
+		if (!used || !sameFrame(decoder.getFrame(), frames[i])) {
+			break;
+		}
+		position += used;
+		++matching;
+	}
+	return matching;
+}
+
+static void checkRoundTrip(const std::vector<BlackboxFrame>& frames) {
+	std::vector<uint8_t> log {encode(frames)};
+
+	CHECK(decode(log, frames, 0) == frames.size());
+	CHECK(BlackboxDecoder::isKeyframe(log.data(), log.size()));
+
+	// Keyframes every keyframeInterval frames
+	uint16_t keyframes {0};
+	for (size_t position {0}; position < log.size(); ++position) {
+		position += BlackboxDecoder::findKeyframe(log.data() + position, log.size() - position);
+		keyframes += position < log.size();
+	}
+	CHECK(keyframes == (frames.size() + BlackboxCodec::keyframeInterval - 1) / BlackboxCodec::keyframeInterval);
+
+	// Truncated frames are not decoded
+	BlackboxDecoder decoder {};
+	CHECK(!decoder.decode(log.data(), 20));
+	CHECK(!decoder.synchronized());
+	CHECK(!decoder.decode(log.data() + 1, log.size() - 1));  // Delta frames need a keyframe first
+}
+
+// A flipped byte stops the decoder until the next keyframe, from where it decodes the rest again
+static void checkCorruption(const std::vector<BlackboxFrame>& frames) {
+	std::vector<uint8_t> log {encode(frames)};
+	BlackboxEncoder      encoder {};
+	uint8_t              buffer[BlackboxCodec::maxFrameSize];
+	size_t               position {0};
+
+	for (uint16_t i {0}; i < 40; ++i) {  // Into the second run of delta frames
+		position += encoder.encode(frames[i], buffer);
+	}
+	log[position + 3] ^= 0x5a;
+
+	BlackboxDecoder decoder {};
+	size_t          decoded {0};
+	uint16_t        frame {0};
+	for (size_t used {1}; decoded < position && used; ++frame) {
+		used = decoder.decode(log.data() + decoded, log.size() - decoded);
+		decoded += used;
+	}
+	CHECK(frame == 40);
+
+	size_t used {decoder.decode(log.data() + decoded, log.size() - decoded)};
+	bool   matched {used && sameFrame(decoder.getFrame(), frames[40])};
+	CHECK(!matched);  // Either invalid or decoded wrong, the CRC only covers keyframes
+
+	size_t keyframe {decoded + BlackboxDecoder::findKeyframe(log.data() + decoded, log.size() - decoded)};
+	std::vector<uint8_t> rest(log.begin() + keyframe, log.end());
+	CHECK(keyframe < log.size());
+	uint16_t resumed {2 * BlackboxCodec::keyframeInterval};
+	CHECK(decode(rest, frames, resumed) == frames.size() - resumed);
+
+	// A corrupted keyframe is skipped by its CRC
+	log = encode(frames);
+	log[10] ^= 0x01;
+	CHECK(!BlackboxDecoder::isKeyframe(log.data(), log.size()));
+	CHECK(BlackboxDecoder::findKeyframe(log.data(), log.size()) > 0);
+}
+
+static void checkRestart(const std::vector<BlackboxFrame>& frames) {
+	BlackboxEncoder encoder {};
+	uint8_t         buffer[BlackboxCodec::maxFrameSize];
+
+	encoder.encode(frames[0], buffer);
+	encoder.encode(frames[1], buffer);
+	CHECK(buffer[0] == BlackboxCodec::deltaType);
+	encoder.restart();
+	uint8_t length {encoder.encode(frames[2], buffer)};
+	CHECK(BlackboxDecoder::isKeyframe(buffer, length));
+
+	// Decoding resumes from the restart alone
+	BlackboxDecoder decoder {};
+	CHECK(decoder.decode(buffer, length) == length);
+	CHECK(sameFrame(decoder.getFrame(), frames[2]));
+}
+
+// Every word at or changing by half the range takes three bytes, the most a frame can take
+static void checkLargestFrames() {
+	std::vector<BlackboxFrame> frames(4);
+
+	for (uint16_t i {0}; i < frames.size(); ++i) {
+		auto* words {reinterpret_cast<uint16_t*>(&frames[i])};
+		for (uint8_t j {0}; j < BlackboxCodec::wordNumber; ++j) {
+			words[j] = i % 2 ? 0x0000 : 0x8000;
+		}
+	}
+
+	BlackboxEncoder encoder {};
+	uint8_t         buffer[BlackboxCodec::maxFrameSize + 16];
+	uint8_t         largest {0};
+	for (const auto& frame : frames) {
+		largest = std::max(largest, encoder.encode(frame, buffer));
+	}
+	CHECK(largest == BlackboxCodec::maxFrameSize);
+	CHECK(decode(encode(frames), frames, 0) == frames.size());
+}
+
+static void measure(const std::vector<BlackboxFrame>& frames) {
+	std::vector<uint8_t> log {encode(frames)};
+	double               ratio {static_cast<double>(frames.size() * sizeof(BlackboxFrame)) / log.size()};
+
+	std::printf(
+	    "Flight frames: %.1f of %zu bytes on average, compression ratio %.2f\n",
+	    static_cast<double>(log.size()) / frames.size(),
+	    sizeof(BlackboxFrame),
+	    ratio
+	);
+	CHECK(ratio > 1.5);  // About 1.9, the same as for the logs of the simulator
+
+	BlackboxEncoder encoder {};
+	uint8_t         buffer[BlackboxCodec::maxFrameSize];
+	uint16_t        next {0};
+	double          encodes {test::measure([&]() {
+		sink = sink + encoder.encode(frames[next], buffer);
+		next = (next + 1) % frames.size();
+	})};
+
+	BlackboxDecoder decoder {};
+	size_t          position {0};
+	double          decodes {test::measure([&]() {
+		size_t used {decoder.decode(log.data() + position, log.size() - position)};
+		position = used ? position + used : 0;  // Starts over at the end, from the first keyframe
+	})};
+
+	std::printf("Encoding: %.0f ns per frame, decoding: %.0f ns per frame\n", 1e9 / encodes, 1e9 / decodes);
+}
+
+int main() {
+	std::vector<BlackboxFrame> frames {makeFlight()};
+
+	checkRoundTrip(frames);
+	checkCorruption(frames);
+	checkRestart(frames);
+	checkLargestFrames();
+	measure(frames);
+
+	return test::finish("blackbox-codec");
+}
@@ -0,0 +1,322 @@
+/*
+ * File:   companion-link.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 8:10 AM
+ */
+
+/* The companion protocol over a pseudo terminal, in real time. The firmware side is a process of its own that opens
+ * the terminal as UART2 and updates the link at the 100Hz of the telemetry group, this process is the companion
+ * computer on the other end of the terminal. Checks the replies to requests, setting a variable and reading it back,
+ * resynchronizing after a corrupted frame, decoding a command that arrives while the last one is being handled
+ * and streaming subscribed variables without losing frames.
+ * Also reports the round trip time of a request, which is mostly the wait for the next update, and the throughput
+ * of the stream.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "companion.hpp"
+#include "host.hpp"
+#include "nvm.hpp"
+#include "test.hpp"
+
+constexpr static uint32_t PERIOD {10000};  // us, the telemetry group
+constexpr static uint16_t REQUEST_NUMBER {200};
+constexpr static uint32_t REPLY_TIMEOUT {100};  // ms
+constexpr static uint16_t STREAM_RATE {100};    // Frames per second, as fast as the group runs
+constexpr static uint32_t STREAM_TIME {2000};   // ms
+
+using Clock = std::chrono::steady_clock;
+
+static const data::VariableID streamed[] {
+  data::VariableID::Status,
+  data::VariableID::Inputs,
+  data::VariableID::Outputs
+};
+constexpr static uint8_t STREAMED_NUMBER {sizeof(streamed) / sizeof(streamed[0])};
+
+static int              terminal {-1};  // Master side, the companion computer
+static CompanionDecoder decoder {};
+static uint8_t          received[256] {};
+static uint16_t         receivedLength {0};
+static uint16_t         receivedPosition {0};
+
+// The firmware as far as the link is concerned, runs until it is killed
+static void runFirmware(const char* port) {
+	util::init();
+	nvm::load();
+	if (!host::openUART(2, port)) {
+		std::perror(port);
+		std::_Exit(2);
+	}
+	companion::init();
+
+	for (uint32_t next {util::getMicros()};; next += PERIOD) {
+		companion::update();
+		util::sleepUntil(next + PERIOD);
+	}
+}
+
+static void sendFrame(const uint8_t* frame, uint8_t length) {
+	for (uint8_t sent {0}; sent < length;) {
+		ssize_t written {write(terminal, frame + sent, length - sent)};
+
+		if (written <= 0) {
+			std::perror("companion-link");
+			std::exit(2);
+		}
+		sent += written;
+	}
+}
+
+static void sendCommand(data::CommandType type, uint8_t value, const uint8_t* src = nullptr, uint8_t length = 0) {
+	CompanionEncoder encoder {};
+	uint8_t          frame[CompanionCodec::maxFrameSize];
+
+	encoder.begin(frame);
+	encoder.append(static_cast<uint8_t>(type));
+	encoder.append(value);
+	encoder.append(src, length);
+	sendFrame(frame, encoder.finish());
+}
+
+// Returns false if no message is received within the timeout, the message is then in the decoder
+static bool receiveMessage(uint32_t timeout) {
+	Clock::time_point deadline {Clock::now() + std::chrono::milliseconds(timeout)};
+
+	while (true) {
+		while (receivedPosition < receivedLength) {
+			if (decoder.process(received[receivedPosition++])) {
+				return true;
+			}
+		}
+
+		auto remaining {std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count()};
+		if (remaining <= 0) {
+			return false;
+		}
+
+		pollfd fd {terminal, POLLIN, 0};
+		if (poll(&fd, 1, remaining) <= 0) {
+			continue;
+		}
+
+		ssize_t length {read(terminal, received, sizeof(received))};
+		receivedLength = length > 0 ? length : 0;
+		receivedPosition = 0;
+	}
+}
+
+// Waits until the firmware had the time to handle a command that has no reply
+static void waitForUpdate() {
+	usleep(3 * PERIOD);
+}
+
+static uint8_t sizeOf(data::VariableID id) {
+	return data::getVariable(static_cast<uint8_t>(id))->size;
+}
+
+static bool isVariable(data::VariableID id) {
+	const uint8_t* message {decoder.getMessage()};
+
+	return decoder.getLength() == sizeOf(id) && message[0] == static_cast<uint8_t>(data::ResponseType::ReturnVariable)
+	    && message[1] == static_cast<uint8_t>(id);
+}
+
+static void checkRequests() {
+	uint32_t roundTrips[REQUEST_NUMBER] {};
+	uint16_t replies {0};
+
+	for (uint16_t i {0}; i < REQUEST_NUMBER; ++i) {
+		usleep(rand() % PERIOD);  // At any point of the period, not always right after the last update
+
+		Clock::time_point start {Clock::now()};
+
+		sendCommand(data::CommandType::GetVariable, static_cast<uint8_t>(data::VariableID::Status));
+		if (!receiveMessage(REPLY_TIMEOUT)) {
+			continue;
+		}
+		roundTrips[replies++] = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+		CHECK(isVariable(data::VariableID::Status));
+	}
+	CHECK(replies == REQUEST_NUMBER);
+
+	if (replies) {
+		std::sort(roundTrips, roundTrips + replies);
+		std::printf(
+		    "Round trip of a request: %u us at least, %u us median, %u us at most\n",
+		    roundTrips[0],
+		    roundTrips[replies / 2],
+		    roundTrips[replies - 1]
+		);
+	}
+}
+
+static void checkSetVariable() {
+	int16_t trims[data::outputChannelNumber] {12, -34, 56, -78, 90, -12, 34, -56};
+
+	sendCommand(
+	    data::CommandType::SetVariable,
+	    static_cast<uint8_t>(data::VariableID::Trims),
+	    reinterpret_cast<const uint8_t*>(trims),
+	    sizeof(trims)
+	);
+	waitForUpdate();
+
+	sendCommand(data::CommandType::GetVariable, static_cast<uint8_t>(data::VariableID::Trims));
+	if (CHECK(receiveMessage(REPLY_TIMEOUT)) && CHECK(isVariable(data::VariableID::Trims))) {
+		CHECK(!std::memcmp(decoder.getMessage() + data::variableHeaderSize, trims, sizeof(trims)));
+	}
+}
+
+// A corrupted command is dropped by its CRC, the next one is handled again
+static void checkResynchronization() {
+	CompanionEncoder encoder {};
+	uint8_t          frame[CompanionCodec::maxFrameSize];
+	uint8_t          command[2] {
+	  static_cast<uint8_t>(data::CommandType::GetVariable),
+	  static_cast<uint8_t>(data::VariableID::Status)
+	};
+
+	encoder.begin(frame);
+	encoder.append(command, sizeof(command));
+	uint8_t length {encoder.finish()};
+	frame[2] ^= 0x10;
+	sendFrame(frame, length);
+	sendFrame(frame + 1, 3);  // A partial frame, ended by the delimiter of the next one
+	CHECK(!receiveMessage(3 * PERIOD / 1000));
+
+	sendCommand(data::CommandType::GetVariable, static_cast<uint8_t>(data::VariableID::Status));
+	CHECK(receiveMessage(REPLY_TIMEOUT) && isVariable(data::VariableID::Status));
+}
+
+// A command that starts in the same read as the last one and ends after it is handled is decoded in full
+static void checkSplitCommand() {
+	CompanionEncoder encoder {};
+	uint8_t          frames[2 * CompanionCodec::maxFrameSize];
+	uint8_t          command[2] {static_cast<uint8_t>(data::CommandType::GetVariable)};
+
+	command[1] = static_cast<uint8_t>(data::VariableID::Status);
+	encoder.begin(frames);
+	encoder.append(command, sizeof(command));
+	uint8_t first {encoder.finish()};
+
+	command[1] = static_cast<uint8_t>(data::VariableID::Trims);
+	encoder.begin(frames + first);
+	encoder.append(command, sizeof(command));
+	uint8_t length {static_cast<uint8_t>(first + encoder.finish())};
+
+	sendFrame(frames, first + 3);
+	CHECK(receiveMessage(REPLY_TIMEOUT) && isVariable(data::VariableID::Status));
+	waitForUpdate();
+	sendFrame(frames + first + 3, length - first - 3);
+	CHECK(receiveMessage(REPLY_TIMEOUT) && isVariable(data::VariableID::Trims));
+}
+
+static void checkStream() {
+	data::USBSubscribeRequest request {STREAM_RATE, {}};
+	uint8_t                   frameSize {sizeof(data::USBStreamFrame)};
+
+	for (uint8_t i {0}; i < STREAMED_NUMBER; ++i) {
+		request.variableIDs[i] = static_cast<uint8_t>(streamed[i]);
+		frameSize += sizeOf(streamed[i]);
+	}
+	sendCommand(
+	    data::CommandType::Subscribe,
+	    STREAMED_NUMBER,
+	    reinterpret_cast<const uint8_t*>(&request),
+	    sizeof(request.rate) + STREAMED_NUMBER
+	);
+
+	uint32_t          frames {0};
+	uint32_t          bytes {0};
+	uint16_t          gaps {0};
+	uint16_t          sequence {0};
+	Clock::time_point start {Clock::now()};
+	Clock::time_point end {start + std::chrono::milliseconds(STREAM_TIME)};
+
+	while (Clock::now() < end && receiveMessage(REPLY_TIMEOUT)) {
+		const uint8_t* message {decoder.getMessage()};
+		auto*          header {reinterpret_cast<const data::USBStreamFrame*>(message)};
+
+		bool           isFrame {header->responseType == static_cast<uint8_t>(data::ResponseType::StreamFrame)};
+
+		if (!CHECK(isFrame && decoder.getLength() == frameSize)) {
+			break;
+		}
+		CHECK(header->count == STREAMED_NUMBER);
+		CHECK(message[sizeof(data::USBStreamFrame) + 1] == static_cast<uint8_t>(streamed[0]));
+
+		gaps += frames && header->sequence != static_cast<uint16_t>(sequence + 1);
+		sequence = header->sequence;
+		++frames;
+		bytes += frameSize;
+	}
+
+	double elapsed {std::chrono::duration<double>(Clock::now() - start).count()};
+	std::printf(
+	    "Stream: %u frames of %u bytes in %.1f s, %.0f frames/s, %.0f bytes/s, %u lost\n",
+	    frames,
+	    frameSize,
+	    elapsed,
+	    frames / elapsed,
+	    bytes / elapsed,
+	    gaps
+	);
+	CHECK(frames > STREAM_RATE * STREAM_TIME / 1000 / 2);  // Leaves room for a busy machine
+	CHECK(!gaps);
+
+	// Stops streaming, frames already sent are read first
+	request.rate = 0;
+	sendCommand(data::CommandType::Subscribe, 0, reinterpret_cast<const uint8_t*>(&request), sizeof(request.rate));
+	while (receiveMessage(3 * PERIOD / 1000));
+	CHECK(!receiveMessage(3 * PERIOD / 1000));
+}
+
+int main() {
+	terminal = posix_openpt(O_RDWR | O_NOCTTY);
+	if (terminal < 0 || grantpt(terminal) || unlockpt(terminal)) {
+		std::perror("companion-link");
+		return 2;
+	}
+
+	// Raw before either side writes, otherwise the line discipline echoes and translates the bytes
+	const char* port {ptsname(terminal)};
+	int         slave {open(port, O_RDWR | O_NOCTTY)};
+	termios     settings {};
+	if (slave < 0 || tcgetattr(slave, &settings)) {
+		std::perror(port);
+		return 2;
+	}
+	cfmakeraw(&settings);
+	tcsetattr(slave, TCSANOW, &settings);
+
+	std::fflush(stdout);
+	pid_t pid {fork()};
+	if (!pid) {
+		runFirmware(port);
+	}
+
+	checkRequests();
+	checkSetVariable();
+	checkResynchronization();
+	checkSplitCommand();
+	checkStream();
+	CHECK(decoder.getStatistics().errors == 0);
+
+	kill(pid, SIGKILL);
+	waitpid(pid, nullptr, 0);
+	close(slave);
+	close(terminal);
+	return test::finish("companion-link");
+}
@@ -0,0 +1,163 @@
+/*
+ * File:   dshot-codec.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 4:50 AM
+ */
+
+/* DShot frames against the bit patterns of the protocol description, and telemetry replies built here the way
+ * an ESC sends them, down to the samples of the pin. Also reports how long building the frames of all motors
+ * and decoding their replies takes.
+ */
+
+#include <vector>
+
+#include "DShotCodec.hpp"
+#include "test.hpp"
+
+constexpr static uint16_t SAMPLE_COUNT {128};  // Same as the driver
+constexpr static uint8_t  PIN {5};
+
+constexpr static uint8_t gcrEncode[16] {
+  0x19, 0x1b, 0x12, 0x13, 0x1d, 0x15, 0x16, 0x17, 0x1a, 0x09, 0x0a, 0x0b, 0x1e, 0x0d, 0x0e, 0x0f
+};
+
+// 12-bit period value and its CRC, GCR-encoded with the start bit on top, every 1 is an edge on the line
+static uint32_t encodeReply(uint16_t periodValue) {
+	uint16_t crc = ~(periodValue ^ (periodValue >> 4u) ^ (periodValue >> 8u)) & 0xf;
+	uint16_t payload = periodValue << 4u | crc;
+	uint32_t value {0x1u << 20u};
+
+	for (uint8_t i {0}; i < 4; ++i) {
+		value |= static_cast<uint32_t>(gcrEncode[payload >> (i * 4u) & 0xf]) << (i * 5u);
+	}
+	return value;
+}
+
+// Samples of the pin at 3x the bit rate, the line idles high before and after the reply, other pins toggle
+static std::vector<uint16_t> sampleReply(uint32_t value, uint16_t idle) {
+	std::vector<uint16_t> samples(SAMPLE_COUNT);
+	bool                  level {true};
+	uint16_t              position {0};
+
+	for (; position < idle; ++position) {
+		samples[position] = 0x1u << PIN;
+	}
+	for (int8_t bit {DShotCodec::telemetryBits - 1}; bit >= 0; --bit) {
+		level ^= value >> bit & 0x1;
+		for (uint8_t i {0}; i < 3; ++i, ++position) {
+			samples[position] = level << PIN;
+		}
+	}
+	for (; position < SAMPLE_COUNT; ++position) {
+		samples[position] = 0x1u << PIN;
+	}
+
+	for (uint16_t i {0}; i < SAMPLE_COUNT; ++i) {
+		samples[i] |= (i & 0x1) << (PIN + 1) | (i % 5 == 0) << (PIN - 1);
+	}
+	return samples;
+}
+
+static bool decodeSamples(const std::vector<uint16_t>& samples, uint32_t& eRPM) {
+	return DShotCodec::decodeTelemetry(DShotCodec::extractTelemetry(samples.data(), SAMPLE_COUNT, PIN), eRPM);
+}
+
+static void checkFrames() {
+	// Throttle 1046 without telemetry is 1000001011000110
+	CHECK(DShotCodec::encodeFrame(1046, false, false) == 0x82c6);
+	CHECK(DShotCodec::encodeFrame(1046, true, false) == 0x82d7);
+	CHECK(DShotCodec::encodeFrame(1046, false, true) == 0x82c9);
+	CHECK(DShotCodec::encodeFrame(0, false, false) == 0x0000);
+	CHECK(DShotCodec::encodeFrame(DShotCodec::throttleMax, false, false) == 0xffee);
+
+	uint32_t buffer[DShotCodec::frameBits + 1];
+	uint16_t frame {0x82c6};
+	for (auto& value : buffer) {
+		value = 0xdead;
+	}
+	DShotCodec::buildBuffer(buffer, frame, 80, 40);
+	bool bitsMatch {true};
+	for (uint8_t i {0}; i < DShotCodec::frameBits; ++i) {
+		bitsMatch &= buffer[i] == (frame >> (15 - i) & 0x1 ? 80u : 40u);
+	}
+	CHECK(bitsMatch);
+	CHECK(buffer[DShotCodec::frameBits] == 0);
+
+	CHECK(DShotCodec::toThrottle(-1500) == 0);
+	CHECK(DShotCodec::toThrottle(-1024) == 0);
+	CHECK(DShotCodec::toThrottle(-1023) == DShotCodec::throttleMin);
+	CHECK(DShotCodec::toThrottle(0) == 1047);
+	CHECK(DShotCodec::toThrottle(1024) == DShotCodec::throttleMax);
+	CHECK(DShotCodec::toThrottle(1500) == DShotCodec::throttleMax);
+}
+
+static void checkTelemetry() {
+	uint32_t eRPM {0};
+
+	// Mantissa and exponent of the period in us
+	const uint16_t periods[][2] {
+	  {0x1ff, 0},
+	  {0x100, 1},
+	  {0x0f3, 2},
+	  {0x01c, 7},
+	  {0x001, 0}
+	};
+	for (const auto& period : periods) {
+		uint32_t value {encodeReply(period[1] << 9u | period[0])};
+
+		CHECK(DShotCodec::decodeTelemetry(value, eRPM) && eRPM == 60000000u / (period[0] << period[1]));
+		for (uint16_t idle : {0, 7, 31}) {
+			eRPM = 0;
+			CHECK(decodeSamples(sampleReply(value, idle), eRPM) && eRPM == 60000000u / (period[0] << period[1]));
+		}
+	}
+
+	CHECK(decodeSamples(sampleReply(encodeReply(0xfff), 10), eRPM) && eRPM == 0);  // Motor stopped
+	CHECK(!DShotCodec::decodeTelemetry(encodeReply(0x000), eRPM));                  // No period
+	CHECK(!DShotCodec::decodeTelemetry(0, eRPM));
+
+	// 0x00 is not a GCR code, wherever it is
+	uint32_t value {encodeReply(0x2f3)};
+	for (uint8_t i {0}; i < 4; ++i) {
+		CHECK(!DShotCodec::decodeTelemetry(value & ~(0x1fu << (i * 5u)), eRPM));
+	}
+	CHECK(!DShotCodec::decodeTelemetry(value ^ 0x1, eRPM));  // Valid codes, wrong CRC
+
+	std::vector<uint16_t> idle(SAMPLE_COUNT, 0x1u << PIN);
+	CHECK(!decodeSamples(idle, eRPM));
+}
+
+static void measure() {
+	uint32_t buffers[4][DShotCodec::frameBits + 1];
+	uint16_t throttle {0};
+
+	double frameRate {test::measure([&]() {
+		for (auto& buffer : buffers) {
+			uint16_t frame {DShotCodec::encodeFrame(DShotCodec::toThrottle(++throttle % 2048 - 1024), false, true)};
+			DShotCodec::buildBuffer(buffer, frame, 40, 20);
+		}
+	})};
+	CHECK(buffers[0][DShotCodec::frameBits] == 0);
+
+	auto     samples {sampleReply(encodeReply(0x2f3), 12)};
+	uint32_t eRPM {0};
+	uint32_t decoded {0};
+
+	double replyRate {test::measure([&]() {
+		for (uint8_t i {0}; i < 4; ++i) {
+			decoded += decodeSamples(samples, eRPM);
+		}
+	})};
+	CHECK(decoded > 0 && eRPM == 60000000u / (0xf3 << 1u));
+
+	std::printf("Frames of 4 motors: %.0f ns, replies of 4 motors: %.0f ns\n", 1e9 / frameRate, 1e9 / replyRate);
+}
+
+int main() {
+	checkFrames();
+	checkTelemetry();
+	measure();
+
+	return test::finish("dshot-codec");
+}
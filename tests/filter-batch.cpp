@@ -0,0 +1,74 @@
+/*
+ * File:   filter-batch.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 10:40 AM
+ */
+
+/* The samples of a simulated flight run through tools/mahony-batch, once built with the vector extensions
+ * of the compiler and once with AVX2, both next to the test in tools/. The batches have to give the same bits
+ * as the scalar Mahony filters and quaternion products with -t 0, also with a filter count that leaves lanes unused.
+ * The AVX2 build is only run on processors that have it. Also reports the speeds the tool measured.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "test.hpp"
+
+static std::string         tools {};
+static test::TempDirectory directory {};
+
+static void checkBuild(const char* program, const char* lanes) {
+	for (const char* filters : {"64", "13"}) {
+		std::string output {};
+
+		CHECK(test::run({tools + program, "-f", directory.pathOf("flash.bin"), "-n", filters, "-t", "0",
+		                 directory.pathOf("flight.log")},
+		                output)
+		      == 0);
+		std::printf("%s", output.c_str());
+
+		size_t line {output.find('\n')};
+		CHECK(output.find(std::string(" filters, ") + lanes + " with ") < line);
+		CHECK(output.find("Mahony updates: ", line) != std::string::npos);
+		CHECK(output.find("Quaternion products: ", line) != std::string::npos);
+
+		// Exactly 0, anything else is printed with digits
+		size_t differences {0};
+		for (size_t position {0}; (position = output.find("largest difference ", position)) != std::string::npos;) {
+			position += 19;
+			differences += output.compare(position, 2, "0\n") == 0;
+		}
+		CHECK(differences == 2);
+	}
+}
+
+int main(int, char** argv) {
+	tools = test::getTools(argv[0]);
+	if (!directory.create("filter-batch")) {
+		return 2;
+	}
+
+	std::string result {};
+	if (!CHECK(simulation::fly(
+	        (tools + "simulator").c_str(),
+	        simulation::getEnvironment({}),
+	        {"FC_SIM_TIME=5", "FC_SIM_SEED=1", "FC_FLASH=" + directory.pathOf("flash.bin"),
+	         "FC_UART1=" + directory.pathOf("flight.log")},
+	        result
+	    ))) {
+		return test::finish("filter-batch");
+	}
+
+	checkBuild("mahony-batch", "generic");
+	if (__builtin_cpu_supports("avx2")) {
+		checkBuild("mahony-batch-avx2", "AVX2");
+	} else {
+		std::printf("No AVX2, only the generic build was run\n");
+	}
+
+	return test::finish("filter-batch");
+}
@@ -0,0 +1,324 @@
+/*
+ * File:   gain-sweep.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 10:00 AM
+ */
+
+/* tools/gain-sweep, built next to the test in tools/, and the pool of threads it runs the flights from.
+ * simulation::runAll() has to run every run exactly once whatever the number of runs and threads, threads done
+ * with their own share take runs from the others.
+ * The sweep flies this program instead of the simulator: with FAKE_SIMULATOR set, it prints a result line with
+ * scores taken from the gains in steps, so that many runs tie, and fails, crashes or returns a score that is not
+ * a number for some of the gains. The front printed has to be the one found by comparing every pair of runs,
+ * the runs have to be the same for any number of jobs and the ranges have to be kept to.
+ * A few flights of the real simulator make sure the sweep reads its results.
+ * Also reports how many runs per second the sweep starts, which is mostly the cost of starting a process.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation.hpp"
+#include "test.hpp"
+
+constexpr static uint32_t RUN_NUMBER {300};
+constexpr static uint8_t  GAIN_NUMBER {11};
+constexpr static uint8_t  SCORE_NUMBER {4};
+constexpr static uint8_t  COLUMN_NUMBER {1 + GAIN_NUMBER + SCORE_NUMBER + 1};  // Run, gains, scores, failed
+
+using Row = std::vector<float>;
+
+static std::string         program {};
+static std::string         tools {};
+static test::TempDirectory directory {};
+
+// The scores of the fake simulator, tracking, overshoot, effort and estimate
+static void getScores(const float* gains, float* scores) {
+	scores[0] = std::floor(gains[0] / 1000);  // pitch.p
+	scores[1] = std::floor(gains[1] / 300);   // pitch.i
+	scores[2] = std::floor(gains[3] / 1000);  // roll.p
+	scores[3] = std::floor(gains[9] * 2);     // kp
+}
+
+static bool fails(const float* gains) {
+	return gains[2] < 5;  // pitch.d
+}
+
+static bool crashes(const float* gains) {
+	return gains[5] > 150;  // roll.d
+}
+
+static bool isNotANumber(const float* gains) {
+	return gains[10] < 0.02f;  // ki
+}
+
+// Stands in for the simulator, with the result line of host/simulator.cpp
+static int fakeSimulator() {
+	const char* pids {std::getenv("FC_SIM_PIDS")};
+	const char* estimator {std::getenv("FC_SIM_ESTIMATOR")};
+	float       gains[GAIN_NUMBER] {};
+	float       scores[SCORE_NUMBER] {};
+
+	if (!pids || !estimator
+	    || std::sscanf(pids, "%f,%f,%f,%f,%f,%f,%f,%f,%f", &gains[0], &gains[1], &gains[2], &gains[3], &gains[4],
+	                   &gains[5], &gains[6], &gains[7], &gains[8]) != 9
+	    || std::sscanf(estimator, "%f,%f", &gains[9], &gains[10]) != 2) {
+		return 2;
+	}
+	if (fails(gains)) {
+		return 2;
+	}
+
+	getScores(gains, scores);
+	char estimate[16];
+	std::snprintf(estimate, sizeof(estimate), "%g", isNotANumber(gains) ? NAN : scores[3]);
+	std::printf(
+	    "time=60.0 speedup=1 crashed=%d roll_tracking=%g pitch_tracking=%g roll_estimate=%s pitch_estimate=%s "
+	    "roll_overshoot=%g pitch_overshoot=%g effort=%g saturation=0 unrecovered=0 recovery_time=0 min_altitude=100\n",
+	    crashes(gains),
+	    scores[0],
+	    scores[0],
+	    estimate,
+	    estimate,
+	    scores[1],
+	    scores[1],
+	    scores[2]
+	);
+	return crashes(gains);
+}
+
+// The rows of the CSV after the header, rows with the wrong number of columns are left empty
+static std::vector<Row> parseCSV(const std::string& csv) {
+	std::vector<Row> rows {};
+	size_t           start {csv.find('\n')};
+
+	while (start != std::string::npos && start + 1 < csv.size()) {
+		const char* line {csv.c_str() + start + 1};
+		Row         row {};
+		char*       end {nullptr};
+
+		for (const char* value {line}; row.size() < COLUMN_NUMBER; value = end + 1) {
+			row.push_back(std::strtof(value, &end));
+			if (end == value || (*end != ',' && *end != '\n')) {
+				break;
+			}
+		}
+		rows.push_back(row.size() == COLUMN_NUMBER && *end == '\n' ? row : Row {});
+		start = csv.find('\n', start + 1);
+	}
+	return rows;
+}
+
+static int sweep(std::vector<std::string> arguments, std::string& front) {
+	arguments.insert(arguments.begin(), tools + "gain-sweep");
+	return test::run(arguments, front);
+}
+
+static const float* scoresOf(const Row& row) {
+	return row.data() + 1 + GAIN_NUMBER;
+}
+
+static bool dominates(const Row& a, const Row& b) {
+	bool better {false};
+
+	for (uint8_t i {0}; i < SCORE_NUMBER; ++i) {
+		if (scoresOf(a)[i] > scoresOf(b)[i]) {
+			return false;
+		}
+		better = better || scoresOf(a)[i] < scoresOf(b)[i];
+	}
+	return better;
+}
+
+// Every run once, also with more threads than runs, and threads that are done take over runs of a busy one
+static void checkRunAll() {
+	for (uint32_t runNumber : {0u, 1u, 7u, 1000u}) {
+		for (unsigned jobNumber : {1u, 2u, 3u, 8u, 17u}) {
+			std::vector<std::atomic<uint16_t>> counts(runNumber);
+
+			simulation::runAll(runNumber, jobNumber, [&counts](uint32_t run) {
+				++counts[run];
+			});
+			CHECK(std::all_of(counts.begin(), counts.end(), [](const std::atomic<uint16_t>& count) {
+				return count == 1;
+			}));
+		}
+	}
+
+	// The runs of the first share are slow, the other threads are done long before
+	std::vector<std::thread::id> threads(400);
+	simulation::runAll(threads.size(), 4, [&threads](uint32_t run) {
+		if (run < threads.size() / 4) {
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+		threads[run] = std::this_thread::get_id();
+	});
+
+	std::vector<std::thread::id> first(threads.begin(), threads.begin() + threads.size() / 4);
+	std::sort(first.begin(), first.end());
+	CHECK(std::unique(first.begin(), first.end()) - first.begin() > 1);
+}
+
+// The front of the sweep against the one found by comparing every pair of runs
+static void checkFront() {
+	std::string front {};
+	std::string runs {directory.pathOf("runs.csv")};
+
+	CHECK(sweep({"-n", std::to_string(RUN_NUMBER), "-j", "3", "-o", runs, program}, front) == 0);
+
+	std::vector<Row> all {parseCSV(test::readFile(runs))};
+	std::vector<Row> printed {parseCSV(front)};
+	if (!CHECK(all.size() == RUN_NUMBER) || !CHECK(!printed.empty())) {
+		return;
+	}
+
+	uint32_t failed {0};
+	uint32_t mismatches {0};
+	for (uint32_t i {0}; i < all.size(); ++i) {
+		const Row& row {all[i]};
+		if (row.empty()) {
+			++mismatches;
+			continue;
+		}
+
+		const float* gains {row.data() + 1};
+		bool         invalid {fails(gains) || crashes(gains) || isNotANumber(gains)};
+		float        scores[SCORE_NUMBER] {};
+
+		getScores(gains, scores);
+		mismatches += row[0] != i || row.back() != invalid;
+		if (!invalid) {
+			mismatches += !std::equal(scores, scores + SCORE_NUMBER, scoresOf(row));
+		}
+		failed += invalid;
+	}
+	CHECK(!mismatches);
+	CHECK(failed > RUN_NUMBER / 10 && failed < RUN_NUMBER / 2);  // Some runs fail, crash or have no estimate
+
+	std::vector<uint32_t> expected {};
+	for (uint32_t i {0}; i < all.size(); ++i) {
+		bool dominated {std::any_of(all.begin(), all.end(), [&all, i](const Row& other) {
+			return !other.back() && dominates(other, all[i]);
+		})};
+
+		if (!all[i].back() && !dominated) {
+			expected.push_back(i);
+		}
+	}
+
+	std::vector<uint32_t> found {};
+	for (const Row& row : printed) {
+		if (row.empty() || row[0] >= RUN_NUMBER) {
+			++mismatches;
+			continue;
+		}
+		found.push_back(row[0]);
+		mismatches += row != all[row[0]];
+	}
+	CHECK(!mismatches);
+	CHECK(std::is_sorted(printed.begin(), printed.end(), [](const Row& a, const Row& b) {
+		return std::lexicographical_compare(
+		    scoresOf(a), scoresOf(a) + SCORE_NUMBER, scoresOf(b), scoresOf(b) + SCORE_NUMBER
+		);
+	}));
+	std::sort(found.begin(), found.end());
+	CHECK(found == expected);
+	std::printf("Front: %zu of %u runs, %u failed\n", found.size(), RUN_NUMBER, failed);
+}
+
+// The gains are drawn before the runs start, the threads only change the order they are flown in
+static void checkJobs() {
+	std::string fronts[2] {};
+
+	for (const char* jobs : {"1", "4"}) {
+		std::string& front {fronts[jobs[0] == '4']};
+		std::string  runs {directory.pathOf(jobs[0] == '4' ? "runs4.csv" : "runs1.csv")};
+
+		CHECK(sweep({"-n", "100", "-j", jobs, "-s", "7", "-o", runs, program}, front) == 0);
+	}
+	CHECK(fronts[0] == fronts[1]);
+	CHECK(test::readFile(directory.pathOf("runs1.csv")) == test::readFile(directory.pathOf("runs4.csv")));
+	CHECK(test::readFile(directory.pathOf("runs1.csv")).size() > 100 * 2 * COLUMN_NUMBER);
+}
+
+static void checkRanges() {
+	std::string front {};
+	std::string runs {directory.pathOf("ranges.csv")};
+
+	CHECK(sweep({"-n", "100", "-r", "pitch.p=2500", "-r", "kp=0.5:1", "-r", "ki=1", "-o", runs, program}, front) == 0);
+
+	std::vector<Row> all {parseCSV(test::readFile(runs))};
+	uint32_t         outside {0};
+	for (const Row& row : all) {
+		outside += row.empty() || row[1] != 2500 || row[10] < 0.5f || row[10] > 1 || row[11] != 1;
+	}
+	CHECK(all.size() == 100);
+	CHECK(!outside);
+
+	// Another seed, other gains
+	std::string other {directory.pathOf("other.csv")};
+	CHECK(sweep({"-n", "100", "-s", "2", "-o", other, program}, front) == 0);
+	CHECK(test::readFile(other) != test::readFile(directory.pathOf("runs.csv")));
+
+	// Every run crashes, nothing on the front
+	CHECK(sweep({"-n", "20", "-r", "roll.d=180", program}, front) == 1);
+	CHECK(parseCSV(front).empty());
+
+	CHECK(sweep({"-n", "20", "-r", "roll.x=1", program}, front) == 2);
+	CHECK(sweep({"-n", "20", "-r", "roll.d=2:1", program}, front) == 2);
+	CHECK(sweep({"-n", "20", directory.pathOf("missing")}, front) == 2);
+}
+
+static void checkSimulator() {
+	std::string front {};
+
+	unsetenv("FAKE_SIMULATOR");
+	setenv("FC_SIM_TIME", "5", 1);
+	// Around the gains the simulator sets up itself, so that none of the flights crashes
+	CHECK(
+	    sweep(
+	        {"-n", "4", "-j", "2", "-r", "pitch.p=1200:1800", "-r", "roll.p=1200:1800", "-r", "pitch.i=300", "-r",
+	         "roll.i=300", "-r", "pitch.d=40", "-r", "roll.d=40", "-r", "kp=0.5", "-r", "ki=0.5", tools + "simulator"},
+	        front
+	    )
+	    == 0
+	);
+	unsetenv("FC_SIM_TIME");
+
+	std::vector<Row> printed {parseCSV(front)};
+	std::printf("%s", front.c_str());
+	if (CHECK(!printed.empty() && !printed[0].empty())) {
+		CHECK(scoresOf(printed[0])[0] > 0 && scoresOf(printed[0])[0] < 20);  // Tracking
+		CHECK(scoresOf(printed[0])[2] > 0);                                   // Effort
+	}
+}
+
+int main(int, char** argv) {
+	if (std::getenv("FAKE_SIMULATOR")) {
+		return fakeSimulator();
+	}
+
+	program = argv[0];
+	tools = test::getTools(argv[0]);
+	if (!directory.create("gain-sweep")) {
+		return 2;
+	}
+
+	checkRunAll();
+	setenv("FAKE_SIMULATOR", "1", 1);
+	checkFront();
+	checkJobs();
+	checkRanges();
+	checkSimulator();
+
+	return test::finish("gain-sweep");
+}
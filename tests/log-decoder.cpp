@@ -0,0 +1,240 @@
+/*
+ * File:   log-decoder.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 10:15 AM
+ */
+
+/* A blackbox log of a simulated flight converted with tools/blackbox-decoder, both built next to the test in tools/.
+ * Every row of the CSV has to match the frame decoded from the log here, member by member of BlackboxFrame.
+ * A time range gives the frames inside it and no others, selected fields come in the order they were asked for
+ * and column files hold the same values as the CSV. The output doesn't depend on the number of threads.
+ * Also reports how fast the log is converted.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BlackboxCodec.hpp"
+#include "simulation.hpp"
+#include "test.hpp"
+
+using Rows = std::vector<std::vector<long>>;
+
+static std::string         tools {};
+static test::TempDirectory directory {};
+
+static int decode(std::vector<std::string> arguments, std::string& output) {
+	arguments.insert(arguments.begin(), tools + "blackbox-decoder");
+	arguments.push_back(directory.pathOf("flight.log"));
+	return test::run(arguments, output);
+}
+
+// Frames in the order of the log, decoding goes on at the next keyframe after an invalid frame
+static std::vector<BlackboxFrame> decodeLog(const std::string& log) {
+	auto*                      data {reinterpret_cast<const uint8_t*>(log.data())};
+	std::vector<BlackboxFrame> frames {};
+	BlackboxDecoder            decoder {};
+
+	for (size_t position {BlackboxDecoder::findKeyframe(data, log.size())}; position < log.size();) {
+		size_t length {decoder.decode(data + position, log.size() - position)};
+
+		if (!length) {
+			position += 1 + BlackboxDecoder::findKeyframe(data + position + 1, log.size() - position - 1);
+			continue;
+		}
+		frames.push_back(decoder.getFrame());
+		position += length;
+	}
+	return frames;
+}
+
+// All members in their order, arrays element by element
+static std::vector<long> getValues(const BlackboxFrame& frame) {
+	std::vector<long> values {frame.time, frame.loopTime, frame.status};
+
+	values.insert(values.end(), frame.accelerations, frame.accelerations + 3);
+	values.insert(values.end(), frame.angularRates, frame.angularRates + 3);
+	values.insert(values.end(), frame.attitude, frame.attitude + 3);
+	values.insert(values.end(), frame.channels, frame.channels + 16);
+	values.insert(values.end(), &frame.pidTerms[0][0], &frame.pidTerms[0][0] + 9);
+	values.insert(values.end(), frame.outputs, frame.outputs + 8);
+	values.insert(values.end(), frame.taskTimes, frame.taskTimes + 6);
+	values.insert(values.end(), frame.setpoint, frame.setpoint + 2);
+	values.insert(values.end(), frame.intervals, frame.intervals + 2);
+	return values;
+}
+
+// The header goes into the names, the values of every following line into the rows
+static Rows parseCSV(const std::string& csv, std::string& names) {
+	Rows   rows {};
+	size_t line {csv.find('\n')};
+
+	names = csv.substr(0, line);
+	for (++line; line < csv.size();) {
+		size_t            end {csv.find('\n', line)};
+		std::vector<long> row {};
+
+		for (const char* number {csv.c_str() + line}; number < csv.c_str() + end; ++number) {
+			char* next {nullptr};
+
+			row.push_back(std::strtol(number, &next, 10));
+			number = next;
+		}
+		rows.push_back(row);
+		line = end + 1;
+	}
+	return rows;
+}
+
+static void checkAll(const std::vector<BlackboxFrame>& frames) {
+	std::string output {};
+	std::string names {};
+
+	CHECK(decode({"-j", "1"}, output) == 0);
+	Rows rows {parseCSV(output, names)};
+
+	CHECK(names.compare(0, 37, "time,loopTime,status,accelerations[0]") == 0);
+	CHECK(names.find(",pidTerms[8],outputs[0],") != std::string::npos);
+	CHECK(names.compare(names.size() - 25, 25, "intervals[0],intervals[1]") == 0);
+	if (!CHECK(rows.size() == frames.size())) {
+		return;
+	}
+
+	size_t differing {0};
+	for (size_t i {0}; i < frames.size(); ++i) {
+		differing += rows[i] != getValues(frames[i]);
+	}
+	CHECK(differing == 0);
+
+	std::string threaded {};
+	CHECK(decode({"-j", "4"}, threaded) == 0);
+	CHECK(threaded == output);
+
+	auto   start {std::chrono::steady_clock::now()};
+	size_t runs {0};
+	do {
+		decode({}, threaded);
+		++runs;
+	} while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));
+	double elapsed {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+	std::printf("%zu frames, %.0f frames/s\n", frames.size(), frames.size() * runs / elapsed);
+}
+
+// Times that are not on keyframes, the frames in range start and end in the middle of segments
+static void checkRange(const std::vector<BlackboxFrame>& frames) {
+	uint32_t    start {frames[frames.size() * 2 / 5 + 5].time};
+	uint32_t    end {frames[frames.size() * 3 / 5 + 7].time};
+	std::string output {};
+	std::string names {};
+
+	CHECK(decode({"-s", std::to_string(start), "-e", std::to_string(end), "-j", "3"}, output) == 0);
+	Rows rows {parseCSV(output, names)};
+	Rows expected {};
+
+	for (const auto& frame : frames) {
+		if (frame.time >= start && frame.time <= end) {
+			expected.push_back(getValues(frame));
+		}
+	}
+	CHECK(expected.size() > frames.size() / 10);
+	CHECK(rows == expected);
+
+	CHECK(decode({"-s", std::to_string(frames.back().time + 1)}, output) == 0);
+	CHECK(parseCSV(output, names).empty());
+}
+
+// In the order of the list, a name without an index stands for the whole array
+static void checkFields(const std::vector<BlackboxFrame>& frames) {
+	std::string output {};
+	std::string names {};
+
+	CHECK(decode({"-f", "outputs,time,attitude[1]", "-j", "2"}, output) == 0);
+	Rows rows {parseCSV(output, names)};
+
+	CHECK(names == "outputs[0],outputs[1],outputs[2],outputs[3],outputs[4],outputs[5],outputs[6],outputs[7],"
+	               "time,attitude[1]");
+	if (!CHECK(rows.size() == frames.size())) {
+		return;
+	}
+
+	size_t differing {0};
+	for (size_t i {0}; i < frames.size(); ++i) {
+		std::vector<long> expected {frames[i].outputs, frames[i].outputs + 8};
+
+		expected.push_back(frames[i].time);
+		expected.push_back(frames[i].attitude[1]);
+		differing += rows[i] != expected;
+	}
+	CHECK(differing == 0);
+
+	CHECK(decode({"-f", "time,altitude"}, output) == 2);
+}
+
+// Little-endian files of the field size, the same with any number of threads
+static void checkColumns(const std::vector<BlackboxFrame>& frames) {
+	std::string output {};
+	std::string columns[2][3] {};
+
+	for (const char* jobs : {"1", "4"}) {
+		CHECK(decode({"-f", "time,taskTimes[2],setpoint[0]", "-c", directory.pathOf(""), "-j", jobs}, output) == 0);
+		CHECK(output.empty());
+
+		std::string* files {columns[jobs[0] == '4']};
+		files[0] = test::readFile(directory.pathOf("time.bin"));
+		files[1] = test::readFile(directory.pathOf("taskTimes[2].bin"));
+		files[2] = test::readFile(directory.pathOf("setpoint[0].bin"));
+	}
+	for (uint8_t i {0}; i < 3; ++i) {
+		CHECK(columns[0][i] == columns[1][i]);
+	}
+	if (!CHECK(columns[0][0].size() == frames.size() * 4 && columns[0][1].size() == frames.size() * 2)
+	    || !CHECK(columns[0][2].size() == frames.size() * 2)) {
+		return;
+	}
+
+	size_t differing {0};
+	for (size_t i {0}; i < frames.size(); ++i) {
+		uint32_t time;
+		uint16_t taskTime;
+		int16_t  setpoint;
+
+		std::memcpy(&time, columns[0][0].data() + i * 4, 4);
+		std::memcpy(&taskTime, columns[0][1].data() + i * 2, 2);
+		std::memcpy(&setpoint, columns[0][2].data() + i * 2, 2);
+		differing += time != frames[i].time || taskTime != frames[i].taskTimes[2] || setpoint != frames[i].setpoint[0];
+	}
+	CHECK(differing == 0);
+}
+
+int main(int, char** argv) {
+	tools = test::getTools(argv[0]);
+	if (!directory.create("log-decoder")) {
+		return 2;
+	}
+
+	std::string result {};
+	if (!CHECK(simulation::fly(
+	        (tools + "simulator").c_str(),
+	        simulation::getEnvironment({}),
+	        {"FC_SIM_TIME=10", "FC_SIM_SEED=1", "FC_FLASH=" + directory.pathOf("flash.bin"),
+	         "FC_UART1=" + directory.pathOf("flight.log")},
+	        result
+	    ))) {
+		return test::finish("log-decoder");
+	}
+
+	std::vector<BlackboxFrame> frames {decodeLog(test::readFile(directory.pathOf("flight.log")))};
+	if (CHECK(frames.size() > 2000)) {
+		checkAll(frames);
+		checkRange(frames);
+		checkFields(frames);
+		checkColumns(frames);
+	}
+
+	return test::finish("log-decoder");
+}
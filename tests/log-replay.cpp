@@ -0,0 +1,188 @@
+/*
+ * File:   log-replay.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 9:30 AM
+ */
+
+/* Blackbox logs of simulated flights replayed with tools/blackbox-replay, both built next to the test in tools/.
+ * A log replayed with the flash image of its flight has to match in every frame, with the PIDs of another flight
+ * it has to differ. A corrupted keyframe stops the replay there, a log cut off mid-frame is compared
+ * up to there, several logs are reported in their order whatever the number of jobs.
+ * Also reports how fast the logs are replayed.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "test.hpp"
+
+constexpr static const char* FLIGHT_TIME {"FC_SIM_TIME=10"};
+constexpr static const char* OTHER_PIDS {"FC_SIM_PIDS=1000,200,20,1000,200,20,1,0,0"};
+
+static std::string         tools {};
+static std::vector<char*>  environment {};
+static test::TempDirectory directory {};
+
+struct Report {
+	bool   found {false};
+	size_t frames {0};
+	size_t differing {0};
+	bool   gap {false};
+};
+
+// Flies with the blackbox on UART1 and the options in a flash image of its own
+static bool record(const char* flash, const char* log, const std::vector<std::string>& variables) {
+	std::vector<std::string> all {variables};
+	std::string              result {};
+
+	all.push_back(FLIGHT_TIME);
+	all.push_back("FC_SIM_SEED=1");
+	all.push_back("FC_FLASH=" + directory.pathOf(flash));
+	all.push_back("FC_UART1=" + directory.pathOf(log));
+	return simulation::fly((tools + "simulator").c_str(), environment, all, result);
+}
+
+static int replay(std::vector<std::string> arguments, std::string& output) {
+	arguments.insert(arguments.begin(), tools + "blackbox-replay");
+	return test::run(arguments, output);
+}
+
+// The line of the log in the output of the replay
+static Report getReport(const std::string& output, const std::string& log) {
+	Report report {};
+	size_t line {output.find(log + ": ")};
+
+	if (line != std::string::npos) {
+		std::string text {output.substr(line + log.size() + 2, output.find('\n', line) - line - log.size() - 2)};
+		report.found = std::sscanf(text.c_str(), "%zu frames, %zu differing", &report.frames, &report.differing) == 2;
+		report.gap = text.find("stopped at a gap") != std::string::npos;
+	}
+	return report;
+}
+
+static Report checkFlight() {
+	std::string output {};
+
+	if (!CHECK(record("flash.bin", "flight.log", {}))) {
+		return {};
+	}
+
+	CHECK(replay({"-f", directory.pathOf("flash.bin"), directory.pathOf("flight.log")}, output) == 0);
+	std::printf("%s", output.c_str());
+
+	Report report {getReport(output, directory.pathOf("flight.log"))};
+	CHECK(report.found);
+	CHECK(report.frames > 2000);  // Every control cycle of the 10s flight
+	CHECK(report.differing == 0);
+	CHECK(!report.gap);
+	return report;
+}
+
+// The PIDs are taken from the flash image, with those of another flight the PID terms and the outputs differ
+static void checkOptions() {
+	std::string output {};
+
+	if (!CHECK(record("other.bin", "other.log", {OTHER_PIDS}))) {
+		return;
+	}
+
+	CHECK(replay({"-f", directory.pathOf("other.bin"), directory.pathOf("other.log")}, output) == 0);
+	CHECK(getReport(output, directory.pathOf("other.log")).differing == 0);
+
+	CHECK(replay({"-f", directory.pathOf("flash.bin"), "-m", "3", directory.pathOf("other.log")}, output) == 1);
+	Report report {getReport(output, directory.pathOf("other.log"))};
+	CHECK(report.frames > 2000);
+	CHECK(report.differing > 0);
+	CHECK(output.find(" ms: ") != std::string::npos);  // The first differing frames, up to -m
+}
+
+static void checkDamage(const Report& flight) {
+	std::string log {test::readFile(directory.pathOf("flight.log"))};
+	std::string output {};
+
+	// A corrupted byte in a keyframe in the middle, its CRC stops the replay without reporting differences.
+	// Frames in between have no CRC of their own, corrupted ones are only caught by the differences they make.
+	std::string corrupted {log};
+	size_t      keyframe {log.find("\xb1\xac\x4b", log.size() / 2)};
+	if (!CHECK(keyframe != std::string::npos)) {
+		return;
+	}
+	corrupted[keyframe + 5] ^= 0x5a;
+	test::writeFile(directory.pathOf("corrupted.log"), corrupted);
+	CHECK(replay({"-f", directory.pathOf("flash.bin"), directory.pathOf("corrupted.log")}, output) == 0);
+
+	Report report {getReport(output, directory.pathOf("corrupted.log"))};
+	CHECK(report.gap);
+	CHECK(report.differing == 0);
+	CHECK(report.frames > flight.frames * 2 / 5 && report.frames < flight.frames * 3 / 5);
+
+	// Cut off mid-frame, like a recording that stopped with the power, every complete frame is compared
+	test::writeFile(directory.pathOf("cut.log"), log.substr(0, log.size() - 3));
+	CHECK(replay({"-f", directory.pathOf("flash.bin"), directory.pathOf("cut.log")}, output) == 0);
+	report = getReport(output, directory.pathOf("cut.log"));
+	CHECK(!report.gap);
+	CHECK(report.differing == 0);
+	CHECK(report.frames == flight.frames - 1);
+}
+
+// Reports come in the order of the logs, the exit status is the worst of them
+static void checkJobs() {
+	std::vector<std::string> logs {
+	  directory.pathOf("flight.log"),
+	  directory.pathOf("other.log"),
+	  directory.pathOf("corrupted.log"),
+	  directory.pathOf("cut.log"),
+	  directory.pathOf("flight.log")
+	};
+	std::string outputs[2] {};
+
+	for (const char* jobs : {"1", "3"}) {
+		std::vector<std::string> arguments {"-f", directory.pathOf("flash.bin"), "-m", "0", "-j", jobs};
+		arguments.insert(arguments.end(), logs.begin(), logs.end());
+
+		std::string& output {outputs[jobs[0] == '3']};
+		CHECK(replay(arguments, output) == 1);
+		std::printf("%s", output.substr(output.rfind('\n', output.size() - 2) + 1).c_str());
+
+		size_t position {0};
+		for (const auto& log : logs) {
+			position = output.find(log + ": ", position);
+			if (!CHECK(position != std::string::npos)) {
+				break;
+			}
+			++position;
+		}
+	}
+
+	// The same reports, only the speed may differ
+	for (const auto& log : logs) {
+		Report one {getReport(outputs[0], log)};
+		Report three {getReport(outputs[1], log)};
+		CHECK(one.frames == three.frames && one.differing == three.differing && one.gap == three.gap);
+	}
+
+	std::string output {};
+	CHECK(replay({directory.pathOf("flight.log"), directory.pathOf("missing.log")}, output) == 2);
+	CHECK(output.find(directory.pathOf("missing.log") + ": could not be opened") != std::string::npos);
+}
+
+int main(int, char** argv) {
+	tools = test::getTools(argv[0]);
+	environment = simulation::getEnvironment({});
+	if (!directory.create("log-replay")) {
+		return 2;
+	}
+
+	Report flight {checkFlight()};
+	if (flight.frames) {
+		checkOptions();
+		checkDamage(flight);
+		checkJobs();
+	}
+
+	return test::finish("log-replay");
+}
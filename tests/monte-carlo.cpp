@@ -0,0 +1,395 @@
+/*
+ * File:   monte-carlo.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 10:40 AM
+ */
+
+/* tools/monte-carlo, built next to the test in tools/. The campaigns fly this program instead of the simulator:
+ * with FAKE_SIMULATOR set, it prints a result line computed from the seed and the variations, and fails for some
+ * of the seeds. Every seed has to be flown once with the variations its own generator draws, the results file
+ * has to hold the results as printed, over more than one block, and read back the same for any number of jobs.
+ * The summary has to count the runs like the results file does, with percentiles within their 1% bins.
+ * A few flights of the real simulator are flown again by themselves from their row of the results file.
+ * Also reports how many runs per second the campaign starts, which is mostly the cost of starting a process.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "test.hpp"
+
+constexpr static uint32_t RUN_NUMBER {4500};  // More than a block of the results file
+constexpr static uint8_t  VARIATION_NUMBER {4};
+constexpr static uint8_t  RESULT_NUMBER {10};
+constexpr static uint8_t  COLUMN_NUMBER {1 + VARIATION_NUMBER + RESULT_NUMBER};
+constexpr static uint32_t FAILING_SEEDS {17};  // Every 17th seed can't be flown
+
+// The ranges the tool draws from by default
+constexpr static float ranges[VARIATION_NUMBER][2] {
+  {0,   3    },
+  {0.5, 4    },
+  {0,   20000},
+  {0,   8    }
+};
+
+// Seed, variations and results in the columns of the results file, the float values exactly
+using Row = std::vector<double>;
+
+static std::string         program {};
+static std::string         tools {};
+static test::TempDirectory directory {};
+
+// The results of the fake simulator, from crashed to min_altitude
+static void getResults(const float* variations, float* results) {
+	float bias {variations[0]};
+	float noise {variations[1]};
+	float latency {variations[2]};
+	float wind {variations[3]};
+
+	results[0] = wind > 7;
+	results[1] = results[0] ? 20 + wind : 60;
+	results[2] = 2 + bias * noise;
+	results[3] = 1 + latency / 5000;
+	results[4] = bias * 3;
+	results[5] = noise / 2;
+	results[6] = wind * wind / 1000;
+	results[7] = latency > 15000;
+	results[8] = latency / 10000;
+	results[9] = 100 - wind * 10;
+}
+
+// Stands in for the simulator, with the result line of host/simulator.cpp
+static int fakeSimulator() {
+	const char* names[] {"FC_SIM_BIAS", "FC_SIM_NOISE", "FC_SIM_LATENCY", "FC_SIM_WIND"};
+	const char* seed {std::getenv("FC_SIM_SEED")};
+	float       variations[VARIATION_NUMBER] {};
+	float       results[RESULT_NUMBER] {};
+
+	for (uint8_t i {0}; i < VARIATION_NUMBER; ++i) {
+		const char* value {std::getenv(names[i])};
+
+		if (!value) {
+			return 2;
+		}
+		variations[i] = std::strtof(value, nullptr);
+	}
+	if (!seed || std::strtoul(seed, nullptr, 0) % FAILING_SEEDS == 0) {
+		return 2;
+	}
+
+	getResults(variations, results);
+	std::printf(
+	    "time=%.9g speedup=1 crashed=%.0f roll_tracking=%.9g pitch_tracking=%.9g roll_estimate=%.9g "
+	    "pitch_estimate=%.9g roll_overshoot=0 pitch_overshoot=0 effort=0 saturation=%.9g unrecovered=%.0f "
+	    "recovery_time=%.9g min_altitude=%.9g\n",
+	    results[1],
+	    results[0],
+	    results[2],
+	    results[3],
+	    results[4],
+	    results[5],
+	    results[6],
+	    results[7],
+	    results[8],
+	    results[9]
+	);
+	return static_cast<int>(results[0]);
+}
+
+static int runTool(std::vector<std::string> arguments, std::string& output) {
+	arguments.insert(arguments.begin(), tools + "monte-carlo");
+	return test::run(arguments, output);
+}
+
+// The rows of a results file dumped as CSV, by seed, rows with the wrong number of columns are left empty
+static std::vector<Row> dump(const std::string& results) {
+	std::string      csv {};
+	std::vector<Row> rows {};
+
+	if (!CHECK(runTool({"-d", results}, csv) == 0)) {
+		return rows;
+	}
+
+	for (size_t start {csv.find('\n')}; start != std::string::npos && start + 1 < csv.size();
+	     start = csv.find('\n', start + 1)) {
+		Row   row {};
+		char* end {nullptr};
+
+		for (const char* value {csv.c_str() + start + 1}; row.size() < COLUMN_NUMBER; value = end + 1) {
+			row.push_back(row.empty() ? std::strtoul(value, &end, 10) : std::strtof(value, &end));  // As written
+			if (end == value || (*end != ',' && *end != '\n')) {
+				break;
+			}
+		}
+		rows.push_back(row.size() == COLUMN_NUMBER && *end == '\n' ? row : Row {});
+	}
+	std::sort(rows.begin(), rows.end());
+	return rows;
+}
+
+// Every seed once, with the variations of its own generator and the results the fake simulator prints for them
+static void checkRows(const std::vector<Row>& rows, uint32_t seed, uint32_t runNumber) {
+	uint32_t mismatches {0};
+
+	CHECK(rows.size() == runNumber);
+	for (uint32_t i {0}; i < rows.size(); ++i) {
+		const Row&   row {rows[i]};
+		std::mt19937 generator {seed + i};
+		float        variations[VARIATION_NUMBER] {};
+		float        results[RESULT_NUMBER] {};
+
+		if (row.empty() || row[0] != seed + i) {
+			++mismatches;
+			continue;
+		}
+		for (uint8_t j {0}; j < VARIATION_NUMBER; ++j) {
+			std::uniform_real_distribution<float> distribution {ranges[j][0], ranges[j][1]};
+
+			variations[j] = distribution(generator);
+			mismatches += row[1 + j] != variations[j];
+		}
+
+		getResults(variations, results);
+		for (uint8_t j {0}; j < RESULT_NUMBER; ++j) {
+			double value {row[1 + VARIATION_NUMBER + j]};
+			mismatches += (seed + i) % FAILING_SEEDS ? value != results[j] : !std::isnan(value);
+		}
+	}
+	CHECK(!mismatches);
+}
+
+// The value below which the percentage of the values is, by the nearest rank like the summary
+static double getPercentile(std::vector<double> values, double percentile) {
+	std::sort(values.begin(), values.end());
+	return values[static_cast<size_t>(std::ceil(percentile / 100 * values.size())) - 1];
+}
+
+template <class F>
+static unsigned countIf(const std::vector<Row>& rows, F predicate) {
+	return std::count_if(rows.begin(), rows.end(), predicate);
+}
+
+static bool isClose(double value, double expected, double tolerance) {
+	return std::fabs(value - expected) <= tolerance * std::fabs(expected) + 1e-3;
+}
+
+// The summary printed by the campaign, and again from the results file, against the dumped rows
+static void checkSummary(const std::string& summary, const std::vector<Row>& rows) {
+	unsigned runs {0};
+	unsigned failed {0};
+	unsigned crashed {0};
+	unsigned saturated {0};
+	unsigned unrecovered {0};
+
+	CHECK(std::sscanf(summary.c_str(), "%u runs, %u could not be flown", &runs, &failed) == 2);
+	size_t line {summary.find("\ncrashed ")};
+	CHECK(
+	    line != std::string::npos
+	    && std::sscanf(
+	           summary.c_str() + line + 1,
+	           "crashed %u (%*f%%), saturated over 1%% of the time %u (%*f%%), unrecovered %u",
+	           &crashed,
+	           &saturated,
+	           &unrecovered
+	       ) == 3
+	);
+
+	std::vector<Row> flown {};
+	std::copy_if(rows.begin(), rows.end(), std::back_inserter(flown), [](const Row& row) {
+		return !std::isnan(row[1 + VARIATION_NUMBER]);
+	});
+	CHECK(runs == rows.size());
+	CHECK(failed == rows.size() - flown.size());
+	CHECK(crashed == countIf(flown, [](const Row& row) {
+		return row[5] != 0;
+	}));
+	CHECK(saturated == countIf(flown, [](const Row& row) {
+		return static_cast<float>(row[11]) > 0.01f;
+	}));
+	CHECK(unrecovered == countIf(flown, [](const Row& row) {
+		return row[12] != 0;
+	}));
+	CHECK(crashed && saturated && unrecovered && failed);
+
+	// Mean, p50, p90, p99 and max of the results after the time
+	const char* names[] {"roll_tracking",
+	                     "pitch_tracking",
+	                     "roll_estimate",
+	                     "pitch_estimate",
+	                     "saturation",
+	                     "unrecovered",
+	                     "recovery_time",
+	                     "min_altitude"};
+	uint32_t    mismatches {0};
+	for (uint8_t column {1 + VARIATION_NUMBER + 2}; column < COLUMN_NUMBER; ++column) {
+		std::vector<double> values {};
+		for (const Row& row : flown) {
+			values.push_back(row[column]);
+		}
+
+		std::string name {std::string("\n") + names[column - 1 - VARIATION_NUMBER - 2] + ' '};
+		size_t      position {summary.find(name)};
+		double      printed[5] {};
+
+		if (position == std::string::npos
+		    || std::sscanf(
+		           summary.c_str() + position + name.size(),
+		           "%lf %lf %lf %lf %lf",
+		           &printed[0],
+		           &printed[1],
+		           &printed[2],
+		           &printed[3],
+		           &printed[4]
+		       ) != 5) {
+			++mismatches;
+			continue;
+		}
+
+		double mean {0};
+		for (double value : values) {
+			mean += value / values.size();
+		}
+		mismatches += !isClose(printed[0], mean, 1e-3);  // Printed with 4 digits
+		mismatches += !isClose(printed[1], getPercentile(values, 50), 0.006);
+		mismatches += !isClose(printed[2], getPercentile(values, 90), 0.006);
+		mismatches += !isClose(printed[3], getPercentile(values, 99), 0.006);
+		mismatches += !isClose(printed[4], *std::max_element(values.begin(), values.end()), 1e-3);
+	}
+	CHECK(!mismatches);
+}
+
+static void checkCampaign() {
+	std::string results {directory.pathOf("campaign.fcmc")};
+	std::string summary {};
+
+	CHECK(runTool({"-n", std::to_string(RUN_NUMBER), "-j", "3", "-s", "100", "-o", results, program}, summary) == 0);
+	std::printf("%s", summary.c_str());
+
+	std::vector<Row> rows {dump(results)};
+	checkRows(rows, 100, RUN_NUMBER);
+	checkSummary(summary, rows);
+
+	std::string again {};
+	CHECK(runTool({"-p", results}, again) == 0);
+	CHECK(again == summary);
+
+	// Cut off within the last block, or not a results file at all
+	std::string file {test::readFile(results)};
+	std::string output {};
+	test::writeFile(directory.pathOf("cut.fcmc"), file.substr(0, file.size() - 4));
+	CHECK(runTool({"-d", directory.pathOf("cut.fcmc")}, output) == 2);
+	CHECK(runTool({"-p", directory.pathOf("cut.fcmc")}, output) == 2);
+	test::writeFile(directory.pathOf("cut.fcmc"), "FCMD" + file.substr(4));
+	CHECK(runTool({"-p", directory.pathOf("cut.fcmc")}, output) == 2);
+}
+
+// The runs come in in any order, sorted by the seed they are the same
+static void checkJobs() {
+	std::string output {};
+
+	CHECK(runTool({"-n", "200", "-j", "1", "-o", directory.pathOf("one.fcmc"), program}, output) == 0);
+	CHECK(runTool({"-n", "200", "-j", "4", "-o", directory.pathOf("four.fcmc"), program}, output) == 0);
+
+	std::vector<Row> one {dump(directory.pathOf("one.fcmc"))};
+	std::vector<Row> four {dump(directory.pathOf("four.fcmc"))};
+	uint32_t         mismatches {0};
+	checkRows(one, 1, 200);
+	CHECK(one.size() == four.size());
+	for (size_t i {0}; i < std::min(one.size(), four.size()); ++i) {
+		for (size_t j {0}; j < std::min(one[i].size(), four[i].size()); ++j) {
+			mismatches += one[i][j] != four[i][j] && !(std::isnan(one[i][j]) && std::isnan(four[i][j]));
+		}
+		mismatches += one[i].size() != four[i].size();
+	}
+	CHECK(!mismatches);
+}
+
+static void checkRanges() {
+	std::string output {};
+
+	std::string results {directory.pathOf("ranges.fcmc")};
+	CHECK(runTool({"-n", "50", "-r", "wind=2:3", "-r", "latency=5000", "-o", results, program}, output) == 0);
+
+	uint32_t outside {0};
+	for (const Row& row : dump(results)) {
+		outside += row.empty() || row[4] < 2 || row[4] > 3 || row[3] != 5000;
+	}
+	CHECK(!outside);
+
+	CHECK(runTool({"-n", "5", "-r", "wind=-1:2", program}, output) == 2);
+	CHECK(runTool({"-n", "5", "-r", "gusts=1", program}, output) == 2);
+	CHECK(runTool({"-n", "5", directory.pathOf("missing")}, output) == 2);
+}
+
+// Any run of the real simulator flown again by itself, from its row of the results file
+static void checkSimulator() {
+	std::string simulator {tools + "simulator"};
+	std::string results {directory.pathOf("simulator.fcmc")};
+	std::string output {};
+
+	unsetenv("FAKE_SIMULATOR");
+	setenv("FC_SIM_TIME", "5", 1);
+	CHECK(runTool({"-n", "3", "-j", "2", "-s", "40", "-o", results, simulator}, output) == 0);
+
+	std::vector<Row>   rows {dump(results)};
+	std::vector<char*> environment {simulation::getEnvironment({})};
+	uint32_t           mismatches {0};
+	CHECK(rows.size() == 3);
+	for (const Row& row : rows) {
+		if (row.empty()) {
+			++mismatches;
+			continue;
+		}
+
+		std::vector<std::string> variables {"FC_SIM_SEED=" + std::to_string(static_cast<uint32_t>(row[0]))};
+		const char*              names[] {"FC_SIM_BIAS", "FC_SIM_NOISE", "FC_SIM_LATENCY", "FC_SIM_WIND"};
+		char                     value[24];
+		std::string              result {};
+
+		for (uint8_t i {0}; i < VARIATION_NUMBER; ++i) {
+			std::snprintf(value, sizeof(value), "%.9g", row[1 + i]);
+			variables.push_back(std::string(names[i]) + '=' + value);
+		}
+		if (!simulation::fly(simulator.c_str(), environment, variables, result)) {
+			++mismatches;
+			continue;
+		}
+
+		const char* columns[] {"crashed", "time", "roll_tracking", "pitch_tracking", "roll_estimate", "pitch_estimate"};
+		for (uint8_t i {0}; i < sizeof(columns) / sizeof(columns[0]); ++i) {
+			float field {NAN};
+			simulation::getField(result, columns[i], field);
+			mismatches += field != static_cast<float>(row[1 + VARIATION_NUMBER + i]);
+		}
+	}
+	unsetenv("FC_SIM_TIME");
+	CHECK(!mismatches);
+}
+
+int main(int, char** argv) {
+	if (std::getenv("FAKE_SIMULATOR")) {
+		return fakeSimulator();
+	}
+
+	program = argv[0];
+	tools = test::getTools(argv[0]);
+	if (!directory.create("monte-carlo")) {
+		return 2;
+	}
+
+	setenv("FAKE_SIMULATOR", "1", 1);
+	checkCampaign();
+	checkJobs();
+	checkRanges();
+	checkSimulator();
+
+	return test::finish("monte-carlo");
+}
@@ -0,0 +1,220 @@
+/*
+ * File:   nvm-commit.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 5:50 AM
+ */
+
+/* Options written while a 200Hz loop runs in simulated time, against the NVMCTRL model of host/flash.cpp.
+ * Flash commands take the longest times of the datasheet there, and waiting for the controller or reading the flash
+ * while it is busy lets the simulated time pass, so a task that waited for the flash would take time.
+ * The loop is the output group with the mixer and the main loop around it, the trims keep changing, so records are
+ * moved and rows erased under it. The tasks have to take none and start on time, the outputs have to follow
+ * the written trims without ever mixing in anything else, nvm::write() on the other hand has to take the command times.
+ */
+
+#include <cstring>
+
+#include "data.hpp"
+#include "flash.hpp"
+#include "host.hpp"
+#include "nvm.hpp"
+#include "TaskScheduler.hpp"
+#include "test.hpp"
+
+constexpr static uint32_t STEP {100};          // us
+constexpr static uint32_t PERIOD {5000};       // us
+constexpr static uint32_t WRITE_TIME {2500};   // us, see host/flash.cpp
+constexpr static uint16_t COMMIT_RUN {10};     // Run that changes the PIDs
+constexpr static uint16_t REEDIT_RUN {11};     // Run that changes them again while the first record is written
+constexpr static uint16_t TRIMS_RUN {20};      // First run that changes the trims, every other run after that
+constexpr static uint16_t RUN_NUMBER {400};
+constexpr static uint8_t  JOURNAL_PAGES {flash::size / flash::pageSize};
+
+static TaskScheduler<uint8_t, 4> scheduler {};
+static uint16_t                  runs {0};
+static uint64_t                  commitTime {0};
+static uint64_t                  writtenTime {0};  // First run that found the last PIDs in flash
+static uint16_t                  runsWhileWriting {0};
+static uint16_t                  trimCommits {0};
+
+static InlinePID<float>::PIDCoefficients pitchCoefficients[2] {
+  {2.0f, 0.5f, 0.25f},
+  {3.0f, 0.75f, 0.125f}
+};
+// The defaults and the two sets the trims alternate between
+static int16_t trims[3][data::outputChannelNumber] {
+  {},
+  {5, -5, 10, -10, 15, -15, 20, -20},
+  {-30, 30, -60, 60, -90, 90, -120, 120}
+};
+
+static void setPitchCoefficients(const InlinePID<float>::PIDCoefficients& coefficients) {
+	if (data::setVariable(
+	        static_cast<uint8_t>(data::VariableID::PIDs),
+	        offsetof(data::USBPIDsResponse, coefficients) - data::variableHeaderSize,
+	        sizeof(coefficients),
+	        reinterpret_cast<const uint8_t*>(&coefficients)
+	    )
+	    == data::SetResult::Stored) {
+		nvm::commit();
+	}
+}
+
+static const uint8_t* bytes(const void* src) {
+	return static_cast<const uint8_t*>(src);
+}
+
+static bool pitchWritten(const InlinePID<float>::PIDCoefficients& coefficients) {
+	return !std::memcmp(nvm::get(nvm::options->pidCoefficients), &coefficients, sizeof(coefficients));
+}
+
+static int16_t inputOf(uint8_t channel) {
+	return channel * 100 - 350;
+}
+
+// Every output through its own input, with nothing clamped
+static void setMixer() {
+	int16_t mixes[data::mixesNumber] {};
+	int16_t limits[data::outputChannelNumber * 2] {};
+
+	for (uint8_t i {0}; i < data::outputChannelNumber; ++i) {
+		mixes[i * data::inputChannelNumber + i] = 1000;
+		limits[i * 2] = -1000;
+		limits[i * 2 + 1] = 1000;
+		data::inputs[i][0] = inputOf(i);
+	}
+	while (data::setVariable(static_cast<uint8_t>(data::VariableID::Mux), 0, sizeof(mixes), bytes(mixes))
+	       == data::SetResult::Pending) {
+		nvm::write();
+	}
+	while (data::setVariable(static_cast<uint8_t>(data::VariableID::Limits), 0, sizeof(limits), bytes(limits))
+	       == data::SetResult::Pending) {
+		nvm::write();
+	}
+	nvm::write();
+}
+
+// The trims the outputs were mixed with, -1 if the outputs don't match any of them
+static int8_t getMixedTrims() {
+	for (uint8_t set {0}; set < 3; ++set) {
+		uint8_t i {0};
+
+		while (i < data::outputChannelNumber && data::outputs[i][0] == inputOf(i) + trims[set][i]) {
+			++i;
+		}
+		if (i == data::outputChannelNumber) {
+			return set;
+		}
+	}
+	return -1;
+}
+
+// The output group of the flight loop as far as the options are concerned, with the link making the edits
+static void task() {
+	++runs;
+
+	if (runs == COMMIT_RUN) {
+		commitTime = util::getMicros64();
+		setPitchCoefficients(pitchCoefficients[0]);
+	} else if (runs == REEDIT_RUN) {
+		setPitchCoefficients(pitchCoefficients[1]);
+	} else if (runs >= TRIMS_RUN && runs % 2 == 0) {  // A pending edit is made again two runs later
+		const int16_t* set {trims[1 + trimCommits % 2]};
+
+		if (data::setVariable(static_cast<uint8_t>(data::VariableID::Trims), 0, sizeof(trims[0]), bytes(set))
+		    == data::SetResult::Stored) {
+			nvm::commit();
+			++trimCommits;
+		}
+	}
+
+	data::calculateOutputs();
+	CHECK(getMixedTrims() >= 0);
+
+	if (runs >= COMMIT_RUN) {  // The PIDs use the edits right away
+		CHECK(!std::memcmp(
+		    data::usbPIDsResponse.coefficients, &pitchCoefficients[runs >= REEDIT_RUN], sizeof(pitchCoefficients[0])
+		));
+	}
+
+	if (runs > COMMIT_RUN && !writtenTime) {
+		if (!nvm::busy() && pitchWritten(pitchCoefficients[1])) {  // Not stalling on the flash
+			writtenTime = util::getMicros64();
+		} else {
+			++runsWhileWriting;
+		}
+	}
+}
+
+static void checkBlockingWrite() {
+	nvm::edit(nvm::options->angularRateOffsets, 0.01f);
+
+	uint64_t start {util::getMicros64()};
+	nvm::write();
+	uint64_t elapsed {util::getMicros64() - start};
+
+	std::printf("nvm::write() of a single page record: %llu us\n", static_cast<unsigned long long>(elapsed));
+	CHECK(elapsed >= WRITE_TIME);
+	CHECK(*nvm::get(nvm::options->angularRateOffsets) == 0.01f);
+}
+
+static void checkBackgroundCommit() {
+	scheduler.setClock(util::getMicros);
+
+	setMixer();
+
+	uint32_t start {util::getMicros()};
+	uint8_t  id {scheduler.setInterval(start, PERIOD, task)};
+	uint64_t stallTime {host::getFlashStallTime()};
+
+	while (runs < RUN_NUMBER) {  // Like the main loop
+		data::updateOptions();
+		scheduler.execute(util::getMicros());
+		util::sleepUntil(scheduler.getNextTimestamp());
+	}
+	stallTime = host::getFlashStallTime() - stallTime;
+
+	const auto& statistics {scheduler.getStatistics(id)};
+	std::printf(
+	    "Loop while committing: %u runs, longest %u us, latest start %u us, PIDs written %llu us after the commit\n",
+	    statistics.runs,
+	    statistics.maxTime,
+	    statistics.maxLateness,
+	    static_cast<unsigned long long>(writtenTime - commitTime)
+	);
+	std::printf(
+	    "Trims written %u times, the journal holds %u pages, CPU stalled on the flash for %llu us\n",
+	    trimCommits,
+	    JOURNAL_PAGES,
+	    static_cast<unsigned long long>(stallTime)
+	);
+	CHECK(statistics.maxTime == 0);
+	CHECK(statistics.maxLateness == 0);
+	CHECK(statistics.overruns == 0);
+	CHECK(stallTime == 0);
+
+	// A record of a single page each, so the journal went around twice and rows were freed and erased under the loop
+	CHECK(trimCommits > 2 * JOURNAL_PAGES);
+	nvm::write();  // Idle, so that the copies are taken
+	data::updateOptions();
+	data::calculateOutputs();
+	CHECK(getMixedTrims() == 1 + (trimCommits - 1) % 2);
+
+	CHECK(writtenTime);
+	CHECK(writtenTime - commitTime >= 2 * WRITE_TIME);  // Both records, one after the other
+	CHECK(runsWhileWriting > 0);
+	CHECK(pitchWritten(pitchCoefficients[1]));
+	CHECK(!std::memcmp(nvm::get(nvm::options->trims), trims[1 + (trimCommits - 1) % 2], sizeof(trims[0])));
+}
+
+int main() {
+	host::simulate(STEP, [](uint64_t) {});
+	util::init();
+	nvm::load();
+
+	checkBlockingWrite();
+	checkBackgroundCommit();
+
+	return test::finish("nvm-commit");
+}
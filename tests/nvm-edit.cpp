@@ -0,0 +1,273 @@
+/*
+ * File:   nvm-edit.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 6:50 AM
+ */
+
+/* Requests setting options across several record pages, against the flash model of host/flash.cpp.
+ * The same requests are applied twice from an erased image, each time in a process of its own:
+ * - Like the transports, from a 1kHz task that retries pending requests and only commits
+ * - Waiting with nvm::write() whenever a request is pending, the way a blocking edit used to do it
+ * Both have to leave the same image, the task has to take no time, and the options loaded from the image
+ * have to match the requests.
+ */
+
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "data.hpp"
+#include "flash.hpp"
+#include "host.hpp"
+#include "nvm.hpp"
+#include "TaskScheduler.hpp"
+#include "test.hpp"
+
+constexpr static uint32_t STEP {100};     // us
+constexpr static uint32_t PERIOD {1000};  // us, the USB group
+constexpr static uint8_t  REQUEST_NUMBER {60};
+constexpr static uint8_t  REQUEST_SIZE {160};  // Data of a USB request
+
+static const data::VariableID edited[] {
+  data::VariableID::Mux,
+  data::VariableID::Trims,
+  data::VariableID::Limits,
+  data::VariableID::PIDs
+};
+constexpr static uint8_t EDITED_NUMBER {sizeof(edited) / sizeof(edited[0])};
+
+struct Request {
+	uint8_t count;
+	uint8_t slices[REQUEST_SIZE];
+};
+
+static Request  requests[REQUEST_NUMBER] {};
+static uint8_t  expected[EDITED_NUMBER][0xff] {};  // Responses once all requests are applied
+static uint32_t seed {2026};
+static char     paths[2][32] {"/tmp/nvm-edit-XXXXXX", "/tmp/nvm-edit-XXXXXX"};
+
+static TaskScheduler<uint8_t, 2> scheduler {};
+static uint8_t                   applied {0};
+static bool                      stored {false};  // The current request is set, but maybe not yet written
+static uint16_t                  retries {0};
+
+static uint32_t nextRandom() {
+	seed ^= seed << 13u;
+	seed ^= seed >> 17u;
+	seed ^= seed << 5u;
+	return seed;
+}
+
+static const data::Variable* variableOf(uint8_t edit) {
+	return data::getVariable(static_cast<uint8_t>(edited[edit]));
+}
+
+// A random slice of the mixes, which take three record pages, and sometimes one of another variable
+static void prepareRequests() {
+	for (uint8_t i {0}; i < EDITED_NUMBER; ++i) {
+		data::readVariable(variableOf(i), 0, variableOf(i)->size, expected[i]);
+	}
+
+	for (auto& request : requests) {
+		uint8_t position {0};
+
+		request.count = nextRandom() % 2 + 1;
+		for (uint8_t i {0}; i < request.count; ++i) {
+			uint8_t edit = i ? 1 + nextRandom() % (EDITED_NUMBER - 1) : 0;  // Never the same bytes twice
+			uint8_t size = variableOf(edit)->size - data::variableHeaderSize;
+			uint8_t offset = nextRandom() % size;
+			uint8_t length = 1 + nextRandom() % util::min<uint8_t>(size - offset, 64);
+
+			data::VariableSlice slice {static_cast<uint8_t>(edited[edit]), offset, length};
+			util::copy(request.slices + position, reinterpret_cast<const uint8_t*>(&slice), sizeof(slice));
+			position += sizeof(slice);
+
+			for (uint8_t j {0}; j < length; ++j) {
+				request.slices[position + j] = nextRandom();
+				expected[edit][data::variableHeaderSize + offset + j] = request.slices[position + j];
+			}
+			position += length;
+		}
+	}
+}
+
+static data::SetResult set(const Request& request) {
+	return data::setVariables(request.count, request.slices, sizeof(request.slices));
+}
+
+// The options of the request are in flash, read without the edits
+static bool written(const Request& request) {
+	uint8_t position {0};
+
+	for (uint8_t i {0}; i < request.count; ++i) {
+		auto*                 slice {reinterpret_cast<const data::VariableSlice*>(request.slices + position)};
+		const data::Variable* variable {data::getVariable(slice->variableID)};
+		position += sizeof(data::VariableSlice);
+
+		for (uint8_t j {0}; j < slice->length; ++j) {
+			uint8_t index = data::variableHeaderSize + slice->offset + j;
+
+			if (index >= variable->storedOffset
+			    && *nvm::get(variable->stored + (index - variable->storedOffset)) != request.slices[position + j]) {
+				return false;
+			}
+		}
+		position += slice->length;
+	}
+	return true;
+}
+
+// The USB group as far as the requests are concerned, one request at a time like a host waiting for the readback
+static void task() {
+	if (applied == REQUEST_NUMBER) {
+		return;
+	}
+
+	if (!stored) {
+		data::SetResult result {set(requests[applied])};
+
+		if (result != data::SetResult::NotStored) {
+			nvm::commit();
+		}
+		stored = result != data::SetResult::Pending;
+		retries += !stored;
+	} else if (!nvm::busy() && written(requests[applied])) {  // Reading the flash while it is busy would stall
+		++applied;
+		stored = false;
+	}
+}
+
+static void open(const char* path) {
+	if (!host::openFlash(path)) {
+		std::perror(path);
+		std::_Exit(2);
+	}
+	nvm::load();
+}
+
+static void applyInTask() {
+	test::failures = 0;  // Counted by the parent already
+	host::simulate(STEP, [](uint64_t) {});
+	util::init();
+	open(paths[0]);
+
+	scheduler.setClock(util::getMicros);
+	uint8_t id {scheduler.setInterval(util::getMicros(), PERIOD, task)};
+
+	while (applied < REQUEST_NUMBER && util::getMicros64() < 60000000) {
+		scheduler.execute(util::getMicros());
+		util::sleepUntil(scheduler.getNextTimestamp());
+	}
+
+	const auto& statistics {scheduler.getStatistics(id)};
+	std::printf(
+	    "Requests from the task: %u applied in %llu ms, %u retries, longest run %u us\n",
+	    applied,
+	    static_cast<unsigned long long>(util::getMicros64() / 1000),
+	    retries,
+	    statistics.maxTime
+	);
+	CHECK(applied == REQUEST_NUMBER);
+	CHECK(retries > 0);
+	CHECK(statistics.maxTime == 0);
+	CHECK(statistics.overruns == 0);
+
+	std::fflush(stdout);
+	std::_Exit(test::failures);
+}
+
+static void applyWaiting() {
+	test::failures = 0;
+	host::setFlashTiming(0, 0);
+	open(paths[1]);
+
+	for (const auto& request : requests) {
+		while (set(request) == data::SetResult::Pending) {
+			nvm::write();
+		}
+		nvm::write();
+	}
+
+	std::fflush(stdout);
+	std::_Exit(test::failures);
+}
+
+static void checkLoaded() {
+	test::failures = 0;
+	open(paths[0]);
+
+	for (uint8_t i {0}; i < EDITED_NUMBER; ++i) {  // Only the stored part, the rest of the PIDs response is in RAM
+		const data::Variable* variable {variableOf(i)};
+		uint8_t               response[0xff];
+
+		data::readVariable(variable, 0, variable->size, response);
+		CHECK(!std::memcmp(
+		    response + variable->storedOffset,
+		    expected[i] + variable->storedOffset,
+		    variable->size - variable->storedOffset
+		));
+	}
+
+	std::fflush(stdout);
+	std::_Exit(test::failures);
+}
+
+template <class F>
+static bool runProcess(F function) {
+	std::fflush(stdout);
+
+	pid_t pid {fork()};
+	if (!pid) {
+		function();
+	}
+
+	int status {0};
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool readImage(const char* path, uint8_t* image) {
+	FILE* file {std::fopen(path, "rb")};
+	if (!file) {
+		return false;
+	}
+
+	bool complete {std::fread(image, 1, flash::size, file) == flash::size};
+	std::fclose(file);
+	return complete;
+}
+
+int main() {
+	for (auto& path : paths) {
+		int file {mkstemp(path)};
+		if (file < 0) {
+			std::perror(path);
+			return 2;
+		}
+		close(file);
+	}
+
+	nvm::load();  // Erased, the defaults
+	prepareRequests();
+
+	CHECK(runProcess(applyInTask));
+	CHECK(runProcess(applyWaiting));
+	CHECK(runProcess(checkLoaded));
+
+	uint8_t images[2][flash::size];
+	if (CHECK(readImage(paths[0], images[0]) && readImage(paths[1], images[1]))) {
+		uint16_t differing {0};
+
+		for (uint16_t i {0}; i < flash::size; ++i) {
+			differing += images[0][i] != images[1][i];
+		}
+		std::printf("Images: %u of %u bytes differ\n", differing, flash::size);
+		CHECK(!differing);
+	}
+
+	for (const auto& path : paths) {
+		unlink(path);
+	}
+	return test::finish("nvm-edit");
+}
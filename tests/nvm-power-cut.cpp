@@ -0,0 +1,202 @@
+/*
+ * File:   nvm-power-cut.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 6:20 AM
+ */
+
+/* Power cuts in the middle of every flash command of a series of commits, against the flash model of
+ * host/flash.cpp. Every run starts from an erased image and is a process of its own that ends with the cut,
+ * then another process loads the image like the device after a reboot. Edits are written a record page at a time,
+ * so every page of an option has to hold either its value from before the interrupted commit or the new one,
+ * and the options have to be writable again afterwards.
+ * The commits rotate through the options, so the journal wraps around and rows are freed several times.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "flash.hpp"
+#include "host.hpp"
+#include "nvm.hpp"
+#include "test.hpp"
+
+constexpr static uint16_t COMMIT_NUMBER {40};
+constexpr static uint8_t  HEADER_SIZE {8};  // Record header ahead of the value in the first page, see src/nvm.cpp
+constexpr static uint32_t MAX_COMMANDS {2000};  // Ends the test if the journal never stops writing
+
+struct Option {
+	uint8_t offset;
+	uint8_t size;
+};
+
+#define OPTION(field) {offsetof(nvm::Options, field), sizeof(nvm::Options::field)}
+
+// Mixes take three record pages, the others one
+static const Option edited[] {
+  OPTION(angularRateOffsets),
+  OPTION(mixes),
+  OPTION(trims),
+  OPTION(limits),
+  OPTION(pidCoefficients)
+};
+constexpr static uint8_t EDITED_NUMBER {sizeof(edited) / sizeof(edited[0])};
+
+static uint8_t expected[COMMIT_NUMBER + 1][sizeof(nvm::Options)] {};  // Options after each commit
+static char    path[] {"/tmp/nvm-power-cut-XXXXXX"};
+
+static uint8_t valueOf(uint16_t commit, uint8_t position) {
+	return commit * 37 + position * 11 + 1;
+}
+
+static void prepareExpected() {
+	std::memcpy(expected[0], &nvm::_internal::defaults, sizeof(nvm::Options));
+
+	for (uint16_t commit {1}; commit <= COMMIT_NUMBER; ++commit) {
+		const Option& option {edited[commit % EDITED_NUMBER]};
+
+		std::memcpy(expected[commit], expected[commit - 1], sizeof(nvm::Options));
+		for (uint8_t i {0}; i < option.size; ++i) {
+			expected[commit][option.offset + i] = valueOf(commit, i);
+		}
+	}
+}
+
+static void loadImage() {
+	host::setFlashTiming(0, 0);
+	if (!host::openFlash(path)) {
+		std::perror(path);
+		std::_Exit(2);
+	}
+	nvm::load();
+}
+
+// Runs the commits until the power is cut, reporting each commit through the pipe before it starts
+static void runCommits(uint32_t cut, int report) {
+	loadImage();
+	host::cutFlashPower(cut, cut);
+
+	for (uint16_t commit {1}; commit <= COMMIT_NUMBER; ++commit) {
+		const Option& option {edited[commit % EDITED_NUMBER]};
+
+		if (write(report, &commit, sizeof(commit)) != sizeof(commit)) {
+			std::_Exit(2);
+		}
+		while (!nvm::_internal::edit(option.offset, expected[commit] + option.offset, option.size)) {
+			nvm::write();
+		}
+		nvm::write();
+	}
+	std::_Exit(0);
+}
+
+// Position of the first value byte of the record page after the one holding the position
+static uint8_t nextPage(uint8_t position) {
+	return (position + HEADER_SIZE) / flash::pageSize * flash::pageSize + flash::pageSize - HEADER_SIZE;
+}
+
+static bool matches(uint16_t commit, const Option& option, uint8_t start, uint8_t end) {
+	auto* value {nvm::get(reinterpret_cast<const uint8_t*>(nvm::options) + option.offset)};
+	return !std::memcmp(value + start, expected[commit] + option.offset + start, end - start);
+}
+
+static bool matches(uint16_t commit, const Option& option) {
+	return matches(commit, option, 0, option.size);
+}
+
+// Loads the image after a cut during the commit and checks the options, the exit status is the number of failures
+static void checkRecovery(uint16_t commit) {
+	test::failures = 0;  // Counted by the parent already
+	loadImage();
+
+	for (const auto& option : edited) {
+		for (uint8_t start {0}; start < option.size; start = nextPage(start)) {
+			uint8_t end {util::min(nextPage(start), option.size)};
+
+			if (!CHECK(matches(commit - 1, option, start, end) || matches(commit, option, start, end))) {
+				std::printf("Option at %u, bytes %u to %u\n", option.offset, start, end);
+			}
+		}
+	}
+
+	// Still writable
+	const Option& option {edited[commit % EDITED_NUMBER]};
+	while (!nvm::_internal::edit(option.offset, expected[0] + option.offset, option.size)) {
+		nvm::write();
+	}
+	nvm::write();
+	CHECK(matches(0, option));
+
+	std::fflush(stdout);
+	std::_Exit(test::failures);
+}
+
+template <class F>
+static int runProcess(F function) {
+	std::fflush(stdout);
+
+	pid_t pid {fork()};
+	if (!pid) {
+		function();
+	}
+
+	int status {0};
+	waitpid(pid, &status, 0);
+	return status;
+}
+
+int main() {
+	int file {mkstemp(path)};
+	if (file < 0) {
+		std::perror(path);
+		return 2;
+	}
+	close(file);
+	prepareExpected();
+
+	uint32_t cuts {0};
+	uint32_t cut {1};
+	for (; cut < MAX_COMMANDS; ++cut) {
+		int pipeFds[2];
+		if (pipe(pipeFds) || truncate(path, 0)) {
+			std::perror("nvm-power-cut");
+			return 2;
+		}
+
+		int status {runProcess([&]() {
+			close(pipeFds[0]);
+			runCommits(cut, pipeFds[1]);
+		})};
+		close(pipeFds[1]);
+
+		uint16_t commit {0};
+		uint16_t reported;
+		while (read(pipeFds[0], &reported, sizeof(reported)) == sizeof(reported)) {
+			commit = reported;
+		}
+		close(pipeFds[0]);
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {  // All commits done before the cut
+			break;
+		}
+		if (!CHECK(WIFEXITED(status) && WEXITSTATUS(status) == host::powerCutStatus && commit)) {
+			break;
+		}
+		++cuts;
+
+		status = runProcess([&]() {
+			checkRecovery(commit);
+		});
+		if (!CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+			std::printf("Cut in flash command %u during commit %u\n", cut, commit);
+		}
+	}
+
+	std::printf("Power cut in each of the %u flash commands of %u commits\n", cuts, COMMIT_NUMBER);
+	CHECK(cuts > COMMIT_NUMBER);
+	CHECK(cut < MAX_COMMANDS);
+	unlink(path);
+	return test::finish("nvm-power-cut");
+}
@@ -0,0 +1,209 @@
+/*
+ * File:   profiler.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 9:50 AM
+ */
+
+/* Profiler zones run on the host backend, with clock_gettime() replaced by a clock the test moves forward,
+ * so every run takes exactly the ticks it is given. The p99 of runs of one duration is the upper bound of the bucket
+ * they went into, for a random distribution it is the bound of the bucket of the real 99th percentile.
+ * Full buckets halve the others, zones past the table are not recorded, reset() keeps the names
+ * and a tick counter wrapping in the middle of a run still gives its duration.
+ * Also reports how long a zone takes with the real clock.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <dlfcn.h>
+#include <string>
+#include <vector>
+
+#include "profiler.hpp"
+#include "test.hpp"
+
+static bool     faked {false};
+static uint64_t now {0};  // ns
+
+// Takes the place of the one in libc, passes the call on while the clock is not faked
+extern "C" int clock_gettime(clockid_t clock, timespec* time) {
+	static auto real {reinterpret_cast<int (*)(clockid_t, timespec*)>(dlsym(RTLD_NEXT, "clock_gettime"))};
+
+	if (!faked) {
+		return real(clock, time);
+	}
+	time->tv_sec = static_cast<time_t>(now / 1000000000u);
+	time->tv_nsec = static_cast<long>(now % 1000000000u);
+	return 0;
+}
+
+static void run(uint8_t& zone, const char* name, uint32_t ticks) {
+	uint32_t start {profiler::begin()};
+
+	now += ticks;
+	profiler::end(zone, name, start);
+}
+
+// Upper bound of the half-octave the duration falls into, counted by hand
+static uint32_t getHalfOctaveLimit(uint32_t ticks) {
+	if (ticks < 96) {
+		return 96;
+	}
+	for (uint32_t limit {128}; limit <= (1u << 18); limit *= 2) {
+		if (ticks < limit * 3 / 4) {
+			return limit * 3 / 4;
+		}
+		if (ticks < limit) {
+			return limit;
+		}
+	}
+	return 1u << 18;
+}
+
+// With one longer run above the 99th percentile the p99 is not capped by the maximum
+static void checkBuckets(uint8_t& zone) {
+	for (uint32_t ticks : {1u,      63u,     64u,     95u,     96u,     127u,    128u,    191u,
+	                       192u,    1000u,   1024u,   1535u,   1536u,   196607u, 196608u, 262143u,
+	                       262144u, 500000u}) {
+		profiler::reset();
+		for (uint16_t i {0}; i < 200; ++i) {
+			run(zone, "buckets", ticks);
+		}
+		run(zone, "buckets", 1000000);
+
+		profiler::Statistics statistics {profiler::getStatistics(zone - 1)};
+		if (!CHECK(statistics.p99Time == getHalfOctaveLimit(ticks))) {
+			std::printf("%u ticks: p99 %u\n", ticks, statistics.p99Time);
+		}
+		CHECK(statistics.runs == 201);
+		CHECK(statistics.minTime == ticks);
+		CHECK(statistics.maxTime == 1000000);
+	}
+}
+
+// Exponentially distributed runs from a fixed seed, compared to their sorted durations
+static void checkPercentile() {
+	static uint8_t        zone {0};
+	std::vector<uint32_t> durations {};
+	uint32_t              state {0x2545f491};
+	uint64_t              total {0};
+
+	for (uint16_t i {0}; i < 10000; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		uint32_t ticks {500 + static_cast<uint32_t>(-2000 * std::log((state + 0.5) / 4294967296.0))};
+		durations.push_back(ticks);
+		total += ticks;
+		run(zone, "percentile", ticks);
+	}
+	std::sort(durations.begin(), durations.end());
+
+	profiler::Statistics statistics {profiler::getStatistics(zone - 1)};
+	uint32_t             percentile {durations[9899]};
+
+	CHECK(statistics.runs == 10000);
+	CHECK(statistics.minTime == durations.front());
+	CHECK(statistics.maxTime == durations.back());
+	CHECK(statistics.averageTime == total / 10000);
+	CHECK(statistics.p99Time == std::min(getHalfOctaveLimit(percentile), durations.back()));
+	CHECK(statistics.p99Time > percentile && statistics.p99Time <= percentile * 3 / 2);
+	std::printf("p99 of %u ticks reported as %u\n", percentile, statistics.p99Time);
+}
+
+// Once a bucket is full the older runs weigh half, without that the slow ones would still be over 1%
+static void checkHalving() {
+	static uint8_t zone {0};
+
+	for (uint16_t i {0}; i < 700; ++i) {
+		run(zone, "halving", 10000);
+	}
+	for (uint32_t i {0}; i < 67535; ++i) {
+		run(zone, "halving", 100);
+	}
+
+	profiler::Statistics statistics {profiler::getStatistics(zone - 1)};
+	CHECK(statistics.runs == 68235);
+	CHECK(statistics.p99Time == 128);
+	CHECK(statistics.maxTime == 10000);
+}
+
+// The counter passes 2^32 ns between the start and the end of the run
+static void checkWrap() {
+	static uint8_t zone {0};
+
+	now = (5ull << 32) - 100;
+	run(zone, "wrap", 300);
+
+	profiler::Statistics statistics {profiler::getStatistics(zone - 1)};
+	CHECK(statistics.runs == 1);
+	CHECK(statistics.minTime == 300 && statistics.maxTime == 300);
+}
+
+static void checkScope() {
+	uint8_t zone {profiler::getZoneCount()};
+
+	for (uint8_t i {0}; i < 3; ++i) {
+		PROFILE_ZONE("scope");
+		now += 5000;
+	}
+
+	profiler::Statistics statistics {profiler::getStatistics(zone)};
+	CHECK(profiler::getZoneCount() == zone + 1);
+	CHECK(statistics.name && std::string(statistics.name) == "scope");
+	CHECK(statistics.runs == 3);
+	CHECK(statistics.averageTime == 5000);
+}
+
+static void checkTable(uint8_t buckets) {
+	static uint8_t zones[2] {};
+
+	run(zones[0], "last", 1000);
+	CHECK(zones[0] == profiler::zoneNumber);
+
+	run(zones[1], "unrecorded", 1000);
+	run(zones[1], "unrecorded", 1000);
+	CHECK(zones[1] == 0xff);
+	CHECK(profiler::getZoneCount() == profiler::zoneNumber);
+	CHECK(profiler::getStatistics(profiler::zoneNumber).runs == 0);
+	CHECK(profiler::getStatistics(profiler::zoneNumber).name == nullptr);
+
+	// Names stay registered, the same IDs keep recording
+	profiler::reset();
+	for (uint8_t i {0}; i < profiler::zoneNumber; ++i) {
+		profiler::Statistics statistics {profiler::getStatistics(i)};
+		CHECK(statistics.name != nullptr);
+		CHECK(statistics.runs == 0 && statistics.maxTime == 0 && statistics.p99Time == 0);
+	}
+	run(zones[0], "last", 2000);
+	CHECK(profiler::getStatistics(profiler::zoneNumber - 1).runs == 1);
+	CHECK(profiler::getStatistics(profiler::zoneNumber - 1).maxTime == 2000);
+	CHECK(std::string(profiler::getStatistics(buckets - 1).name) == "buckets");
+}
+
+int main() {
+	static uint8_t buckets {0};
+
+	profiler::init();
+	faked = true;
+	now = 1000000000;
+
+	checkBuckets(buckets);
+	checkPercentile();
+	checkHalving();
+	checkWrap();
+	checkScope();
+	checkTable(buckets);
+
+	// A zone that is already registered, like all of them after the first run
+	faked = false;
+	double rate {test::measure([&]() {
+		profiler::end(buckets, "buckets", profiler::begin());
+	})};
+	std::printf("%.0f ns per zone\n", 1e9 / rate);
+
+	return test::finish("profiler");
+}
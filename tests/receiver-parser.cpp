@@ -0,0 +1,155 @@
+/*
+ * File:   receiver-parser.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 4:05 AM
+ */
+
+/* Receiver parsers fed with byte streams as the receivers send them, starting in the middle of a frame,
+ * one byte at a time like the UART interrupt does. Every stream holds two complete frames, the checksums were
+ * calculated separately from the parsers. Also reports how fast each parser goes through a stream of frames.
+ */
+
+#include <cstring>
+#include <vector>
+
+#include "ReceiverParser.hpp"
+#include "test.hpp"
+
+static const uint8_t sbusStream[] {
+	  0x00, 0x00, 0x0f, 0xe0, 0x03, 0x1f, 0x2b, 0xc0, 0x37, 0x71, 0x56, 0x80, 0x0f, 0x7c, 0xdc, 0x65,
+	  0x09, 0xf8, 0xc0, 0xc7, 0x8a, 0x89, 0x83, 0x0f, 0x7c, 0x00, 0x00, 0x0f, 0xe8, 0xa3, 0x1e, 0x96,
+	  0xc0, 0x37, 0x71, 0x56, 0x80, 0x0f, 0x7c, 0xdc, 0x65, 0x09, 0xf8, 0xc0, 0xc7, 0x8a, 0x89, 0x83,
+	  0x0f, 0x80, 0x0c, 0x00,
+};
+static const int16_t sbusChannels[] {11, -13, -478, 1, 1002, -1000, 1, 1, 622, -844, 1, 1, -1000, 1002, 1, 40};
+static const uint8_t crsfStream[] {
+	  0x1f, 0x2b, 0xc0, 0x37, 0x71, 0x56, 0x80, 0x0f, 0x7c, 0xdc, 0x65, 0x09, 0xf8, 0xc0, 0xc7, 0x8a,
+	  0x89, 0x83, 0x0f, 0x7c, 0x02, 0xc8, 0x18, 0x16, 0xe0, 0x03, 0x1f, 0x2b, 0xc0, 0x37, 0x71, 0x56,
+	  0x80, 0x0f, 0x7c, 0xdc, 0x65, 0x09, 0xf8, 0xc0, 0xc7, 0x8a, 0x89, 0x83, 0x0f, 0x7c, 0x02, 0xc8,
+	  0x0c, 0x14, 0x50, 0x52, 0x64, 0x0a, 0x00, 0x04, 0x02, 0x48, 0x64, 0x08, 0x36, 0xc8, 0x18, 0x16,
+	  0xe8, 0xa3, 0x1e, 0x96, 0xc0, 0x37, 0x71, 0x56, 0x80, 0x0f, 0x7c, 0xdc, 0x65, 0x09, 0xf8, 0xc0,
+	  0xc7, 0x8a, 0x89, 0x83, 0x0f, 0x80, 0x43,
+};
+static const int16_t crsfChannels[] {11, -13, -478, 1, 1002, -1000, 1, 1, 622, -844, 1, 1, -1000, 1002, 1, 40};
+static const uint8_t crsfLinkLost[] {
+	  0xc8, 0x0c, 0x14, 0x50, 0x52, 0x00, 0x0a, 0x00, 0x04, 0x02, 0x48, 0x64, 0x08, 0x34,
+};
+static const uint8_t ibusStream[] {
+	  0x4c, 0x04, 0xdc, 0x05, 0xdc, 0x05, 0xe8, 0x03, 0xd0, 0x07, 0xdd, 0xf3, 0x20, 0x40, 0xdc, 0x05,
+	  0xdc, 0x05, 0xe8, 0x03, 0xdc, 0x05, 0xd0, 0x07, 0xe8, 0x03, 0xdc, 0x05, 0xdc, 0x05, 0xd6, 0x06,
+	  0x4c, 0x04, 0xdc, 0x05, 0xdc, 0x05, 0xe8, 0x03, 0xd0, 0x07, 0xdd, 0xf3, 0x20, 0x40, 0xf0, 0x05,
+	  0xc8, 0x05, 0xb0, 0x04, 0xdc, 0x05, 0xd0, 0x07, 0xe8, 0x03, 0xdc, 0x05, 0xdc, 0x05, 0xd6, 0x06,
+	  0x4c, 0x04, 0xdc, 0x05, 0xdc, 0x05, 0xe8, 0x03, 0xd0, 0x07, 0x14, 0xf4,
+};
+static const int16_t ibusChannels[] {40, -40, -600, 0, 1000, -1000, 0, 0, 500, -800, 0, 0, -1000, 1000, 0, 0};
+static const uint8_t sumdStream[] {
+	  0x80, 0x2e, 0xe0, 0x2e, 0xe0, 0x24, 0x13, 0xa8, 0x01, 0x10, 0x2e, 0xe0, 0x2e, 0xe0, 0x1f, 0x40,
+	  0x2e, 0xe0, 0x3e, 0x80, 0x1f, 0x40, 0x2e, 0xe0, 0x2e, 0xe0, 0x36, 0xb0, 0x25, 0x80, 0x2e, 0xe0,
+	  0x2e, 0xe0, 0x1f, 0x40, 0x3e, 0x80, 0x2e, 0xe0, 0x2e, 0xe0, 0x24, 0x13, 0xa8, 0x81, 0x10, 0x2f,
+	  0x80, 0x2e, 0x3e, 0x25, 0x83, 0x2e, 0xe0, 0x3e, 0x80, 0x1f, 0x40, 0x2e, 0xe0, 0x2e, 0xe0, 0x36,
+	  0xb0, 0x25, 0x80, 0x2e, 0xe0, 0x2e, 0xe0, 0x1f, 0x40, 0x3e, 0x80, 0x2e, 0xe0, 0x2e, 0xe0, 0x35,
+	  0x4a,
+};
+static const int16_t sumdChannels[] {40, -40, -599, 0, 1000, -1000, 0, 0, 500, -600, 0, 0, -1000, 1000, 0, 0};
+
+struct Stream {
+	const char*    name;
+	const uint8_t* bytes;
+	size_t         size;
+	uint8_t        frameSize;  // Of the last frame
+	const int16_t* channels;   // Decoded from the last frame
+	uint8_t        flags;
+};
+
+static uint32_t feed(ReceiverParser& parser, const uint8_t* bytes, size_t size) {
+	uint32_t published {0};
+
+	for (size_t i {0}; i < size; ++i) {
+		published += parser.process(bytes[i]);
+	}
+	return published;
+}
+
+static bool matches(const ReceiverParser::Snapshot& snapshot, const int16_t* channels) {
+	return !std::memcmp(snapshot.channels, channels, sizeof(snapshot.channels));
+}
+
+template <class P>
+static void checkStream(const Stream& stream) {
+	P parser {};
+
+	// The last frame is only published with its last byte
+	CHECK(feed(parser, stream.bytes, stream.size - 1) == 1);
+	CHECK(!matches(parser.getSnapshot(), stream.channels));
+	CHECK(parser.process(stream.bytes[stream.size - 1]));
+	CHECK(matches(parser.getSnapshot(), stream.channels));
+	CHECK(parser.getSnapshot().flags == stream.flags);
+
+	const auto& statistics {parser.getStatistics()};
+	CHECK(statistics.bytes == stream.size);
+	CHECK(statistics.frames == 2);
+	CHECK(statistics.errors == 0);
+
+	// A corrupted frame is dropped and the previous one stays
+	std::vector<uint8_t> corrupted(stream.bytes, stream.bytes + stream.size);
+	corrupted.back() ^= 0x01;
+	parser.reset();
+	CHECK(!feed(parser, corrupted.data() + stream.size - stream.frameSize, stream.frameSize));
+	CHECK(matches(parser.getSnapshot(), stream.channels));
+	CHECK(statistics.errors == 1);
+
+	// And the parser picks up again with the next one
+	CHECK(feed(parser, stream.bytes + stream.size - stream.frameSize, stream.frameSize) == 1);
+	CHECK(statistics.frames == 3);
+}
+
+template <class P>
+static void measure(const Stream& stream) {
+	std::vector<uint8_t> bytes {};
+	P                    parser {};
+
+	while (bytes.size() < 65536) {
+		bytes.insert(bytes.end(), stream.bytes + stream.size - stream.frameSize, stream.bytes + stream.size);
+	}
+
+	double rate {test::measure([&]() {
+		feed(parser, bytes.data(), bytes.size());
+	})};
+	double byteRate {rate * bytes.size()};
+	std::printf(
+	    "%s: %.1f MB/s, %.1f ns per byte, %.0f ns per frame\n",
+	    stream.name,
+	    byteRate / 1e6,
+	    1e9 / byteRate,
+	    1e9 * stream.frameSize / byteRate
+	);
+	CHECK(parser.getStatistics().errors == 0);
+}
+
+int main() {
+	const uint8_t lostFlags {ReceiverParser::frameLostFlag | ReceiverParser::failsafeFlag};
+	Stream        sbus {"S.BUS", sbusStream, sizeof(sbusStream), 25, sbusChannels, lostFlags};
+	Stream        crsf {"CRSF", crsfStream, sizeof(crsfStream), 26, crsfChannels, 0};
+	Stream        ibus {"i-BUS", ibusStream, sizeof(ibusStream), 32, ibusChannels, 0};
+	Stream        sumd {"SUMD", sumdStream, sizeof(sumdStream), 37, sumdChannels, ReceiverParser::failsafeFlag};
+
+	checkStream<SBUSParser>(sbus);
+	checkStream<CRSFParser>(crsf);
+	checkStream<IBUSParser>(ibus);
+	checkStream<SUMDParser>(sumd);
+
+	// No link quality is failsafe until it comes back
+	CRSFParser parser {};
+	feed(parser, crsfLinkLost, sizeof(crsfLinkLost));
+	feed(parser, crsfStream + sizeof(crsfStream) - crsf.frameSize, crsf.frameSize);
+	CHECK(parser.getSnapshot().flags == ReceiverParser::failsafeFlag);
+	CHECK(matches(parser.getSnapshot(), crsfChannels));
+
+	measure<SBUSParser>(sbus);
+	measure<CRSFParser>(crsf);
+	measure<IBUSParser>(ibus);
+	measure<SUMDParser>(sumd);
+
+	return test::finish("receiver-parser");
+}
@@ -0,0 +1,160 @@
+/*
+ * File:   simulator-flight.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 9:00 AM
+ */
+
+/* Flights of the software-in-the-loop simulator, built next to the test as described in host/host.hpp and started
+ * like the tools start it, see tools/simulation.hpp. The default airframe and gains have to fly the step sequence
+ * and come back from the inverted orientation, a flight has to depend on nothing but its seed and the controller
+ * has to be the one flying: with the PIDs zeroed, the aircraft doesn't follow the roll step and the servos stay still.
+ * Gains that push away from the command have to end the flight as a crash.
+ * Also reports how much faster than real time the simulator flies.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "simulation.hpp"
+#include "test.hpp"
+
+constexpr static const char* FLIGHT_TIME {"FC_SIM_TIME=10"};
+
+static std::string         simulator {};
+static std::vector<char*>  environment {};
+static test::TempDirectory directory {};
+
+struct Flight {
+	bool        finished {false};
+	std::string result {};
+
+	float get(const char* name) const {
+		float value {-1};
+		simulation::getField(result, name, value);
+		return value;
+	}
+
+	// The result without the speedup, the only part that depends on the machine
+	std::string withoutSpeedup() const {
+		size_t start {result.find(" speedup=")};
+		size_t end {result.find(' ', start + 1)};
+		return start == std::string::npos ? result : result.substr(0, start) + result.substr(end);
+	}
+};
+
+static Flight fly(const std::vector<std::string>& variables) {
+	Flight flight {};
+
+	flight.finished = simulation::fly(simulator.c_str(), environment, variables, flight.result);
+	return flight;
+}
+
+static void checkFlight(const Flight& flight) {
+	std::printf("Default flight: %s", flight.result.c_str());
+	CHECK(flight.finished);
+	CHECK(flight.get("time") == 10.0f);
+	CHECK(flight.get("crashed") == 0);
+	CHECK(flight.get("roll_tracking") > 0 && flight.get("roll_tracking") < 20);
+	CHECK(flight.get("pitch_tracking") > 0 && flight.get("pitch_tracking") < 10);
+	CHECK(flight.get("roll_estimate") < 15);
+	CHECK(flight.get("pitch_estimate") < 10);
+	CHECK(flight.get("min_altitude") > 50);
+	std::printf("Simulated %.0f times faster than real time\n", flight.get("speedup"));  // Depends on the load
+}
+
+static void checkSeeds(const Flight& flight) {
+	std::string traces[2] {directory.pathOf("trace.csv"), directory.pathOf("again.csv")};
+
+	Flight again {fly({FLIGHT_TIME, "FC_SIM_SEED=1", std::string("FC_SIM_TRACE=") + traces[0]})};
+	Flight traced {fly({FLIGHT_TIME, "FC_SIM_SEED=1", std::string("FC_SIM_TRACE=") + traces[1]})};
+	Flight other {fly({FLIGHT_TIME, "FC_SIM_SEED=2"})};
+
+	CHECK(again.withoutSpeedup() == flight.withoutSpeedup());
+	CHECK(other.withoutSpeedup() != flight.withoutSpeedup());
+
+	// Every 10ms after the launch, with the header
+	std::string trace {test::readFile(traces[0])};
+	size_t      lines {0};
+	for (char c : trace) {
+		lines += c == '\n';
+	}
+	CHECK(lines >= 1000 && lines <= 1002);
+	CHECK(!trace.compare(0, 5, "time,"));
+	CHECK(trace == test::readFile(traces[1]));
+}
+
+// The roll of a trace at a time, NaN if the trace doesn't get there
+static float getRoll(const std::string& trace, const char* time) {
+	size_t line {trace.find(std::string("\n") + time + ',')};
+	float  roll {NAN};
+
+	if (line != std::string::npos) {
+		std::sscanf(trace.c_str() + trace.find(',', line) + 1, "%f", &roll);
+	}
+	return roll;
+}
+
+// The end of the 20 degree roll step: the controller holds it, without the PIDs the aircraft stays level
+static void checkController(const Flight& flight) {
+	std::string trace {directory.pathOf("controller.csv")};
+	std::string traced {std::string("FC_SIM_TRACE=") + trace};
+	Flight      controlled {fly({FLIGHT_TIME, "FC_SIM_SEED=1", traced})};
+	float       roll {getRoll(test::readFile(trace), "3.990")};
+	Flight      zeroed {fly({FLIGHT_TIME, "FC_SIM_SEED=1", "FC_SIM_PIDS=0,0,0,0,0,0,0,0,0", traced})};
+	float       zeroedRoll {getRoll(test::readFile(trace), "3.990")};
+
+	std::printf("Without the PIDs: %s", zeroed.result.c_str());
+	std::printf("Roll at the end of the step: %.1f deg, %.1f deg without the PIDs\n", roll, zeroedRoll);
+	CHECK(controlled.finished && zeroed.finished);
+	CHECK(roll > 15 && roll < 25);
+	CHECK(std::fabs(zeroedRoll) < 5);
+	CHECK(zeroed.get("effort") < 0.1f * flight.get("effort"));
+}
+
+// Gains that push away from the command, the flight has to end on the ground with the exit status of a crash
+static void checkCrash() {
+	Flight flight {fly({"FC_SIM_TIME=30", "FC_SIM_SEED=1", "FC_SIM_PIDS=-2000,0,0,-2000,0,0,0,0,0"})};
+
+	std::printf("Unstable gains: %s", flight.result.c_str());
+	CHECK(flight.finished);
+	CHECK(flight.get("crashed") == 1);
+	CHECK(flight.get("time") > 0 && flight.get("time") < 30);
+	CHECK(flight.get("min_altitude") <= 0);
+}
+
+// Coming back from the first inverted segment, whether the estimate holds through the later ones is reported only
+static void checkInverted() {
+	Flight flight {fly({"FC_SIM_TIME=12", "FC_SIM_SEED=1", "FC_SIM_SEQUENCE=inverted"})};
+
+	std::printf("Inverted sequence: %s", flight.result.c_str());
+	CHECK(flight.finished);
+	CHECK(flight.get("unrecovered") == 0);
+	CHECK(flight.get("recovery_time") > 0 && flight.get("recovery_time") < 2);
+}
+
+int main(int, char** argv) {
+	simulator = test::getTools(argv[0]) + "simulator";
+	environment = simulation::getEnvironment({});
+
+	if (access(simulator.c_str(), X_OK)) {
+		std::perror(simulator.c_str());
+		return 2;
+	}
+	if (!directory.create("simulator-flight")) {
+		return 2;
+	}
+
+	Flight flight {fly({FLIGHT_TIME, "FC_SIM_SEED=1"})};
+	checkFlight(flight);
+	checkSeeds(flight);
+	checkController(flight);
+	checkCrash();
+	checkInverted();
+
+	return test::finish("simulator-flight");
+}
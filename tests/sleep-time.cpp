@@ -0,0 +1,110 @@
+/*
+ * File:   sleep-time.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 8:40 AM
+ */
+
+/* Time spent asleep in util::sleepUntil(), which housekeeping reports as the sleep share of the Tasks variable.
+ * A 200Hz task keeps the CPU busy for 1ms, like one waiting for a peripheral, so the share has to be 80%
+ * in simulated time, where the task spins the simulated time forward. In real time the share is reported,
+ * it is close to 80% on an idle machine.
+ * Between the runs the loop has to sleep through until the next one, every wake-up runs the task on time.
+ * Each case is a process of its own, the clock can't go back from real to simulated time.
+ */
+
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "host.hpp"
+#include "TaskScheduler.hpp"
+#include "test.hpp"
+#include "util.hpp"
+
+constexpr static uint32_t STEP {100};      // us
+constexpr static uint32_t PERIOD {5000};   // us
+constexpr static uint32_t BUSY {1000};     // us
+constexpr static uint16_t RUN_NUMBER {200};
+
+static TaskScheduler<uint8_t, 2> scheduler {};
+static bool                      simulated {false};
+
+static void task() {
+	if (simulated) {
+		host::_internal::spin(BUSY);
+		return;
+	}
+
+	uint32_t start {util::getMicros()};
+	while (util::getMicros() - start < BUSY);
+}
+
+// The main loop for a number of runs, the exit status is the number of failures
+static void runLoop(const char* name) {
+	test::failures = 0;  // Counted by the parent already
+	util::init();
+	scheduler.setClock(util::getMicros);
+
+	uint32_t start {util::getMicros()};
+	uint8_t  id {scheduler.setInterval(start, PERIOD, task)};
+	uint16_t wakeUps {0};
+
+	while (scheduler.getStatistics(id).runs < RUN_NUMBER) {
+		scheduler.execute(util::getMicros());
+		util::sleepUntil(scheduler.getNextTimestamp());
+		++wakeUps;
+	}
+
+	// Ends right after the last run woke the loop up, like the busy time of the housekeeping period
+	uint32_t elapsed {util::getMicros() - start};
+	uint32_t sleepTime {util::getSleepTime()};
+	float    share = static_cast<float>(sleepTime) / elapsed;
+
+	const auto& statistics {scheduler.getStatistics(id)};
+	std::printf(
+	    "%s: %u us asleep of %u us, share %.1f%%, latest start %u us\n",
+	    name,
+	    sleepTime,
+	    elapsed,
+	    share * 100,
+	    statistics.maxLateness
+	);
+	CHECK(wakeUps == RUN_NUMBER + 1);  // Also the one before the first run
+	if (simulated) {
+		CHECK(sleepTime == PERIOD + RUN_NUMBER * (PERIOD - BUSY));
+		CHECK(statistics.maxLateness == 0);
+	} else {
+		CHECK(sleepTime < elapsed);  // The share itself depends on the load, reported only
+	}
+
+	std::fflush(stdout);
+	std::_Exit(test::failures);
+}
+
+template <class F>
+static bool runProcess(F function) {
+	std::fflush(stdout);
+
+	pid_t pid {fork()};
+	if (!pid) {
+		function();
+	}
+
+	int status {0};
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main() {
+	CHECK(runProcess([]() {
+		simulated = true;
+		host::simulate(STEP, [](uint64_t) {});
+		runLoop("Simulated time");
+	}));
+	CHECK(runProcess([]() {
+		runLoop("Real time");
+	}));
+
+	return test::finish("sleep-time");
+}
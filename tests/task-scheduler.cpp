@@ -0,0 +1,264 @@
+/*
+ * File:   task-scheduler.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 7:40 AM
+ */
+
+/* The heap of TaskScheduler against a plain list of the scheduled tasks: random timeouts, intervals and cancels
+ * have to run the tasks in the order of their timestamps, also across the overflow of the timestamps
+ * and of the clock the execution times are measured with. A task scheduled by a callback with the ID of the task
+ * that ran must not get the execution time of that run.
+ * Also reports how long a run of an interval task and a setTimeout() with its clearTimeout() take
+ * for 8 to 256 scheduled tasks.
+ */
+
+#include <utility>
+#include <vector>
+
+#include "TaskScheduler.hpp"
+#include "test.hpp"
+
+constexpr static uint16_t CAPACITY {256};
+constexpr static uint32_t OPERATION_NUMBER {20000};
+
+using Scheduler = TaskScheduler<uint16_t, CAPACITY>;
+
+struct Scheduled {
+	uint16_t id;
+	uint32_t timestamp;
+	uint32_t interval;
+};
+
+static uint32_t          seed {2026};
+static uint16_t          ran {0};  // Index of the last task that ran
+static uint32_t          runs {0};
+static volatile uint32_t sink {0};  // Keeps the measured calls from being optimized away
+
+static uint32_t ticks {0};  // A 24-bit clock like SysTick
+
+static uint32_t readTicks() {
+	return ticks;
+}
+
+// Takes 300 ticks
+static void spend() {
+	ticks = (ticks + 300) & 0xffffff;
+}
+
+static uint32_t nextRandom() {
+	seed ^= seed << 13u;
+	seed ^= seed >> 17u;
+	seed ^= seed << 5u;
+	return seed;
+}
+
+// A task of its own for every index, so the test knows which one ran
+template <uint16_t I>
+static void run() {
+	ran = I;
+	++runs;
+}
+
+template <uint16_t... I>
+constexpr static Scheduler::task_type tasks[] {run<I>...};
+
+template <uint16_t... I>
+constexpr static const Scheduler::task_type* makeTasks(std::integer_sequence<uint16_t, I...>) {
+	return tasks<I...>;
+}
+
+static const Scheduler::task_type* taskOf {makeTasks(std::make_integer_sequence<uint16_t, CAPACITY>())};
+
+static bool earlier(uint32_t a, uint32_t b) {
+	return static_cast<int32_t>(a - b) < 0;
+}
+
+// Schedules, cancels and runs tasks at random, the scheduler has to agree with the list after every step
+static void checkAgainstList(uint32_t start) {
+	static Scheduler       scheduler {};
+	std::vector<Scheduled> scheduled {};
+	uint32_t               now {start};
+	uint32_t               mismatches {0};
+	uint16_t               rejected {0};
+
+	scheduler.reset();
+	for (uint32_t i {0}; i < OPERATION_NUMBER; ++i) {
+		uint32_t operation {nextRandom() % 8};
+
+		if (operation < 4) {  // Schedule
+			bool     interval {operation < 2};
+			uint32_t delay {1 + nextRandom() % 5000};
+			uint16_t id {interval ? scheduler.setInterval(now, delay, run<0>) : scheduler.setTimeout(now, delay, run<0>)};
+
+			if (!id) {
+				rejected += scheduled.size() == CAPACITY;
+				mismatches += scheduled.size() != CAPACITY;
+				continue;
+			}
+			for (const auto& task : scheduled) {
+				mismatches += task.id == id;  // IDs of scheduled tasks are not given out again
+			}
+			// The task only identifies itself by its callback, so it is scheduled again with the one of its ID
+			scheduler.clearTimeout(id);
+			uint16_t again {interval ? scheduler.setInterval(now, delay, taskOf[id - 1])
+			                         : scheduler.setTimeout(now, delay, taskOf[id - 1])};
+			mismatches += again != id;  // The ID just freed is the first given out
+			scheduled.push_back({id, now + delay, interval ? delay : 0});
+		} else if (operation < 5 && !scheduled.empty()) {  // Cancel
+			size_t index {nextRandom() % scheduled.size()};
+
+			scheduler.clearInterval(scheduled[index].id);
+			scheduled.erase(scheduled.begin() + index);
+		} else {  // Let time pass and run the tasks due
+			uint32_t until {now + nextRandom() % 2000};
+
+			while (!scheduler.empty() && !earlier(until, scheduler.getNextTimestamp())) {
+				uint32_t timestamp {scheduler.getNextTimestamp()};
+				size_t   first {0};
+
+				for (size_t j {1}; j < scheduled.size(); ++j) {
+					first = earlier(scheduled[j].timestamp, scheduled[first].timestamp) ? j : first;
+				}
+				mismatches += scheduled[first].timestamp != timestamp;
+
+				now = timestamp + nextRandom() % 3;  // Sometimes a little late
+				Scheduler::task_type cb {scheduler.getNextTask(now)};
+				if (!cb) {
+					++mismatches;
+					break;
+				}
+				cb();
+
+				// Any of the tasks due at the same time may go first
+				auto task {scheduled.begin()};
+				while (task != scheduled.end() && (task->id != ran + 1 || task->timestamp != timestamp)) {
+					++task;
+				}
+				if (task == scheduled.end()) {
+					++mismatches;
+					break;
+				}
+				if (task->interval) {
+					task->timestamp += ((now - task->timestamp) / task->interval + 1) * task->interval;
+				} else {
+					scheduled.erase(task);
+				}
+			}
+			now = earlier(now, until) ? until : now;
+		}
+
+		mismatches += scheduler.size() != scheduled.size();
+	}
+
+	CHECK(!mismatches);
+	CHECK(scheduler.size() == scheduled.size());
+	CHECK(rejected > 0);  // Intervals are scheduled more often than cancelled, so the scheduler fills up
+}
+
+static void checkIntervals() {
+	TaskScheduler<uint8_t, 4> scheduler {};
+	uint8_t                   id {scheduler.setInterval(0xffffff00, 100, run<1>)};
+
+	// Runs on its grid across the overflow, missed runs are skipped and counted
+	scheduler.execute(0xffffff63);
+	CHECK(runs == 0);
+	scheduler.execute(0xffffff64);
+	CHECK(runs == 1);
+	CHECK(scheduler.getNextTimestamp() == 0xffffffc8);
+	scheduler.execute(0x00000150);
+	CHECK(runs == 2);
+	CHECK(scheduler.getNextTimestamp() == 0x00000158);
+	CHECK(scheduler.getStatistics(id).overruns == 3);
+	CHECK(scheduler.getStatistics(id).maxLateness == 0x150 - 0xffffffc8);
+
+	// Full at the capacity, IDs come back once cleared
+	CHECK(scheduler.setTimeout(0, 10, run<2>) == 2);
+	CHECK(scheduler.setTimeout(0, 10, run<2>) == 3);
+	CHECK(scheduler.setTimeout(0, 10, run<2>) == 4);
+	CHECK(scheduler.setTimeout(0, 10, run<2>) == 0);
+	scheduler.clearTimeout(3);
+	scheduler.clearTimeout(3);  // Already cleared, nothing happens
+	scheduler.clearTimeout(0);
+	scheduler.clearTimeout(5);
+	CHECK(scheduler.size() == 3);
+	CHECK(scheduler.setTimeout(0, 10, run<2>) == 3);
+	runs = 0;
+}
+
+static TaskScheduler<uint8_t, 2> clocked {};
+
+// Takes 300 ticks and schedules another task, which gets the ID of a timeout that is done
+static void spendAndSchedule() {
+	spend();
+	clocked.setTimeout(20, 10, run<3>);
+}
+
+// Execution times only keep the bits of the clock, so they are right across its wrap.
+// The run of a task is not recorded for another task the callback gave its ID to.
+static void checkClock() {
+	TaskScheduler<uint8_t, 2>& scheduler {clocked};
+	uint8_t                    id {scheduler.setTimeout(0, 10, spend)};
+
+	scheduler.setClock(readTicks, 0xffffff);
+	ticks = 0xffff00;
+	scheduler.execute(10);
+	CHECK(ticks < 0x100);
+	CHECK(scheduler.getStatistics(id).runs == 1);
+	CHECK(scheduler.getStatistics(id).lastTime == 300);
+
+	CHECK(scheduler.setTimeout(10, 10, spendAndSchedule) == id);
+	scheduler.execute(20);
+	CHECK(scheduler.size() == 1);
+	CHECK(scheduler.getStatistics(id).runs == 0);
+	scheduler.execute(30);
+	CHECK(ran == 3);
+	CHECK(scheduler.getStatistics(id).runs == 1);
+	CHECK(scheduler.getStatistics(id).lastTime == 0);
+	runs = 0;
+}
+
+static void measure() {
+	static Scheduler scheduler {};
+
+	for (uint16_t count {8}; count <= CAPACITY; count *= 2) {
+		uint32_t now {0};
+
+		scheduler.reset();
+		for (uint16_t i {0}; i < count - 1; ++i) {  // Periods of 1 to 20ms, one slot left for the timeouts
+			scheduler.setInterval(now, 1000 + nextRandom() % 19000, run<0>);
+		}
+
+		uint32_t calls {0};
+		runs = 0;
+		double rate {test::measure([&]() {
+			now = scheduler.getNextTimestamp();
+			scheduler.execute(now);
+			++calls;
+		})};
+		double perRun {1e9 / rate * calls / runs};
+
+		double timeouts {test::measure([&]() {
+			uint16_t id {scheduler.setTimeout(now, nextRandom() % 20000, run<0>)};
+			sink = sink + id;
+			scheduler.clearTimeout(id);
+		})};
+
+		std::printf(
+		    "%3u tasks: %.0f ns per run of an interval task, %.0f ns per setTimeout() and clearTimeout()\n",
+		    count,
+		    perRun,
+		    1e9 / timeouts
+		);
+	}
+}
+
+int main() {
+	checkIntervals();
+	checkClock();
+	checkAgainstList(0);
+	checkAgainstList(0xfff00000);  // Timestamps overflow during the run
+	measure();
+
+	return test::finish("task-scheduler");
+}
@@ -0,0 +1,179 @@
+/*
+ * File:   test.hpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 4:00 AM
+ */
+
+#ifndef TEST_HPP
+#define TEST_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Checks for the host tests in this directory, every test is a program of its own that exits with 1 if a check
+ * failed. Failed checks are printed with their location and the test goes on, so one run shows all of them.
+ */
+
+#define CHECK(condition) test::check((condition), #condition, __FILE__, __LINE__)
+
+namespace test {
+	inline unsigned checks {0};
+	inline unsigned failures {0};
+
+	inline bool check(bool passed, const char* condition, const char* file, int line) {
+		++checks;
+		if (!passed) {
+			++failures;
+			std::printf("%s:%d: check failed: %s\n", file, line, condition);
+		}
+		return passed;
+	}
+
+	// Prints the summary, the return value is the exit status
+	inline int finish(const char* name) {
+		std::printf("%s: %u checks, %u failed\n", name, checks, failures);
+		return failures ? 1 : 0;
+	}
+
+	// Calls the function until the duration has passed, returns the number of calls per second
+	template <class F>
+	double measure(F function, double seconds = 0.2) {
+		auto     start {std::chrono::steady_clock::now()};
+		double   elapsed {0};
+		uint64_t calls {0};
+
+		do {
+			for (uint16_t i {0}; i < 64; ++i) {
+				function();
+			}
+			calls += 64;
+			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (elapsed < seconds);
+		return calls / elapsed;
+	}
+
+	// Runs a program and reads what it prints, returns its exit status or -1 if it didn't exit
+	inline int run(const std::vector<std::string>& arguments, std::string& output) {
+		std::vector<char*> argv {};
+		for (const auto& argument : arguments) {
+			argv.push_back(const_cast<char*>(argument.c_str()));
+		}
+		argv.push_back(nullptr);
+
+		int fds[2];
+		if (pipe(fds)) {
+			return -1;
+		}
+		std::fflush(stdout);
+
+		pid_t pid {fork()};
+		if (!pid) {
+			dup2(fds[1], STDOUT_FILENO);
+			close(fds[0]);
+			close(fds[1]);
+			execv(argv[0], argv.data());
+			std::_Exit(127);
+		}
+		close(fds[1]);
+
+		char    buffer[4096];
+		ssize_t length;
+		output.clear();
+		while ((length = read(fds[0], buffer, sizeof(buffer))) > 0) {
+			output.append(buffer, length);
+		}
+		close(fds[0]);
+
+		int status {0};
+		waitpid(pid, &status, 0);
+		return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	}
+
+	// The tools/ directory next to the test program, where the Makefile builds the programs the tests start
+	inline std::string getTools(const char* program) {
+		std::string path {program};
+		return path.substr(0, path.rfind('/') + 1) + "tools/";
+	}
+
+	// The whole file, empty if it can't be read
+	inline std::string readFile(const std::string& path) {
+		std::string content {};
+		FILE*       file {std::fopen(path.c_str(), "rb")};
+		char        buffer[4096];
+		size_t      length;
+
+		if (!file) {
+			return content;
+		}
+		while ((length = std::fread(buffer, 1, sizeof(buffer), file))) {
+			content.append(buffer, length);
+		}
+		std::fclose(file);
+		return content;
+	}
+
+	inline bool writeFile(const std::string& path, const std::string& content) {
+		FILE* file {std::fopen(path.c_str(), "wb")};
+
+		if (!file) {
+			return false;
+		}
+		bool written {std::fwrite(content.data(), 1, content.size(), file) == content.size()};
+		return !std::fclose(file) && written;
+	}
+
+	/* A directory in /tmp for the files of a test, removed with everything in it when the test ends.
+	 * Only created by create(), programs that are also started as something else don't leave one behind.
+	 */
+	class TempDirectory {
+	public:
+		TempDirectory() = default;
+		TempDirectory(const TempDirectory&) = delete;
+		TempDirectory& operator=(const TempDirectory&) = delete;
+
+		~TempDirectory() {
+			DIR* dir {_path.empty() ? nullptr : opendir(_path.c_str())};
+
+			if (!dir) {
+				return;
+			}
+			while (dirent* entry {readdir(dir)}) {
+				if (std::string(entry->d_name) != "." && std::string(entry->d_name) != "..") {
+					unlink(pathOf(entry->d_name).c_str());
+				}
+			}
+			closedir(dir);
+			rmdir(_path.c_str());
+		}
+
+		// Prints the error if the directory can't be created
+		bool create(const char* name) {
+			std::string path {std::string("/tmp/") + name + "-XXXXXX"};
+
+			if (!mkdtemp(&path[0])) {
+				std::perror(path.c_str());
+				return false;
+			}
+			_path = path;
+			return true;
+		}
+
+		std::string pathOf(const char* name) const {
+			return _path + '/' + name;
+		}
+
+	protected:
+		std::string _path {};
+	};
+}
+
+#endif /* TEST_HPP */
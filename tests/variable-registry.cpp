@@ -0,0 +1,240 @@
+/*
+ * File:   variable-registry.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 5:20 AM
+ */
+
+/* Variables accessed through the registry the way the transports do it, with the options in the flash model
+ * of the host, which starts erased, and the subscriptions of the streams.
+ * Also reports how long looking up a variable and copying its response takes.
+ */
+
+#include <cstring>
+
+#include "data.hpp"
+#include "nvm.hpp"
+#include "test.hpp"
+
+static volatile uint32_t sink {0};  // Keeps the measured calls from being optimized away
+
+template <class T>
+static const uint8_t* bytes(const T& value) {
+	return reinterpret_cast<const uint8_t*>(&value);
+}
+
+// The response of every variable starts with its ID, also for the variables read from flash
+static void checkHeaders() {
+	for (uint8_t i {0}; i < data::variableNumber; ++i) {
+		const data::Variable* variable {data::getVariable(i)};
+		uint8_t               header[data::variableHeaderSize];
+
+		if (!CHECK(variable)) {
+			continue;
+		}
+		data::readVariable(variable, 0, sizeof(header), header);
+		CHECK(header[0] == static_cast<uint8_t>(data::ResponseType::ReturnVariable));
+		CHECK(header[1] == i);
+	}
+	CHECK(!data::getVariable(data::variableNumber));
+	CHECK(!data::getVariable(0xff));
+}
+
+static void checkAccess() {
+	// Not writable
+	int16_t status[3] {1, 2, 3};
+	CHECK(
+	    data::setVariable(static_cast<uint8_t>(data::VariableID::Status), 0, sizeof(status), bytes(status))
+	    == data::SetResult::NotStored
+	);
+	CHECK(data::usbStatusResponse.yaw == 0);
+
+	// Kept in RAM and in the options
+	InlinePID<float>::PIDCoefficients coefficients {1.5f, 0.25f, 0.125f};
+	uint8_t                           offset = offsetof(data::USBPIDsResponse, coefficients) - data::variableHeaderSize
+	                            + sizeof(coefficients);
+	CHECK(
+	    data::setVariable(static_cast<uint8_t>(data::VariableID::PIDs), offset, sizeof(coefficients), bytes(coefficients))
+	    == data::SetResult::Stored
+	);
+	nvm::write();
+	CHECK(!std::memcmp(&data::usbPIDsResponse.coefficients[1], &coefficients, sizeof(coefficients)));
+	CHECK(!std::memcmp(nvm::get(nvm::options->pidCoefficients + 1), &coefficients, sizeof(coefficients)));
+
+	// Only in flash, edits are read back before they are written
+	int16_t trims[data::outputChannelNumber] {10, -20, 30, -40, 50, -60, 70, -80};
+	CHECK(
+	    data::setVariable(static_cast<uint8_t>(data::VariableID::Trims), 0, sizeof(trims), bytes(trims))
+	    == data::SetResult::Stored
+	);
+
+	data::USBTrimsResponse response {};
+	data::readVariable(
+	    data::getVariable(static_cast<uint8_t>(data::VariableID::Trims)),
+	    0,
+	    sizeof(response),
+	    reinterpret_cast<uint8_t*>(&response)
+	);
+	CHECK(!std::memcmp(response.trims, trims, sizeof(trims)));
+	CHECK(!std::memcmp(nvm::get(nvm::options->trims), nvm::_internal::defaults.trims, sizeof(trims)));
+	nvm::write();
+	CHECK(!std::memcmp(nvm::get(nvm::options->trims), trims, sizeof(trims)));
+
+	// The mixer works from a copy, taken between cycles once the record is written
+	CHECK(data::trims[7][0] == 0);
+	data::updateOptions();
+	CHECK(data::trims[7][0] == -80);
+
+	// Out of range
+	CHECK(
+	    data::setVariable(static_cast<uint8_t>(data::VariableID::Trims), sizeof(trims), 2, bytes(trims))
+	    == data::SetResult::NotStored
+	);
+	CHECK(data::setVariable(data::variableNumber, 0, 2, bytes(trims)) == data::SetResult::NotStored);
+
+	// Another record page while one is edited, nothing of it is taken until the edited page is written
+	int16_t values[2] {1000, -1000};
+	CHECK(
+	    data::setVariable(static_cast<uint8_t>(data::VariableID::Trims), 0, sizeof(values), bytes(values))
+	    == data::SetResult::Stored
+	);
+	CHECK(
+	    data::setVariable(static_cast<uint8_t>(data::VariableID::Mux), 0, sizeof(values), bytes(values))
+	    == data::SetResult::Pending
+	);
+	CHECK(nvm::read(reinterpret_cast<const uint8_t*>(nvm::options->mixes)) == 0);
+	nvm::write();
+	CHECK(
+	    data::setVariable(static_cast<uint8_t>(data::VariableID::Mux), 0, sizeof(values), bytes(values))
+	    == data::SetResult::Stored
+	);
+	nvm::write();
+	CHECK(nvm::get(nvm::options->mixes)[0] == 1000);
+	CHECK(nvm::get(nvm::options->trims)[0] == 1000);
+}
+
+static void checkBatches() {
+	// Limits of the first output and the last trim in one request
+	uint8_t request[2 * sizeof(data::VariableSlice) + 6] {};
+	auto*   slice {reinterpret_cast<data::VariableSlice*>(request)};
+	*slice = {static_cast<uint8_t>(data::VariableID::Limits), 0, 4};
+	int16_t limits[2] {-500, 600};
+	std::memcpy(request + sizeof(data::VariableSlice), limits, sizeof(limits));
+	slice = reinterpret_cast<data::VariableSlice*>(request + sizeof(data::VariableSlice) + sizeof(limits));
+	*slice = {static_cast<uint8_t>(data::VariableID::Trims), 14, 2};
+	int16_t trim {123};
+	std::memcpy(request + 2 * sizeof(data::VariableSlice) + sizeof(limits), &trim, sizeof(trim));
+
+	CHECK(data::setVariables(2, request, sizeof(request)) == data::SetResult::Pending);  // Two records
+	nvm::write();
+	CHECK(data::setVariables(2, request, sizeof(request)) == data::SetResult::Stored);
+	nvm::write();
+	CHECK(nvm::get(nvm::options->limits)[0] == -500);
+	CHECK(nvm::get(nvm::options->limits)[1] == 600);
+	CHECK(nvm::get(nvm::options->trims)[7] == 123);
+
+	// The same slices read back, the length of the second one is up to the end of the variable
+	data::VariableSlice slices[2] {
+	  {static_cast<uint8_t>(data::VariableID::Limits), 0,  4},
+	  {static_cast<uint8_t>(data::VariableID::Trims),  14, 0}
+	};
+	uint8_t response[64] {};
+	uint8_t size {data::getVariables(2, slices, response, sizeof(response))};
+
+	CHECK(size == sizeof(data::USBVariablesResponse) + sizeof(request));
+	CHECK(response[1] == 2);
+	CHECK(!std::memcmp(response + sizeof(data::USBVariablesResponse), request, sizeof(request)));
+
+	// Slices that don't fit are left out
+	CHECK(data::getVariables(2, slices, response, 12) == sizeof(data::USBVariablesResponse) + 7);
+	CHECK(response[1] == 1);
+}
+
+static void checkSubscriptions() {
+	data::Stream stream {};
+	uint8_t      statusSize {data::getVariable(static_cast<uint8_t>(data::VariableID::Status))->size};
+	uint8_t      muxSize {data::getVariable(static_cast<uint8_t>(data::VariableID::Mux))->size};
+
+	// Variables that don't fit into a frame are skipped, unknown ones too
+	data::USBSubscribeRequest request {200, {static_cast<uint8_t>(data::VariableID::Mux), 0xff, 0, 1}};
+	data::subscribe(stream, 4, bytes(request), sizeof(request), sizeof(data::USBStreamFrame) + muxSize - 1);
+	CHECK(stream.count == 2);
+	CHECK(stream.variableIDs[0] == 0 && stream.variableIDs[1] == 1);
+	CHECK(stream.period == 5000);
+
+	data::subscribe(stream, 4, bytes(request), sizeof(request), sizeof(data::USBStreamFrame) + statusSize);
+	CHECK(stream.count == 1);
+
+	// Only as many variables as the request holds, nothing at all from a request without the rate
+	data::subscribe(stream, 4, bytes(request), sizeof(request.rate) + 1, 0xff);
+	CHECK(stream.count == 1);
+	CHECK(stream.variableIDs[0] == static_cast<uint8_t>(data::VariableID::Mux));
+	data::subscribe(stream, 4, bytes(request), 1, 0xff);
+	CHECK(stream.count == 1);
+
+	// Frames stay on the period grid, late ones don't delay the next and missed ones are skipped
+	stream.lastFrame = 0;
+	CHECK(!data::streamDue(stream, 4999));
+	CHECK(data::streamDue(stream, 5300));
+	CHECK(!data::streamDue(stream, 9999));
+	CHECK(data::streamDue(stream, 10000));
+	CHECK(data::streamDue(stream, 27000));
+	CHECK(stream.lastFrame == 25000);
+
+	request.rate = 0;
+	data::subscribe(stream, 0, bytes(request), sizeof(request), 0xff);
+	CHECK(!stream.count);
+	CHECK(!data::streamDue(stream, 100000));
+}
+
+static void measure() {
+	double lookups {test::measure([]() {
+		for (uint8_t i {0}; i < data::variableNumber; ++i) {
+			sink = sink + data::getVariable(i)->size;
+		}
+	})};
+	std::printf("Lookup: %.1f ns per variable\n", 1e9 / lookups / data::variableNumber);
+
+	struct {
+		const char*     name;
+		data::VariableID id;
+	} copies[] {
+	  {"Status",        data::VariableID::Status},
+	  {"PIDs",          data::VariableID::PIDs  },
+	  {"Mixes (flash)", data::VariableID::Mux   }
+	};
+	for (const auto& copy : copies) {
+		const data::Variable* variable {data::getVariable(static_cast<uint8_t>(copy.id))};
+		uint8_t               response[0xff];
+
+		double rate {test::measure([&]() {
+			data::readVariable(variable, 0, variable->size, response);
+			sink = sink + response[variable->size - 1];
+		})};
+		std::printf("%s: %u bytes in %.0f ns\n", copy.name, variable->size, 1e9 / rate);
+	}
+
+	data::VariableSlice slices[4] {
+	  {static_cast<uint8_t>(data::VariableID::Status),  0, 0},
+	  {static_cast<uint8_t>(data::VariableID::Sensors), 0, 0},
+	  {static_cast<uint8_t>(data::VariableID::Outputs), 0, 0},
+	  {static_cast<uint8_t>(data::VariableID::Trims),   0, 0}
+	};
+	uint8_t response[160];
+	double  rate {test::measure([&]() {
+		sink = sink + data::getVariables(4, slices, response, sizeof(response));
+	})};
+	std::printf("Batch of 4 variables: %.0f ns\n", 1e9 / rate);
+}
+
+int main() {
+	nvm::load();
+
+	checkHeaders();
+	checkAccess();
+	checkBatches();
+	checkSubscriptions();
+	measure();
+
+	return test::finish("variable-registry");
+}
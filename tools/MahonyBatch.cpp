@@ -0,0 +1,147 @@
+#include "MahonyBatch.hpp"
+
+
+using namespace lanes;
+
+MahonyBatch::MahonyBatch(uint32_t size, float Kp, float Ki):
+  _twoKp(toPadded(size), Kp * 2.0f),
+  _twoKi(toPadded(size), Ki * 2.0f),
+  _quats {size},
+  _integralFBx(toPadded(size), 0.0f),
+  _integralFBy(toPadded(size), 0.0f),
+  _integralFBz(toPadded(size), 0.0f) {
+	// Nothing to do
+}
+
+uint32_t MahonyBatch::getSize() const {
+	return _quats.getSize();
+}
+
+void MahonyBatch::updateIMU(const float* const rot[3], const float* const acc[3], const float* dt) {
+	uint32_t size {_quats.getSize()};
+	float    padded[7][width] {};  // The last vector reads past the arrays of the samples
+
+	for (uint32_t i {0}; i < size; i += width) {
+		Float r[3];
+		Float a[3];
+		Float t;
+
+		if (i + width <= size) {
+			for (uint8_t j {0}; j < 3; ++j) {
+				r[j] = load(rot[j] + i);
+				a[j] = load(acc[j] + i);
+			}
+			t = load(dt + i);
+		} else {
+			for (uint32_t k {0}; k < size - i; ++k) {
+				for (uint8_t j {0}; j < 3; ++j) {
+					padded[j][k] = rot[j][i + k];
+					padded[j + 3][k] = acc[j][i + k];
+				}
+				padded[6][k] = dt[i + k];
+			}
+			for (uint8_t j {0}; j < 3; ++j) {
+				r[j] = load(padded[j]);
+				a[j] = load(padded[j + 3]);
+			}
+			t = load(padded[6]);
+		}
+		update(i, r, a, t);
+	}
+}
+
+void MahonyBatch::updateIMU(const Vector3<float, uint8_t>& rot, const Vector3<float, uint8_t>& acc, float dt) {
+	Float r[3] {broadcast(rot[0][0]), broadcast(rot[1][0]), broadcast(rot[2][0])};
+	Float a[3] {broadcast(acc[0][0]), broadcast(acc[1][0]), broadcast(acc[2][0])};
+	Float t {broadcast(dt)};
+
+	for (uint32_t i {0}; i < _twoKp.size(); i += width) {
+		Float rc[3] {r[0], r[1], r[2]};
+		Float ac[3] {a[0], a[1], a[2]};
+
+		update(i, rc, ac, t);
+	}
+}
+
+// Mahony::updateIMU() with the branches turned into masks, the operations in the same order
+void MahonyBatch::update(uint32_t i, Float rot[3], Float acc[3], Float dt) {
+	Float w {load(_quats.getW() + i)};
+	Float x {load(_quats.getX() + i)};
+	Float y {load(_quats.getY() + i)};
+	Float z {load(_quats.getZ() + i)};
+
+	for (uint8_t j {0}; j < 3; ++j) {
+		rot[j] = rot[j] * broadcast(F_DEG_TO_RAD);
+	}
+
+	// util::abs(a) < 1e-5 compares in double, 1e-5f is the largest float below 1e-5
+	Float limit {broadcast(1e-5f)};
+	Mask  valid {!((abs(acc[0]) <= limit) & (abs(acc[1]) <= limit) & (abs(acc[2]) <= limit))};
+
+	Float recipNorm {invSqrt(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2])};
+	for (uint8_t j {0}; j < 3; ++j) {
+		acc[j] = acc[j] * recipNorm;
+	}
+
+	Float halfvx {x * z - w * y};
+	Float halfvy {w * x + y * z};
+	Float halfvz {w * w - broadcast(0.5f) + z * z};
+
+	Float halfe[3] {
+	  acc[1] * halfvz - acc[2] * halfvy, acc[2] * halfvx - acc[0] * halfvz, acc[0] * halfvy - acc[1] * halfvx
+	};
+
+	Float  twoKp {load(&_twoKp[i])};
+	Float  twoKi {load(&_twoKi[i])};
+	Mask   integral {twoKi > broadcast(0.0f)};
+	float* integralFB[3] {&_integralFBx[i], &_integralFBy[i], &_integralFBz[i]};
+
+	for (uint8_t j {0}; j < 3; ++j) {
+		Float previous {load(integralFB[j])};
+		Float feedback {select(integral, previous + twoKi * halfe[j] * dt, broadcast(0.0f))};
+		Float corrected {select(integral, rot[j] + feedback, rot[j])};
+
+		store(integralFB[j], select(valid, feedback, previous));
+		rot[j] = select(valid, corrected + twoKp * halfe[j], rot[j]);
+	}
+
+	Float halfDt {broadcast(0.5f) * dt};
+	for (uint8_t j {0}; j < 3; ++j) {
+		rot[j] = rot[j] * halfDt;
+	}
+
+	Float nw {w + (-x * rot[0] - y * rot[1] - z * rot[2])};
+	Float nx {x + (w * rot[0] + y * rot[2] - z * rot[1])};
+	Float ny {y + (w * rot[1] - x * rot[2] + z * rot[0])};
+	Float nz {z + (w * rot[2] + x * rot[1] - y * rot[0])};
+	Float norm {invSqrt(nw * nw + nx * nx + ny * ny + nz * nz)};
+
+	store(_quats.getW() + i, nw * norm);
+	store(_quats.getX() + i, nx * norm);
+	store(_quats.getY() + i, ny * norm);
+	store(_quats.getZ() + i, nz * norm);
+}
+
+float MahonyBatch::getKp(uint32_t index) const {
+	return _twoKp[index] / 2.0f;
+}
+
+float MahonyBatch::getKi(uint32_t index) const {
+	return _twoKi[index] / 2.0f;
+}
+
+void MahonyBatch::setKp(uint32_t index, float Kp) {
+	_twoKp[index] = Kp * 2.0f;
+}
+
+void MahonyBatch::setKi(uint32_t index, float Ki) {
+	_twoKi[index] = Ki * 2.0f;
+}
+
+const QuaternionBatch& MahonyBatch::getQuaternions() const {
+	return _quats;
+}
+
+QuaternionBatch& MahonyBatch::getQuaternions() {
+	return _quats;
+}
@@ -0,0 +1,53 @@
+/*
+ * File:   MahonyBatch.hpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 2:20 AM
+ */
+
+#ifndef MAHONYBATCH_HPP
+#define MAHONYBATCH_HPP
+
+#include <vector>
+
+#include "Mahony.hpp"
+#include "QuaternionBatch.hpp"
+
+/* Many independent Mahony filters updated a vector at a time, each with its own gains, for replaying
+ * and sweeping on the host. The filters are stored as arrays of each state variable, see lanes.hpp.
+ * Every filter gives the same bits as Mahony::updateIMU() with the same gains and samples when both are built
+ * with -ffp-contract=off, see tools/mahony-batch.cpp.
+ */
+
+class MahonyBatch {
+public:
+	explicit MahonyBatch(uint32_t size, float Kp = Mahony::defaultKp, float Ki = Mahony::defaultKi);
+
+	uint32_t getSize() const;
+
+	// Every filter with its own samples, arrays of each axis, dps, any unit of acceleration and s
+	void updateIMU(const float* const rot[3], const float* const acc[3], const float* dt);
+	// All filters with the same sample
+	void updateIMU(const Vector3<float, uint8_t>& rot, const Vector3<float, uint8_t>& acc, float dt);
+
+	float getKp(uint32_t index) const;
+	float getKi(uint32_t index) const;
+	void  setKp(uint32_t index, float Kp);
+	void  setKi(uint32_t index, float Ki);
+
+	const QuaternionBatch& getQuaternions() const;
+	QuaternionBatch&       getQuaternions();
+
+protected:
+	// Arrays padded to whole vectors, like the quaternions
+	std::vector<float> _twoKp;
+	std::vector<float> _twoKi;
+	QuaternionBatch    _quats;
+	std::vector<float> _integralFBx;
+	std::vector<float> _integralFBy;
+	std::vector<float> _integralFBz;
+
+	void update(uint32_t i, lanes::Float rot[3], lanes::Float acc[3], lanes::Float dt);
+};
+
+#endif /* MAHONYBATCH_HPP */
@@ -0,0 +1,100 @@
+#include "QuaternionBatch.hpp"
+
+#include <cmath>
+
+
+using namespace lanes;
+
+QuaternionBatch::QuaternionBatch(uint32_t size):
+  _size {size},
+  _w(toPadded(size), 1.0f),
+  _x(toPadded(size), 0.0f),
+  _y(toPadded(size), 0.0f),
+  _z(toPadded(size), 0.0f) {
+	// Nothing to do
+}
+
+uint32_t QuaternionBatch::getSize() const {
+	return _size;
+}
+
+Quaternion QuaternionBatch::get(uint32_t index) const {
+	return {_w[index], _x[index], _y[index], _z[index]};
+}
+
+void QuaternionBatch::set(uint32_t index, const Quaternion& quat) {
+	_w[index] = quat.getW();
+	_x[index] = quat.getX();
+	_y[index] = quat.getY();
+	_z[index] = quat.getZ();
+}
+
+void QuaternionBatch::normalize() {
+	for (uint32_t i {0}; i < _w.size(); i += width) {
+		Float w {load(&_w[i])};
+		Float x {load(&_x[i])};
+		Float y {load(&_y[i])};
+		Float z {load(&_z[i])};
+		Float norm {invSqrt(w * w + x * x + y * y + z * z)};
+
+		store(&_w[i], w * norm);
+		store(&_x[i], x * norm);
+		store(&_y[i], y * norm);
+		store(&_z[i], z * norm);
+	}
+}
+
+void QuaternionBatch::conjugate() {
+	for (uint32_t i {0}; i < _w.size(); i += width) {
+		store(&_x[i], -load(&_x[i]));
+		store(&_y[i], -load(&_y[i]));
+		store(&_z[i], -load(&_z[i]));
+	}
+}
+
+void QuaternionBatch::multiply(const QuaternionBatch& a, const QuaternionBatch& b, QuaternionBatch& result) {
+	for (uint32_t i {0}; i < result._w.size(); i += width) {
+		Float aw {load(&a._w[i])};
+		Float ax {load(&a._x[i])};
+		Float ay {load(&a._y[i])};
+		Float az {load(&a._z[i])};
+		Float bw {load(&b._w[i])};
+		Float bx {load(&b._x[i])};
+		Float by {load(&b._y[i])};
+		Float bz {load(&b._z[i])};
+
+		store(&result._w[i], aw * bw - ax * bx - ay * by - az * bz);
+		store(&result._x[i], aw * bx + ax * bw + ay * bz - az * by);
+		store(&result._y[i], aw * by - ax * bz + ay * bw + az * bx);
+		store(&result._z[i], aw * bz + ax * by - ay * bx + az * bw);
+	}
+}
+
+void QuaternionBatch::toEuler(float* yaw, float* pitch, float* roll) const {
+	for (uint32_t i {0}; i < _size; ++i) {
+		float w {_w[i]};
+		float x {_x[i]};
+		float y {_y[i]};
+		float z {_z[i]};
+
+		roll[i] = atan2f(2.0f * (w * x + y * z), 1.0f - 2.0f * (x * x + y * y));
+		pitch[i] = asinf(2.0f * (w * y - z * x));
+		yaw[i] = atan2f(2.0f * (w * z + x * y), 1.0f - 2.0f * (y * y + z * z));
+	}
+}
+
+float* QuaternionBatch::getW() {
+	return _w.data();
+}
+
+float* QuaternionBatch::getX() {
+	return _x.data();
+}
+
+float* QuaternionBatch::getY() {
+	return _y.data();
+}
+
+float* QuaternionBatch::getZ() {
+	return _z.data();
+}
@@ -0,0 +1,53 @@
+/*
+ * File:   QuaternionBatch.hpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 2:10 AM
+ */
+
+#ifndef QUATERNIONBATCH_HPP
+#define QUATERNIONBATCH_HPP
+
+#include <vector>
+
+#include "lanes.hpp"
+#include "Quaternion.hpp"
+
+/* Many quaternions stored as arrays of each component, processed a vector at a time, see lanes.hpp.
+ * Gives the same results as Quaternion for every element.
+ */
+
+class QuaternionBatch {
+public:
+	explicit QuaternionBatch(uint32_t size);  // Identity rotations
+
+	uint32_t getSize() const;
+
+	// Normalized again like every Quaternion, compare the components for the exact values
+	Quaternion get(uint32_t index) const;
+	void       set(uint32_t index, const Quaternion& quat);
+
+	void normalize();
+	void conjugate();
+
+	// Element by element a * b, rotation b followed by a, the result may be one of them
+	static void multiply(const QuaternionBatch& a, const QuaternionBatch& b, QuaternionBatch& result);
+
+	// Tait-Bryan angles into arrays of the size of the batch, one element at a time through the math library
+	void toEuler(float* yaw, float* pitch, float* roll) const;
+
+	// Components padded to whole vectors
+	float* getW();
+	float* getX();
+	float* getY();
+	float* getZ();
+
+protected:
+	uint32_t           _size;
+	std::vector<float> _w;
+	std::vector<float> _x;
+	std::vector<float> _y;
+	std::vector<float> _z;
+};
+
+#endif /* QUATERNIONBATCH_HPP */
@@ -0,0 +1,385 @@
+/*
+ * File:   blackbox-decoder.cpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 4:05 PM
+ */
+
+/* Host tool for blackbox logs recorded by the firmware, uses the same frame definitions and codec.
+ * Build on Linux from the repository root with:
+ *   g++ -std=c++17 -O2 -pthread -Iinc -o blackbox-decoder tools/blackbox-decoder.cpp src/BlackboxCodec.cpp
+ *
+ * The log is memory-mapped and split at keyframes, each segment between two keyframes decodes on its own,
+ * so segments are spread across threads and the results are written in order.
+ * Keyframes are found by scanning for the sync sequence and checking the CRC, the index can be printed with -i.
+ * Time ranges (-s, -e) only decode the segments that overlap them, selected fields (-f) are the only
+ * ones converted and written. Delta frames still have to be read whole, that is how their size is known.
+ *
+ * Output is CSV on stdout, or with -c, one little-endian binary file per field in the given directory.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BlackboxCodec.hpp"
+
+enum class FieldType : uint8_t {
+	U32,
+	U16,
+	I16
+};
+
+struct Field {
+	std::string name;
+	uint8_t     word;
+	FieldType   type;
+};
+
+struct Keyframe {
+	size_t   offset;
+	uint32_t time;
+};
+
+struct Options {
+	const char*        columnDir {nullptr};
+	bool               printIndex {false};
+	uint32_t           start {0};
+	uint32_t           end {UINT32_MAX};
+	unsigned           threadNumber {std::max(std::thread::hardware_concurrency(), 1u)};
+	std::vector<Field> fields {};
+};
+
+constexpr static size_t BATCH_SEGMENTS {256};  // Segments decoded per thread before writing out
+
+static void addField(std::vector<Field>& fields, const char* name, size_t offset, size_t size, FieldType type) {
+	size_t elementSize {type == FieldType::U32 ? sizeof(uint32_t) : sizeof(uint16_t)};
+	size_t count {size / elementSize};
+
+	for (size_t i {0}; i < count; ++i) {
+		fields.push_back({count == 1 ? name : std::string(name) + '[' + std::to_string(i) + ']',
+		                  static_cast<uint8_t>((offset + i * elementSize) / sizeof(uint16_t)),
+		                  type});
+	}
+}
+
+#define FIELD(name, type) addField(fields, #name, offsetof(BlackboxFrame, name), sizeof(BlackboxFrame::name), type)
+
+static std::vector<Field> allFields() {
+	std::vector<Field> fields {};
+
+	FIELD(time, FieldType::U32);
+	FIELD(loopTime, FieldType::U16);
+	FIELD(status, FieldType::U16);
+	FIELD(accelerations, FieldType::I16);
+	FIELD(angularRates, FieldType::I16);
+	FIELD(attitude, FieldType::I16);
+	FIELD(channels, FieldType::I16);
+	FIELD(pidTerms, FieldType::I16);
+	FIELD(outputs, FieldType::I16);
+	FIELD(taskTimes, FieldType::U16);
+	FIELD(setpoint, FieldType::I16);
+	FIELD(intervals, FieldType::U16);
+	return fields;
+}
+
+#undef FIELD
+
+static uint32_t fieldValue(const BlackboxFrame& frame, const Field& field) {
+	auto* words {reinterpret_cast<const uint16_t*>(&frame)};
+
+	switch (field.type) {
+		case FieldType::U32:
+			return words[field.word] | (static_cast<uint32_t>(words[field.word + 1]) << 16u);
+		case FieldType::U16:
+			return words[field.word];
+		case FieldType::I16:
+		default:
+			return static_cast<int16_t>(words[field.word]);
+	}
+}
+
+// Keyframes starting within [from, to), a keyframe may run past the end
+static void findKeyframes(const uint8_t* log, size_t size, size_t from, size_t to, std::vector<Keyframe>& dest) {
+	BlackboxDecoder decoder {};
+	size_t          searchEnd {std::min(size, to + BlackboxCodec::maxFrameSize)};
+
+	for (size_t i {from}; i < to;) {
+		i += BlackboxDecoder::findKeyframe(log + i, searchEnd - i);
+		if (i >= to) {
+			break;
+		}
+
+		decoder.decode(log + i, size - i);
+		dest.push_back({i, decoder.getFrame().time});
+		++i;
+	}
+}
+
+static std::vector<Keyframe> buildIndex(const uint8_t* log, size_t size, unsigned threadNumber) {
+	std::vector<std::vector<Keyframe>> parts(threadNumber);
+	std::vector<std::thread>           threads {};
+	size_t                             partSize {size / threadNumber + 1};
+
+	for (unsigned i {0}; i < threadNumber; ++i) {
+		size_t from {std::min(size, i * partSize)};
+		size_t to {std::min(size, from + partSize)};
+
+		threads.emplace_back(findKeyframes, log, size, from, to, std::ref(parts[i]));
+	}
+
+	std::vector<Keyframe> index {};
+	for (unsigned i {0}; i < threadNumber; ++i) {
+		threads[i].join();
+		index.insert(index.end(), parts[i].begin(), parts[i].end());
+	}
+	return index;
+}
+
+// Decodes frames from one keyframe up to the next one, stopping at an invalid frame
+template <class Callback>
+static void decodeSegment(const uint8_t* log, size_t from, size_t to, Callback callback) {
+	BlackboxDecoder decoder {};
+
+	while (from < to) {
+		size_t length {decoder.decode(log + from, to - from)};
+
+		if (!length) {
+			break;
+		}
+		callback(decoder.getFrame());
+		from += length;
+	}
+}
+
+static void writeCSVHeader(const Options& options) {
+	for (size_t i {0}; i < options.fields.size(); ++i) {
+		std::fputs(options.fields[i].name.c_str(), stdout);
+		std::fputc(i + 1 < options.fields.size() ? ',' : '\n', stdout);
+	}
+}
+
+static void decodeCSV(const uint8_t* log, size_t from, size_t to, const Options& options, std::string& dest) {
+	char number[16];
+
+	decodeSegment(log, from, to, [&](const BlackboxFrame& frame) {
+		if (frame.time < options.start || frame.time > options.end) {
+			return;
+		}
+
+		for (size_t i {0}; i < options.fields.size(); ++i) {
+			const Field& field {options.fields[i]};
+			uint32_t     value {fieldValue(frame, field)};
+
+			int length {field.type == FieldType::I16 ? std::snprintf(number, sizeof(number), "%d", static_cast<int32_t>(value))
+			                                         : std::snprintf(number, sizeof(number), "%u", value)};
+			dest.append(number, length);
+			dest.push_back(i + 1 < options.fields.size() ? ',' : '\n');
+		}
+	});
+}
+
+static void decodeColumns(
+    const uint8_t* log, size_t from, size_t to, const Options& options, std::vector<std::string>& dest
+) {
+	decodeSegment(log, from, to, [&](const BlackboxFrame& frame) {
+		if (frame.time < options.start || frame.time > options.end) {
+			return;
+		}
+
+		for (size_t i {0}; i < options.fields.size(); ++i) {
+			const Field& field {options.fields[i]};
+			uint32_t     value {fieldValue(frame, field)};
+
+			dest[i].append(reinterpret_cast<const char*>(&value), field.type == FieldType::U32 ? 4 : 2);
+		}
+	});
+}
+
+static bool parseOptions(int argc, char** argv, Options& options, const char*& path) {
+	std::vector<Field> fields {allFields()};
+	int                opt;
+
+	while ((opt = getopt(argc, argv, "c:e:f:ij:s:")) != -1) {
+		switch (opt) {
+			case 'c':
+				options.columnDir = optarg;
+				break;
+			case 'e':
+				options.end = std::strtoul(optarg, nullptr, 0);
+				break;
+			case 'f': {
+				std::string list {optarg};
+
+				for (size_t start {0}; start <= list.size();) {
+					size_t      end {std::min(list.find(',', start), list.size())};
+					std::string name {list.substr(start, end - start)};
+					size_t      before {options.fields.size()};
+
+					for (const auto& field : fields) {  // A name without an index selects the whole array
+						if (field.name == name || field.name.compare(0, name.size() + 1, name + '[') == 0) {
+							options.fields.push_back(field);
+						}
+					}
+					if (options.fields.size() == before) {
+						std::fprintf(stderr, "Unknown field: %s\n", name.c_str());
+						return false;
+					}
+					start = end + 1;
+				}
+				break;
+			}
+			case 'i':
+				options.printIndex = true;
+				break;
+			case 'j':
+				options.threadNumber = std::max(std::atoi(optarg), 1);
+				break;
+			case 's':
+				options.start = std::strtoul(optarg, nullptr, 0);
+				break;
+			default:
+				return false;
+		}
+	}
+
+	if (optind != argc - 1) {
+		return false;
+	}
+	if (options.fields.empty()) {
+		options.fields = fields;
+	}
+	path = argv[optind];
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options     options {};
+	const char* path {nullptr};
+
+	if (!parseOptions(argc, argv, options, path)) {
+		std::fprintf(
+		    stderr,
+		    "Usage: %s [-i] [-j threads] [-f field,...] [-s start ms] [-e end ms] [-c column directory] log\n",
+		    argv[0]
+		);
+		return 2;
+	}
+
+	int fd {open(path, O_RDONLY)};
+	if (fd < 0) {
+		std::perror(path);
+		return 1;
+	}
+
+	struct stat status {};
+	fstat(fd, &status);
+	size_t size {static_cast<size_t>(status.st_size)};
+
+	if (!size) {
+		close(fd);
+		return 0;
+	}
+
+	auto* log {static_cast<const uint8_t*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0))};
+	close(fd);
+	if (log == MAP_FAILED) {
+		std::perror(path);
+		return 1;
+	}
+	madvise(const_cast<uint8_t*>(log), size, MADV_SEQUENTIAL);
+
+	std::vector<Keyframe> index {buildIndex(log, size, options.threadNumber)};
+
+	if (options.printIndex) {
+		std::printf("offset,time\n");
+		for (const auto& keyframe : index) {
+			std::printf("%zu,%u\n", keyframe.offset, keyframe.time);
+		}
+		return 0;
+	}
+
+	// Segments that may hold frames in the time range: from the last keyframe before the start
+	// to the first keyframe after the end
+	size_t first {0};
+	size_t last {index.size()};
+	while (first + 1 < index.size() && index[first + 1].time <= options.start) {
+		++first;
+	}
+	for (size_t i {first}; i < index.size(); ++i) {
+		if (index[i].time > options.end) {
+			last = i;
+			break;
+		}
+	}
+
+	std::vector<FILE*> columns {};
+	if (options.columnDir) {
+		for (const auto& field : options.fields) {
+			std::string fieldPath {std::string(options.columnDir) + '/' + field.name + ".bin"};
+			FILE*       file {std::fopen(fieldPath.c_str(), "wb")};
+
+			if (!file) {
+				std::perror(fieldPath.c_str());
+				return 1;
+			}
+			columns.push_back(file);
+		}
+	} else {
+		writeCSVHeader(options);
+	}
+
+	size_t batchSize {options.threadNumber * BATCH_SEGMENTS};
+
+	for (size_t batch {first}; batch < last; batch += batchSize) {
+		size_t                                batchEnd {std::min(last, batch + batchSize)};
+		std::vector<std::string>              text(options.threadNumber);
+		std::vector<std::vector<std::string>> data(options.threadNumber, std::vector<std::string>(options.fields.size()));
+		std::vector<std::thread>              threads {};
+		size_t                                perThread {(batchEnd - batch + options.threadNumber - 1) / options.threadNumber};
+
+		for (unsigned t {0}; t < options.threadNumber; ++t) {
+			size_t from {std::min(batchEnd, batch + t * perThread)};
+			size_t to {std::min(batchEnd, from + perThread)};
+
+			threads.emplace_back([&, t, from, to]() {
+				for (size_t i {from}; i < to; ++i) {
+					size_t end {i + 1 < index.size() ? index[i + 1].offset : size};
+
+					if (options.columnDir) {
+						decodeColumns(log, index[i].offset, end, options, data[t]);
+					} else {
+						decodeCSV(log, index[i].offset, end, options, text[t]);
+					}
+				}
+			});
+		}
+
+		for (unsigned t {0}; t < options.threadNumber; ++t) {
+			threads[t].join();
+
+			if (options.columnDir) {
+				for (size_t i {0}; i < columns.size(); ++i) {
+					std::fwrite(data[t][i].data(), 1, data[t][i].size(), columns[i]);
+				}
+			} else {
+				std::fwrite(text[t].data(), 1, text[t].size(), stdout);
+			}
+		}
+	}
+
+	for (auto* file : columns) {
+		std::fclose(file);
+	}
+	munmap(const_cast<uint8_t*>(log), size);
+	return 0;
+}
@@ -0,0 +1,372 @@
+/*
+ * File:   blackbox-replay.cpp
+ * Author: Mikhail
+ *
+ * Created on October 19, 2026, 11:40 PM
+ */
+
+/* Host tool that replays blackbox logs through the flight logic and compares the results with the recorded ones.
+ * Linked with the host drivers instead of main.cpp, build from the repository root with:
+ *   g++ -std=gnu++17 -O2 -ffp-contract=off -DPROFILING=false -Ihost -Iinc -o blackbox-replay \
+ *       tools/blackbox-replay.cpp host/analog.cpp host/flash.cpp host/i2c.cpp host/servo.cpp host/uart.cpp \
+ *       host/usb.cpp host/util.cpp src/AttitudeEstimator.cpp src/BlackboxCodec.cpp src/CompanionCodec.cpp \
+ *       src/LSM6DSO32.cpp src/Madgwick.cpp src/Mahony.cpp src/Quaternion.cpp src/ReceiverParser.cpp \
+ *       src/blackbox.cpp src/companion.cpp src/data.cpp src/flight.cpp src/nvm.cpp src/profiler.cpp src/receiver.cpp
+ * Fused multiply-adds would round differently from the device, hence -ffp-contract=off. The profiling zones
+ * would read the clock a few times per frame for nothing.
+ *
+ * Every frame is one control cycle. The raw IMU samples are written into the simulated LSM6DSO32 and read through
+ * its driver, the recorded commands and intervals are passed to the flight logic like the main loop does,
+ * then the attitude, the flight mode, the PID terms and the outputs are compared with the recorded ones.
+ * The options (gyroscope offsets, PIDs, mixes) are taken from a flash image like the one the host build keeps,
+ * a blank flash is used without one.
+ *
+ * The state of the flight logic is only known from the start, so a log has to begin at power-on. After a gap,
+ * a lost or corrupted frame, the replay stops and the rest of the log is not compared.
+ * Logs built on the host replay bit-exactly. Logs from the device may differ in the last bit where the math library
+ * does, the -t option sets the difference in LSB that is still accepted.
+ *
+ * The flight logic keeps its state in statics, so every log is replayed in a process of its own, up to -j at a time.
+ * Logs are memory-mapped and decoded in one pass. The results are printed in the order of the logs,
+ * the exit status is 1 if any frame differed and 2 if a log could not be read.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "BlackboxCodec.hpp"
+#include "flight.hpp"
+#include "host.hpp"
+#include "LSM6DSO32.hpp"
+#include "nvm.hpp"
+
+constexpr static float ATT_LSB {10430.0f};  // Same as the companion setpoints
+
+struct Options {
+	const char* flash {nullptr};
+	unsigned    jobNumber {std::max(std::thread::hardware_concurrency(), 1u)};
+	int         tolerance {0};  // LSB
+	size_t      reported {10};  // Differing frames printed per log
+};
+
+struct Compared {
+	const char* name;
+	size_t      offset;
+	size_t      count;
+};
+
+#define COMPARED(name) {#name, offsetof(BlackboxFrame, name), sizeof(BlackboxFrame::name) / sizeof(int16_t)}
+
+static const Compared compared[] {COMPARED(attitude), COMPARED(pidTerms), COMPARED(outputs)};
+
+#undef COMPARED
+
+struct Result {
+	size_t   frames {0};
+	size_t   differing {0};
+	size_t   skipped {0};  // Bytes before the first keyframe
+	bool     gap {false};
+	uint32_t gapTime {0};  // ms
+};
+
+// Runs one control cycle from the recorded inputs and writes the results into a frame
+static void replay(const BlackboxFrame& frame, BlackboxFrame& result) {
+	// Back to the sensor axes, see updateSensors() and LSM6DSO32::getRawAccelerations()
+	int16_t accelerations[3] {
+	  static_cast<int16_t>(-frame.accelerations[2]),
+	  static_cast<int16_t>(-frame.accelerations[1]),
+	  frame.accelerations[0]
+	};
+	int16_t angularRates[3] {
+	  static_cast<int16_t>(-frame.angularRates[2]),
+	  static_cast<int16_t>(-frame.angularRates[1]),
+	  frame.angularRates[0]
+	};
+
+	host::getIMU().setAccelerations(accelerations);
+	host::getIMU().setAngularRates(angularRates);
+	LSM6DSO32::update();
+	flight::updateAttitude(LSM6DSO32::getAngularRates(), LSM6DSO32::getAccelerations(), frame.intervals[0]);
+
+	flight::Commands commands {};
+
+	for (uint8_t i {0}; i < ReceiverParser::channelNumber; ++i) {
+		commands.channels[i] = frame.channels[i];
+	}
+	commands.receiverAvailable = frame.status & 0x1u;
+	commands.failsafeActive = frame.status & 0x2u;
+	commands.setpointActive = frame.status & 0x4u;
+	if (commands.setpointActive) {
+		commands.setpointPitch = frame.setpoint[0] / ATT_LSB;
+		commands.setpointHeading = frame.setpoint[1] / ATT_LSB;
+	}
+
+	flight::updateControl(commands, frame.intervals[1]);
+	flight::updateOutputs(commands);
+
+	result = {};
+	flight::writeResults(result);
+}
+
+// Appends the differences to the report, returns true if there were any
+static bool compare(
+    const BlackboxFrame& frame, const BlackboxFrame& result, const Options& options, bool report, std::string& dest
+) {
+	char line[96];
+	bool differs {false};
+
+	if (frame.status >> 8u != result.status >> 8u) {
+		differs = true;
+		if (report) {
+			std::snprintf(
+			    line, sizeof(line), "  %u ms: mode %u, replayed %u\n", frame.time, frame.status >> 8u, result.status >> 8u
+			);
+			dest += line;
+		}
+	}
+
+	for (const auto& field : compared) {
+		auto* logged {reinterpret_cast<const int16_t*>(reinterpret_cast<const uint8_t*>(&frame) + field.offset)};
+		auto* replayed {reinterpret_cast<const int16_t*>(reinterpret_cast<const uint8_t*>(&result) + field.offset)};
+
+		for (size_t i {0}; i < field.count; ++i) {
+			if (std::abs(logged[i] - replayed[i]) <= options.tolerance) {
+				continue;
+			}
+
+			differs = true;
+			if (report) {
+				std::snprintf(
+				    line, sizeof(line), "  %u ms: %s[%zu] %d, replayed %d\n", frame.time, field.name, i, logged[i], replayed[i]
+				);
+				dest += line;
+			}
+		}
+	}
+	return differs;
+}
+
+// The recorded intervals must account for the time between the frames, otherwise frames are missing
+static bool continuous(const BlackboxFrame& previous, const BlackboxFrame& frame) {
+	int64_t elapsed {static_cast<int64_t>(frame.time - previous.time) * 1000};
+
+	return frame.intervals[0] != 0xffff && std::llabs(elapsed - frame.intervals[0]) <= 2000;  // Times are whole ms
+}
+
+static Result replayLog(const uint8_t* log, size_t size, const Options& options, std::string& report) {
+	Result          result {};
+	BlackboxDecoder decoder {};
+	BlackboxFrame   previous {};
+	BlackboxFrame   replayed {};
+	size_t          offset {BlackboxDecoder::findKeyframe(log, size)};
+
+	result.skipped = offset;
+	while (offset < size) {
+		size_t length {decoder.decode(log + offset, size - offset)};
+
+		if (!length) {
+			if (size - offset >= BlackboxCodec::maxFrameSize) {  // Otherwise the recording stopped mid-frame
+				result.gap = true;
+				result.gapTime = previous.time;
+			}
+			break;
+		}
+		offset += length;
+
+		const BlackboxFrame& frame {decoder.getFrame()};
+		if (result.frames && !continuous(previous, frame)) {
+			result.gap = true;
+			result.gapTime = previous.time;
+			break;
+		}
+
+		replay(frame, replayed);
+		if (compare(frame, replayed, options, result.differing < options.reported, report)) {
+			++result.differing;
+		}
+		++result.frames;
+		previous = frame;
+	}
+	return result;
+}
+
+// Runs in a process of its own, the report goes to the file descriptor
+static int runLog(const char* path, const Options& options, int fd) {
+	std::string report {path};
+	int         file {open(path, O_RDONLY)};
+
+	if (file < 0) {
+		report += ": could not be opened\n";
+		write(fd, report.data(), report.size());
+		return 2;
+	}
+
+	struct stat status {};
+	fstat(file, &status);
+	size_t size {static_cast<size_t>(status.st_size)};
+
+	auto* log {size ? static_cast<const uint8_t*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0)) : nullptr};
+	close(file);
+	if (log == MAP_FAILED) {
+		report += ": could not be mapped\n";
+		write(fd, report.data(), report.size());
+		return 2;
+	}
+	if (log) {
+		madvise(const_cast<uint8_t*>(log), size, MADV_SEQUENTIAL);
+	}
+
+	std::string differences {};
+	auto        start {std::chrono::steady_clock::now()};
+	Result      result {log ? replayLog(log, size, options, differences) : Result {}};
+	double      seconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+	char        line[160];
+
+	std::snprintf(
+	    line,
+	    sizeof(line),
+	    ": %zu frames, %zu differing, %.0f MB/s",
+	    result.frames,
+	    result.differing,
+	    seconds > 0 ? size / seconds / 1e6 : 0
+	);
+	report += line;
+	if (result.skipped) {
+		std::snprintf(line, sizeof(line), ", %zu bytes before the first keyframe", result.skipped);
+		report += line;
+	}
+	if (result.gap) {
+		std::snprintf(line, sizeof(line), ", stopped at a gap after %u ms", result.gapTime);
+		report += line;
+	}
+	report += '\n';
+	report += differences;
+	write(fd, report.data(), report.size());
+
+	if (log) {
+		munmap(const_cast<uint8_t*>(log), size);
+	}
+	return result.differing ? 1 : 0;
+}
+
+struct Job {
+	pid_t pid;
+	int   fd;
+};
+
+// Prints the report of the job once it is done, returns its exit status
+static int finish(const Job& job) {
+	char    buffer[4096];
+	ssize_t length;
+
+	while ((length = read(job.fd, buffer, sizeof(buffer))) > 0) {
+		std::fwrite(buffer, 1, length, stdout);
+	}
+	close(job.fd);
+
+	int status {0};
+	waitpid(job.pid, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:j:m:t:")) != -1) {
+		switch (opt) {
+			case 'f':
+				options.flash = optarg;
+				break;
+			case 'j':
+				options.jobNumber = std::max(std::atoi(optarg), 1);
+				break;
+			case 'm':
+				options.reported = std::strtoul(optarg, nullptr, 0);
+				break;
+			case 't':
+				options.tolerance = std::max(std::atoi(optarg), 0);
+				break;
+			default:
+				return false;
+		}
+	}
+	return optind < argc;
+}
+
+int main(int argc, char** argv) {
+	Options options {};
+
+	if (!parseOptions(argc, argv, options)) {
+		std::fprintf(
+		    stderr, "Usage: %s [-f flash image] [-j jobs] [-t tolerance LSB] [-m reported frames] log...\n", argv[0]
+		);
+		return 2;
+	}
+
+	util::init();
+	if (options.flash) {
+		if (access(options.flash, R_OK) || !host::openFlash(options.flash)) {
+			std::perror(options.flash);
+			return 2;
+		}
+	}
+
+	// The same setup as on the device, see calibrate() in main.cpp
+	nvm::load();
+	data::updateOptions();
+	const float* offsets {nvm::get(nvm::options->angularRateOffsets)};
+	LSM6DSO32::setOffsets({{offsets[0]}, {offsets[1]}, {offsets[2]}});
+
+	std::fflush(stdout);
+
+	std::vector<Job> jobs {};
+	int              exitStatus {0};
+	size_t           totalSize {0};
+	auto             start {std::chrono::steady_clock::now()};
+
+	for (int i {optind}; i < argc || !jobs.empty();) {
+		if (i < argc && jobs.size() < options.jobNumber) {
+			int   fds[2];
+			pid_t pid;
+
+			struct stat status {};
+			if (!stat(argv[i], &status)) {
+				totalSize += status.st_size;
+			}
+
+			if (pipe(fds) || (pid = fork()) < 0) {
+				std::perror("fork");
+				return 2;
+			}
+			if (!pid) {  // Starts from the state set up above, untouched by other logs
+				close(fds[0]);
+				_exit(runLog(argv[i], options, fds[1]));
+			}
+
+			close(fds[1]);
+			jobs.push_back({pid, fds[0]});
+			++i;
+		} else {  // In the order of the logs, later jobs keep running meanwhile
+			exitStatus = std::max(exitStatus, finish(jobs.front()));
+			jobs.erase(jobs.begin());
+		}
+	}
+
+	double seconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+	std::printf(
+	    "%d logs, %.1f MB in %.2f s, %.0f MB/s\n", argc - optind, totalSize / 1e6, seconds, totalSize / seconds / 1e6
+	);
+	return exitStatus;
+}
@@ -0,0 +1,386 @@
+/*
+ * File:   gain-sweep.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 12:30 AM
+ */
+
+/* Host tool that flies the simulator with many sets of PID and estimator gains and prints the Pareto-optimal ones.
+ * Build with:
+ *   g++ -std=c++17 -O2 -pthread -o gain-sweep tools/gain-sweep.cpp tools/simulation.cpp
+ * and pass it the simulator built as described in host/host.hpp.
+ *
+ * The gains are drawn at random from the given ranges, log-uniformly where the range is positive.
+ * Every set is flown once through FC_SIM_PIDS and FC_SIM_ESTIMATOR. The other FC_SIM_ variables are taken from
+ * the environment, the same FC_SIM_SEED for all runs, so the sets are compared over the same noise.
+ *
+ * Each run is scored by four errors, all to be minimized: the tracking and estimator errors (RMS over roll
+ * and pitch), the overshoot and the actuator effort, see simulator.cpp. Runs that hit the ground are dropped,
+ * so are runs with a score that is not a number.
+ * The sets no other set is better than in every score are printed to stdout as CSV, by tracking error
+ * and then by the other scores.
+ * The -o option writes every run in the same format.
+ *
+ * Every run is a simulator process of its own, see simulation.hpp. Gains and scores are kept in flat arrays
+ * indexed by the run, the only state shared while running are the shares of the threads, one cache line each.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "simulation.hpp"
+
+constexpr static uint8_t PARAMETER_NUMBER {11};
+constexpr static uint8_t SCORE_NUMBER {4};
+
+static const char* const parameterNames[PARAMETER_NUMBER] {
+  "pitch.p", "pitch.i", "pitch.d", "roll.p", "roll.i", "roll.d", "heading.p", "heading.i", "heading.d", "kp", "ki"
+};
+static const char* const scoreNames[SCORE_NUMBER] {"tracking", "overshoot", "effort", "estimate"};
+
+struct Range {
+	float min;
+	float max;
+};
+
+// Around the gains the simulator sets up on a blank flash, the heading PID is unused in the attitude mode
+static Range defaultRanges[PARAMETER_NUMBER] {
+  {300,   6000},
+  {30,    1500},
+  {4,     200 },
+  {300,   6000},
+  {30,    1500},
+  {4,     200 },
+  {1,     1   },
+  {0,     0   },
+  {0,     0   },
+  {0.05f, 5   },
+  {0.01f, 2   }
+};
+
+struct Options {
+	const char* simulator {nullptr};
+	const char* output {nullptr};
+	unsigned    jobNumber {std::max(std::thread::hardware_concurrency(), 1u)};
+	uint32_t    runNumber {1000};
+	uint32_t    seed {1};
+	Range       ranges[PARAMETER_NUMBER] {};
+};
+
+struct Gains {
+	float values[PARAMETER_NUMBER];
+};
+
+struct Scores {
+	float values[SCORE_NUMBER];
+	bool  valid;  // Flown to the end without hitting the ground
+};
+
+static float toSignificant(float value) {
+	char str[16];
+
+	std::snprintf(str, sizeof(str), "%.4g", value);
+	return std::strtof(str, nullptr);
+}
+
+static Gains draw(std::mt19937& generator, const Range* ranges) {
+	Gains gains {};
+
+	for (uint8_t i {0}; i < PARAMETER_NUMBER; ++i) {
+		const Range& range {ranges[i]};
+
+		if (range.min == range.max) {
+			gains.values[i] = range.min;
+		} else if (range.min > 0) {
+			std::uniform_real_distribution<float> distribution {std::log(range.min), std::log(range.max)};
+			gains.values[i] = toSignificant(std::exp(distribution(generator)));
+		} else {
+			std::uniform_real_distribution<float> distribution {range.min, range.max};
+			gains.values[i] = toSignificant(distribution(generator));
+		}
+	}
+	return gains;
+}
+
+static Scores parseResult(const std::string& result) {
+	static const char* const names[] {"crashed",
+	                                  "roll_tracking",
+	                                  "pitch_tracking",
+	                                  "roll_overshoot",
+	                                  "pitch_overshoot",
+	                                  "effort",
+	                                  "roll_estimate",
+	                                  "pitch_estimate"};
+	float                    fields[std::size(names)] {};
+	Scores                   scores {};
+
+	for (uint8_t i {0}; i < std::size(names); ++i) {
+		if (!simulation::getField(result, names[i], fields[i])) {
+			return scores;
+		}
+	}
+
+	scores.values[0] = std::sqrt((fields[1] * fields[1] + fields[2] * fields[2]) / 2);
+	scores.values[1] = (fields[3] + fields[4]) / 2;
+	scores.values[2] = fields[5];
+	scores.values[3] = std::sqrt((fields[6] * fields[6] + fields[7] * fields[7]) / 2);
+	scores.valid = !fields[0] && std::all_of(std::begin(scores.values), std::end(scores.values), [](float value) {
+		return std::isfinite(value);
+	});
+	return scores;
+}
+
+class Sweep {
+public:
+	Sweep(const Options& options):
+	  _options {options}, _environment {simulation::getEnvironment({"FC_SIM_PIDS", "FC_SIM_ESTIMATOR"})} {
+		std::mt19937 generator {options.seed};
+
+		_gains.reserve(options.runNumber);
+		for (uint32_t i {0}; i < options.runNumber; ++i) {
+			_gains.push_back(draw(generator, options.ranges));
+		}
+		_scores.resize(options.runNumber);
+	}
+
+	void run() {
+		simulation::runAll(_options.runNumber, _options.jobNumber, [this](uint32_t run) {
+			_scores[run] = fly(_gains[run]);
+		});
+	}
+
+	const std::vector<Gains>& getGains() const {
+		return _gains;
+	}
+
+	const std::vector<Scores>& getScores() const {
+		return _scores;
+	}
+
+	uint32_t getFailed() const {
+		return _failed;
+	}
+
+protected:
+	const Options&        _options;
+	std::vector<Gains>    _gains {};
+	std::vector<Scores>   _scores {};
+	std::vector<char*>    _environment;
+	std::atomic<uint32_t> _failed {0};
+
+	Scores fly(const Gains& gains) {
+		std::string pids {"FC_SIM_PIDS="};
+		std::string estimator {"FC_SIM_ESTIMATOR="};
+		std::string result {};
+		char        value[24];
+
+		for (uint8_t i {0}; i < PARAMETER_NUMBER; ++i) {
+			std::snprintf(value, sizeof(value), i == 8 || i == PARAMETER_NUMBER - 1 ? "%g" : "%g,", gains.values[i]);
+			(i < 9 ? pids : estimator) += value;
+		}
+
+		if (!simulation::fly(_options.simulator, _environment, {pids, estimator}, result)) {
+			++_failed;
+			return {};
+		}
+		return parseResult(result);
+	}
+};
+
+// True if a is no worse than b in every score and better in at least one
+static bool dominates(const Scores& a, const Scores& b) {
+	bool better {false};
+
+	for (uint8_t i {0}; i < SCORE_NUMBER; ++i) {
+		if (a.values[i] > b.values[i]) {
+			return false;
+		}
+		better = better || a.values[i] < b.values[i];
+	}
+	return better;
+}
+
+/* Sorted by the scores in turn, a run can only be dominated by an earlier one, and then also by one already
+ * on the front. Sorting by the first score alone would leave runs that tie in it in any order.
+ */
+static std::vector<uint32_t> getFront(const std::vector<Scores>& scores) {
+	std::vector<uint32_t> order {};
+	std::vector<uint32_t> front {};
+
+	for (uint32_t i {0}; i < scores.size(); ++i) {
+		if (scores[i].valid) {
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&scores](uint32_t a, uint32_t b) {
+		return std::lexicographical_compare(
+		    std::begin(scores[a].values),
+		    std::end(scores[a].values),
+		    std::begin(scores[b].values),
+		    std::end(scores[b].values)
+		);
+	});
+
+	for (uint32_t run : order) {
+		bool dominated {std::any_of(front.begin(), front.end(), [&scores, run](uint32_t other) {
+			return dominates(scores[other], scores[run]);
+		})};
+
+		if (!dominated) {
+			front.push_back(run);
+		}
+	}
+	return front;
+}
+
+static void printRun(FILE* file, uint32_t run, const Gains& gains, const Scores& scores) {
+	std::fprintf(file, "%u", run);
+	for (float value : gains.values) {
+		std::fprintf(file, ",%g", value);
+	}
+	for (float value : scores.values) {
+		std::fprintf(file, ",%.3f", value);
+	}
+	std::fprintf(file, ",%d\n", !scores.valid);
+}
+
+static void printHeader(FILE* file) {
+	std::fprintf(file, "run");
+	for (const char* name : parameterNames) {
+		std::fprintf(file, ",%s", name);
+	}
+	for (const char* name : scoreNames) {
+		std::fprintf(file, ",%s", name);
+	}
+	std::fprintf(file, ",failed\n");
+}
+
+// "name=min:max" or "name=value"
+static bool parseRange(const char* str, Range* ranges) {
+	const char* separator {std::strchr(str, '=')};
+
+	if (!separator) {
+		return false;
+	}
+	for (uint8_t i {0}; i < PARAMETER_NUMBER; ++i) {
+		if (!std::strncmp(str, parameterNames[i], separator - str) && !parameterNames[i][separator - str]) {
+			char* end {nullptr};
+
+			ranges[i].min = std::strtof(separator + 1, &end);
+			ranges[i].max = *end == ':' ? std::strtof(end + 1, &end) : ranges[i].min;
+			return !*end && ranges[i].min <= ranges[i].max;
+		}
+	}
+	return false;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	int opt;
+
+	std::copy(std::begin(defaultRanges), std::end(defaultRanges), options.ranges);
+	while ((opt = getopt(argc, argv, "j:n:o:r:s:")) != -1) {
+		switch (opt) {
+			case 'j':
+				options.jobNumber = std::max(std::atoi(optarg), 1);
+				break;
+			case 'n':
+				options.runNumber = std::strtoul(optarg, nullptr, 0);
+				break;
+			case 'o':
+				options.output = optarg;
+				break;
+			case 'r':
+				if (!parseRange(optarg, options.ranges)) {
+					std::fprintf(stderr, "Invalid range: %s\n", optarg);
+					return false;
+				}
+				break;
+			case 's':
+				options.seed = std::strtoul(optarg, nullptr, 0);
+				break;
+			default:
+				return false;
+		}
+	}
+	if (optind + 1 != argc) {
+		return false;
+	}
+	options.simulator = argv[optind];
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options options {};
+
+	if (!parseOptions(argc, argv, options)) {
+		std::fprintf(
+		    stderr, "Usage: %s [-n runs] [-j jobs] [-s seed] [-r name=min:max]... [-o all runs CSV] simulator\n", argv[0]
+		);
+		std::fprintf(stderr, "Gains:");
+		for (uint8_t i {0}; i < PARAMETER_NUMBER; ++i) {
+			std::fprintf(stderr, " %s=%g:%g", parameterNames[i], defaultRanges[i].min, defaultRanges[i].max);
+		}
+		std::fprintf(stderr, "\n");
+		return 2;
+	}
+	if (access(options.simulator, X_OK)) {
+		std::perror(options.simulator);
+		return 2;
+	}
+
+	Sweep sweep {options};
+	auto  start {std::chrono::steady_clock::now()};
+	sweep.run();
+	double seconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+
+	const auto& gains {sweep.getGains()};
+	const auto& scores {sweep.getScores()};
+
+	if (options.output) {
+		FILE* file {std::fopen(options.output, "w")};
+
+		if (!file) {
+			std::perror(options.output);
+			return 2;
+		}
+		printHeader(file);
+		for (uint32_t i {0}; i < options.runNumber; ++i) {
+			printRun(file, i, gains[i], scores[i]);
+		}
+		std::fclose(file);
+	}
+
+	auto front {getFront(scores)};
+	printHeader(stdout);
+	for (uint32_t run : front) {
+		printRun(stdout, run, gains[run], scores[run]);
+	}
+
+	uint32_t valid {static_cast<uint32_t>(std::count_if(scores.begin(), scores.end(), [](const Scores& s) {
+		return s.valid;
+	}))};
+	std::fprintf(
+	    stderr,
+	    "%u runs, %u crashed, %u failed, %zu on the front, %.1f s, %.0f runs/s\n",
+	    options.runNumber,
+	    options.runNumber - valid - sweep.getFailed(),
+	    sweep.getFailed(),
+	    front.size(),
+	    seconds,
+	    options.runNumber / seconds
+	);
+	return valid ? 0 : 1;
+}
@@ -0,0 +1,257 @@
+/*
+ * File:   lanes.hpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 2:00 AM
+ */
+
+#ifndef LANES_HPP
+#define LANES_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
+
+/* Floats processed a vector at a time for the batch filters on the host, with AVX2, NEON or the vector extensions
+ * of GCC and Clang elsewhere. Every operation rounds like the scalar one, so a calculation written in the same order
+ * gives the same bits as long as neither is fused into multiply-adds. Build with -ffp-contract=off and without FMA,
+ * GCC still fuses some of the scalar code when FMA instructions are enabled.
+ */
+
+namespace lanes {
+#if defined(__AVX2__)
+	constexpr static uint8_t width {8};
+	constexpr static char    name[] {"AVX2"};
+
+	struct Float {
+		__m256 v;
+	};
+
+	struct Mask {
+		__m256 v;
+	};
+
+	inline Float load(const float* src) {
+		return {_mm256_loadu_ps(src)};
+	}
+
+	inline void store(float* dest, Float a) {
+		_mm256_storeu_ps(dest, a.v);
+	}
+
+	inline Float broadcast(float a) {
+		return {_mm256_set1_ps(a)};
+	}
+
+	inline Float operator+ (Float a, Float b) {
+		return {_mm256_add_ps(a.v, b.v)};
+	}
+
+	inline Float operator- (Float a, Float b) {
+		return {_mm256_sub_ps(a.v, b.v)};
+	}
+
+	inline Float operator* (Float a, Float b) {
+		return {_mm256_mul_ps(a.v, b.v)};
+	}
+
+	inline Float operator- (Float a) {
+		return {_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))};
+	}
+
+	inline Float abs(Float a) {
+		return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+	}
+
+	inline Mask operator<= (Float a, Float b) {
+		return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)};
+	}
+
+	inline Mask operator> (Float a, Float b) {
+		return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)};
+	}
+
+	inline Mask operator& (Mask a, Mask b) {
+		return {_mm256_and_ps(a.v, b.v)};
+	}
+
+	inline Mask operator!(Mask a) {
+		return {_mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))};
+	}
+
+	// a where the mask is set, b elsewhere
+	inline Float select(Mask mask, Float a, Float b) {
+		return {_mm256_blendv_ps(b.v, a.v, mask.v)};
+	}
+
+	// First guess of util::invSqrt()
+	inline Float guessInvSqrt(Float a) {
+		__m256i i {_mm256_castps_si256(a.v)};
+		return {_mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x5f3759df), _mm256_srai_epi32(i, 1)))};
+	}
+#elif defined(__ARM_NEON)
+	constexpr static uint8_t width {4};
+	constexpr static char    name[] {"NEON"};
+
+	struct Float {
+		float32x4_t v;
+	};
+
+	struct Mask {
+		uint32x4_t v;
+	};
+
+	inline Float load(const float* src) {
+		return {vld1q_f32(src)};
+	}
+
+	inline void store(float* dest, Float a) {
+		vst1q_f32(dest, a.v);
+	}
+
+	inline Float broadcast(float a) {
+		return {vdupq_n_f32(a)};
+	}
+
+	inline Float operator+ (Float a, Float b) {
+		return {vaddq_f32(a.v, b.v)};
+	}
+
+	inline Float operator- (Float a, Float b) {
+		return {vsubq_f32(a.v, b.v)};
+	}
+
+	inline Float operator* (Float a, Float b) {
+		return {vmulq_f32(a.v, b.v)};
+	}
+
+	inline Float operator- (Float a) {
+		return {vnegq_f32(a.v)};
+	}
+
+	inline Float abs(Float a) {
+		return {vabsq_f32(a.v)};
+	}
+
+	inline Mask operator<= (Float a, Float b) {
+		return {vcleq_f32(a.v, b.v)};
+	}
+
+	inline Mask operator> (Float a, Float b) {
+		return {vcgtq_f32(a.v, b.v)};
+	}
+
+	inline Mask operator& (Mask a, Mask b) {
+		return {vandq_u32(a.v, b.v)};
+	}
+
+	inline Mask operator!(Mask a) {
+		return {vmvnq_u32(a.v)};
+	}
+
+	inline Float select(Mask mask, Float a, Float b) {
+		return {vbslq_f32(mask.v, a.v, b.v)};
+	}
+
+	inline Float guessInvSqrt(Float a) {
+		int32x4_t i {vreinterpretq_s32_f32(a.v)};
+		return {vreinterpretq_f32_s32(vsubq_s32(vdupq_n_s32(0x5f3759df), vshrq_n_s32(i, 1)))};
+	}
+#else
+	// GCC vector extensions, SSE2 on any x86-64 processor
+	constexpr static uint8_t width {4};
+	constexpr static char    name[] {"generic"};
+
+	typedef float   FloatVector __attribute__((vector_size(16)));
+	typedef int32_t IntVector __attribute__((vector_size(16)));
+
+	struct Float {
+		FloatVector v;
+	};
+
+	struct Mask {
+		IntVector v;  // All bits set where true
+	};
+
+	inline Float load(const float* src) {
+		Float result;
+		std::memcpy(&result.v, src, sizeof(result.v));
+		return result;
+	}
+
+	inline void store(float* dest, Float a) {
+		std::memcpy(dest, &a.v, sizeof(a.v));
+	}
+
+	inline Float broadcast(float a) {
+		return {FloatVector {a, a, a, a}};
+	}
+
+	inline Float operator+ (Float a, Float b) {
+		return {a.v + b.v};
+	}
+
+	inline Float operator- (Float a, Float b) {
+		return {a.v - b.v};
+	}
+
+	inline Float operator* (Float a, Float b) {
+		return {a.v * b.v};
+	}
+
+	inline Float operator- (Float a) {
+		return {-a.v};
+	}
+
+	inline Float abs(Float a) {
+		return {reinterpret_cast<FloatVector>(reinterpret_cast<IntVector>(a.v) & 0x7fffffff)};
+	}
+
+	inline Mask operator<= (Float a, Float b) {
+		return {a.v <= b.v};
+	}
+
+	inline Mask operator> (Float a, Float b) {
+		return {a.v > b.v};
+	}
+
+	inline Mask operator& (Mask a, Mask b) {
+		return {a.v & b.v};
+	}
+
+	inline Mask operator!(Mask a) {
+		return {~a.v};
+	}
+
+	inline Float select(Mask mask, Float a, Float b) {
+		IntVector bits {(reinterpret_cast<IntVector>(a.v) & mask.v) | (reinterpret_cast<IntVector>(b.v) & ~mask.v)};
+		return {reinterpret_cast<FloatVector>(bits)};
+	}
+
+	inline Float guessInvSqrt(Float a) {
+		return {reinterpret_cast<FloatVector>(0x5f3759df - (reinterpret_cast<IntVector>(a.v) >> 1))};
+	}
+#endif
+
+	// Same as util::invSqrt(), two Newton steps after the first guess
+	inline Float invSqrt(Float a) {
+		Float half {a * broadcast(0.5f)};
+		Float y {guessInvSqrt(a)};
+
+		y = y * (broadcast(1.5f) - half * y * y);
+		y = y * (broadcast(1.5f) - half * y * y);
+		return y;
+	}
+
+	// Number of floats to allocate for the given number of lanes, whole vectors
+	inline uint32_t toPadded(uint32_t size) {
+		return (size + width - 1) / width * width;
+	}
+}
+
+#endif /* LANES_HPP */
@@ -0,0 +1,311 @@
+/*
+ * File:   mahony-batch.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 2:40 AM
+ */
+
+/* Host tool that runs the IMU samples of blackbox logs through many Mahony filters at once, each with its own gains,
+ * both with MahonyBatch and with a Mahony for every filter, checks that they agree and compares their speed.
+ * The same is done for chains of quaternion products with QuaternionBatch. Build from the repository root with:
+ *   g++ -std=gnu++17 -O2 -mavx2 -ffp-contract=off -DPROFILING=false -Ihost -Iinc -Itools -o mahony-batch \
+ *       tools/mahony-batch.cpp tools/MahonyBatch.cpp tools/QuaternionBatch.cpp host/analog.cpp host/flash.cpp \
+ *       host/i2c.cpp host/servo.cpp host/uart.cpp host/usb.cpp host/util.cpp src/AttitudeEstimator.cpp \
+ *       src/BlackboxCodec.cpp src/CompanionCodec.cpp src/LSM6DSO32.cpp src/Madgwick.cpp src/Mahony.cpp \
+ *       src/Quaternion.cpp src/ReceiverParser.cpp src/blackbox.cpp src/companion.cpp src/data.cpp src/flight.cpp \
+ *       src/nvm.cpp src/profiler.cpp src/receiver.cpp
+ * Leave out -mavx2 on ARM, NEON is used there, and on processors without AVX2, which get the vector extensions of the compiler.
+ *
+ * Every filter and product in the batch has to give the same bits as the scalar code, the -t option sets
+ * the largest difference of a quaternion component or an angle that is still accepted, 0 by default.
+ * Fused multiply-adds would round the two paths differently, hence -ffp-contract=off. Neither -mfma nor -march=native
+ * may be used either, GCC turns Quaternion::operator*() into fused multiply-adds even with it.
+ *
+ * The samples are read through the LSM6DSO32 driver with the gyroscope offsets from the flash image like
+ * tools/blackbox-replay.cpp does, from every frame of the logs one after another. Filter k of n gets
+ * Kp = 0.05 * 100^(k / n) and the default Ki if k is odd, no integral feedback otherwise.
+ * The exit status is 1 if the results differed by more than the tolerance and 2 if a log could not be read.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <unistd.h>
+
+#include "BlackboxCodec.hpp"
+#include "host.hpp"
+#include "LSM6DSO32.hpp"
+#include "MahonyBatch.hpp"
+#include "nvm.hpp"
+#include "QuaternionBatch.hpp"
+
+struct Options {
+	const char* flash {nullptr};
+	uint32_t    filterNumber {256};
+	uint32_t    repeats {1};
+	float       tolerance {0};
+};
+
+struct Sample {
+	Vector3<float, uint8_t> rot;
+	Vector3<float, uint8_t> acc;
+	float                   dt;
+};
+
+struct Comparison {
+	double scalarSeconds {0};
+	double batchSeconds {0};
+	float  difference {0};  // Largest of a quaternion component or an angle
+};
+
+static double getSeconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// All frames a decoder finds, the whole file is read at once
+static bool readSamples(const char* path, std::vector<Sample>& samples) {
+	FILE* file {std::fopen(path, "rb")};
+
+	if (!file) {
+		return false;
+	}
+
+	std::vector<uint8_t> log {};
+	uint8_t              buffer[65536];
+	size_t               length;
+	while ((length = std::fread(buffer, 1, sizeof(buffer), file))) {
+		log.insert(log.end(), buffer, buffer + length);
+	}
+	std::fclose(file);
+
+	BlackboxDecoder decoder {};
+	for (size_t offset {BlackboxDecoder::findKeyframe(log.data(), log.size())}; offset < log.size();) {
+		size_t used {decoder.decode(log.data() + offset, log.size() - offset)};
+
+		if (!used) {  // Skips to the next keyframe after a gap
+			offset += BlackboxDecoder::findKeyframe(log.data() + offset + 1, log.size() - offset - 1) + 1;
+			continue;
+		}
+		offset += used;
+
+		// Back to the sensor axes, see replay() in tools/blackbox-replay.cpp
+		const BlackboxFrame& frame {decoder.getFrame()};
+		int16_t              accelerations[3] {
+		  static_cast<int16_t>(-frame.accelerations[2]),
+		  static_cast<int16_t>(-frame.accelerations[1]),
+		  frame.accelerations[0]
+		};
+		int16_t angularRates[3] {
+		  static_cast<int16_t>(-frame.angularRates[2]),
+		  static_cast<int16_t>(-frame.angularRates[1]),
+		  frame.angularRates[0]
+		};
+
+		host::getIMU().setAccelerations(accelerations);
+		host::getIMU().setAngularRates(angularRates);
+		LSM6DSO32::update();
+		samples.push_back(
+		    {LSM6DSO32::getAngularRates(), LSM6DSO32::getAccelerations(), frame.intervals[0] / 1000000.0f}
+		);
+	}
+	return true;
+}
+
+static float getDifference(const Quaternion& quat, QuaternionBatch& batch, uint32_t index) {
+	return std::max({
+	  std::abs(quat.getW() - batch.getW()[index]),
+	  std::abs(quat.getX() - batch.getX()[index]),
+	  std::abs(quat.getY() - batch.getY()[index]),
+	  std::abs(quat.getZ() - batch.getZ()[index])
+	});
+}
+
+static void setGains(uint32_t filter, uint32_t filterNumber, float& Kp, float& Ki) {
+	Kp = 0.05f * std::pow(100.0f, static_cast<float>(filter) / filterNumber);
+	Ki = filter % 2 ? Mahony::defaultKi : 0.0f;
+}
+
+static Comparison compareMahony(const std::vector<Sample>& samples, const Options& options) {
+	Comparison          comparison {};
+	std::vector<Mahony> filters {};
+	MahonyBatch         batch {options.filterNumber};
+
+	for (uint32_t k {0}; k < options.filterNumber; ++k) {
+		float Kp;
+		float Ki;
+
+		setGains(k, options.filterNumber, Kp, Ki);
+		filters.emplace_back(Kp, Ki);
+		batch.setKp(k, Kp);
+		batch.setKi(k, Ki);
+	}
+	std::vector<Mahony> initialFilters {filters};
+	MahonyBatch         initialBatch {batch};
+
+	// Every filter after every sample
+	for (const auto& sample : samples) {
+		batch.updateIMU(sample.rot, sample.acc, sample.dt);
+		for (uint32_t k {0}; k < options.filterNumber; ++k) {
+			filters[k].updateIMU(sample.rot, sample.acc, sample.dt);
+			comparison.difference = std::max(
+			    comparison.difference, getDifference(filters[k].getQuaternion(), batch.getQuaternions(), k)
+			);
+		}
+	}
+
+	// A filter at a time for the scalar code, its state stays in registers
+	for (uint32_t r {0}; r < options.repeats; ++r) {
+		filters = initialFilters;
+		auto start {std::chrono::steady_clock::now()};
+		for (auto& filter : filters) {
+			for (const auto& sample : samples) {
+				filter.updateIMU(sample.rot, sample.acc, sample.dt);
+			}
+		}
+		comparison.scalarSeconds += getSeconds(start);
+
+		batch = initialBatch;
+		start = std::chrono::steady_clock::now();
+		for (const auto& sample : samples) {
+			batch.updateIMU(sample.rot, sample.acc, sample.dt);
+		}
+		comparison.batchSeconds += getSeconds(start);
+	}
+
+	// The angles go through the same math library calls
+	std::vector<float> angles(options.filterNumber * 3);
+	batch.getQuaternions().toEuler(&angles[0], &angles[options.filterNumber], &angles[options.filterNumber * 2]);
+	for (uint32_t k {0}; k < options.filterNumber; ++k) {
+		auto euler {filters[k].getQuaternion().toEuler()};
+
+		for (uint8_t i {0}; i < 3; ++i) {
+			comparison.difference =
+			    std::max(comparison.difference, std::abs(euler[i][0] - angles[i * options.filterNumber + k]));
+		}
+	}
+	return comparison;
+}
+
+// q = a * q repeatedly, every product normalized like Quaternion does
+static Comparison compareProducts(const MahonyBatch& filters, uint32_t steps, const Options& options) {
+	Comparison              comparison {};
+	const QuaternionBatch&  factors {filters.getQuaternions()};
+	QuaternionBatch         products {options.filterNumber};
+	std::vector<Quaternion> scalarProducts(options.filterNumber);
+	std::vector<Quaternion> scalarFactors {};
+
+	for (uint32_t k {0}; k < options.filterNumber; ++k) {
+		scalarFactors.push_back(factors.get(k));
+		scalarProducts[k] = Quaternion::fromEuler(k * 0.01f, k * 0.005f, -k * 0.02f);
+		products.set(k, scalarProducts[k]);
+	}
+	QuaternionBatch batchFactors {options.filterNumber};
+	for (uint32_t k {0}; k < options.filterNumber; ++k) {
+		batchFactors.set(k, scalarFactors[k]);
+	}
+
+	auto start {std::chrono::steady_clock::now()};
+	for (uint32_t i {0}; i < steps; ++i) {
+		for (uint32_t k {0}; k < options.filterNumber; ++k) {
+			scalarProducts[k] = scalarFactors[k] * scalarProducts[k];
+		}
+	}
+	comparison.scalarSeconds = getSeconds(start);
+
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i {0}; i < steps; ++i) {
+		QuaternionBatch::multiply(batchFactors, products, products);
+		products.normalize();
+	}
+	comparison.batchSeconds = getSeconds(start);
+
+	for (uint32_t k {0}; k < options.filterNumber; ++k) {
+		comparison.difference = std::max(comparison.difference, getDifference(scalarProducts[k], products, k));
+	}
+	return comparison;
+}
+
+static void printComparison(const char* name, const Comparison& comparison, double updates) {
+	std::printf(
+	    "%s: scalar %.1f M/s, batch %.1f M/s, %.1f times faster, largest difference %g\n",
+	    name,
+	    updates / comparison.scalarSeconds / 1e6,
+	    updates / comparison.batchSeconds / 1e6,
+	    comparison.scalarSeconds / comparison.batchSeconds,
+	    comparison.difference
+	);
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:n:r:t:")) != -1) {
+		switch (opt) {
+			case 'f':
+				options.flash = optarg;
+				break;
+			case 'n':
+				options.filterNumber = std::max(std::atoi(optarg), 1);
+				break;
+			case 'r':
+				options.repeats = std::max(std::atoi(optarg), 1);
+				break;
+			case 't':
+				options.tolerance = std::max(std::strtof(optarg, nullptr), 0.0f);
+				break;
+			default:
+				return false;
+		}
+	}
+	return optind < argc;
+}
+
+int main(int argc, char** argv) {
+	Options options {};
+
+	if (!parseOptions(argc, argv, options)) {
+		std::fprintf(
+		    stderr, "Usage: %s [-f flash image] [-n filters] [-r repeats] [-t tolerance] log...\n", argv[0]
+		);
+		return 2;
+	}
+
+	util::init();
+	if (options.flash) {
+		if (access(options.flash, R_OK) || !host::openFlash(options.flash)) {
+			std::perror(options.flash);
+			return 2;
+		}
+	}
+	nvm::load();
+	const float* offsets {nvm::get(nvm::options->angularRateOffsets)};
+	LSM6DSO32::setOffsets({{offsets[0]}, {offsets[1]}, {offsets[2]}});
+
+	std::vector<Sample> samples {};
+	for (int i {optind}; i < argc; ++i) {
+		if (!readSamples(argv[i], samples)) {
+			std::perror(argv[i]);
+			return 2;
+		}
+	}
+
+	std::printf(
+	    "%zu samples, %u filters, %s with %u lanes\n", samples.size(), options.filterNumber, lanes::name, lanes::width
+	);
+
+	MahonyBatch filters {options.filterNumber};
+	Comparison  mahony {compareMahony(samples, options)};
+	for (const auto& sample : samples) {  // Different orientations to multiply
+		filters.updateIMU(sample.rot, sample.acc, sample.dt);
+	}
+	Comparison products {compareProducts(filters, samples.size(), options)};
+
+	double updates {static_cast<double>(samples.size()) * options.filterNumber};
+	printComparison("Mahony updates", mahony, updates * options.repeats);
+	printComparison("Quaternion products", products, updates);
+	return mahony.difference > options.tolerance || products.difference > options.tolerance ? 1 : 0;
+}
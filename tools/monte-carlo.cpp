@@ -0,0 +1,519 @@
+/*
+ * File:   monte-carlo.cpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 1:30 AM
+ */
+
+/* Host tool that flies the simulator many times with random sensor biases, noise, latency and wind
+ * to see how often the attitude loop saturates, fails to recover from a switch of the orientation or crashes.
+ * Build with:
+ *   g++ -std=c++17 -O2 -pthread -o monte-carlo tools/monte-carlo.cpp tools/simulation.cpp
+ * and pass it the simulator built as described in host/host.hpp.
+ *
+ * Run i is flown with FC_SIM_SEED set to the base seed plus i, its variations are drawn uniformly from the ranges
+ * with a generator seeded the same way, so any run can be flown again by itself. The other FC_SIM_ variables
+ * are taken from the environment, FC_SIM_SEQUENCE=inverted tests the recovery from inverted flight.
+ *
+ * The variations and the results of every run are written to a results file as they come in, in blocks of
+ * BLOCK_SIZE runs with the values of each column together. The percentiles printed at the end are taken from
+ * histograms with 1% wide bins, kept for every column, so neither needs all the runs in memory.
+ * The -d option prints a results file as CSV, -p prints its summary.
+ *
+ * Results file, little-endian:
+ *   "FCMC", version, number of columns, then a type ('u' for uint32, 'f' for float) and a null-terminated name
+ *   for every column. Blocks follow: the number of runs as uint32, then the 4-byte values of each column in turn.
+ *   Runs the simulator could not finish have NaN results.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "simulation.hpp"
+
+constexpr static uint32_t BLOCK_SIZE {4096};
+constexpr static uint8_t  VERSION {1};
+constexpr static uint8_t  VARIATION_NUMBER {4};
+constexpr static uint8_t  RESULT_NUMBER {10};
+constexpr static uint8_t  COLUMN_NUMBER {1 + VARIATION_NUMBER + RESULT_NUMBER};
+constexpr static float    SATURATED_SHARE {0.01f};  // Of the flight, runs above count as saturated
+
+// The seed first, then the variations and the fields of the result line of the simulator
+static const char* const columnNames[COLUMN_NUMBER] {
+  "seed",
+  "bias",
+  "noise",
+  "latency",
+  "wind",
+  "crashed",
+  "time",
+  "roll_tracking",
+  "pitch_tracking",
+  "roll_estimate",
+  "pitch_estimate",
+  "saturation",
+  "unrecovered",
+  "recovery_time",
+  "min_altitude"
+};
+static const char* const variableNames[VARIATION_NUMBER] {
+  "FC_SIM_BIAS", "FC_SIM_NOISE", "FC_SIM_LATENCY", "FC_SIM_WIND"
+};
+
+struct Range {
+	float min;
+	float max;
+};
+
+// Times the defaults of the simulator for the bias and the noise, us for the latency and m/s for the wind
+static const Range defaultRanges[VARIATION_NUMBER] {
+  {0,   3    },
+  {0.5, 4    },
+  {0,   20000},
+  {0,   8    }
+};
+
+struct Options {
+	const char* simulator {nullptr};
+	const char* output {"monte-carlo.fcmc"};
+	const char* dumped {nullptr};
+	const char* summarized {nullptr};
+	unsigned    jobNumber {std::max(std::thread::hardware_concurrency(), 1u)};
+	uint32_t    runNumber {1000};
+	uint32_t    seed {1};
+	Range       ranges[VARIATION_NUMBER] {};
+};
+
+// Column values of a run, the seed is kept as the bits of a uint32
+union Value {
+	uint32_t u;
+	float    f;
+};
+
+struct Run {
+	Value values[COLUMN_NUMBER];
+};
+
+// Logarithmic bins 1% wide from MIN to MAX, values below MIN in the first one
+class Histogram {
+public:
+	constexpr static double MIN {1e-3};
+	constexpr static double MAX {1e6};
+	constexpr static double RATIO {1.01};
+
+	void add(double value) {
+		if (std::isnan(value)) {
+			return;
+		}
+		size_t bin {value < MIN ? 0 : std::min<size_t>(std::log(value / MIN) / std::log(RATIO) + 1, _bins.size() - 1)};
+
+		++_bins[bin];
+		++_count;
+		_sum += value;
+		_min = std::min(_min, value);
+		_max = std::max(_max, value);
+	}
+
+	// Middle of the bin, within the smallest and the largest value
+	double getPercentile(double percentile) const {
+		uint64_t rank {static_cast<uint64_t>(std::ceil(percentile / 100 * _count))};
+		uint64_t count {0};
+
+		for (size_t i {0}; i < _bins.size(); ++i) {
+			count += _bins[i];
+			if (count >= rank && count) {
+				double value {i ? MIN * std::pow(RATIO, i - 0.5) : 0};
+				return std::clamp(value, _min, _max);
+			}
+		}
+		return 0;
+	}
+
+	double getMean() const {
+		return _count ? _sum / _count : 0;
+	}
+
+	double getMax() const {
+		return _count ? _max : 0;
+	}
+
+protected:
+	std::vector<uint64_t> _bins
+	    = std::vector<uint64_t>(static_cast<size_t>(std::log(MAX / MIN) / std::log(RATIO)) + 2);
+	uint64_t _count {0};
+	double   _sum {0};
+	double   _min {INFINITY};
+	double   _max {-INFINITY};
+};
+
+class Summary {
+public:
+	void add(const Run& run) {
+		++_runs;
+		if (std::isnan(run.values[5].f)) {
+			++_failed;
+			return;
+		}
+		_crashed += run.values[5].f != 0;
+		_saturated += run.values[11].f > SATURATED_SHARE;
+		_unrecovered += run.values[12].f != 0;
+		for (uint8_t i {0}; i < RESULT_NUMBER; ++i) {
+			_histograms[i].add(run.values[1 + VARIATION_NUMBER + i].f);
+		}
+	}
+
+	void print(FILE* file) const {
+		uint32_t flown {_runs - _failed};
+
+		std::fprintf(file, "%u runs, %u could not be flown\n", _runs, _failed);
+		std::fprintf(
+		    file,
+		    "crashed %u (%.1f%%), saturated over %.0f%% of the time %u (%.1f%%), unrecovered %u (%.1f%%)\n",
+		    _crashed,
+		    toPercent(_crashed, flown),
+		    SATURATED_SHARE * 100,
+		    _saturated,
+		    toPercent(_saturated, flown),
+		    _unrecovered,
+		    toPercent(_unrecovered, flown)
+		);
+		std::fprintf(file, "%-16s %10s %10s %10s %10s %10s\n", "", "mean", "p50", "p90", "p99", "max");
+		for (uint8_t i {2}; i < RESULT_NUMBER; ++i) {  // Crashed and time are counted above
+			const Histogram& histogram {_histograms[i]};
+
+			std::fprintf(
+			    file,
+			    "%-16s %10.4g %10.4g %10.4g %10.4g %10.4g\n",
+			    columnNames[1 + VARIATION_NUMBER + i],
+			    histogram.getMean(),
+			    histogram.getPercentile(50),
+			    histogram.getPercentile(90),
+			    histogram.getPercentile(99),
+			    histogram.getMax()
+			);
+		}
+	}
+
+protected:
+	Histogram _histograms[RESULT_NUMBER] {};
+	uint32_t  _runs {0};
+	uint32_t  _failed {0};
+	uint32_t  _crashed {0};
+	uint32_t  _saturated {0};
+	uint32_t  _unrecovered {0};
+
+	static double toPercent(uint32_t count, uint32_t total) {
+		return total ? 100.0 * count / total : 0;
+	}
+};
+
+// Collects the runs into blocks and writes them out column by column
+class ResultsWriter {
+public:
+	bool open(const char* path) {
+		if (!(_file = std::fopen(path, "wb"))) {
+			return false;
+		}
+
+		uint8_t header[] {'F', 'C', 'M', 'C', VERSION, COLUMN_NUMBER};
+		std::fwrite(header, 1, sizeof(header), _file);
+		for (uint8_t i {0}; i < COLUMN_NUMBER; ++i) {
+			std::fputc(i ? 'f' : 'u', _file);
+			std::fwrite(columnNames[i], 1, std::strlen(columnNames[i]) + 1, _file);
+		}
+		_block.reserve(BLOCK_SIZE);
+		return !std::ferror(_file);
+	}
+
+	void add(const Run& run) {
+		_block.push_back(run);
+		if (_block.size() == BLOCK_SIZE) {
+			flush();
+		}
+	}
+
+	bool close() {
+		flush();
+		bool ok {!std::ferror(_file)};
+		return !std::fclose(_file) && ok;
+	}
+
+protected:
+	FILE*              _file {nullptr};
+	std::vector<Run>   _block {};
+	std::vector<Value> _column {};
+
+	void flush() {
+		if (_block.empty()) {
+			return;
+		}
+
+		uint32_t size {static_cast<uint32_t>(_block.size())};
+		std::fwrite(&size, sizeof(size), 1, _file);
+		_column.resize(size);
+		for (uint8_t i {0}; i < COLUMN_NUMBER; ++i) {
+			for (uint32_t j {0}; j < size; ++j) {
+				_column[j] = _block[j].values[i];
+			}
+			std::fwrite(_column.data(), sizeof(Value), size, _file);
+		}
+		_block.clear();
+	}
+};
+
+// Calls the function for every run in the file, one block in memory at a time
+template <class F>
+static bool readResults(const char* path, F function) {
+	FILE* file {std::fopen(path, "rb")};
+
+	if (!file) {
+		return false;
+	}
+
+	uint8_t header[6];
+	bool    ok {std::fread(header, 1, sizeof(header), file) == sizeof(header) && !std::memcmp(header, "FCMC", 4)
+             && header[4] == VERSION && header[5] == COLUMN_NUMBER};
+	for (uint8_t i {0}; ok && i < COLUMN_NUMBER; ++i) {  // Only files with the same columns are read
+		std::string name {};
+		int         type {std::fgetc(file)};
+		int         c;
+
+		while ((c = std::fgetc(file)) > 0) {
+			name += static_cast<char>(c);
+		}
+		ok = !c && type == (i ? 'f' : 'u') && name == columnNames[i];
+	}
+
+	std::vector<Value> columns {};
+	uint32_t           size;
+	while (ok && std::fread(&size, sizeof(size), 1, file) == 1) {
+		columns.resize(size_t {size} * COLUMN_NUMBER);
+		ok = size && size <= BLOCK_SIZE
+		  && std::fread(columns.data(), sizeof(Value), columns.size(), file) == columns.size();
+		if (!ok) {
+			break;
+		}
+		for (uint32_t j {0}; j < size; ++j) {
+			Run run {};
+
+			for (uint8_t i {0}; i < COLUMN_NUMBER; ++i) {
+				run.values[i] = columns[size_t {i} * size + j];
+			}
+			function(run);
+		}
+	}
+
+	std::fclose(file);
+	return ok;
+}
+
+static void printRun(FILE* file, const Run& run) {
+	std::fprintf(file, "%u", run.values[0].u);
+	for (uint8_t i {1}; i < COLUMN_NUMBER; ++i) {
+		std::fprintf(file, ",%.9g", run.values[i].f);
+	}
+	std::fprintf(file, "\n");
+}
+
+class Campaign {
+public:
+	Campaign(const Options& options):
+	  _options {options}, _environment {simulation::getEnvironment({"FC_SIM_SEED",
+	                                                                "FC_SIM_BIAS",
+	                                                                "FC_SIM_NOISE",
+	                                                                "FC_SIM_LATENCY",
+	                                                                "FC_SIM_WIND"})} {
+		// Nothing to do
+	}
+
+	bool run() {
+		if (!_writer.open(_options.output)) {
+			return false;
+		}
+		simulation::runAll(_options.runNumber, _options.jobNumber, [this](uint32_t run) {
+			Run result {fly(_options.seed + run)};
+			std::lock_guard<std::mutex> lock {_mutex};
+
+			_writer.add(result);
+			_summary.add(result);
+		});
+		return _writer.close();
+	}
+
+	const Summary& getSummary() const {
+		return _summary;
+	}
+
+protected:
+	const Options&     _options;
+	std::vector<char*> _environment;
+	std::mutex         _mutex {};
+	ResultsWriter      _writer {};
+	Summary            _summary {};
+
+	Run fly(uint32_t seed) {
+		std::mt19937             generator {seed};
+		std::vector<std::string> variables {"FC_SIM_SEED=" + std::to_string(seed)};
+		std::string              result {};
+		Run                      run {};
+
+		run.values[0].u = seed;
+		for (uint8_t i {0}; i < VARIATION_NUMBER; ++i) {
+			std::uniform_real_distribution<float> distribution {_options.ranges[i].min, _options.ranges[i].max};
+			char                                  value[24];
+
+			run.values[1 + i].f = _options.ranges[i].min == _options.ranges[i].max ? _options.ranges[i].min
+			                                                                        : distribution(generator);
+			std::snprintf(value, sizeof(value), "%.9g", run.values[1 + i].f);
+			variables.push_back(std::string {variableNames[i]} + '=' + value);
+		}
+
+		bool flown {simulation::fly(_options.simulator, _environment, variables, result)};
+		for (uint8_t i {1 + VARIATION_NUMBER}; i < COLUMN_NUMBER; ++i) {
+			if (!flown || !simulation::getField(result, columnNames[i], run.values[i].f)) {
+				run.values[i].f = NAN;
+			}
+		}
+		return run;
+	}
+};
+
+// "name=min:max" or "name=value"
+static bool parseRange(const char* str, Range* ranges) {
+	const char* separator {std::strchr(str, '=')};
+
+	if (!separator) {
+		return false;
+	}
+	for (uint8_t i {0}; i < VARIATION_NUMBER; ++i) {
+		const char* name {columnNames[1 + i]};
+
+		if (!std::strncmp(str, name, separator - str) && !name[separator - str]) {
+			char* end {nullptr};
+
+			ranges[i].min = std::strtof(separator + 1, &end);
+			ranges[i].max = *end == ':' ? std::strtof(end + 1, &end) : ranges[i].min;
+			return !*end && ranges[i].min >= 0 && ranges[i].min <= ranges[i].max;
+		}
+	}
+	return false;
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	int opt;
+
+	std::copy(std::begin(defaultRanges), std::end(defaultRanges), options.ranges);
+	while ((opt = getopt(argc, argv, "d:j:n:o:p:r:s:")) != -1) {
+		switch (opt) {
+			case 'd':
+				options.dumped = optarg;
+				break;
+			case 'j':
+				options.jobNumber = std::max(std::atoi(optarg), 1);
+				break;
+			case 'n':
+				options.runNumber = std::strtoul(optarg, nullptr, 0);
+				break;
+			case 'o':
+				options.output = optarg;
+				break;
+			case 'p':
+				options.summarized = optarg;
+				break;
+			case 'r':
+				if (!parseRange(optarg, options.ranges)) {
+					std::fprintf(stderr, "Invalid range: %s\n", optarg);
+					return false;
+				}
+				break;
+			case 's':
+				options.seed = std::strtoul(optarg, nullptr, 0);
+				break;
+			default:
+				return false;
+		}
+	}
+	if (options.dumped || options.summarized) {
+		return optind == argc;
+	}
+	if (optind + 1 != argc) {
+		return false;
+	}
+	options.simulator = argv[optind];
+	return true;
+}
+
+int main(int argc, char** argv) {
+	Options options {};
+
+	if (!parseOptions(argc, argv, options)) {
+		std::fprintf(
+		    stderr,
+		    "Usage: %s [-n runs] [-j jobs] [-s base seed] [-r name=min:max]... [-o results] simulator\n"
+		    "       %s -d results | -p results\n",
+		    argv[0],
+		    argv[0]
+		);
+		std::fprintf(stderr, "Variations:");
+		for (uint8_t i {0}; i < VARIATION_NUMBER; ++i) {
+			std::fprintf(stderr, " %s=%g:%g", columnNames[1 + i], defaultRanges[i].min, defaultRanges[i].max);
+		}
+		std::fprintf(stderr, "\n");
+		return 2;
+	}
+
+	if (options.dumped) {
+		for (const char* name : columnNames) {
+			std::printf(name == columnNames[0] ? "%s" : ",%s", name);
+		}
+		std::printf("\n");
+		if (!readResults(options.dumped, [](const Run& run) {
+			    printRun(stdout, run);
+		    })) {
+			std::fprintf(stderr, "%s: not a complete results file\n", options.dumped);
+			return 2;
+		}
+		return 0;
+	}
+	if (options.summarized) {
+		Summary summary {};
+
+		if (!readResults(options.summarized, [&summary](const Run& run) {
+			    summary.add(run);
+		    })) {
+			std::fprintf(stderr, "%s: not a complete results file\n", options.summarized);
+			return 2;
+		}
+		summary.print(stdout);
+		return 0;
+	}
+
+	if (access(options.simulator, X_OK)) {
+		std::perror(options.simulator);
+		return 2;
+	}
+
+	Campaign campaign {options};
+	auto     start {std::chrono::steady_clock::now()};
+	if (!campaign.run()) {
+		std::perror(options.output);
+		return 2;
+	}
+	double seconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+
+	campaign.getSummary().print(stdout);
+	std::fprintf(stderr, "%.1f s, %.0f runs/s\n", seconds, options.runNumber / seconds);
+	return 0;
+}
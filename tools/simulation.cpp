@@ -0,0 +1,171 @@
+#include "simulation.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+
+// Indices of the runs left in a share, the beginning in the low and the end in the high half,
+// so that the owner and the other threads agree with a single compare-and-swap
+struct alignas(64) Share {
+	std::atomic<uint64_t> runs {0};
+};
+
+static uint64_t toRuns(uint32_t begin, uint32_t end) {
+	return static_cast<uint64_t>(end) << 32u | begin;
+}
+
+static bool take(Share& share, uint32_t& run) {
+	uint64_t runs {share.runs.load()};
+
+	do {
+		if (static_cast<uint32_t>(runs) == static_cast<uint32_t>(runs >> 32u)) {
+			return false;
+		}
+		run = runs;
+	} while (!share.runs.compare_exchange_weak(runs, runs + 1));
+	return true;
+}
+
+// Moves the second half of the remaining runs of another share into the empty own one
+static bool steal(Share& from, Share& to) {
+	uint64_t runs {from.runs.load()};
+	uint32_t begin;
+	uint32_t end;
+	uint32_t count;
+
+	do {
+		begin = runs;
+		end = runs >> 32u;
+		count = (end - begin + 1) / 2;
+		if (!count) {
+			return false;
+		}
+	} while (!from.runs.compare_exchange_weak(runs, toRuns(begin, end - count)));
+
+	to.runs.store(toRuns(end - count, end));
+	return true;
+}
+
+static void work(
+    std::vector<Share>& shares, unsigned id, const std::function<void(uint32_t run)>& function
+) {
+	Share&   share {shares[id]};
+	uint32_t run;
+
+	for (;;) {
+		if (take(share, run)) {
+			function(run);
+			continue;
+		}
+
+		bool stolen {false};
+		for (unsigned i {1}; i < shares.size() && !stolen; ++i) {
+			stolen = steal(shares[(id + i) % shares.size()], share);
+		}
+		if (!stolen) {
+			return;
+		}
+	}
+}
+
+void simulation::runAll(uint32_t runNumber, unsigned jobNumber, const std::function<void(uint32_t run)>& function) {
+	std::vector<Share>       shares(jobNumber);
+	std::vector<std::thread> workers {};
+
+	for (unsigned i {0}; i < jobNumber; ++i) {
+		shares[i].runs.store(toRuns(uint64_t {runNumber} * i / jobNumber, uint64_t {runNumber} * (i + 1) / jobNumber));
+	}
+	for (unsigned i {0}; i < jobNumber; ++i) {
+		workers.emplace_back(work, std::ref(shares), i, std::cref(function));
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+std::vector<char*> simulation::getEnvironment(std::initializer_list<const char*> set) {
+	std::vector<char*> environment {};
+
+	for (char** variable {environ}; *variable; ++variable) {
+		bool passed {std::strncmp(*variable, "FC_", 3) != 0};
+
+		if (!std::strncmp(*variable, "FC_SIM_", 7) && std::strncmp(*variable, "FC_SIM_TRACE=", 13)) {
+			passed = true;
+			for (const char* name : set) {
+				size_t length {std::strlen(name)};
+
+				if (!std::strncmp(*variable, name, length) && (*variable)[length] == '=') {
+					passed = false;
+				}
+			}
+		}
+		if (passed) {
+			environment.push_back(*variable);
+		}
+	}
+	return environment;
+}
+
+bool simulation::fly(
+    const char*                     simulator,
+    const std::vector<char*>&       environment,
+    const std::vector<std::string>& variables,
+    std::string&                    result
+) {
+	std::vector<char*> envp {environment};
+	for (const auto& variable : variables) {
+		envp.push_back(const_cast<char*>(variable.c_str()));
+	}
+	envp.push_back(nullptr);
+
+	int                        fds[2];
+	pid_t                      pid;
+	posix_spawn_file_actions_t actions;
+	char* const                arguments[] {const_cast<char*>(simulator), nullptr};
+
+	if (pipe2(fds, O_CLOEXEC)) {  // Not inherited by the other runs started meanwhile
+		return false;
+	}
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+	int error {posix_spawn(&pid, simulator, &actions, nullptr, arguments, envp.data())};
+	posix_spawn_file_actions_destroy(&actions);
+	close(fds[1]);
+	if (error) {
+		close(fds[0]);
+		return false;
+	}
+
+	char    buffer[512];
+	ssize_t length;
+	result.clear();
+	while ((length = read(fds[0], buffer, sizeof(buffer))) > 0) {
+		result.append(buffer, length);
+	}
+	close(fds[0]);
+
+	int status {0};
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) && WEXITSTATUS(status) <= 1;  // 1 if the aircraft hit the ground
+}
+
+bool simulation::getField(const std::string& result, const char* name, float& value) {
+	size_t length {std::strlen(name)};
+
+	for (size_t position {result.find(name)}; position != std::string::npos; position = result.find(name, position + 1)) {
+		if ((!position || result[position - 1] == ' ') && result[position + length] == '=') {
+			value = std::strtof(result.c_str() + position + length + 1, nullptr);
+			return true;
+		}
+	}
+	return false;
+}
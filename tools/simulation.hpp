@@ -0,0 +1,46 @@
+/*
+ * File:   simulation.hpp
+ * Author: Mikhail
+ *
+ * Created on October 20, 2026, 1:10 AM
+ */
+
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+/* Running the simulator from the host tools, see host/simulator.cpp. The flight logic keeps its state in statics,
+ * so every flight is a simulator process of its own, started from a pool of threads.
+ */
+
+namespace simulation {
+	/* Calls the function for every run below the count from the given number of threads. Each thread starts with
+	 * an equal share of the runs and takes half of the remaining share of another one once done with its own.
+	 */
+	void runAll(uint32_t runNumber, unsigned jobNumber, const std::function<void(uint32_t run)>& function);
+
+	/* The environment of the tool to start the simulator with. FC_ variables are dropped except FC_SIM_ ones
+	 * not in the list, the tool sets those itself, and FC_SIM_TRACE, runs must not share a file or a port.
+	 */
+	std::vector<char*> getEnvironment(std::initializer_list<const char*> set);
+
+	/* Flies the simulator once with the variables ("NAME=value") added to the environment and reads its result line.
+	 * Returns false if it could not be started or did not finish the flight, hitting the ground is fine.
+	 */
+	bool fly(
+	    const char*                     simulator,
+	    const std::vector<char*>&       environment,
+	    const std::vector<std::string>& variables,
+	    std::string&                    result
+	);
+
+	// Value of "name=" in the result line
+	bool getField(const std::string& result, const char* name, float& value);
+}
+
+#endif /* SIMULATION_HPP */